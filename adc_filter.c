@@ -0,0 +1,158 @@
+#include "adc_filter.h"
+#include "hardware/sync.h"
+#include <stdio.h>
+#include <string.h>
+
+// Read in the sample clock interrupt (adc_filter_apply); changed together
+// from the main loop with interrupts disabled
+static adc_filter_mode_t mode = ADC_FILTER_NONE;
+static uint8_t param = 0;
+static uint8_t generation = 1;          // Zeroed filter state always starts fresh
+static uint32_t scan_period_us = ADC_FILTER_SCAN_PERIOD_US;
+static uint32_t report_interval_us = ADC_FILTER_REPORT_INTERVAL_US;
+
+static uint32_t delay_scans(adc_filter_mode_t filter_mode, uint8_t filter_param) {
+    switch (filter_mode) {
+        case ADC_FILTER_IIR:
+            return (1u << filter_param) - 1;
+        case ADC_FILTER_MEDIAN:
+            return (filter_param - 1) / 2;
+        default:
+            return 0;
+    }
+}
+
+static uint16_t median(const uint16_t* values, uint8_t count) {
+    uint16_t sorted[ADC_FILTER_MEDIAN_MAX];
+    for (uint8_t i = 0; i < count; i++) {
+        uint16_t value = values[i];
+        uint8_t j = i;
+        while (j > 0 && sorted[j - 1] > value) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = value;
+    }
+    return sorted[count / 2];
+}
+
+//--------------------------------------------------------------------+
+// CONFIGURATION
+//--------------------------------------------------------------------+
+// Group delay has to stay inside one report interval
+static bool delay_fits(adc_filter_mode_t filter_mode, uint8_t filter_param, uint32_t scan_us, uint32_t interval_us) {
+    return delay_scans(filter_mode, filter_param) * scan_us < interval_us;
+}
+
+// A tick between separate stores could see MEDIAN with param 0
+static void set_mode(adc_filter_mode_t new_mode, uint8_t new_param) {
+    uint32_t interrupts = save_and_disable_interrupts();
+    mode = new_mode;
+    param = new_param;
+    generation++;
+    if (generation == 0) generation = 1;
+    restore_interrupts(interrupts);
+}
+
+// After a timing change: keep the mode if it still fits, otherwise turn the filter off
+static bool recheck(void) {
+    if (delay_fits(mode, param, scan_period_us, report_interval_us)) {
+        return true;
+    }
+
+    printf("ADC filter: %lu us delay exceeds the %lu us report interval, filter off\n",
+           (unsigned long)adc_filter_get_delay_us(), (unsigned long)report_interval_us);
+    set_mode(ADC_FILTER_NONE, 0);
+    return false;
+}
+
+bool adc_filter_configure(adc_filter_mode_t new_mode, uint8_t new_param) {
+    switch (new_mode) {
+        case ADC_FILTER_NONE:
+            new_param = 0;
+            break;
+        case ADC_FILTER_IIR:
+            if (new_param < 1 || new_param > ADC_FILTER_IIR_SHIFT_MAX) return false;
+            break;
+        case ADC_FILTER_MEDIAN:
+            if (new_param != 3 && new_param != 5) return false;
+            break;
+        default:
+            return false;
+    }
+
+    if (!delay_fits(new_mode, new_param, scan_period_us, report_interval_us)) {
+        return false;
+    }
+
+    set_mode(new_mode, new_param);
+    return true;
+}
+
+bool adc_filter_set_scan_period(uint32_t new_scan_period_us) {
+    scan_period_us = new_scan_period_us;
+    return recheck();
+}
+
+bool adc_filter_set_report_interval(uint32_t new_report_interval_us) {
+    report_interval_us = new_report_interval_us;
+    return recheck();
+}
+
+adc_filter_mode_t adc_filter_get_mode(void) {
+    return mode;
+}
+
+uint8_t adc_filter_get_param(void) {
+    return param;
+}
+
+uint32_t adc_filter_get_delay_scans(void) {
+    return delay_scans(mode, param);
+}
+
+uint32_t adc_filter_get_delay_us(void) {
+    return delay_scans(mode, param) * scan_period_us;
+}
+
+//--------------------------------------------------------------------+
+// FILTERING
+//--------------------------------------------------------------------+
+uint16_t adc_filter_apply(adc_filter_t* filter, uint16_t value) {
+    if (filter->generation != generation) {
+        memset(filter, 0, sizeof(*filter));
+        filter->iir_state = (uint32_t)value << 8;
+        filter->generation = generation;
+    }
+
+    switch (mode) {
+        case ADC_FILTER_IIR: {
+            int32_t error = ((int32_t)value << 8) - (int32_t)filter->iir_state;
+            filter->iir_state = (uint32_t)((int32_t)filter->iir_state + (error >> param));
+            return (uint16_t)((filter->iir_state + 0x80) >> 8);
+        }
+        case ADC_FILTER_MEDIAN:
+            filter->history[filter->history_next] = value;
+            filter->history_next = (uint8_t)((filter->history_next + 1) % param);
+            if (filter->history_count < param) filter->history_count++;
+            return median(filter->history, filter->history_count);
+        default:
+            return value;
+    }
+}
+
+uint32_t adc_filter_format_mode(char* out, uint32_t size) {
+    int length;
+    switch (mode) {
+        case ADC_FILTER_IIR:
+            length = snprintf(out, size, "iir%u", param);
+            break;
+        case ADC_FILTER_MEDIAN:
+            length = snprintf(out, size, "median%u", param);
+            break;
+        default:
+            length = snprintf(out, size, "none");
+            break;
+    }
+    return (length < (int)size) ? (uint32_t)length : size - 1;
+}
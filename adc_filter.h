@@ -0,0 +1,68 @@
+#ifndef ADC_FILTER_H
+#define ADC_FILTER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Fixed-point smoothing for oversampled analog inputs.
+//
+// Runs once per input scan on the 16-bit oversampled value of a channel;
+// one mode applies to every channel:
+//   NONE      pass through
+//   IIR       one-pole low pass y += (x - y) / 2^k, k = 1-3; the state
+//             keeps 8 fraction bits. Group delay 2^k - 1 scans.
+//   MEDIAN    median of the last N scans, N = 3 or 5; drops single
+//             spikes. Group delay (N - 1) / 2 scans.
+// The group delay has to stay under one report interval. The module keeps
+// the current scan period and report interval: adc_filter_configure()
+// refuses a mode that would not fit them, and when either changes (CLOCK
+// period, USB mode) a mode that no longer fits falls back to NONE. With
+// the 1 ms sample clock and XInput's 8 ms reports the worst case (IIR
+// k = 3, 7 ms) fits; HID's 1 ms reports leave no room for a filter unless
+// the scan period is shortened.
+
+#define ADC_FILTER_IIR_SHIFT_MAX    3
+#define ADC_FILTER_MEDIAN_MAX       5
+#define ADC_FILTER_SCAN_PERIOD_US   1000    // Until adc_filter_set_scan_period()
+#define ADC_FILTER_REPORT_INTERVAL_US 8000  // Until adc_filter_set_report_interval()
+
+typedef enum {
+    ADC_FILTER_NONE = 0,
+    ADC_FILTER_IIR,
+    ADC_FILTER_MEDIAN
+} adc_filter_mode_t;
+
+// Per-channel state; zero-initialise, it resets itself when the mode changes
+typedef struct {
+    uint32_t iir_state;                         // Q16.8
+    uint16_t history[ADC_FILTER_MEDIAN_MAX];
+    uint8_t history_count;
+    uint8_t history_next;
+    uint8_t generation;                         // Mode it was last run with
+} adc_filter_t;
+
+// Filter functions
+bool adc_filter_configure(adc_filter_mode_t mode, uint8_t param);   // false: invalid or too slow
+adc_filter_mode_t adc_filter_get_mode(void);
+uint8_t adc_filter_get_param(void);
+uint32_t adc_filter_get_delay_scans(void);
+uint32_t adc_filter_get_delay_us(void);
+
+// Timing the delay is checked against; false if the mode had to fall back to NONE
+bool adc_filter_set_scan_period(uint32_t scan_period_us);
+bool adc_filter_set_report_interval(uint32_t report_interval_us);
+
+uint16_t adc_filter_apply(adc_filter_t* filter, uint16_t value);
+
+// "none", "iir2", "median5"... for reports and commands
+uint32_t adc_filter_format_mode(char* out, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ADC_FILTER_H
@@ -0,0 +1,222 @@
+#include "adc_stream.h"
+#include "pico/stdlib.h"
+#include "hardware/adc.h"
+#include "hardware/dma.h"
+#include "hardware/sync.h"
+#include <stdio.h>
+#include <string.h>
+
+#define ADC_STREAM_RING_SIZE    (ADC_STREAM_CHANNELS * ADC_STREAM_ROUNDS)
+#define ADC_STREAM_RING_MASK    (ADC_STREAM_RING_SIZE - 1)
+#define ADC_STREAM_RING_BITS    10      // log2 of the ring size in bytes
+#define ADC_STREAM_BLOCK        4096    // Conversions per DMA block (multiple of the channel count)
+
+// The DMA ring wraps on its own size, so it has to be aligned to it
+static uint16_t ring[ADC_STREAM_RING_SIZE] __attribute__((aligned(1 << ADC_STREAM_RING_BITS)));
+static const uint32_t block_count = ADC_STREAM_BLOCK;
+
+static uint32_t ratio = ADC_STREAM_RATIO_DEFAULT;
+static uint8_t ratio_shift = 5;         // log2(ratio)
+
+static int data_chan = -1;
+static int ctrl_chan = -1;
+static bool running = false;
+
+static uint32_t restart_count = 0;
+static uint32_t report_count = 0;
+static uint32_t age_max_us = 0;
+static uint64_t age_total_us = 0;
+
+static void stream_begin(void) {
+    // Data: ADC FIFO -> ring, paced by the ADC, re-armed by the control channel
+    dma_channel_config data = dma_channel_get_default_config((uint)data_chan);
+    channel_config_set_transfer_data_size(&data, DMA_SIZE_16);
+    channel_config_set_read_increment(&data, false);
+    channel_config_set_write_increment(&data, true);
+    channel_config_set_ring(&data, true, ADC_STREAM_RING_BITS);
+    channel_config_set_dreq(&data, DREQ_ADC);
+    channel_config_set_chain_to(&data, (uint)ctrl_chan);
+    dma_channel_configure((uint)data_chan, &data, ring, &adc_hw->fifo, ADC_STREAM_BLOCK, true);
+
+    // Control: writes the block count back into the data channel's trigger
+    dma_channel_config ctrl = dma_channel_get_default_config((uint)ctrl_chan);
+    channel_config_set_transfer_data_size(&ctrl, DMA_SIZE_32);
+    channel_config_set_read_increment(&ctrl, false);
+    channel_config_set_write_increment(&ctrl, false);
+    dma_channel_configure((uint)ctrl_chan, &ctrl, &dma_channel_hw_addr((uint)data_chan)->al1_transfer_count_trig,
+                          &block_count, 1, false);
+
+    // Every round starts at ADC0, so ring slot N stays channel N
+    adc_select_input(0);
+    adc_set_round_robin((1u << ADC_STREAM_CHANNELS) - 1);
+    adc_fifo_setup(true, true, 1, false, false);
+    adc_set_clkdiv(48000000.0f / ADC_STREAM_RATE_HZ - 1.0f);
+    adc_run(true);
+}
+
+static void stream_end(void) {
+    adc_run(false);
+
+    // Aborting the data channel can fire its chain; the second pass catches it
+    dma_channel_abort((uint)data_chan);
+    dma_channel_abort((uint)ctrl_chan);
+    dma_channel_abort((uint)data_chan);
+    adc_set_round_robin(0);
+    adc_fifo_setup(false, false, 0, false, false);
+    adc_fifo_drain();
+}
+
+//--------------------------------------------------------------------+
+// STREAM CONTROL
+//--------------------------------------------------------------------+
+bool adc_stream_start(void) {
+    if (running) {
+        return true;
+    }
+
+    if (data_chan < 0) {
+        data_chan = dma_claim_unused_channel(false);
+        ctrl_chan = dma_claim_unused_channel(false);
+        if (data_chan < 0 || ctrl_chan < 0) {
+            printf("ADC stream: No free DMA channels, using blocking reads\n");
+            if (data_chan >= 0) dma_channel_unclaim((uint)data_chan);
+            if (ctrl_chan >= 0) dma_channel_unclaim((uint)ctrl_chan);
+            data_chan = ctrl_chan = -1;
+            return false;
+        }
+    }
+
+    memset(ring, 0, sizeof(ring));
+    stream_begin();
+    running = true;
+    return true;
+}
+
+void adc_stream_stop(void) {
+    if (running) {
+        running = false;
+        stream_end();
+    }
+}
+
+bool adc_stream_running(void) {
+    return running;
+}
+
+// Newest ring slot of a channel, and how many conversions came after it
+static uint32_t latest_slot(uint8_t channel, uint32_t* behind) {
+    // A dropped conversion would shift every channel to the wrong slot
+    if (adc_hw->fcs & ADC_FCS_OVER_BITS) {
+        stream_end();
+        hw_set_bits(&adc_hw->fcs, ADC_FCS_OVER_BITS | ADC_FCS_UNDER_BITS);
+        stream_begin();
+        restart_count++;
+    }
+
+    uint32_t next = (uint32_t)((uintptr_t)dma_channel_hw_addr((uint)data_chan)->write_addr -
+                               (uintptr_t)ring) / sizeof(ring[0]);
+    *behind = (next - 1 - channel) & (ADC_STREAM_CHANNELS - 1);
+    return (next - 1 - *behind) & ADC_STREAM_RING_MASK;
+}
+
+uint16_t adc_stream_read(uint8_t channel, uint32_t* age_us) {
+    channel &= ADC_STREAM_CHANNELS - 1;
+
+    if (!running) {
+        adc_select_input(channel);
+        if (age_us) *age_us = 0;
+        return adc_read();
+    }
+
+    uint32_t behind;
+    uint32_t slot = latest_slot(channel, &behind);
+    if (age_us) *age_us = (behind + 1) * ADC_STREAM_CONVERSION_US;
+    return ring[slot];
+}
+
+uint16_t adc_stream_read_oversampled(uint8_t channel, uint32_t* age_us) {
+    channel &= ADC_STREAM_CHANNELS - 1;
+
+    if (!running) {
+        return (uint16_t)(adc_stream_read(channel, age_us) << 4);
+    }
+
+    uint32_t behind;
+    uint32_t slot = latest_slot(channel, &behind);
+    uint32_t count = ratio;
+    uint32_t sum = 0;
+
+    // The ring holds twice the longest window, so DMA never laps the read
+    for (uint32_t i = 0; i < count; i++) {
+        sum += ring[(slot - i * ADC_STREAM_CHANNELS) & ADC_STREAM_RING_MASK];
+    }
+
+    if (age_us) *age_us = (behind + 1) * ADC_STREAM_CONVERSION_US + adc_stream_get_delay_us();
+
+    // Scale the sum to 16 bits: the 12-bit mean plus up to 4 fraction bits
+    return (uint16_t)((ratio_shift <= 4) ? sum << (4 - ratio_shift) : sum >> (ratio_shift - 4));
+}
+
+bool adc_stream_set_ratio(uint32_t new_ratio) {
+    if (new_ratio == 0 || new_ratio > ADC_STREAM_RATIO_MAX || (new_ratio & (new_ratio - 1))) {
+        return false;
+    }
+
+    uint8_t shift = 0;
+    while ((1u << shift) < new_ratio) shift++;
+
+    uint32_t interrupts = save_and_disable_interrupts();
+    ratio = new_ratio;
+    ratio_shift = shift;
+    restore_interrupts(interrupts);
+    return true;
+}
+
+uint32_t adc_stream_get_ratio(void) {
+    return ratio;
+}
+
+uint32_t adc_stream_get_delay_us(void) {
+    return (ratio - 1) * ADC_STREAM_ROUND_US / 2;
+}
+
+//--------------------------------------------------------------------+
+// STATISTICS
+//--------------------------------------------------------------------+
+void adc_stream_report_built(uint32_t age_us) {
+    report_count++;
+    age_total_us += age_us;
+    if (age_us > age_max_us) age_max_us = age_us;
+}
+
+void adc_stream_get_stats(adc_stream_stats_t* stats) {
+    uint32_t interrupts = save_and_disable_interrupts();
+    stats->restarts = restart_count;
+    stats->reports = report_count;
+    stats->age_max_us = age_max_us;
+    stats->age_mean_us = report_count ? (uint32_t)(age_total_us / report_count) : 0;
+    restore_interrupts(interrupts);
+}
+
+void adc_stream_reset_stats(void) {
+    uint32_t interrupts = save_and_disable_interrupts();
+    restart_count = 0;
+    report_count = 0;
+    age_max_us = 0;
+    age_total_us = 0;
+    restore_interrupts(interrupts);
+}
+
+uint32_t adc_stream_format_report(char* out, uint32_t size) {
+    adc_stream_stats_t stats;
+    adc_stream_get_stats(&stats);
+
+    int length = snprintf(out, size,
+                          "ADC %s rate_hz %lu ratio %lu delay_us %lu restarts %lu reports %lu age_max_us %lu "
+                          "age_mean_us %lu\n",
+                          running ? "dma" : "blocking", (unsigned long)ADC_STREAM_RATE_HZ, (unsigned long)ratio,
+                          (unsigned long)adc_stream_get_delay_us(),
+                          (unsigned long)stats.restarts, (unsigned long)stats.reports,
+                          (unsigned long)stats.age_max_us, (unsigned long)stats.age_mean_us);
+    return (length < (int)size) ? (uint32_t)length : size - 1;
+}
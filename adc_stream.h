@@ -0,0 +1,79 @@
+#ifndef ADC_STREAM_H
+#define ADC_STREAM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Free-running ADC with DMA into a ring.
+//
+// The ADC converts ADC0-3 round robin on its own clock and a DMA channel
+// moves every result into a ring of ADC_STREAM_ROUNDS rounds, so ring slot
+// N holds ADC channel N modulo four. A second DMA channel re-arms the first
+// when its block ends, so the stream never stops. Reading a channel is a
+// plain memory read: no channel select, no wait for a conversion.
+//
+// Oversampling: adc_stream_read_oversampled() averages the channel's last
+// `ratio` conversions (a power of 2, 1-64) and returns the mean scaled to
+// 16 bits, so noise shrinks by sqrt(ratio) and the resolution grows to
+// 12 + log4(ratio) bits. The average is a boxcar whose group delay is half
+// its length: (ratio - 1) / 2 rounds of ADC_STREAM_CHANNELS conversions,
+// 620 us at the default ratio of 32, whose window spans one 1 ms scan.
+//
+// The age of a sample follows from the DMA write position: a channel is at
+// most (conversions since it was written + 1) conversion periods old; for
+// an oversampled read the group delay is added. The age of the analog data
+// in every submitted report is kept for the "ADC" text command.
+//
+// Until adc_stream_start() succeeds, reads fall back to a blocking
+// adc_read() (age 0).
+
+#define ADC_STREAM_CHANNELS     4       // One ring slot per ADC input (power of 2)
+#define ADC_STREAM_ROUNDS       128     // Conversions of each channel kept (power of 2)
+#define ADC_STREAM_RATIO_MAX    64
+#define ADC_STREAM_RATIO_DEFAULT 32
+#define ADC_STREAM_RATE_HZ      100000  // Conversions per second over all channels
+#define ADC_STREAM_CONVERSION_US (1000000 / ADC_STREAM_RATE_HZ)
+#define ADC_STREAM_ROUND_US     (ADC_STREAM_CHANNELS * ADC_STREAM_CONVERSION_US)
+#define ADC_STREAM_REPORT_MAX   192
+
+typedef struct {
+    uint32_t restarts;          // FIFO overflows that needed a resync
+    uint32_t reports;           // Reports whose analog age was recorded
+    uint32_t age_max_us;        // Oldest analog data in a submitted report
+    uint32_t age_mean_us;
+} adc_stream_stats_t;
+
+// Stream functions
+bool adc_stream_start(void);    // adc_init() and adc_gpio_init() first
+void adc_stream_stop(void);
+bool adc_stream_running(void);
+
+// Latest sample of an ADC channel (0-3) without waiting, and its age bound
+uint16_t adc_stream_read(uint8_t channel, uint32_t* age_us);
+
+// Mean of the last `ratio` samples as 0-65520 (raw << 4 at ratio 1); the
+// age includes the boxcar group delay
+uint16_t adc_stream_read_oversampled(uint8_t channel, uint32_t* age_us);
+bool adc_stream_set_ratio(uint32_t ratio);  // false unless a power of 2 up to the max
+uint32_t adc_stream_get_ratio(void);
+uint32_t adc_stream_get_delay_us(void);     // Boxcar group delay
+
+// A report carrying analog data of this age was handed to the USB stack
+void adc_stream_report_built(uint32_t age_us);
+
+// Statistics
+void adc_stream_get_stats(adc_stream_stats_t* stats);
+void adc_stream_reset_stats(void);
+
+// Render the text report ("ADC" command), returns its length
+uint32_t adc_stream_format_report(char* out, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ADC_STREAM_H
@@ -0,0 +1,366 @@
+#!/usr/bin/env python3
+"""
+BGG Serial Client
+Host side of the framed binary CDC protocol (see binary_protocol.h).
+
+Frames are 0x00 <COBS body> 0x00 with a 6 byte header, payload and CRC32.
+Reads are pipelined: several FILE_READ requests are kept in flight and
+matched to their replies by request ID.
+
+Usage:
+    python bgg_serial_client.py COM5 list
+    python bgg_serial_client.py COM5 get config.json [output]
+    python bgg_serial_client.py COM5 put config.json input
+    python bgg_serial_client.py COM5 perf
+    python bgg_serial_client.py COM5 latency
+    python bgg_serial_client.py COM5 rx
+    python bgg_serial_client.py COM5 mode [xinput|hid]   (hid/xinput re-enumerate)
+    python bgg_serial_client.py COM5 trace arm|stop|info
+    python bgg_serial_client.py COM5 trace save trace.bin   (replay with sim/bgg_replay)
+"""
+
+import struct
+import sys
+
+OP_PING = 0x01
+OP_VERSION = 0x02
+OP_FILE_LIST = 0x10
+OP_FILE_INFO = 0x11
+OP_FILE_READ = 0x12
+OP_FILE_WRITE_BEGIN = 0x13
+OP_FILE_WRITE_DATA = 0x14
+OP_FILE_WRITE_COMMIT = 0x15
+OP_FILE_WRITE_ABORT = 0x16
+OP_PERF = 0x20
+OP_PERF_RESET = 0x21
+OP_LATENCY = 0x22
+OP_LATENCY_RESET = 0x23
+OP_TRACE_INFO = 0x24
+OP_TRACE_ARM = 0x25
+OP_TRACE_READ = 0x26
+OP_RX_STATS = 0x27
+RESPONSE = 0x80
+
+MAX_PAYLOAD = 240
+PIPELINE_DEPTH = 4
+
+STATUS_NAMES = ["OK", "BAD_CRC", "BAD_LENGTH", "UNKNOWN_OPCODE",
+                "NOT_FOUND", "BAD_OFFSET", "BAD_STATE", "IO_ERROR", "BUSY"]
+
+
+def _make_crc_table():
+    table = []
+    for i in range(256):
+        crc = i << 24
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x04C11DB7) if crc & 0x80000000 else (crc << 1)
+        table.append(crc & 0xFFFFFFFF)
+    return table
+
+
+CRC_TABLE = _make_crc_table()
+
+
+def crc32(data, crc=0):
+    """CRC32 as computed by config_storage_crc32_update() in the firmware"""
+    crc ^= 0xFFFFFFFF
+    for byte in data:
+        crc = (crc >> 8) ^ CRC_TABLE[(crc ^ byte) & 0xFF]
+    return crc ^ 0xFFFFFFFF
+
+
+def cobs_encode(data):
+    out = bytearray([0])
+    code_pos = 0
+    code = 1
+    for byte in data:
+        if byte == 0:
+            out[code_pos] = code
+            code_pos = len(out)
+            out.append(0)
+            code = 1
+        else:
+            out.append(byte)
+            code += 1
+            if code == 0xFF:
+                out[code_pos] = code
+                code_pos = len(out)
+                out.append(0)
+                code = 1
+    out[code_pos] = code
+    return bytes(out)
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            raise ValueError("malformed COBS frame")
+        out += data[i + 1:i + code]
+        i += code
+        if code != 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+class ProtocolError(Exception):
+    pass
+
+
+class BGGSerialClient:
+    def __init__(self, port):
+        """port: object with read(n) and write(data), e.g. serial.Serial"""
+        self.port = port
+        self.next_id = 1
+        self.rx = bytearray()
+
+    def send(self, opcode, payload=b""):
+        request_id = self.next_id
+        self.next_id = (self.next_id + 1) & 0xFFFF
+        body = struct.pack("<BBHH", opcode, 0, request_id, len(payload)) + payload
+        body += struct.pack("<I", crc32(body))
+        self.port.write(b"\x00" + cobs_encode(body) + b"\x00")
+        return request_id
+
+    def receive(self):
+        """Return (opcode, status, request_id, payload) of the next frame"""
+        while True:
+            start = self.rx.find(b"\x00")
+            if start >= 0:
+                end = self.rx.find(b"\x00", start + 1)
+                while end == start + 1:
+                    start = end
+                    end = self.rx.find(b"\x00", start + 1)
+                if end > start:
+                    encoded = bytes(self.rx[start + 1:end])
+                    del self.rx[:end + 1]
+                    body = cobs_decode(encoded)
+                    if len(body) < 10 or crc32(body[:-4]) != struct.unpack("<I", body[-4:])[0]:
+                        raise ProtocolError("corrupt response frame")
+                    opcode, status, request_id, length = struct.unpack("<BBHH", body[:6])
+                    return opcode, status, request_id, body[6:6 + length]
+            chunk = self.port.read(256)
+            if not chunk:
+                raise ProtocolError("timeout waiting for response")
+            self.rx += chunk
+
+    def request(self, opcode, payload=b""):
+        request_id = self.send(opcode, payload)
+        return self.expect(opcode, request_id)
+
+    def expect(self, opcode, request_id):
+        got_op, status, got_id, payload = self.receive()
+        if got_id != request_id or got_op != (opcode | RESPONSE):
+            raise ProtocolError("unexpected response 0x%02X id %d" % (got_op, got_id))
+        if status != 0:
+            name = STATUS_NAMES[status] if status < len(STATUS_NAMES) else str(status)
+            raise ProtocolError("request 0x%02X failed: %s" % (opcode, name))
+        return payload
+
+    def version(self):
+        return self.request(OP_VERSION).decode()
+
+    def list_files(self):
+        data = self.request(OP_FILE_LIST)
+        files = []
+        pos = 0
+        while pos < len(data):
+            size, name_len = struct.unpack("<IB", data[pos:pos + 5])
+            files.append((data[pos + 5:pos + 5 + name_len].decode(), size))
+            pos += 5 + name_len
+        return files
+
+    def file_info(self, name):
+        return struct.unpack("<II", self.request(OP_FILE_INFO, name.encode()))
+
+    def read_file(self, name):
+        size, crc = self.file_info(name)
+        pending = []
+        offset = 0
+        content = bytearray()
+        while offset < size or pending:
+            # Keep the pipeline full
+            while offset < size and len(pending) < PIPELINE_DEPTH:
+                payload = struct.pack("<IH", offset, MAX_PAYLOAD) + name.encode()
+                pending.append(self.send(OP_FILE_READ, payload))
+                offset += MAX_PAYLOAD
+            content += self.expect(OP_FILE_READ, pending.pop(0))
+        if len(content) != size or crc32(content) != crc:
+            raise ProtocolError("CRC mismatch reading %s" % name)
+        return bytes(content)
+
+    def write_file(self, name, content):
+        self.request(OP_FILE_WRITE_BEGIN, name.encode())
+        try:
+            pending = []
+            chunk_size = MAX_PAYLOAD - 4
+            for offset in range(0, len(content), chunk_size):
+                chunk = content[offset:offset + chunk_size]
+                pending.append(self.send(OP_FILE_WRITE_DATA, struct.pack("<I", offset) + chunk))
+                if len(pending) >= PIPELINE_DEPTH:
+                    self.expect(OP_FILE_WRITE_DATA, pending.pop(0))
+            for request_id in pending:
+                self.expect(OP_FILE_WRITE_DATA, request_id)
+        except ProtocolError:
+            self.request(OP_FILE_WRITE_ABORT)
+            raise
+        self.request(OP_FILE_WRITE_COMMIT, struct.pack("<II", len(content), crc32(content)))
+
+    def perf_stages(self):
+        """Per-stage loop timings: list of dicts with times in microseconds"""
+        stages = []
+        index = 0
+        stage_count = 1
+        while index < stage_count:
+            data = self.request(OP_PERF, bytes([index]))
+            _, stage_count, mhz, count, low, high, total = struct.unpack("<BBIIIIQ", data[:26])
+            histogram = struct.unpack("<25I", data[26:126])
+            stages.append({
+                "name": data[126:].decode(),
+                "count": count,
+                "min_us": low / mhz,
+                "mean_us": (total / count / mhz) if count else 0.0,
+                "max_us": high / mhz,
+                "histogram": histogram,
+            })
+            index += 1
+        return stages
+
+    def latency_classes(self):
+        """Input-to-USB latency per input class: list of dicts in microseconds"""
+        classes = []
+        index = 0
+        class_count = 1
+        while index < class_count:
+            data = self.request(OP_LATENCY, bytes([index]))
+            _, class_count, count, p50, p99, high, build = struct.unpack("<BBIIIII", data[:22])
+            classes.append({
+                "name": data[22:].decode(),
+                "count": count,
+                "p50_us": p50,
+                "p99_us": p99,
+                "max_us": high,
+                "build_us": build,
+            })
+            index += 1
+        return classes
+
+    def rx_stats(self):
+        """Config port receive counters, including lines and frames dropped for size"""
+        names = ("bytes", "lines", "frames", "line_overflows", "frame_overflows", "partial_spans")
+        return dict(zip(names, struct.unpack("<6I", self.request(OP_RX_STATS))))
+
+    def command(self, line):
+        """Send a text command (see file_emulation.c) and return its one-line reply"""
+        self.port.write(line.encode() + b"\n")
+        while b"\n" not in self.rx:
+            chunk = self.port.read(256)
+            if not chunk:
+                raise ProtocolError("timeout waiting for reply to %s" % line)
+            self.rx += chunk
+        end = self.rx.index(b"\n")
+        reply = bytes(self.rx[:end]).decode(errors="replace").strip()
+        del self.rx[:end + 1]
+        return reply
+
+    def mode(self, mode=None):
+        """Current USB mode, or save a new one ("xinput" or "hid"); the device then re-enumerates"""
+        if mode is None:
+            reply = self.command("MODE")
+            if not reply.startswith("MODE "):
+                raise ProtocolError(reply)
+            return reply[5:]
+        reply = self.command("MODE:" + mode.upper())
+        if reply != "OK":
+            raise ProtocolError(reply)
+        return mode.lower()
+
+    def trace_info(self):
+        armed, count, dropped, capacity, size = struct.unpack("<BIIII", self.request(OP_TRACE_INFO))
+        return {"armed": bool(armed), "count": count, "dropped": dropped,
+                "capacity": capacity, "size": size}
+
+    def trace_arm(self, arm=True):
+        self.request(OP_TRACE_ARM, bytes([1 if arm else 0]))
+
+    def read_trace(self):
+        """Stop the input trace and download its image"""
+        self.trace_arm(False)
+        size = self.trace_info()["size"]
+        pending = []
+        offset = 0
+        image = bytearray()
+        while offset < size or pending:
+            while offset < size and len(pending) < PIPELINE_DEPTH:
+                pending.append(self.send(OP_TRACE_READ, struct.pack("<IH", offset, MAX_PAYLOAD)))
+                offset += MAX_PAYLOAD
+            image += self.expect(OP_TRACE_READ, pending.pop(0))
+        if len(image) != size:
+            raise ProtocolError("trace image truncated")
+        return bytes(image)
+
+
+def main():
+    if len(sys.argv) < 3:
+        print(__doc__)
+        sys.exit(1)
+
+    import serial
+    port = serial.Serial(sys.argv[1], 115200, timeout=2)
+    client = BGGSerialClient(port)
+    command = sys.argv[2]
+
+    if command == "list":
+        print(client.version())
+        for name, size in client.list_files():
+            print("%-24s %6d bytes" % (name, size))
+    elif command == "get":
+        content = client.read_file(sys.argv[3])
+        if len(sys.argv) > 4:
+            with open(sys.argv[4], "wb") as f:
+                f.write(content)
+        else:
+            sys.stdout.write(content.decode(errors="replace"))
+    elif command == "put":
+        with open(sys.argv[4], "rb") as f:
+            client.write_file(sys.argv[3], f.read())
+        print("Wrote %s" % sys.argv[3])
+    elif command == "perf":
+        for stage in client.perf_stages():
+            print("%-8s %8d %10.2f %10.2f %10.2f" % (stage["name"], stage["count"],
+                  stage["min_us"], stage["mean_us"], stage["max_us"]))
+    elif command == "latency":
+        for entry in client.latency_classes():
+            print("%-8s %8d %8d %8d %8d %8d" % (entry["name"], entry["count"], entry["p50_us"],
+                  entry["p99_us"], entry["max_us"], entry["build_us"]))
+    elif command == "rx":
+        for name, value in client.rx_stats().items():
+            print("%-16s %d" % (name, value))
+    elif command == "mode":
+        if len(sys.argv) > 3:
+            client.mode(sys.argv[3])
+            print("USB mode %s, re-enumerating" % sys.argv[3].lower())
+        else:
+            print("USB mode %s" % client.mode())
+    elif command == "trace":
+        action = sys.argv[3] if len(sys.argv) > 3 else "info"
+        if action == "arm":
+            client.trace_arm(True)
+        elif action == "stop":
+            client.trace_arm(False)
+        elif action == "save":
+            image = client.read_trace()
+            with open(sys.argv[4], "wb") as f:
+                f.write(image)
+        info = client.trace_info()
+        print("%s, %d records, %d dropped, capacity %d" % ("armed" if info["armed"] else "stopped",
+              info["count"], info["dropped"], info["capacity"]))
+    else:
+        print(__doc__)
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,552 @@
+#include "binary_protocol.h"
+#include "file_emulation.h"
+#include "config_storage.h"
+#include "cdc_tx.h"
+#include "cdc_rx.h"
+#include "perf.h"
+#include "latency.h"
+#include "input_trace.h"
+#include "tusb.h"
+#include <stdio.h>
+#include <string.h>
+
+#define BIN_PROTO_VERSION_STRING  "BGG XInput Firmware v1.0"
+
+typedef void (*bin_handler_t)(uint16_t request_id, const uint8_t* payload, uint16_t length);
+
+typedef struct {
+    uint8_t opcode;
+    bin_handler_t handler;
+} bin_command_t;
+
+// Binary file write state; token is file_emu's name for this write, so a
+// write that ended underneath (aborted, or a new one began) is noticed
+static struct {
+    bool active;
+    uint32_t token;
+    uint32_t size;
+    uint32_t crc;
+} bin_write;
+
+static uint32_t frame_count = 0;
+static uint32_t error_count = 0;
+
+//--------------------------------------------------------------------+
+// FRAMING
+//--------------------------------------------------------------------+
+static inline uint16_t get_u16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t get_u32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void put_u16(uint8_t* p, uint16_t value) {
+    p[0] = value & 0xFF;
+    p[1] = value >> 8;
+}
+
+static inline void put_u32(uint8_t* p, uint32_t value) {
+    p[0] = value & 0xFF;
+    p[1] = (value >> 8) & 0xFF;
+    p[2] = (value >> 16) & 0xFF;
+    p[3] = value >> 24;
+}
+
+// COBS decode in place, returns decoded length or -1 if malformed
+static int cobs_decode(uint8_t* data, uint32_t length) {
+    uint32_t in = 0;
+    uint32_t out = 0;
+
+    while (in < length) {
+        uint8_t code = data[in++];
+        if (code == 0 || in + code - 1 > length) {
+            return -1;
+        }
+        for (uint8_t i = 1; i < code; i++) {
+            data[out++] = data[in++];
+        }
+        if (code != 0xFF && in < length) {
+            data[out++] = 0;
+        }
+    }
+    return (int)out;
+}
+
+// COBS encode, returns encoded length (without delimiters)
+static uint32_t cobs_encode(const uint8_t* data, uint32_t length, uint8_t* out) {
+    uint32_t code_pos = 0;
+    uint32_t pos = 1;
+    uint8_t code = 1;
+
+    for (uint32_t i = 0; i < length; i++) {
+        if (data[i] == 0) {
+            out[code_pos] = code;
+            code_pos = pos++;
+            code = 1;
+        } else {
+            out[pos++] = data[i];
+            if (++code == 0xFF) {
+                out[code_pos] = code;
+                code_pos = pos++;
+                code = 1;
+            }
+        }
+    }
+    out[code_pos] = code;
+    return pos;
+}
+
+bool bin_proto_send(uint8_t opcode, uint8_t status, uint16_t request_id, const void* payload, uint16_t length) {
+    static uint8_t frame[BIN_PROTO_MAX_FRAME];
+    static uint8_t encoded[BIN_PROTO_MAX_ENCODED];
+
+    if (length > BIN_PROTO_MAX_PAYLOAD) {
+        return false;
+    }
+
+    frame[0] = opcode;
+    frame[1] = status;
+    put_u16(&frame[2], request_id);
+    put_u16(&frame[4], length);
+    if (length > 0) {
+        memcpy(&frame[BIN_PROTO_HEADER_SIZE], payload, length);
+    }
+    uint32_t body = BIN_PROTO_HEADER_SIZE + length;
+    put_u32(&frame[body], config_storage_calculate_crc32(frame, body));
+
+    encoded[0] = BIN_PROTO_DELIMITER;
+    uint32_t size = 1 + cobs_encode(frame, body + BIN_PROTO_CRC_SIZE, &encoded[1]);
+    encoded[size++] = BIN_PROTO_DELIMITER;
+
+    if (!tud_cdc_connected()) {
+        return false;
+    }
+    return cdc_tx_write(encoded, size);
+}
+
+static inline void send_status(uint8_t opcode, uint16_t request_id, bin_proto_status_t status) {
+    bin_proto_send(opcode | BIN_PROTO_RESPONSE, (uint8_t)status, request_id, NULL, 0);
+}
+
+// Copy a length-delimited file name out of a payload
+static bool payload_filename(const uint8_t* data, uint16_t length, char* filename) {
+    if (length == 0 || length >= MAX_FILENAME_LENGTH) {
+        return false;
+    }
+    memcpy(filename, data, length);
+    filename[length] = '\0';
+    return true;
+}
+
+//--------------------------------------------------------------------+
+// REQUEST HANDLERS
+//--------------------------------------------------------------------+
+static void handle_ping(uint16_t request_id, const uint8_t* payload, uint16_t length) {
+    bin_proto_send(BIN_OP_PING | BIN_PROTO_RESPONSE, BIN_STATUS_OK, request_id, payload, length);
+}
+
+static void handle_version(uint16_t request_id, const uint8_t* payload, uint16_t length) {
+    (void)payload;
+    (void)length;
+    bin_proto_send(BIN_OP_VERSION | BIN_PROTO_RESPONSE, BIN_STATUS_OK, request_id,
+                   BIN_PROTO_VERSION_STRING, sizeof(BIN_PROTO_VERSION_STRING) - 1);
+}
+
+static void handle_file_list(uint16_t request_id, const uint8_t* payload, uint16_t length) {
+    (void)payload;
+    (void)length;
+
+    uint8_t out[BIN_PROTO_MAX_PAYLOAD];
+    uint16_t pos = 0;
+
+    for (uint32_t i = 0; i < MAX_VIRTUAL_FILES; i++) {
+        const char* name = file_emu_get_file_name(i);
+        if (!name) continue;
+
+        uint32_t size = 0;
+        file_emu_get_size(name, &size);
+        uint8_t name_len = (uint8_t)strlen(name);
+        if ((uint32_t)pos + 5 + name_len > sizeof(out)) break;
+
+        put_u32(&out[pos], size);
+        out[pos + 4] = name_len;
+        memcpy(&out[pos + 5], name, name_len);
+        pos += 5 + name_len;
+    }
+
+    bin_proto_send(BIN_OP_FILE_LIST | BIN_PROTO_RESPONSE, BIN_STATUS_OK, request_id, out, pos);
+}
+
+static void handle_file_info(uint16_t request_id, const uint8_t* payload, uint16_t length) {
+    char filename[MAX_FILENAME_LENGTH];
+    uint32_t size;
+
+    if (!payload_filename(payload, length, filename)) {
+        send_status(BIN_OP_FILE_INFO, request_id, BIN_STATUS_BAD_LENGTH);
+        return;
+    }
+    if (!file_emu_get_size(filename, &size)) {
+        send_status(BIN_OP_FILE_INFO, request_id, BIN_STATUS_NOT_FOUND);
+        return;
+    }
+
+    uint8_t chunk[64];
+    uint32_t crc = 0;
+    for (uint32_t offset = 0; offset < size; ) {
+        uint32_t count = file_emu_read_at(filename, offset, chunk, sizeof(chunk));
+        if (count == 0) break;
+        crc = config_storage_crc32_update(crc, chunk, count);
+        offset += count;
+    }
+
+    uint8_t out[8];
+    put_u32(&out[0], size);
+    put_u32(&out[4], crc);
+    bin_proto_send(BIN_OP_FILE_INFO | BIN_PROTO_RESPONSE, BIN_STATUS_OK, request_id, out, sizeof(out));
+}
+
+static void handle_file_read(uint16_t request_id, const uint8_t* payload, uint16_t length) {
+    char filename[MAX_FILENAME_LENGTH];
+    uint32_t size;
+
+    if (length < 6 || !payload_filename(payload + 6, length - 6, filename)) {
+        send_status(BIN_OP_FILE_READ, request_id, BIN_STATUS_BAD_LENGTH);
+        return;
+    }
+
+    uint32_t offset = get_u32(payload);
+    uint16_t count = get_u16(payload + 4);
+    if (count > BIN_PROTO_MAX_PAYLOAD) {
+        send_status(BIN_OP_FILE_READ, request_id, BIN_STATUS_BAD_LENGTH);
+        return;
+    }
+    if (!file_emu_get_size(filename, &size)) {
+        send_status(BIN_OP_FILE_READ, request_id, BIN_STATUS_NOT_FOUND);
+        return;
+    }
+    if (offset > size) {
+        send_status(BIN_OP_FILE_READ, request_id, BIN_STATUS_BAD_OFFSET);
+        return;
+    }
+
+    // Short (or empty) payload marks the end of the file
+    uint8_t out[BIN_PROTO_MAX_PAYLOAD];
+    uint32_t actual = file_emu_read_at(filename, offset, out, count);
+    bin_proto_send(BIN_OP_FILE_READ | BIN_PROTO_RESPONSE, BIN_STATUS_OK, request_id, out, (uint16_t)actual);
+}
+
+static void handle_file_write_begin(uint16_t request_id, const uint8_t* payload, uint16_t length) {
+    char filename[MAX_FILENAME_LENGTH];
+
+    if (!payload_filename(payload, length, filename)) {
+        send_status(BIN_OP_FILE_WRITE_BEGIN, request_id, BIN_STATUS_BAD_LENGTH);
+        return;
+    }
+    if (bin_write.active && file_emu_write_owned(bin_write.token)) {
+        // A new upload replaces this protocol's own unfinished one
+        file_emu_write_abort();
+    }
+    bin_write.active = false;
+    if (file_emu_write_busy()) {
+        send_status(BIN_OP_FILE_WRITE_BEGIN, request_id, BIN_STATUS_BUSY);
+        return;
+    }
+    bin_write.token = file_emu_write_begin(filename);
+    if (bin_write.token == 0) {
+        send_status(BIN_OP_FILE_WRITE_BEGIN, request_id, BIN_STATUS_IO_ERROR);
+        return;
+    }
+
+    bin_write.active = true;
+    bin_write.size = 0;
+    bin_write.crc = 0;
+    send_status(BIN_OP_FILE_WRITE_BEGIN, request_id, BIN_STATUS_OK);
+}
+
+// Still writing, and file_emu's writer is still ours
+static bool bin_write_owned(void) {
+    if (bin_write.active && !file_emu_write_owned(bin_write.token)) {
+        bin_write.active = false;
+    }
+    return bin_write.active;
+}
+
+static void handle_file_write_data(uint16_t request_id, const uint8_t* payload, uint16_t length) {
+    if (!bin_write_owned()) {
+        send_status(BIN_OP_FILE_WRITE_DATA, request_id, BIN_STATUS_BAD_STATE);
+        return;
+    }
+    if (length < 4) {
+        send_status(BIN_OP_FILE_WRITE_DATA, request_id, BIN_STATUS_BAD_LENGTH);
+        return;
+    }
+
+    // Chunks must arrive in order; the offset catches a dropped frame
+    if (get_u32(payload) != bin_write.size) {
+        send_status(BIN_OP_FILE_WRITE_DATA, request_id, BIN_STATUS_BAD_OFFSET);
+        return;
+    }
+
+    const uint8_t* data = payload + 4;
+    uint16_t count = length - 4;
+    if (!file_emu_write_append(data, count)) {
+        bin_write.active = false;
+        send_status(BIN_OP_FILE_WRITE_DATA, request_id, BIN_STATUS_IO_ERROR);
+        return;
+    }
+
+    bin_write.crc = config_storage_crc32_update(bin_write.crc, data, count);
+    bin_write.size += count;
+    send_status(BIN_OP_FILE_WRITE_DATA, request_id, BIN_STATUS_OK);
+}
+
+static void handle_file_write_commit(uint16_t request_id, const uint8_t* payload, uint16_t length) {
+    if (!bin_write_owned()) {
+        send_status(BIN_OP_FILE_WRITE_COMMIT, request_id, BIN_STATUS_BAD_STATE);
+        return;
+    }
+    if (length != 8) {
+        send_status(BIN_OP_FILE_WRITE_COMMIT, request_id, BIN_STATUS_BAD_LENGTH);
+        return;
+    }
+
+    bin_write.active = false;
+
+    // End-to-end check of the whole file before it replaces the old copy
+    if (get_u32(payload) != bin_write.size || get_u32(payload + 4) != bin_write.crc) {
+        file_emu_write_abort();
+        send_status(BIN_OP_FILE_WRITE_COMMIT, request_id, BIN_STATUS_BAD_CRC);
+        return;
+    }
+
+    bool ok = file_emu_write_commit();
+    send_status(BIN_OP_FILE_WRITE_COMMIT, request_id, ok ? BIN_STATUS_OK : BIN_STATUS_IO_ERROR);
+}
+
+static void handle_file_write_abort(uint16_t request_id, const uint8_t* payload, uint16_t length) {
+    (void)payload;
+    (void)length;
+
+    if (bin_write_owned()) {
+        file_emu_write_abort();
+        bin_write.active = false;
+    }
+    send_status(BIN_OP_FILE_WRITE_ABORT, request_id, BIN_STATUS_OK);
+}
+
+static void handle_perf(uint16_t request_id, const uint8_t* payload, uint16_t length) {
+    if (length != 1 || payload[0] >= PERF_STAGE_COUNT) {
+        send_status(BIN_OP_PERF, request_id, BIN_STATUS_BAD_LENGTH);
+        return;
+    }
+
+    perf_stage_t stage = (perf_stage_t)payload[0];
+    const perf_stage_stats_t* stats = perf_get_stage(stage);
+    const char* name = perf_get_stage_name(stage);
+
+    uint8_t out[BIN_PROTO_MAX_PAYLOAD];
+    uint32_t pos = 0;
+    out[pos++] = (uint8_t)stage;
+    out[pos++] = PERF_STAGE_COUNT;
+    put_u32(&out[pos], perf_get_cycles_per_us()); pos += 4;
+    put_u32(&out[pos], stats->count); pos += 4;
+    put_u32(&out[pos], stats->count ? stats->min : 0); pos += 4;
+    put_u32(&out[pos], stats->max); pos += 4;
+    put_u32(&out[pos], (uint32_t)stats->total); pos += 4;
+    put_u32(&out[pos], (uint32_t)(stats->total >> 32)); pos += 4;
+    for (int i = 0; i < PERF_HIST_BUCKETS; i++) {
+        put_u32(&out[pos], stats->histogram[i]);
+        pos += 4;
+    }
+    uint32_t name_len = strlen(name);
+    memcpy(&out[pos], name, name_len);
+    pos += name_len;
+
+    bin_proto_send(BIN_OP_PERF | BIN_PROTO_RESPONSE, BIN_STATUS_OK, request_id, out, (uint16_t)pos);
+}
+
+static void handle_perf_reset(uint16_t request_id, const uint8_t* payload, uint16_t length) {
+    (void)payload;
+    (void)length;
+    perf_reset();
+    send_status(BIN_OP_PERF_RESET, request_id, BIN_STATUS_OK);
+}
+
+static void handle_latency(uint16_t request_id, const uint8_t* payload, uint16_t length) {
+    latency_summary_t summary;
+    if (length != 1 || !latency_get_summary((latency_class_t)payload[0], &summary)) {
+        send_status(BIN_OP_LATENCY, request_id, BIN_STATUS_BAD_LENGTH);
+        return;
+    }
+
+    const char* name = latency_get_class_name((latency_class_t)payload[0]);
+    uint8_t out[BIN_PROTO_MAX_PAYLOAD];
+    uint32_t pos = 0;
+    out[pos++] = payload[0];
+    out[pos++] = LATENCY_CLASS_COUNT;
+    put_u32(&out[pos], summary.count); pos += 4;
+    put_u32(&out[pos], summary.p50_us); pos += 4;
+    put_u32(&out[pos], summary.p99_us); pos += 4;
+    put_u32(&out[pos], summary.max_us); pos += 4;
+    put_u32(&out[pos], summary.mean_build_us); pos += 4;
+    uint32_t name_len = strlen(name);
+    memcpy(&out[pos], name, name_len);
+    pos += name_len;
+
+    bin_proto_send(BIN_OP_LATENCY | BIN_PROTO_RESPONSE, BIN_STATUS_OK, request_id, out, (uint16_t)pos);
+}
+
+static void handle_latency_reset(uint16_t request_id, const uint8_t* payload, uint16_t length) {
+    (void)payload;
+    (void)length;
+    latency_reset();
+    send_status(BIN_OP_LATENCY_RESET, request_id, BIN_STATUS_OK);
+}
+
+static void handle_trace_info(uint16_t request_id, const uint8_t* payload, uint16_t length) {
+    (void)payload;
+    (void)length;
+
+    uint8_t out[17];
+    out[0] = input_trace_is_armed() ? 1 : 0;
+    put_u32(&out[1], input_trace_get_count());
+    put_u32(&out[5], input_trace_get_dropped());
+    put_u32(&out[9], INPUT_TRACE_CAPACITY);
+    put_u32(&out[13], input_trace_get_image_size());
+    bin_proto_send(BIN_OP_TRACE_INFO | BIN_PROTO_RESPONSE, BIN_STATUS_OK, request_id, out, sizeof(out));
+}
+
+static void handle_trace_arm(uint16_t request_id, const uint8_t* payload, uint16_t length) {
+    if (length != 1) {
+        send_status(BIN_OP_TRACE_ARM, request_id, BIN_STATUS_BAD_LENGTH);
+        return;
+    }
+
+    if (payload[0]) {
+        input_trace_arm();
+    } else {
+        input_trace_stop();
+    }
+    send_status(BIN_OP_TRACE_ARM, request_id, BIN_STATUS_OK);
+}
+
+static void handle_trace_read(uint16_t request_id, const uint8_t* payload, uint16_t length) {
+    if (length != 6 || get_u16(payload + 4) > BIN_PROTO_MAX_PAYLOAD) {
+        send_status(BIN_OP_TRACE_READ, request_id, BIN_STATUS_BAD_LENGTH);
+        return;
+    }
+    if (input_trace_is_armed()) {
+        send_status(BIN_OP_TRACE_READ, request_id, BIN_STATUS_BAD_STATE);
+        return;
+    }
+
+    uint32_t offset = get_u32(payload);
+    if (offset > input_trace_get_image_size()) {
+        send_status(BIN_OP_TRACE_READ, request_id, BIN_STATUS_BAD_OFFSET);
+        return;
+    }
+
+    // Short (or empty) payload marks the end of the image
+    uint8_t out[BIN_PROTO_MAX_PAYLOAD];
+    uint32_t actual = input_trace_read_image(offset, out, get_u16(payload + 4));
+    bin_proto_send(BIN_OP_TRACE_READ | BIN_PROTO_RESPONSE, BIN_STATUS_OK, request_id, out, (uint16_t)actual);
+}
+
+static void handle_rx_stats(uint16_t request_id, const uint8_t* payload, uint16_t length) {
+    (void)payload;
+    (void)length;
+
+    const cdc_rx_stats_t* stats = cdc_rx_get_stats();
+    uint8_t out[24];
+    put_u32(&out[0], stats->bytes_received);
+    put_u32(&out[4], stats->lines);
+    put_u32(&out[8], stats->frames);
+    put_u32(&out[12], stats->line_overflows);
+    put_u32(&out[16], stats->frame_overflows);
+    put_u32(&out[20], stats->partial_spans);
+    bin_proto_send(BIN_OP_RX_STATS | BIN_PROTO_RESPONSE, BIN_STATUS_OK, request_id, out, sizeof(out));
+}
+
+static const bin_command_t bin_commands[] = {
+    { BIN_OP_PING,              handle_ping },
+    { BIN_OP_VERSION,           handle_version },
+    { BIN_OP_FILE_LIST,         handle_file_list },
+    { BIN_OP_FILE_INFO,         handle_file_info },
+    { BIN_OP_FILE_READ,         handle_file_read },
+    { BIN_OP_FILE_WRITE_BEGIN,  handle_file_write_begin },
+    { BIN_OP_FILE_WRITE_DATA,   handle_file_write_data },
+    { BIN_OP_FILE_WRITE_COMMIT, handle_file_write_commit },
+    { BIN_OP_FILE_WRITE_ABORT,  handle_file_write_abort },
+    { BIN_OP_PERF,              handle_perf },
+    { BIN_OP_PERF_RESET,        handle_perf_reset },
+    { BIN_OP_LATENCY,           handle_latency },
+    { BIN_OP_LATENCY_RESET,     handle_latency_reset },
+    { BIN_OP_TRACE_INFO,        handle_trace_info },
+    { BIN_OP_TRACE_ARM,         handle_trace_arm },
+    { BIN_OP_TRACE_READ,        handle_trace_read },
+    { BIN_OP_RX_STATS,          handle_rx_stats },
+};
+
+//--------------------------------------------------------------------+
+// RECEIVER
+//--------------------------------------------------------------------+
+void bin_proto_process_frame(uint8_t* frame, uint32_t encoded_length) {
+    int length = cobs_decode(frame, encoded_length);
+
+    if (length < BIN_PROTO_HEADER_SIZE + BIN_PROTO_CRC_SIZE) {
+        error_count++;
+        return;  // Too short to even carry a request ID
+    }
+
+    uint8_t opcode = frame[0];
+    uint16_t request_id = get_u16(&frame[2]);
+    uint16_t payload_length = get_u16(&frame[4]);
+
+    if ((uint32_t)(BIN_PROTO_HEADER_SIZE + payload_length + BIN_PROTO_CRC_SIZE) != (uint32_t)length) {
+        error_count++;
+        send_status(opcode, request_id, BIN_STATUS_BAD_LENGTH);
+        return;
+    }
+
+    uint32_t body = BIN_PROTO_HEADER_SIZE + payload_length;
+    if (get_u32(&frame[body]) != config_storage_calculate_crc32(frame, body)) {
+        error_count++;
+        send_status(opcode, request_id, BIN_STATUS_BAD_CRC);
+        return;
+    }
+
+    frame_count++;
+
+    for (uint32_t i = 0; i < sizeof(bin_commands) / sizeof(bin_commands[0]); i++) {
+        if (bin_commands[i].opcode == opcode) {
+            bin_commands[i].handler(request_id, &frame[BIN_PROTO_HEADER_SIZE], payload_length);
+            return;
+        }
+    }
+
+    send_status(opcode, request_id, BIN_STATUS_UNKNOWN_OPCODE);
+}
+
+void bin_proto_init(void) {
+    bin_write.active = false;
+    bin_write.token = 0;
+    frame_count = 0;
+    error_count = 0;
+}
+
+void bin_proto_reset(void) {
+    if (bin_write_owned()) {
+        file_emu_write_abort();
+    }
+    bin_write.active = false;
+}
+
+uint32_t bin_proto_get_frame_count(void) {
+    return frame_count;
+}
+
+uint32_t bin_proto_get_error_count(void) {
+    return error_count;
+}
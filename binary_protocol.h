@@ -0,0 +1,94 @@
+#ifndef BINARY_PROTOCOL_H
+#define BINARY_PROTOCOL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Framed binary protocol on the CDC port, alongside the text commands.
+//
+// A frame on the wire is 0x00 <COBS encoded body> 0x00. The leading zero
+// switches the receiver out of text mode (text lines never contain 0x00),
+// the trailing zero ends the frame. Decoded body, little endian:
+//
+//   uint8_t  opcode      request opcode, responses set BIN_PROTO_RESPONSE
+//   uint8_t  status      0 in requests, bin_proto_status_t in responses
+//   uint16_t request_id  chosen by the host, echoed in the response
+//   uint16_t length      payload length
+//   uint8_t  payload[length]
+//   uint32_t crc         config_storage_calculate_crc32() of everything above
+//
+// Requests are answered in order, so the host may keep several requests
+// outstanding (e.g. reads of consecutive file offsets) and match replies
+// by request_id. The receiver only takes a new frame once the TX queue
+// has room for a full encoded response.
+
+#define BIN_PROTO_HEADER_SIZE     6
+#define BIN_PROTO_CRC_SIZE        4
+#define BIN_PROTO_MAX_PAYLOAD     240
+#define BIN_PROTO_MAX_FRAME       (BIN_PROTO_HEADER_SIZE + BIN_PROTO_MAX_PAYLOAD + BIN_PROTO_CRC_SIZE)
+// COBS adds one byte per 254, plus the two delimiters
+#define BIN_PROTO_MAX_ENCODED     (BIN_PROTO_MAX_FRAME + BIN_PROTO_MAX_FRAME / 254 + 1 + 2)
+
+#define BIN_PROTO_DELIMITER       0x00
+#define BIN_PROTO_RESPONSE        0x80
+
+// Opcodes
+#define BIN_OP_PING               0x01  // Echo payload
+#define BIN_OP_VERSION            0x02  // -> version string
+#define BIN_OP_FILE_LIST          0x10  // -> { uint32 size, uint8 name_len, name }...
+#define BIN_OP_FILE_INFO          0x11  // name -> uint32 size, uint32 crc
+#define BIN_OP_FILE_READ          0x12  // uint32 offset, uint16 length, name -> data
+#define BIN_OP_FILE_WRITE_BEGIN   0x13  // name
+#define BIN_OP_FILE_WRITE_DATA    0x14  // uint32 offset, data
+#define BIN_OP_FILE_WRITE_COMMIT  0x15  // uint32 size, uint32 crc
+#define BIN_OP_FILE_WRITE_ABORT   0x16
+#define BIN_OP_PERF               0x20  // uint8 stage -> stage, stage_count, uint32 cycles_per_us,
+                                        //   count, min, max, uint64 total, uint32 histogram[], name
+#define BIN_OP_PERF_RESET         0x21
+#define BIN_OP_LATENCY            0x22  // uint8 class -> class, class_count, uint32 count, p50_us,
+                                        //   p99_us, max_us, mean_build_us, name
+#define BIN_OP_LATENCY_RESET      0x23
+#define BIN_OP_TRACE_INFO         0x24  // -> uint8 armed, uint32 count, dropped, capacity, image_size
+#define BIN_OP_TRACE_ARM          0x25  // uint8 arm (1) or stop (0)
+#define BIN_OP_TRACE_READ         0x26  // uint32 offset, uint16 length -> trace image bytes
+#define BIN_OP_RX_STATS           0x27  // -> uint32 bytes, lines, frames, line_overflows,
+                                        //   frame_overflows, partial_spans
+
+typedef enum {
+    BIN_STATUS_OK = 0,
+    BIN_STATUS_BAD_CRC,
+    BIN_STATUS_BAD_LENGTH,
+    BIN_STATUS_UNKNOWN_OPCODE,
+    BIN_STATUS_NOT_FOUND,
+    BIN_STATUS_BAD_OFFSET,
+    BIN_STATUS_BAD_STATE,
+    BIN_STATUS_IO_ERROR,
+    BIN_STATUS_BUSY             // Another file write is in progress, retry later
+} bin_proto_status_t;
+
+// Protocol functions
+void bin_proto_init(void);
+
+// Host disconnected: abort a file write this protocol started
+void bin_proto_reset(void);
+
+// Handle one received frame: the COBS encoded body between the delimiters.
+// The frame is decoded in place.
+void bin_proto_process_frame(uint8_t* frame, uint32_t encoded_length);
+
+// Send a response frame (used by the request handlers)
+bool bin_proto_send(uint8_t opcode, uint8_t status, uint16_t request_id, const void* payload, uint16_t length);
+
+// Frame statistics
+uint32_t bin_proto_get_frame_count(void);
+uint32_t bin_proto_get_error_count(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BINARY_PROTOCOL_H
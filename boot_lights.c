@@ -0,0 +1,126 @@
+#include "boot_lights.h"
+#include "neopixel.h"
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "tusb.h"
+
+#define BOOT_PIXEL_FIRST    0x01000000  // Colour flag: light pixel 0 only
+
+typedef struct {
+    uint16_t duration_ms;
+    uint32_t value;         // Status LED level, or NeoPixel colour (0xRRGGBB)
+} boot_step_t;
+
+typedef struct {
+    const boot_step_t* steps;
+    uint8_t count;
+    uint8_t index;
+    bool active;
+    uint32_t started_ms;
+    void (*apply)(uint32_t value);
+    void (*finish)(void);   // Leaves the output as normal operation expects it
+} boot_track_t;
+
+// Five short blinks, then two long ones when booting into XInput mode
+static const boot_step_t status_steps[] = {
+    { 100, 1 }, { 100, 0 }, { 100, 1 }, { 100, 0 }, { 100, 1 },
+    { 100, 0 }, { 100, 1 }, { 100, 0 }, { 100, 1 }, { 100, 0 },
+    { 500, 1 }, { 500, 0 }, { 500, 1 }, { 500, 0 },
+};
+#define STATUS_STEPS_SHORT  10
+
+// Startup flash, strip test, then the quick RGB sweep
+static const boot_step_t pixel_steps[] = {
+    { 500,  BOOT_PIXEL_FIRST | 0xFFFFFF },
+    { 1000, 0xFFFFFF },
+    { 1000, 0xFF0000 },
+    { 1000, 0x00FF00 },
+    { 1000, 0x0000FF },
+    { 300,  0xFF0000 },
+    { 300,  0x00FF00 },
+    { 300,  0x0000FF },
+};
+
+static boot_track_t tracks[2];
+
+static void apply_status(uint32_t value) {
+    gpio_put(BOOT_LIGHTS_STATUS_PIN, value != 0);
+}
+
+// Back to the mount indicator driven by tud_mount_cb()/tud_umount_cb()
+static void finish_status(void) {
+    gpio_put(BOOT_LIGHTS_STATUS_PIN, tud_mounted());
+}
+
+static void finish_pixels(void) {
+    neopixel_clear();
+    neopixel_show();
+}
+
+static void apply_pixels(uint32_t value) {
+    neopixel_clear();
+    if (value & BOOT_PIXEL_FIRST) {
+        neopixel_set_pixel(0, value & 0xFFFFFF);
+    } else {
+        neopixel_set_all(value);
+    }
+    neopixel_show();
+}
+
+static void track_start(boot_track_t* track, const boot_step_t* steps, uint8_t count,
+                        void (*apply)(uint32_t), void (*finish)(void), uint32_t now_ms) {
+    track->steps = steps;
+    track->count = count;
+    track->index = 0;
+    track->active = true;
+    track->started_ms = now_ms;
+    track->apply = apply;
+    track->finish = finish;
+    apply(steps[0].value);
+}
+
+static void track_task(boot_track_t* track, uint32_t now_ms) {
+    // Catch up step by step so a slow loop does not stretch the show
+    while (track->active && now_ms - track->started_ms >= track->steps[track->index].duration_ms) {
+        track->started_ms += track->steps[track->index].duration_ms;
+        if (++track->index == track->count) {
+            track->active = false;
+            track->finish();
+        } else {
+            track->apply(track->steps[track->index].value);
+        }
+    }
+}
+
+//--------------------------------------------------------------------+
+// PUBLIC API
+//--------------------------------------------------------------------+
+void boot_lights_start(bool xinput_mode, uint32_t now_ms) {
+    gpio_init(BOOT_LIGHTS_STATUS_PIN);
+    gpio_set_dir(BOOT_LIGHTS_STATUS_PIN, GPIO_OUT);
+
+    track_start(&tracks[0], status_steps,
+                xinput_mode ? sizeof(status_steps) / sizeof(status_steps[0]) : STATUS_STEPS_SHORT,
+                apply_status, finish_status, now_ms);
+    track_start(&tracks[1], pixel_steps, sizeof(pixel_steps) / sizeof(pixel_steps[0]),
+                apply_pixels, finish_pixels, now_ms);
+}
+
+void boot_lights_task(uint32_t now_ms) {
+    for (int i = 0; i < 2; i++) {
+        track_task(&tracks[i], now_ms);
+    }
+}
+
+void boot_lights_cancel(void) {
+    for (int i = 0; i < 2; i++) {
+        if (tracks[i].active) {
+            tracks[i].active = false;
+            tracks[i].finish();
+        }
+    }
+}
+
+bool boot_lights_active(void) {
+    return tracks[1].active;
+}
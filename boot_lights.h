@@ -0,0 +1,31 @@
+#ifndef BOOT_LIGHTS_H
+#define BOOT_LIGHTS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Boot light show without blocking the main loop.
+//
+// The status LED and the NeoPixels each play a fixed table of timed steps;
+// boot_lights_task() moves them on from the main loop, so USB is serviced
+// and reports go out from the first iteration. While the show runs it owns
+// the NeoPixels; boot_lights_cancel() hands them back early (e.g. on the
+// first fret press).
+
+#define BOOT_LIGHTS_STATUS_PIN  25      // Pico on-board LED
+
+// Boot light functions
+void boot_lights_start(bool xinput_mode, uint32_t now_ms);
+void boot_lights_task(uint32_t now_ms);
+void boot_lights_cancel(void);
+bool boot_lights_active(void);  // True while the show owns the NeoPixels
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BOOT_LIGHTS_H
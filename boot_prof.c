@@ -0,0 +1,158 @@
+#include "boot_prof.h"
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "hardware/sync.h"
+#include <stdio.h>
+
+typedef struct {
+    uint64_t start_us;
+    uint64_t end_us;
+    uint8_t core;               // Core that actually ran the phase
+} boot_timing_t;
+
+static const boot_phase_t* graph = NULL;
+static uint8_t graph_count = 0;
+static boot_timing_t timings[BOOT_PROF_MAX_PHASES];
+static volatile uint32_t done_mask[2];  // Each core only writes its own mask
+static uint64_t ready_us = 0;
+static uint64_t first_report_us = 0;
+static bool core1_pending = false;      // Core 1 has phases but is not launched yet
+static uint32_t core1_start_depends = 0;
+
+static inline uint32_t phases_done(void) {
+    return done_mask[0] | done_mask[1];
+}
+
+static void run_phase(uint8_t index, uint core) {
+    timings[index].start_us = time_us_64();
+    graph[index].init();
+    timings[index].end_us = time_us_64();
+    timings[index].core = (uint8_t)core;
+
+    // Publish everything the phase initialised before marking it done
+    __dmb();
+    done_mask[core] |= 1u << index;
+}
+
+static void core1_entry(void);
+
+// Core 0 only: start core 1 once its first phase's dependencies are done,
+// so flash is never written (first-boot config save) while it runs from XIP
+static void launch_core1_when_ready(uint core) {
+    if (core != 0 || !core1_pending) return;
+    if ((phases_done() & core1_start_depends) != core1_start_depends) return;
+
+    core1_pending = false;
+    multicore_launch_core1(core1_entry);
+}
+
+static void run_core(uint core) {
+    for (uint8_t i = 0; i < graph_count; i++) {
+        if (graph[i].core != core) continue;
+
+        while ((phases_done() & graph[i].depends) != graph[i].depends) {
+            launch_core1_when_ready(core);
+            tight_loop_contents();
+        }
+        __dmb();
+        run_phase(i, core);
+        launch_core1_when_ready(core);
+    }
+}
+
+static void core1_entry(void) {
+    run_core(1);
+}
+
+static bool graph_valid(const boot_phase_t* phases, uint8_t count) {
+    if (count > BOOT_PROF_MAX_PHASES) return false;
+
+    for (uint8_t i = 0; i < count; i++) {
+        // Only earlier phases, and only cores that exist
+        if ((phases[i].depends >> i) != 0 || phases[i].core > 1) {
+            printf("Boot: Phase %s has an invalid dependency or core\n", phases[i].name);
+            return false;
+        }
+    }
+    return true;
+}
+
+//--------------------------------------------------------------------+
+// INIT GRAPH
+//--------------------------------------------------------------------+
+void boot_prof_run(const boot_phase_t* phases, uint8_t count) {
+    graph = phases;
+    done_mask[0] = 0;
+    done_mask[1] = 0;
+
+    if (!graph_valid(phases, count)) {
+        // Still boot: everything on core 0 in table order
+        graph_count = count > BOOT_PROF_MAX_PHASES ? BOOT_PROF_MAX_PHASES : count;
+        for (uint8_t i = 0; i < graph_count; i++) {
+            run_phase(i, 0);
+        }
+        ready_us = time_us_64();
+        return;
+    }
+    graph_count = count;
+
+    // Core 1's first phase can only depend on core 0 phases, so those always finish
+    bool use_core1 = false;
+    for (uint8_t i = 0; i < count; i++) {
+        if (phases[i].core == 1) {
+            use_core1 = true;
+            core1_start_depends = phases[i].depends;
+            break;
+        }
+    }
+    core1_pending = use_core1;
+
+    launch_core1_when_ready(0);
+    run_core(0);
+
+    uint32_t all = (count == 32) ? 0xFFFFFFFFu : (1u << count) - 1;
+    while (phases_done() != all) {
+        launch_core1_when_ready(0);
+        tight_loop_contents();
+    }
+    __dmb();
+
+    // Core 1 must not be running from flash when config or files are saved
+    if (use_core1) {
+        multicore_reset_core1();
+    }
+    ready_us = time_us_64();
+}
+
+void boot_prof_first_report(void) {
+    if (first_report_us == 0) {
+        first_report_us = time_us_64();
+    }
+}
+
+//--------------------------------------------------------------------+
+// RESULTS
+//--------------------------------------------------------------------+
+uint64_t boot_prof_get_ready_us(void) {
+    return ready_us;
+}
+
+uint64_t boot_prof_get_first_report_us(void) {
+    return first_report_us;
+}
+
+uint32_t boot_prof_format_report(char* out, uint32_t size) {
+    uint32_t pos = snprintf(out, size, "BOOTPROF phase core start_us end_us us\n");
+
+    for (uint8_t i = 0; i < graph_count && pos < size; i++) {
+        pos += snprintf(out + pos, size - pos, "%s %u %lu %lu %lu\n", graph[i].name,
+                        timings[i].core, (unsigned long)timings[i].start_us,
+                        (unsigned long)timings[i].end_us,
+                        (unsigned long)(timings[i].end_us - timings[i].start_us));
+    }
+
+    if (pos < size) pos += snprintf(out + pos, size - pos, "ready %lu\n", (unsigned long)ready_us);
+    if (pos < size) pos += snprintf(out + pos, size - pos, "first_report %lu\n", (unsigned long)first_report_us);
+    if (pos < size) pos += snprintf(out + pos, size - pos, "END_BOOTPROF\n");
+    return (pos < size) ? pos : size - 1;
+}
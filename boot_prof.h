@@ -0,0 +1,59 @@
+#ifndef BOOT_PROF_H
+#define BOOT_PROF_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Boot profiler and init graph.
+//
+// Initialisation is a table of phases, each naming the phases it depends
+// on. Core 0 and core 1 each work through their own phases in table order,
+// starting each one as soon as its dependencies have finished on either
+// core, so every subsystem initialises exactly once and independent phases
+// overlap. Dependencies must point at earlier entries in the table, which
+// keeps the graph free of cycles and the two cores free of deadlock.
+//
+// Core 1 is not launched until the dependencies of its first phase have
+// finished on core 0. Flash cannot be written while the other core runs
+// from XIP and there is no lockout, so any phase that may write flash must
+// be among those dependencies (and core 0 phases after it must not).
+//
+// Every phase is timestamped with time_us_64() (microseconds since reset)
+// and kept for the BOOTPROF command, together with the time the host
+// received the first input report: the cold-boot-to-first-report figure.
+
+#define BOOT_PROF_MAX_PHASES    16
+#define BOOT_PROF_REPORT_MAX    768
+
+#define BOOT_DEP(phase)         (1u << (phase))
+
+typedef struct {
+    const char* name;
+    void (*init)(void);
+    uint32_t depends;           // BOOT_DEP() of every phase that must finish first
+    uint8_t core;               // 0 or 1
+} boot_phase_t;
+
+// Runs the whole graph; returns on core 0 once every phase has finished
+// and core 1 is back in reset (so flash can be written without a lockout)
+void boot_prof_run(const boot_phase_t* phases, uint8_t count);
+
+// First input report reached the host (later calls are ignored)
+void boot_prof_first_report(void);
+
+// Results, microseconds since reset (0 = not yet)
+uint64_t boot_prof_get_ready_us(void);
+uint64_t boot_prof_get_first_report_us(void);
+
+// Render the text report ("BOOTPROF" command), returns its length
+uint32_t boot_prof_format_report(char* out, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BOOT_PROF_H
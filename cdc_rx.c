@@ -0,0 +1,183 @@
+#include "cdc_rx.h"
+#include "cdc_tx.h"
+#include "binary_protocol.h"
+#include "file_emulation.h"
+#include "tusb.h"
+#include <stdio.h>
+#include <string.h>
+
+// One spare byte so a line that fills the buffer can still be NUL terminated
+static uint8_t rx_buffer[CDC_RX_BUFFER_SIZE + 1];
+static uint32_t rx_start = 0;   // Start of the record being received
+static uint32_t rx_scan = 0;    // Bytes before this have been searched
+static uint32_t rx_end = 0;     // End of received data
+
+static bool rx_in_frame = false;
+static bool rx_discarding = false;  // Dropping an over-long record up to its terminator
+static bool rx_continued = false;   // Part of the current line was already dispatched
+
+static cdc_rx_stats_t stats;
+
+void cdc_rx_init(void) {
+    cdc_rx_reset();
+    cdc_rx_reset_stats();
+}
+
+void cdc_rx_reset(void) {
+    rx_start = rx_scan = rx_end = 0;
+    rx_in_frame = false;
+    rx_discarding = false;
+    rx_continued = false;
+}
+
+// Text lines end at CR or LF; 0x00 starts a binary frame
+static const uint8_t* find_text_terminator(const uint8_t* data, uint32_t length) {
+    const uint8_t* newline = memchr(data, '\n', length);
+    uint32_t limit = newline ? (uint32_t)(newline - data) : length;
+
+    const uint8_t* cr = memchr(data, '\r', limit);
+    if (cr) limit = cr - data;
+
+    const uint8_t* zero = memchr(data, 0x00, limit);
+    if (zero) return zero;
+    if (cr) return cr;
+    return newline;
+}
+
+static void dispatch_line(uint32_t start, uint32_t end) {
+    if (rx_discarding) {
+        rx_discarding = false;
+        return;
+    }
+
+    uint32_t length = end - start;
+    if (length == 0 && !rx_continued) {
+        return;  // Blank line, or the LF of a CRLF pair
+    }
+
+    rx_buffer[end] = '\0';
+    file_emu_process_serial_span((const char*)&rx_buffer[start], length, true);
+    rx_continued = false;
+    stats.lines++;
+}
+
+static void dispatch_frame(uint32_t start, uint32_t end) {
+    if (rx_discarding) {
+        rx_discarding = false;
+        return;
+    }
+
+    bin_proto_process_frame(&rx_buffer[start], end - start);
+    stats.frames++;
+}
+
+// Make room at the end of the buffer for the next read
+static void make_room(void) {
+    if (rx_end < CDC_RX_BUFFER_SIZE) {
+        return;
+    }
+
+    if (rx_start > 0) {
+        // Move the unfinished record to the front
+        uint32_t pending = rx_end - rx_start;
+        memmove(rx_buffer, &rx_buffer[rx_start], pending);
+        rx_scan -= rx_start;
+        rx_end = pending;
+        rx_start = 0;
+        return;
+    }
+
+    // A single record fills the whole buffer
+    if (!rx_in_frame && !rx_discarding && file_emu_accepts_partial_lines()) {
+        file_emu_process_serial_span((const char*)rx_buffer, rx_end, false);
+        rx_continued = true;
+        stats.partial_spans++;
+    } else if (!rx_discarding) {
+        rx_discarding = true;
+        rx_continued = false;
+        if (rx_in_frame) {
+            stats.frame_overflows++;
+        } else {
+            stats.line_overflows++;
+        }
+    }
+
+    rx_start = rx_scan = rx_end = 0;
+}
+
+void cdc_rx_task(void) {
+    // Only take a new record when its response is sure to fit in the TX queue:
+    // one binary frame, or a READFILE's START/content/END jobs
+    uint32_t budget = CDC_RX_MAX_PER_TICK;
+
+    while (budget > 0 && cdc_tx_can_queue(BIN_PROTO_MAX_ENCODED, 3)) {
+        if (rx_scan == rx_end) {
+            if (!tud_cdc_available()) {
+                return;
+            }
+            make_room();
+            uint32_t count = tud_cdc_read(&rx_buffer[rx_end], CDC_RX_BUFFER_SIZE - rx_end);
+            if (count == 0) {
+                return;
+            }
+            rx_end += count;
+            stats.bytes_received += count;
+        }
+
+        const uint8_t* data = &rx_buffer[rx_scan];
+        uint32_t length = rx_end - rx_scan;
+        const uint8_t* found = rx_in_frame ? memchr(data, 0x00, length)
+                                           : find_text_terminator(data, length);
+        if (!found) {
+            rx_scan = rx_end;
+            continue;
+        }
+
+        uint32_t terminator = found - rx_buffer;
+        uint8_t byte = *found;
+
+        if (rx_in_frame) {
+            if (terminator > rx_start || rx_discarding) {
+                dispatch_frame(rx_start, terminator);
+                rx_in_frame = false;
+                budget--;
+            }
+            // Back-to-back delimiters keep waiting for the frame body
+        } else if (byte == 0x00) {
+            // Binary frame starts; an unterminated text fragment before it is dropped
+            rx_in_frame = true;
+            rx_discarding = false;
+            rx_continued = false;
+        } else {
+            dispatch_line(rx_start, terminator);
+            budget--;
+        }
+
+        rx_start = rx_scan = terminator + 1;
+        if (rx_start == rx_end) {
+            rx_start = rx_scan = rx_end = 0;
+        }
+    }
+}
+
+bool cdc_rx_has_work(void) {
+    return rx_scan < rx_end || tud_cdc_available();
+}
+
+const cdc_rx_stats_t* cdc_rx_get_stats(void) {
+    return &stats;
+}
+
+void cdc_rx_reset_stats(void) {
+    memset(&stats, 0, sizeof(stats));
+}
+
+uint32_t cdc_rx_format_report(char* out, uint32_t size) {
+    int length = snprintf(out, size,
+                          "RX bytes %lu lines %lu frames %lu line_overflows %lu frame_overflows %lu "
+                          "partial_spans %lu\n",
+                          (unsigned long)stats.bytes_received, (unsigned long)stats.lines,
+                          (unsigned long)stats.frames, (unsigned long)stats.line_overflows,
+                          (unsigned long)stats.frame_overflows, (unsigned long)stats.partial_spans);
+    return (length < (int)size) ? (uint32_t)length : size - 1;
+}
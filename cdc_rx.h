@@ -0,0 +1,60 @@
+#ifndef CDC_RX_H
+#define CDC_RX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// CDC receive path.
+//
+// Bytes are read from TinyUSB straight into one receive buffer and never
+// copied again: text lines and binary frames are found with memchr and
+// handed to their parsers as spans into that buffer (lines are NUL
+// terminated in place, frames are COBS decoded in place). Only the
+// unfinished tail record is moved back to the start of the buffer when it
+// fills up. Text lines longer than the buffer are passed on in pieces
+// while a file is being streamed, and otherwise dropped and counted
+// ("RX" command, BIN_OP_RX_STATS).
+//
+// The buffer is linear rather than a ring on purpose: both parsers need a
+// record as one contiguous span, so a record split by a ring's wrap would
+// have to be copied out anyway. The move touches at most one partial
+// record, and only when the buffer has filled.
+
+#define CDC_RX_BUFFER_SIZE      512
+#define CDC_RX_MAX_PER_TICK     4       // Lines/frames dispatched per cdc_rx_task()
+#define CDC_RX_REPORT_MAX       160
+
+// Receive statistics
+typedef struct {
+    uint32_t bytes_received;
+    uint32_t lines;                 // Complete text lines dispatched
+    uint32_t frames;                // Binary frames dispatched
+    uint32_t line_overflows;        // Text lines dropped for not fitting the buffer
+    uint32_t frame_overflows;       // Binary frames dropped for not fitting the buffer
+    uint32_t partial_spans;         // Pieces of over-long lines streamed to a file
+} cdc_rx_stats_t;
+
+// Receive functions
+void cdc_rx_init(void);
+void cdc_rx_task(void);
+bool cdc_rx_has_work(void);     // Received data not yet dispatched
+
+// Drop any partially received line or frame (e.g. when the terminal disconnects)
+void cdc_rx_reset(void);
+
+// Statistics
+const cdc_rx_stats_t* cdc_rx_get_stats(void);
+void cdc_rx_reset_stats(void);
+
+// Render the text report ("RX" command), returns its length
+uint32_t cdc_rx_format_report(char* out, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CDC_RX_H
@@ -0,0 +1,192 @@
+#include "cdc_tx.h"
+#include "tusb.h"
+#include <string.h>
+
+#define CDC_TX_RING_MASK    (CDC_TX_RING_SIZE - 1)
+
+typedef enum {
+    CDC_TX_JOB_INLINE,      // Bytes held in the ring
+    CDC_TX_JOB_SOURCE       // Bytes pulled from a source callback
+} cdc_tx_job_type_t;
+
+typedef struct {
+    cdc_tx_job_type_t type;
+    uint32_t size;
+    uint32_t cursor;
+    cdc_tx_source_t source;
+    const void* context;
+} cdc_tx_job_t;
+
+// Inline byte ring (free-running indices)
+static uint8_t ring[CDC_TX_RING_SIZE];
+static uint32_t ring_head = 0;
+static uint32_t ring_tail = 0;
+
+// Job queue (free-running indices)
+static cdc_tx_job_t jobs[CDC_TX_MAX_JOBS];
+static uint32_t job_head = 0;
+static uint32_t job_tail = 0;
+
+static uint32_t dropped_count = 0;
+static uint32_t bytes_sent = 0;
+
+static inline uint32_t ring_free(void) {
+    return CDC_TX_RING_SIZE - (ring_head - ring_tail);
+}
+
+static inline uint32_t jobs_free(void) {
+    return CDC_TX_MAX_JOBS - (job_head - job_tail);
+}
+
+void cdc_tx_init(void) {
+    cdc_tx_reset();
+    dropped_count = 0;
+    bytes_sent = 0;
+}
+
+void cdc_tx_reset(void) {
+    ring_head = ring_tail = 0;
+    job_head = job_tail = 0;
+}
+
+bool cdc_tx_can_queue(uint32_t length, uint32_t job_count) {
+    return ring_free() >= length && jobs_free() >= job_count;
+}
+
+bool cdc_tx_idle(void) {
+    return job_head == job_tail;
+}
+
+bool cdc_tx_write(const void* data, uint32_t length) {
+    if (length == 0) {
+        return true;
+    }
+
+    // Append to the last job if it is inline, otherwise start a new one
+    cdc_tx_job_t* last = (job_head != job_tail) ? &jobs[(job_head - 1) % CDC_TX_MAX_JOBS] : NULL;
+    bool merge = last && last->type == CDC_TX_JOB_INLINE;
+
+    if (ring_free() < length || (!merge && jobs_free() == 0)) {
+        dropped_count++;
+        return false;
+    }
+
+    const uint8_t* bytes = (const uint8_t*)data;
+    uint32_t start = ring_head & CDC_TX_RING_MASK;
+    uint32_t first = CDC_TX_RING_SIZE - start;
+    if (first > length) first = length;
+    memcpy(&ring[start], bytes, first);
+    memcpy(&ring[0], bytes + first, length - first);
+    ring_head += length;
+
+    if (merge) {
+        last->size += length;
+    } else {
+        cdc_tx_job_t* job = &jobs[job_head % CDC_TX_MAX_JOBS];
+        job->type = CDC_TX_JOB_INLINE;
+        job->size = length;
+        job->cursor = 0;
+        job->source = NULL;
+        job->context = NULL;
+        job_head++;
+    }
+    return true;
+}
+
+bool cdc_tx_write_str(const char* str) {
+    return cdc_tx_write(str, strlen(str));
+}
+
+bool cdc_tx_write_source(cdc_tx_source_t source, const void* context, uint32_t size) {
+    if (size == 0) {
+        return true;
+    }
+    if (jobs_free() == 0) {
+        dropped_count++;
+        return false;
+    }
+
+    cdc_tx_job_t* job = &jobs[job_head % CDC_TX_MAX_JOBS];
+    job->type = CDC_TX_JOB_SOURCE;
+    job->size = size;
+    job->cursor = 0;
+    job->source = source;
+    job->context = context;
+    job_head++;
+    return true;
+}
+
+// Write as much of the current job as the FIFO accepts, return bytes written
+static uint32_t pump_job(cdc_tx_job_t* job, uint32_t budget) {
+    uint32_t remaining = job->size - job->cursor;
+    uint32_t count = (remaining < budget) ? remaining : budget;
+
+    if (job->type == CDC_TX_JOB_INLINE) {
+        // Contiguous run from the ring tail
+        uint32_t start = ring_tail & CDC_TX_RING_MASK;
+        if (count > CDC_TX_RING_SIZE - start) {
+            count = CDC_TX_RING_SIZE - start;
+        }
+        count = tud_cdc_write(&ring[start], count);
+        ring_tail += count;
+    } else {
+        uint8_t chunk[CDC_TX_CHUNK_SIZE];
+        if (count > sizeof(chunk)) count = sizeof(chunk);
+
+        uint32_t got = job->source(job->context, job->cursor, chunk, count);
+        if (got == 0) {
+            // Source shrank underneath us; end the job
+            job->cursor = job->size;
+            return 0;
+        }
+        count = tud_cdc_write(chunk, got);
+    }
+
+    job->cursor += count;
+    return count;
+}
+
+void cdc_tx_task(void) {
+    if (job_head == job_tail) {
+        return;
+    }
+    if (!tud_cdc_connected()) {
+        cdc_tx_reset();
+        return;
+    }
+
+    uint32_t budget = CDC_TX_MAX_PER_TICK;
+    uint32_t written = 0;
+
+    while (job_head != job_tail && budget > 0) {
+        uint32_t available = tud_cdc_write_available();
+        if (available == 0) {
+            break;
+        }
+
+        cdc_tx_job_t* job = &jobs[job_tail % CDC_TX_MAX_JOBS];
+        uint32_t count = pump_job(job, (available < budget) ? available : budget);
+
+        written += count;
+        budget -= count;
+
+        if (job->cursor >= job->size) {
+            job_tail++;
+        } else if (count == 0) {
+            break;
+        }
+    }
+
+    if (written > 0) {
+        bytes_sent += written;
+        tud_cdc_write_flush();
+    }
+}
+
+uint32_t cdc_tx_get_dropped_count(void) {
+    return dropped_count;
+}
+
+uint32_t cdc_tx_get_bytes_sent(void) {
+    return bytes_sent;
+}
@@ -0,0 +1,51 @@
+#ifndef CDC_TX_H
+#define CDC_TX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Non-blocking CDC transmit pump.
+//
+// Responses are queued as jobs and written out by cdc_tx_task() from the
+// main loop, never more than the CDC TX FIFO can take right now. Short
+// messages are copied into a byte ring; large content is streamed from a
+// source callback with a cursor, so nothing bigger than one FIFO's worth
+// is ever buffered and no call blocks waiting for the host.
+
+#define CDC_TX_RING_SIZE        1024    // Inline bytes (must be a power of 2)
+#define CDC_TX_MAX_JOBS         16
+#define CDC_TX_CHUNK_SIZE       64      // Read size for streamed sources
+#define CDC_TX_MAX_PER_TICK     256     // Upper bound on bytes written per cdc_tx_task()
+
+// Streamed source: copy up to length bytes at offset into buffer, return count
+typedef uint32_t (*cdc_tx_source_t)(const void* context, uint32_t offset, void* buffer, uint32_t length);
+
+// Pump functions
+void cdc_tx_init(void);
+void cdc_tx_task(void);
+
+// Queue data for transmission. Return false (and count a drop) if the queue is full.
+bool cdc_tx_write(const void* data, uint32_t length);
+bool cdc_tx_write_str(const char* str);
+bool cdc_tx_write_source(cdc_tx_source_t source, const void* context, uint32_t size);
+
+// True if length inline bytes and job_count jobs can be queued right now
+bool cdc_tx_can_queue(uint32_t length, uint32_t job_count);
+bool cdc_tx_idle(void);
+
+// Discard everything queued (e.g. when the terminal disconnects)
+void cdc_tx_reset(void);
+
+// Statistics
+uint32_t cdc_tx_get_dropped_count(void);
+uint32_t cdc_tx_get_bytes_sent(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CDC_TX_H
@@ -1,7 +1,12 @@
 #include "config.h"
 #include "config_storage.h"
+#include "whammy_cal.h"
+#include "joystick_cal.h"
+#include "response_curve.h"
+#include "remap.h"
 #include "pico/stdlib.h"
 #include "hardware/flash.h"
+#include "hardware/sync.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -41,11 +46,40 @@ static const config_t default_config = {
     .joystick_x_pin = "GP28",
     .joystick_y_pin = "GP29",
     .hat_mode = "dpad",
+    .usb_mode = "xinput",
     .led_brightness = 1.0f,
     .whammy_min = 500,
     .whammy_max = 65000,
     .whammy_reverse = false,
     .tilt_wave_enabled = true,
+    .joystick_x_center = 32768,
+    .joystick_x_min = 0,
+    .joystick_x_max = 65520,
+    .joystick_y_center = 32768,
+    .joystick_y_min = 0,
+    .joystick_y_max = 65520,
+    .joystick_deadzone = 2048,
+    .whammy_curve = "linear",
+    .joystick_x_curve = "linear",
+    .joystick_y_curve = "linear",
+    .GREEN_FRET_map = "a",
+    .RED_FRET_map = "b",
+    .YELLOW_FRET_map = "y",
+    .BLUE_FRET_map = "x",
+    .ORANGE_FRET_map = "lb",
+    .STRUM_UP_map = "dpad_up",
+    .STRUM_DOWN_map = "dpad_down",
+    .START_map = "start",
+    .SELECT_map = "back",
+    .GUIDE_map = "guide",
+    .TILT_map = "ry",
+    .UP_map = "dpad_up",
+    .DOWN_map = "dpad_down",
+    .LEFT_map = "dpad_left",
+    .RIGHT_map = "dpad_right",
+    .WHAMMY_map = "rx",
+    .joystick_x_map = "lx",
+    .joystick_y_map = "ly",
     .led_color = {
         "#FFFFFF", "#FFFFFF", "#B33E00", "#0000FF", 
         "#FFFF00", "#FF0000", "#00FF00"
@@ -58,6 +92,7 @@ static const config_t default_config = {
 
 // Active configuration (loaded from flash or defaults)
 config_t device_config;
+static uint32_t config_generation = 0;
 
 // Simple JSON value extractor - finds "key": value pairs
 static int extract_json_int(const char* json, const char* key) {
@@ -75,6 +110,14 @@ static int extract_json_int(const char* json, const char* key) {
     return atoi(pos);
 }
 
+const config_t* config_get_current(void) {
+    return &device_config;
+}
+
+uint32_t config_get_generation(void) {
+    return config_generation;
+}
+
 uint8_t config_gp_to_gpio(const char* gp_string) {
     if (!gp_string || strlen(gp_string) < 3) return 0;
     if (strncmp(gp_string, "GP", 2) != 0) return 0;
@@ -101,6 +144,30 @@ uint8_t config_get_neopixel_pin(void) { return config_gp_to_gpio(device_config.n
 uint8_t config_get_joystick_x_pin(void) { return config_gp_to_gpio(device_config.joystick_x_pin); }
 uint8_t config_get_joystick_y_pin(void) { return config_gp_to_gpio(device_config.joystick_y_pin); }
 
+// Compile the active configuration into the input pipeline
+static void config_activate(void) {
+    config_generation++;
+    whammy_cal_load(&device_config);
+    joystick_cal_load(&device_config);
+    response_curve_load(&device_config);
+    remap_load(&device_config);
+}
+
+// Make new_config the active configuration. parsed: its strings came from
+// config_parse_json() and are handed over with it. The sample interrupt
+// reads pins from device_config, so it never sees half of each.
+static void config_install(const config_t* new_config, bool parsed) {
+    uint32_t interrupts = save_and_disable_interrupts();
+    memcpy(&device_config, new_config, sizeof(config_t));
+    if (parsed) {
+        config_parse_json_commit();
+    }
+    restore_interrupts(interrupts);
+
+    config_json_invalidate_cache();
+    config_activate();
+}
+
 void config_init(void) {
     printf("Config: Initializing configuration system...\n");
     
@@ -109,16 +176,18 @@ void config_init(void) {
     
     // Try to load configuration from flash
     if (config_storage_load_from_flash(&device_config)) {
+        config_parse_json_commit();
         printf("Config: Successfully loaded configuration from flash\n");
         config_print_current();
     } else {
         printf("Config: Failed to load from flash, using defaults\n");
         // Use default configuration
         memcpy(&device_config, &default_config, sizeof(config_t));
+        config_json_invalidate_cache();
         config_print_current();
         
         // Try to save defaults to flash for next boot
-        char json_buffer[1024];
+        static char json_buffer[CONFIG_JSON_MAX_SIZE];
         if (config_generate_json(&device_config, json_buffer, sizeof(json_buffer))) {
             if (config_storage_save_to_flash(json_buffer, strlen(json_buffer))) {
                 printf("Config: Default configuration saved to flash\n");
@@ -127,6 +196,8 @@ void config_init(void) {
             }
         }
     }
+
+    config_activate();
 }
 
 void config_print_current(void) {
@@ -153,11 +224,28 @@ void config_print_current(void) {
     printf("  Whammy: %s, Joystick X: %s, Joystick Y: %s\n",
            device_config.WHAMMY, device_config.joystick_x_pin, device_config.joystick_y_pin);
     printf("LED Configuration:\n");
-    printf("  NeoPixel Pin: %s, Hat Mode: %s\n", device_config.neopixel_pin, device_config.hat_mode);
+    printf("  NeoPixel Pin: %s, Hat Mode: %s, USB Mode: %s\n", device_config.neopixel_pin,
+           device_config.hat_mode, device_config.usb_mode);
     printf("  Whammy Range: %lu - %lu, Reverse: %s, Tilt Wave: %s\n",
            device_config.whammy_min, device_config.whammy_max,
            device_config.whammy_reverse ? "Yes" : "No",
            device_config.tilt_wave_enabled ? "Yes" : "No");
+    printf("  Joystick X: %lu (%lu - %lu), Y: %lu (%lu - %lu), Deadzone: %lu\n",
+           device_config.joystick_x_center, device_config.joystick_x_min, device_config.joystick_x_max,
+           device_config.joystick_y_center, device_config.joystick_y_min, device_config.joystick_y_max,
+           device_config.joystick_deadzone);
+    printf("  Curves - Whammy: %s, Joystick X: %s, Joystick Y: %s\n",
+           device_config.whammy_curve, device_config.joystick_x_curve, device_config.joystick_y_curve);
+    printf("Remap:\n");
+    printf("  Frets: %s %s %s %s %s, Strum: %s %s, Tilt: %s\n",
+           device_config.GREEN_FRET_map, device_config.RED_FRET_map, device_config.YELLOW_FRET_map,
+           device_config.BLUE_FRET_map, device_config.ORANGE_FRET_map,
+           device_config.STRUM_UP_map, device_config.STRUM_DOWN_map, device_config.TILT_map);
+    printf("  Start: %s, Select: %s, Guide: %s, D-Pad: %s %s %s %s\n",
+           device_config.START_map, device_config.SELECT_map, device_config.GUIDE_map,
+           device_config.UP_map, device_config.DOWN_map, device_config.LEFT_map, device_config.RIGHT_map);
+    printf("  Whammy: %s, Joystick X: %s, Joystick Y: %s\n",
+           device_config.WHAMMY_map, device_config.joystick_x_map, device_config.joystick_y_map);
     printf("=============================\n");
 }
 
@@ -183,7 +271,7 @@ bool config_update_from_json(const char* json_string) {
     }
     
     // Update active configuration
-    memcpy(&device_config, &new_config, sizeof(config_t));
+    config_install(&new_config, true);
     
     printf("Config: Configuration updated successfully\n");
     config_print_current();
@@ -191,6 +279,83 @@ bool config_update_from_json(const char* json_string) {
     return true;
 }
 
+// Validate, save and activate a modified copy of the active configuration
+static bool config_commit(const config_t* new_config) {
+    static char json_buffer[CONFIG_JSON_MAX_SIZE];
+
+    if (!config_validate(new_config)) {
+        return false;
+    }
+
+    if (!config_generate_json(new_config, json_buffer, sizeof(json_buffer)) ||
+        !config_storage_save_to_flash(json_buffer, strlen(json_buffer))) {
+        printf("Config: Failed to save configuration to flash\n");
+        return false;
+    }
+
+    config_install(new_config, false);
+    return true;
+}
+
+bool config_set_whammy_range(uint32_t whammy_min, uint32_t whammy_max) {
+    config_t new_config;
+
+    memcpy(&new_config, &device_config, sizeof(config_t));
+    new_config.whammy_min = whammy_min;
+    new_config.whammy_max = whammy_max;
+    if (!config_commit(&new_config)) {
+        return false;
+    }
+
+    printf("Config: Whammy range %lu-%lu saved\n", whammy_min, whammy_max);
+    return true;
+}
+
+bool config_set_joystick_cal(uint32_t x_center, uint32_t x_min, uint32_t x_max,
+                             uint32_t y_center, uint32_t y_min, uint32_t y_max) {
+    config_t new_config;
+
+    memcpy(&new_config, &device_config, sizeof(config_t));
+    new_config.joystick_x_center = x_center;
+    new_config.joystick_x_min = x_min;
+    new_config.joystick_x_max = x_max;
+    new_config.joystick_y_center = y_center;
+    new_config.joystick_y_min = y_min;
+    new_config.joystick_y_max = y_max;
+    if (!config_commit(&new_config)) {
+        return false;
+    }
+
+    printf("Config: Joystick calibration saved\n");
+    return true;
+}
+
+bool config_set_joystick_deadzone(uint32_t deadzone) {
+    config_t new_config;
+
+    memcpy(&new_config, &device_config, sizeof(config_t));
+    new_config.joystick_deadzone = deadzone;
+    if (!config_commit(&new_config)) {
+        return false;
+    }
+
+    printf("Config: Joystick deadzone %lu saved\n", deadzone);
+    return true;
+}
+
+bool config_set_usb_mode(const char* usb_mode) {
+    config_t new_config;
+
+    memcpy(&new_config, &device_config, sizeof(config_t));
+    new_config.usb_mode = usb_mode;
+    if (!config_commit(&new_config)) {
+        return false;
+    }
+
+    printf("Config: USB mode %s saved\n", device_config.usb_mode);
+    return true;
+}
+
 bool config_validate(const config_t* config) {
     if (!config) return false;
     
@@ -269,6 +434,69 @@ bool config_validate(const config_t* config) {
         printf("Config: Invalid whammy range: min %lu >= max %lu\n", config->whammy_min, config->whammy_max);
         return false;
     }
+    if (config->whammy_max > 65535) {
+        printf("Config: Invalid whammy_max %lu (must be 0-65535)\n", config->whammy_max);
+        return false;
+    }
+    
+    // Validate joystick calibration: center strictly inside each range
+    if (config->joystick_x_min >= config->joystick_x_center || config->joystick_x_center >= config->joystick_x_max ||
+        config->joystick_x_max > 65535) {
+        printf("Config: Invalid joystick X calibration %lu/%lu/%lu\n",
+               config->joystick_x_min, config->joystick_x_center, config->joystick_x_max);
+        return false;
+    }
+    if (config->joystick_y_min >= config->joystick_y_center || config->joystick_y_center >= config->joystick_y_max ||
+        config->joystick_y_max > 65535) {
+        printf("Config: Invalid joystick Y calibration %lu/%lu/%lu\n",
+               config->joystick_y_min, config->joystick_y_center, config->joystick_y_max);
+        return false;
+    }
+    if (config->joystick_deadzone > JOYSTICK_CAL_DEADZONE_MAX) {
+        printf("Config: Invalid joystick_deadzone %lu (must be 0-%d)\n",
+               config->joystick_deadzone, JOYSTICK_CAL_DEADZONE_MAX);
+        return false;
+    }
+    
+    // Validate response curves
+    if (!response_curve_validate(config->whammy_curve) ||
+        !response_curve_validate(config->joystick_x_curve) ||
+        !response_curve_validate(config->joystick_y_curve)) {
+        printf("Config: Invalid response curve (whammy %s, joystick x %s, y %s)\n",
+               config->whammy_curve ? config->whammy_curve : "NULL",
+               config->joystick_x_curve ? config->joystick_x_curve : "NULL",
+               config->joystick_y_curve ? config->joystick_y_curve : "NULL");
+        return false;
+    }
+    
+    // Validate the remap table
+    const char* const remap_targets[REMAP_SOURCES] = {
+        config->GREEN_FRET_map,
+        config->RED_FRET_map,
+        config->YELLOW_FRET_map,
+        config->BLUE_FRET_map,
+        config->ORANGE_FRET_map,
+        config->STRUM_UP_map,
+        config->STRUM_DOWN_map,
+        config->START_map,
+        config->SELECT_map,
+        config->GUIDE_map,
+        config->TILT_map,
+        config->UP_map,
+        config->DOWN_map,
+        config->LEFT_map,
+        config->RIGHT_map,
+        config->WHAMMY_map,
+        config->joystick_x_map,
+        config->joystick_y_map
+    };
+    for (int i = 0; i < REMAP_SOURCES; i++) {
+        if (!remap_validate_target((remap_source_t)i, remap_targets[i])) {
+            printf("Config: Invalid %s: %s\n", remap_source_key((remap_source_t)i),
+                   remap_targets[i] ? remap_targets[i] : "NULL");
+            return false;
+        }
+    }
     
     // Validate hat mode
     if (!config->hat_mode || (strcmp(config->hat_mode, "dpad") != 0 && 
@@ -277,6 +505,14 @@ bool config_validate(const config_t* config) {
                config->hat_mode ? config->hat_mode : "NULL");
         return false;
     }
+
+    // Validate USB mode
+    if (!config->usb_mode || (strcmp(config->usb_mode, "xinput") != 0 &&
+        strcmp(config->usb_mode, "hid") != 0)) {
+        printf("Config: Invalid usb_mode: %s (must be 'xinput' or 'hid')\n",
+               config->usb_mode ? config->usb_mode : "NULL");
+        return false;
+    }
     
     // Validate LED color arrays
     for (int i = 0; i < 7; i++) {
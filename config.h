@@ -52,11 +52,46 @@ typedef struct {
     
     // Settings
     const char* hat_mode;         // "dpad"
+    const char* usb_mode;         // "xinput" or "hid", chosen at enumeration
     float led_brightness;         // 0.0 to 1.0
     uint32_t whammy_min;
     uint32_t whammy_max;
     bool whammy_reverse;
     bool tilt_wave_enabled;
+
+    // Joystick calibration (16-bit oversampled ADC units)
+    uint32_t joystick_x_center;
+    uint32_t joystick_x_min;
+    uint32_t joystick_x_max;
+    uint32_t joystick_y_center;
+    uint32_t joystick_y_min;
+    uint32_t joystick_y_max;
+    uint32_t joystick_deadzone;   // Radial, in stick units (0-16383)
+
+    // Response curves ("linear", "expo:30", "points:0,20,100"...)
+    const char* whammy_curve;
+    const char* joystick_x_curve;
+    const char* joystick_y_curve;
+
+    // Remap table: XInput target of each control ("a", "dpad_up", "rx", "ly-"...)
+    const char* GREEN_FRET_map;
+    const char* RED_FRET_map;
+    const char* YELLOW_FRET_map;
+    const char* BLUE_FRET_map;
+    const char* ORANGE_FRET_map;
+    const char* STRUM_UP_map;
+    const char* STRUM_DOWN_map;
+    const char* START_map;
+    const char* SELECT_map;
+    const char* GUIDE_map;
+    const char* TILT_map;
+    const char* UP_map;
+    const char* DOWN_map;
+    const char* LEFT_map;
+    const char* RIGHT_map;
+    const char* WHAMMY_map;
+    const char* joystick_x_map;
+    const char* joystick_y_map;
     
     // LED colors (7 element arrays)
     const char* led_color[7];
@@ -66,12 +101,29 @@ typedef struct {
 // Function to initialize configuration system
 void config_init(void);
 
+// Active configuration (live copy used by the firmware and config.json)
+const config_t* config_get_current(void);
+
+// Bumped each time a configuration is activated, so cached pin maps know to reload
+uint32_t config_get_generation(void);
+
 // Function to print current configuration
 void config_print_current(void);
 
 // Function to update configuration from JSON string
 bool config_update_from_json(const char* json_string);
 
+// Replace whammy_min/whammy_max (auto-calibration result) and save to flash
+bool config_set_whammy_range(uint32_t whammy_min, uint32_t whammy_max);
+
+// Replace the joystick calibration (JOY:SAVE) or deadzone and save to flash
+bool config_set_joystick_cal(uint32_t x_center, uint32_t x_min, uint32_t x_max,
+                             uint32_t y_center, uint32_t y_min, uint32_t y_max);
+bool config_set_joystick_deadzone(uint32_t deadzone);
+
+// Replace usb_mode (MODE: command, boot combo) and save to flash
+bool config_set_usb_mode(const char* usb_mode);
+
 // Function to validate configuration
 bool config_validate(const config_t* config);
 
@@ -1,10 +1,13 @@
 #include "config_storage.h"
+#include "response_curve.h"
+#include "remap.h"
 #include "pico/stdlib.h"
 #include "hardware/flash.h"
 #include "hardware/sync.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stddef.h>
 
 // Default config JSON embedded at build time (BGG format)
 static const char default_config_json[] = "{\n"
@@ -39,11 +42,40 @@ static const char default_config_json[] = "{\n"
 "  \"STRUM_UP_led\": 0,\n"
 "  \"STRUM_DOWN_led\": 1,\n"
 "  \"hat_mode\": \"dpad\",\n"
+"  \"usb_mode\": \"xinput\",\n"
 "  \"led_brightness\": 1.0,\n"
 "  \"whammy_min\": 500,\n"
 "  \"whammy_max\": 65000,\n"
 "  \"whammy_reverse\": false,\n"
 "  \"tilt_wave_enabled\": true,\n"
+"  \"joystick_x_center\": 32768,\n"
+"  \"joystick_x_min\": 0,\n"
+"  \"joystick_x_max\": 65520,\n"
+"  \"joystick_y_center\": 32768,\n"
+"  \"joystick_y_min\": 0,\n"
+"  \"joystick_y_max\": 65520,\n"
+"  \"joystick_deadzone\": 2048,\n"
+"  \"whammy_curve\": \"linear\",\n"
+"  \"joystick_x_curve\": \"linear\",\n"
+"  \"joystick_y_curve\": \"linear\",\n"
+"  \"GREEN_FRET_map\": \"a\",\n"
+"  \"RED_FRET_map\": \"b\",\n"
+"  \"YELLOW_FRET_map\": \"y\",\n"
+"  \"BLUE_FRET_map\": \"x\",\n"
+"  \"ORANGE_FRET_map\": \"lb\",\n"
+"  \"STRUM_UP_map\": \"dpad_up\",\n"
+"  \"STRUM_DOWN_map\": \"dpad_down\",\n"
+"  \"START_map\": \"start\",\n"
+"  \"SELECT_map\": \"back\",\n"
+"  \"GUIDE_map\": \"guide\",\n"
+"  \"TILT_map\": \"ry\",\n"
+"  \"UP_map\": \"dpad_up\",\n"
+"  \"DOWN_map\": \"dpad_down\",\n"
+"  \"LEFT_map\": \"dpad_left\",\n"
+"  \"RIGHT_map\": \"dpad_right\",\n"
+"  \"WHAMMY_map\": \"rx\",\n"
+"  \"joystick_x_map\": \"lx\",\n"
+"  \"joystick_y_map\": \"ly\",\n"
 "  \"led_color\": [\n"
 "    \"#FFFFFF\", \"#FFFFFF\", \"#B33E00\", \"#0000FF\",\n"
 "    \"#FFFF00\", \"#FF0000\", \"#00FF00\"\n"
@@ -101,18 +133,22 @@ static const uint32_t crc32_table[256] = {
     0xbcb4666d, 0xb8757bda, 0xb5365d03, 0xb1f740b4
 };
 
-uint32_t config_storage_calculate_crc32(const void* data, uint32_t size) {
+uint32_t config_storage_crc32_update(uint32_t crc, const void* data, uint32_t size) {
     const uint8_t* bytes = (const uint8_t*)data;
-    uint32_t crc = 0xFFFFFFFF;
-    
+    crc ^= 0xFFFFFFFF;
+
     for (uint32_t i = 0; i < size; i++) {
         uint8_t index = (crc ^ bytes[i]) & 0xFF;
         crc = (crc >> 8) ^ crc32_table[index];
     }
-    
+
     return crc ^ 0xFFFFFFFF;
 }
 
+uint32_t config_storage_calculate_crc32(const void* data, uint32_t size) {
+    return config_storage_crc32_update(0, data, size);
+}
+
 bool config_storage_init(void) {
     printf("Config storage: Initializing...\n");
     
@@ -161,14 +197,20 @@ bool config_storage_save_to_flash(const char* json_data, uint32_t json_size) {
         return false;
     }
     
-    // Prepare config data in RAM
-    config_storage_t config_data = {0};
-    config_data.header.magic = CONFIG_MAGIC_HEADER;
-    config_data.header.version = CONFIG_VERSION;
-    config_data.header.json_size = json_size;
-    config_data.header.checksum = config_storage_calculate_crc32(json_data, json_size);
-    
-    memcpy(config_data.json_data, json_data, json_size);
+    // Prepare the whole sector in RAM. Static: it is larger than the core 0
+    // stack, and the flash program below reads a full sector from it
+    static union {
+        config_storage_t config;
+        uint8_t bytes[FLASH_SECTOR_SIZE];
+    } page;
+    memset(&page, 0, sizeof(page));
+    config_storage_t* config_data = &page.config;
+    config_data->header.magic = CONFIG_MAGIC_HEADER;
+    config_data->header.version = CONFIG_VERSION;
+    config_data->header.json_size = json_size;
+    config_data->header.checksum = config_storage_calculate_crc32(json_data, json_size);
+    
+    memcpy(config_data->json_data, json_data, json_size);
     
     printf("Config storage: Saving to flash (size: %lu bytes)\n", json_size);
     
@@ -179,7 +221,7 @@ bool config_storage_save_to_flash(const char* json_data, uint32_t json_size) {
     flash_range_erase(CONFIG_FLASH_OFFSET, FLASH_SECTOR_SIZE);
     
     // Write the config data
-    flash_range_program(CONFIG_FLASH_OFFSET, (const uint8_t*)&config_data, FLASH_SECTOR_SIZE);
+    flash_range_program(CONFIG_FLASH_OFFSET, page.bytes, FLASH_SECTOR_SIZE);
     
     // Re-enable interrupts
     restore_interrupts(interrupts);
@@ -218,7 +260,9 @@ bool config_storage_get_json(char* buffer, uint32_t buffer_size, uint32_t* actua
 }
 
 bool config_storage_load_from_flash(config_t* config) {
-    char json_buffer[CONFIG_JSON_MAX_SIZE + 1];
+    // Static: config_parse_json runs on top of this call and the core 0
+    // stack is only 2 KB
+    static char json_buffer[CONFIG_JSON_MAX_SIZE + 1];
     
     if (!config_storage_get_json(json_buffer, sizeof(json_buffer), NULL)) {
         printf("Config storage: Failed to get JSON from flash\n");
@@ -238,6 +282,32 @@ void config_storage_format(void) {
     printf("Config storage: Format completed\n");
 }
 
+// String storage for parsed configs (config_t only holds const char*). There
+// are two sets: a parse always fills the one the active config does not point
+// into, and config_parse_json_commit() hands it over once that config has
+// been installed, so a file that fails validation never touches the strings
+// in use (the sample interrupt reads the pin names).
+typedef struct {
+    char device_name[64];
+    char up[8], down[8], left[8], right[8];
+    char green_fret[8], red_fret[8], yellow_fret[8], blue_fret[8], orange_fret[8];
+    char strum_up[8], strum_down[8], tilt[8], select[8], start[8], guide[8];
+    char whammy[8], neopixel[8], joystick_x[8], joystick_y[8];
+    char hat_mode[16], usb_mode[16];
+    char whammy_curve[RESPONSE_CURVE_SPEC_MAX];
+    char joystick_x_curve[RESPONSE_CURVE_SPEC_MAX], joystick_y_curve[RESPONSE_CURVE_SPEC_MAX];
+    char remap[REMAP_SOURCES][REMAP_TARGET_MAX];
+    char version[16], description[64], lastUpdated[16];
+    char led_colors[7][8], released_colors[7][8];
+} config_strings_t;
+
+static config_strings_t string_sets[2];
+static uint8_t spare_strings = 0;
+
+void config_parse_json_commit(void) {
+    spare_strings ^= 1;
+}
+
 // Simple JSON parser for BGG config format
 bool config_parse_json(const char* json, config_t* config) {
     // Note: This is a simplified parser for BGG JSON structure
@@ -312,63 +382,88 @@ bool config_parse_json(const char* json, config_t* config) {
         
         return default_value;
     }
-    
-    // Static buffers for string storage (since config stores const char*)
-    static char device_name_buf[64];
-    static char up_buf[8], down_buf[8], left_buf[8], right_buf[8];
-    static char green_fret_buf[8], red_fret_buf[8], yellow_fret_buf[8], blue_fret_buf[8], orange_fret_buf[8];
-    static char strum_up_buf[8], strum_down_buf[8], tilt_buf[8], select_buf[8], start_buf[8], guide_buf[8];
-    static char whammy_buf[8], neopixel_buf[8], joystick_x_buf[8], joystick_y_buf[8];
-    static char hat_mode_buf[16];
-    static char version_buf[16], description_buf[64], lastUpdated_buf[16];
-    static char led_colors[7][8], released_colors[7][8];
+
+    // Helper function to extract an array of short strings (e.g. "#RRGGBB" colors)
+    int extract_string_array(const char* json, const char* key, char (*out)[8], int max_count) {
+        char search_str[64];
+        snprintf(search_str, sizeof(search_str), "\"%s\":", key);
+
+        char* pos = strstr(json, search_str);
+        if (!pos) return 0;
+
+        pos += strlen(search_str);
+        while (*pos == ' ' || *pos == '\t' || *pos == '\n' || *pos == '\r') pos++;
+        if (*pos != '[') return 0;
+        pos++;
+
+        int count = 0;
+        while (count < max_count) {
+            while (*pos == ' ' || *pos == '\t' || *pos == '\n' || *pos == '\r' || *pos == ',') pos++;
+            if (*pos != '"') break;
+            pos++; // Skip opening quote
+
+            char* end = strchr(pos, '"');
+            if (!end) break;
+
+            size_t len = end - pos;
+            if (len >= sizeof(out[0])) len = sizeof(out[0]) - 1;
+            memcpy(out[count], pos, len);
+            out[count][len] = '\0';
+            count++;
+            pos = end + 1;
+        }
+        return count;
+    }
+
+    // Strings go to the set the active config does not point into
+    config_strings_t* strings = &string_sets[spare_strings];
     
     // Extract metadata
-    if (extract_string_value(json, "version", version_buf, sizeof(version_buf))) {
-        config->metadata.version = version_buf;
+    if (extract_string_value(json, "version", strings->version, sizeof(strings->version))) {
+        config->metadata.version = strings->version;
     } else {
         config->metadata.version = "4.0.0";
     }
     
-    if (extract_string_value(json, "description", description_buf, sizeof(description_buf))) {
-        config->metadata.description = description_buf;
+    if (extract_string_value(json, "description", strings->description, sizeof(strings->description))) {
+        config->metadata.description = strings->description;
     } else {
         config->metadata.description = "BumbleGum Guitar Controller Configuration";
     }
     
-    if (extract_string_value(json, "lastUpdated", lastUpdated_buf, sizeof(lastUpdated_buf))) {
-        config->metadata.lastUpdated = lastUpdated_buf;
+    if (extract_string_value(json, "lastUpdated", strings->lastUpdated, sizeof(strings->lastUpdated))) {
+        config->metadata.lastUpdated = strings->lastUpdated;
     } else {
         config->metadata.lastUpdated = "2025-08-21";
     }
     
     // Extract device name
-    if (extract_string_value(json, "device_name", device_name_buf, sizeof(device_name_buf))) {
-        config->device_name = device_name_buf;
+    if (extract_string_value(json, "device_name", strings->device_name, sizeof(strings->device_name))) {
+        config->device_name = strings->device_name;
     } else {
         config->device_name = "Guitar Controller";
     }
     
     // Extract GPIO pins
-    config->UP = extract_string_value(json, "UP", up_buf, sizeof(up_buf)) ? up_buf : "GP2";
-    config->DOWN = extract_string_value(json, "DOWN", down_buf, sizeof(down_buf)) ? down_buf : "GP3";
-    config->LEFT = extract_string_value(json, "LEFT", left_buf, sizeof(left_buf)) ? left_buf : "GP4";
-    config->RIGHT = extract_string_value(json, "RIGHT", right_buf, sizeof(right_buf)) ? right_buf : "GP5";
-    config->GREEN_FRET = extract_string_value(json, "GREEN_FRET", green_fret_buf, sizeof(green_fret_buf)) ? green_fret_buf : "GP10";
-    config->RED_FRET = extract_string_value(json, "RED_FRET", red_fret_buf, sizeof(red_fret_buf)) ? red_fret_buf : "GP11";
-    config->YELLOW_FRET = extract_string_value(json, "YELLOW_FRET", yellow_fret_buf, sizeof(yellow_fret_buf)) ? yellow_fret_buf : "GP12";
-    config->BLUE_FRET = extract_string_value(json, "BLUE_FRET", blue_fret_buf, sizeof(blue_fret_buf)) ? blue_fret_buf : "GP13";
-    config->ORANGE_FRET = extract_string_value(json, "ORANGE_FRET", orange_fret_buf, sizeof(orange_fret_buf)) ? orange_fret_buf : "GP14";
-    config->STRUM_UP = extract_string_value(json, "STRUM_UP", strum_up_buf, sizeof(strum_up_buf)) ? strum_up_buf : "GP7";
-    config->STRUM_DOWN = extract_string_value(json, "STRUM_DOWN", strum_down_buf, sizeof(strum_down_buf)) ? strum_down_buf : "GP8";
-    config->TILT = extract_string_value(json, "TILT", tilt_buf, sizeof(tilt_buf)) ? tilt_buf : "GP9";
-    config->SELECT = extract_string_value(json, "SELECT", select_buf, sizeof(select_buf)) ? select_buf : "GP0";
-    config->START = extract_string_value(json, "START", start_buf, sizeof(start_buf)) ? start_buf : "GP1";
-    config->GUIDE = extract_string_value(json, "GUIDE", guide_buf, sizeof(guide_buf)) ? guide_buf : "GP6";
-    config->WHAMMY = extract_string_value(json, "WHAMMY", whammy_buf, sizeof(whammy_buf)) ? whammy_buf : "GP27";
-    config->neopixel_pin = extract_string_value(json, "neopixel_pin", neopixel_buf, sizeof(neopixel_buf)) ? neopixel_buf : "GP23";
-    config->joystick_x_pin = extract_string_value(json, "joystick_x_pin", joystick_x_buf, sizeof(joystick_x_buf)) ? joystick_x_buf : "GP28";
-    config->joystick_y_pin = extract_string_value(json, "joystick_y_pin", joystick_y_buf, sizeof(joystick_y_buf)) ? joystick_y_buf : "GP29";
+    config->UP = extract_string_value(json, "UP", strings->up, sizeof(strings->up)) ? strings->up : "GP2";
+    config->DOWN = extract_string_value(json, "DOWN", strings->down, sizeof(strings->down)) ? strings->down : "GP3";
+    config->LEFT = extract_string_value(json, "LEFT", strings->left, sizeof(strings->left)) ? strings->left : "GP4";
+    config->RIGHT = extract_string_value(json, "RIGHT", strings->right, sizeof(strings->right)) ? strings->right : "GP5";
+    config->GREEN_FRET = extract_string_value(json, "GREEN_FRET", strings->green_fret, sizeof(strings->green_fret)) ? strings->green_fret : "GP10";
+    config->RED_FRET = extract_string_value(json, "RED_FRET", strings->red_fret, sizeof(strings->red_fret)) ? strings->red_fret : "GP11";
+    config->YELLOW_FRET = extract_string_value(json, "YELLOW_FRET", strings->yellow_fret, sizeof(strings->yellow_fret)) ? strings->yellow_fret : "GP12";
+    config->BLUE_FRET = extract_string_value(json, "BLUE_FRET", strings->blue_fret, sizeof(strings->blue_fret)) ? strings->blue_fret : "GP13";
+    config->ORANGE_FRET = extract_string_value(json, "ORANGE_FRET", strings->orange_fret, sizeof(strings->orange_fret)) ? strings->orange_fret : "GP14";
+    config->STRUM_UP = extract_string_value(json, "STRUM_UP", strings->strum_up, sizeof(strings->strum_up)) ? strings->strum_up : "GP7";
+    config->STRUM_DOWN = extract_string_value(json, "STRUM_DOWN", strings->strum_down, sizeof(strings->strum_down)) ? strings->strum_down : "GP8";
+    config->TILT = extract_string_value(json, "TILT", strings->tilt, sizeof(strings->tilt)) ? strings->tilt : "GP9";
+    config->SELECT = extract_string_value(json, "SELECT", strings->select, sizeof(strings->select)) ? strings->select : "GP0";
+    config->START = extract_string_value(json, "START", strings->start, sizeof(strings->start)) ? strings->start : "GP1";
+    config->GUIDE = extract_string_value(json, "GUIDE", strings->guide, sizeof(strings->guide)) ? strings->guide : "GP6";
+    config->WHAMMY = extract_string_value(json, "WHAMMY", strings->whammy, sizeof(strings->whammy)) ? strings->whammy : "GP27";
+    config->neopixel_pin = extract_string_value(json, "neopixel_pin", strings->neopixel, sizeof(strings->neopixel)) ? strings->neopixel : "GP23";
+    config->joystick_x_pin = extract_string_value(json, "joystick_x_pin", strings->joystick_x, sizeof(strings->joystick_x)) ? strings->joystick_x : "GP28";
+    config->joystick_y_pin = extract_string_value(json, "joystick_y_pin", strings->joystick_y, sizeof(strings->joystick_y)) ? strings->joystick_y : "GP29";
     
     // Extract LED assignments
     int val;
@@ -394,7 +489,8 @@ bool config_parse_json(const char* json, config_t* config) {
     config->STRUM_DOWN_led = (val >= 0) ? (uint8_t)val : 1;
     
     // Extract settings
-    config->hat_mode = extract_string_value(json, "hat_mode", hat_mode_buf, sizeof(hat_mode_buf)) ? hat_mode_buf : "dpad";
+    config->hat_mode = extract_string_value(json, "hat_mode", strings->hat_mode, sizeof(strings->hat_mode)) ? strings->hat_mode : "dpad";
+    config->usb_mode = extract_string_value(json, "usb_mode", strings->usb_mode, sizeof(strings->usb_mode)) ? strings->usb_mode : "xinput";
     
     float brightness = extract_float_value(json, "led_brightness");
     config->led_brightness = (brightness >= 0.0f) ? brightness : 1.0f;
@@ -407,101 +503,309 @@ bool config_parse_json(const char* json, config_t* config) {
     
     config->whammy_reverse = extract_bool_value(json, "whammy_reverse", false);
     config->tilt_wave_enabled = extract_bool_value(json, "tilt_wave_enabled", true);
+
+    // Joystick calibration; files from older firmware get the uncalibrated full range
+    val = extract_int_value(json, "joystick_x_center");
+    config->joystick_x_center = (val >= 0) ? (uint32_t)val : 32768;
+    val = extract_int_value(json, "joystick_x_min");
+    config->joystick_x_min = (val >= 0) ? (uint32_t)val : 0;
+    val = extract_int_value(json, "joystick_x_max");
+    config->joystick_x_max = (val >= 0) ? (uint32_t)val : 65520;
+    val = extract_int_value(json, "joystick_y_center");
+    config->joystick_y_center = (val >= 0) ? (uint32_t)val : 32768;
+    val = extract_int_value(json, "joystick_y_min");
+    config->joystick_y_min = (val >= 0) ? (uint32_t)val : 0;
+    val = extract_int_value(json, "joystick_y_max");
+    config->joystick_y_max = (val >= 0) ? (uint32_t)val : 65520;
+    val = extract_int_value(json, "joystick_deadzone");
+    config->joystick_deadzone = (val >= 0) ? (uint32_t)val : 2048;
+
+    config->whammy_curve = extract_string_value(json, "whammy_curve", strings->whammy_curve, sizeof(strings->whammy_curve)) ?
+        strings->whammy_curve : "linear";
+    config->joystick_x_curve = extract_string_value(json, "joystick_x_curve", strings->joystick_x_curve,
+        sizeof(strings->joystick_x_curve)) ? strings->joystick_x_curve : "linear";
+    config->joystick_y_curve = extract_string_value(json, "joystick_y_curve", strings->joystick_y_curve,
+        sizeof(strings->joystick_y_curve)) ? strings->joystick_y_curve : "linear";
+
+    // Remap table; a control missing from the file keeps its default target
+    const char** remap_fields[REMAP_SOURCES] = {
+        &config->GREEN_FRET_map,
+        &config->RED_FRET_map,
+        &config->YELLOW_FRET_map,
+        &config->BLUE_FRET_map,
+        &config->ORANGE_FRET_map,
+        &config->STRUM_UP_map,
+        &config->STRUM_DOWN_map,
+        &config->START_map,
+        &config->SELECT_map,
+        &config->GUIDE_map,
+        &config->TILT_map,
+        &config->UP_map,
+        &config->DOWN_map,
+        &config->LEFT_map,
+        &config->RIGHT_map,
+        &config->WHAMMY_map,
+        &config->joystick_x_map,
+        &config->joystick_y_map
+    };
+    for (int i = 0; i < REMAP_SOURCES; i++) {
+        *remap_fields[i] = extract_string_value(json, remap_source_key((remap_source_t)i), strings->remap[i],
+            sizeof(strings->remap[i])) ? strings->remap[i] : remap_default_targets[i];
+    }
     
-    // Extract LED color arrays (simplified - just use defaults for now)
-    // TODO: Implement proper array parsing
+    // Extract LED color arrays, falling back to defaults for missing entries.
+    // config.json is generated from these fields, so they must round-trip.
     const char* default_led_colors[] = {
-        "#FFFFFF", "#FFFFFF", "#B33E00", "#0000FF", 
+        "#FFFFFF", "#FFFFFF", "#B33E00", "#0000FF",
         "#FFFF00", "#FF0000", "#00FF00"
     };
     const char* default_released_colors[] = {
         "#454545", "#454545", "#521C00", "#000091",
         "#696B00", "#8C0009", "#003D00"
     };
-    
+
+    int led_count = extract_string_array(json, "led_color", strings->led_colors, 7);
+    int released_count = extract_string_array(json, "released_color", strings->released_colors, 7);
+
     for (int i = 0; i < 7; i++) {
-        strncpy(led_colors[i], default_led_colors[i], sizeof(led_colors[i]) - 1);
-        led_colors[i][sizeof(led_colors[i]) - 1] = '\0';
-        config->led_color[i] = led_colors[i];
-        
-        strncpy(released_colors[i], default_released_colors[i], sizeof(released_colors[i]) - 1);
-        released_colors[i][sizeof(released_colors[i]) - 1] = '\0';
-        config->released_color[i] = released_colors[i];
+        if (i >= led_count) {
+            strncpy(strings->led_colors[i], default_led_colors[i], sizeof(strings->led_colors[i]) - 1);
+            strings->led_colors[i][sizeof(strings->led_colors[i]) - 1] = '\0';
+        }
+        config->led_color[i] = strings->led_colors[i];
+
+        if (i >= released_count) {
+            strncpy(strings->released_colors[i], default_released_colors[i], sizeof(strings->released_colors[i]) - 1);
+            strings->released_colors[i][sizeof(strings->released_colors[i]) - 1] = '\0';
+        }
+        config->released_color[i] = strings->released_colors[i];
     }
     
     return true;
 }
 
+//--------------------------------------------------------------------+
+// JSON GENERATION
+//--------------------------------------------------------------------+
+// config.json is emitted one line at a time so it can be streamed to the
+// host (or synthesized into MSC sectors) without a full-size RAM copy.
+
+typedef enum {
+    JSON_FIELD_STRING,
+    JSON_FIELD_U8,
+    JSON_FIELD_U32,
+    JSON_FIELD_FLOAT,
+    JSON_FIELD_BOOL
+} json_field_type_t;
+
+typedef struct {
+    const char* key;
+    json_field_type_t type;
+    size_t offset;
+} json_field_t;
+
+#define JSON_FIELD(key, type, member) { key, type, offsetof(config_t, member) }
+
+// Field order matches the BGG-compatible layout produced by previous firmware
+static const json_field_t json_fields[] = {
+    JSON_FIELD("version",          JSON_FIELD_STRING, metadata.version),
+    JSON_FIELD("description",      JSON_FIELD_STRING, metadata.description),
+    JSON_FIELD("lastUpdated",      JSON_FIELD_STRING, metadata.lastUpdated),
+    JSON_FIELD("device_name",      JSON_FIELD_STRING, device_name),
+    JSON_FIELD("UP",               JSON_FIELD_STRING, UP),
+    JSON_FIELD("DOWN",             JSON_FIELD_STRING, DOWN),
+    JSON_FIELD("LEFT",             JSON_FIELD_STRING, LEFT),
+    JSON_FIELD("RIGHT",            JSON_FIELD_STRING, RIGHT),
+    JSON_FIELD("GREEN_FRET",       JSON_FIELD_STRING, GREEN_FRET),
+    JSON_FIELD("RED_FRET",         JSON_FIELD_STRING, RED_FRET),
+    JSON_FIELD("YELLOW_FRET",      JSON_FIELD_STRING, YELLOW_FRET),
+    JSON_FIELD("BLUE_FRET",        JSON_FIELD_STRING, BLUE_FRET),
+    JSON_FIELD("ORANGE_FRET",      JSON_FIELD_STRING, ORANGE_FRET),
+    JSON_FIELD("STRUM_UP",         JSON_FIELD_STRING, STRUM_UP),
+    JSON_FIELD("STRUM_DOWN",       JSON_FIELD_STRING, STRUM_DOWN),
+    JSON_FIELD("TILT",             JSON_FIELD_STRING, TILT),
+    JSON_FIELD("SELECT",           JSON_FIELD_STRING, SELECT),
+    JSON_FIELD("START",            JSON_FIELD_STRING, START),
+    JSON_FIELD("GUIDE",            JSON_FIELD_STRING, GUIDE),
+    JSON_FIELD("WHAMMY",           JSON_FIELD_STRING, WHAMMY),
+    JSON_FIELD("neopixel_pin",     JSON_FIELD_STRING, neopixel_pin),
+    JSON_FIELD("joystick_x_pin",   JSON_FIELD_STRING, joystick_x_pin),
+    JSON_FIELD("joystick_y_pin",   JSON_FIELD_STRING, joystick_y_pin),
+    JSON_FIELD("GREEN_FRET_led",   JSON_FIELD_U8,     GREEN_FRET_led),
+    JSON_FIELD("RED_FRET_led",     JSON_FIELD_U8,     RED_FRET_led),
+    JSON_FIELD("YELLOW_FRET_led",  JSON_FIELD_U8,     YELLOW_FRET_led),
+    JSON_FIELD("BLUE_FRET_led",    JSON_FIELD_U8,     BLUE_FRET_led),
+    JSON_FIELD("ORANGE_FRET_led",  JSON_FIELD_U8,     ORANGE_FRET_led),
+    JSON_FIELD("STRUM_UP_led",     JSON_FIELD_U8,     STRUM_UP_led),
+    JSON_FIELD("STRUM_DOWN_led",   JSON_FIELD_U8,     STRUM_DOWN_led),
+    JSON_FIELD("hat_mode",         JSON_FIELD_STRING, hat_mode),
+    JSON_FIELD("usb_mode",         JSON_FIELD_STRING, usb_mode),
+    JSON_FIELD("led_brightness",   JSON_FIELD_FLOAT,  led_brightness),
+    JSON_FIELD("whammy_min",       JSON_FIELD_U32,    whammy_min),
+    JSON_FIELD("whammy_max",       JSON_FIELD_U32,    whammy_max),
+    JSON_FIELD("whammy_reverse",   JSON_FIELD_BOOL,   whammy_reverse),
+    JSON_FIELD("tilt_wave_enabled", JSON_FIELD_BOOL,  tilt_wave_enabled),
+    JSON_FIELD("joystick_x_center", JSON_FIELD_U32,   joystick_x_center),
+    JSON_FIELD("joystick_x_min",   JSON_FIELD_U32,    joystick_x_min),
+    JSON_FIELD("joystick_x_max",   JSON_FIELD_U32,    joystick_x_max),
+    JSON_FIELD("joystick_y_center", JSON_FIELD_U32,   joystick_y_center),
+    JSON_FIELD("joystick_y_min",   JSON_FIELD_U32,    joystick_y_min),
+    JSON_FIELD("joystick_y_max",   JSON_FIELD_U32,    joystick_y_max),
+    JSON_FIELD("joystick_deadzone", JSON_FIELD_U32,   joystick_deadzone),
+    JSON_FIELD("whammy_curve",     JSON_FIELD_STRING, whammy_curve),
+    JSON_FIELD("joystick_x_curve", JSON_FIELD_STRING, joystick_x_curve),
+    JSON_FIELD("joystick_y_curve", JSON_FIELD_STRING, joystick_y_curve),
+    JSON_FIELD("GREEN_FRET_map",    JSON_FIELD_STRING, GREEN_FRET_map),
+    JSON_FIELD("RED_FRET_map",      JSON_FIELD_STRING, RED_FRET_map),
+    JSON_FIELD("YELLOW_FRET_map",   JSON_FIELD_STRING, YELLOW_FRET_map),
+    JSON_FIELD("BLUE_FRET_map",     JSON_FIELD_STRING, BLUE_FRET_map),
+    JSON_FIELD("ORANGE_FRET_map",   JSON_FIELD_STRING, ORANGE_FRET_map),
+    JSON_FIELD("STRUM_UP_map",      JSON_FIELD_STRING, STRUM_UP_map),
+    JSON_FIELD("STRUM_DOWN_map",    JSON_FIELD_STRING, STRUM_DOWN_map),
+    JSON_FIELD("START_map",         JSON_FIELD_STRING, START_map),
+    JSON_FIELD("SELECT_map",        JSON_FIELD_STRING, SELECT_map),
+    JSON_FIELD("GUIDE_map",         JSON_FIELD_STRING, GUIDE_map),
+    JSON_FIELD("TILT_map",          JSON_FIELD_STRING, TILT_map),
+    JSON_FIELD("UP_map",            JSON_FIELD_STRING, UP_map),
+    JSON_FIELD("DOWN_map",          JSON_FIELD_STRING, DOWN_map),
+    JSON_FIELD("LEFT_map",          JSON_FIELD_STRING, LEFT_map),
+    JSON_FIELD("RIGHT_map",         JSON_FIELD_STRING, RIGHT_map),
+    JSON_FIELD("WHAMMY_map",        JSON_FIELD_STRING, WHAMMY_map),
+    JSON_FIELD("joystick_x_map",    JSON_FIELD_STRING, joystick_x_map),
+    JSON_FIELD("joystick_y_map",    JSON_FIELD_STRING, joystick_y_map),
+};
+
+#define JSON_FIELD_COUNT    (sizeof(json_fields) / sizeof(json_fields[0]))
+#define JSON_LINE_MAX       96
+
+// Lines: "{", one per field, 3 per color array, "}"
+#define JSON_LINE_COUNT     (1 + JSON_FIELD_COUNT + 6 + 1)
+
+// Render a single line of the generated JSON. Returns its length, or -1 past the end.
+static int config_json_line(const config_t* config, uint32_t line, char* buffer, uint32_t buffer_size) {
+    if (line == 0) {
+        return snprintf(buffer, buffer_size, "{\n");
+    }
+    line--;
+
+    if (line < JSON_FIELD_COUNT) {
+        const json_field_t* field = &json_fields[line];
+        const void* value = (const uint8_t*)config + field->offset;
+
+        switch (field->type) {
+            case JSON_FIELD_STRING:
+                return snprintf(buffer, buffer_size, "  \"%s\": \"%s\",\n", field->key, *(const char* const*)value);
+            case JSON_FIELD_U8:
+                return snprintf(buffer, buffer_size, "  \"%s\": %d,\n", field->key, *(const uint8_t*)value);
+            case JSON_FIELD_U32:
+                return snprintf(buffer, buffer_size, "  \"%s\": %lu,\n", field->key, (unsigned long)*(const uint32_t*)value);
+            case JSON_FIELD_FLOAT:
+                return snprintf(buffer, buffer_size, "  \"%s\": %.2f,\n", field->key, *(const float*)value);
+            case JSON_FIELD_BOOL:
+                return snprintf(buffer, buffer_size, "  \"%s\": %s,\n", field->key, *(const bool*)value ? "true" : "false");
+        }
+        return -1;
+    }
+    line -= JSON_FIELD_COUNT;
+
+    const char* const* colors = (line < 3) ? config->led_color : config->released_color;
+    switch (line) {
+        case 0:
+            return snprintf(buffer, buffer_size, "  \"led_color\": [\n");
+        case 3:
+            return snprintf(buffer, buffer_size, "  \"released_color\": [\n");
+        case 1:
+        case 4:
+            return snprintf(buffer, buffer_size,
+                "    \"%s\", \"%s\", \"%s\", \"%s\", \"%s\", \"%s\", \"%s\"\n",
+                colors[0], colors[1], colors[2], colors[3], colors[4], colors[5], colors[6]);
+        case 2:
+            return snprintf(buffer, buffer_size, "  ],\n");
+        case 5:
+            return snprintf(buffer, buffer_size, "  ]\n");
+        case 6:
+            return snprintf(buffer, buffer_size, "}");
+        default:
+            return -1;
+    }
+}
+
+// Sequential readers (CDC streaming, MSC sectors) resume from the last line
+// instead of re-rendering the document from the top on every chunk.
+static struct {
+    const config_t* config;
+    uint32_t line;
+    uint32_t line_start;
+} json_cursor;
+
+void config_json_invalidate_cache(void) {
+    json_cursor.config = NULL;
+}
+
+uint32_t config_json_read_at(const config_t* config, uint32_t offset, char* dst, uint32_t len) {
+    char line_buffer[JSON_LINE_MAX];
+    uint32_t line = 0;
+    uint32_t line_start = 0;
+    uint32_t copied = 0;
+
+    if (len == 0) return 0;
+
+    if (json_cursor.config == config && offset >= json_cursor.line_start) {
+        line = json_cursor.line;
+        line_start = json_cursor.line_start;
+    }
+
+    while (line < JSON_LINE_COUNT) {
+        int n = config_json_line(config, line, line_buffer, sizeof(line_buffer));
+        if (n < 0) break;
+        if (n >= (int)sizeof(line_buffer)) n = sizeof(line_buffer) - 1;
+
+        uint32_t line_end = line_start + (uint32_t)n;
+        if (dst && offset + copied < line_end) {
+            uint32_t from = offset + copied - line_start;
+            uint32_t chunk = (uint32_t)n - from;
+            if (chunk > len - copied) chunk = len - copied;
+
+            memcpy(dst + copied, line_buffer + from, chunk);
+            copied += chunk;
+            if (copied == len) break;  // Stopped inside this line, resume here next time
+        }
+
+        line_start = line_end;
+        line++;
+    }
+
+    json_cursor.config = config;
+    json_cursor.line = line;
+    json_cursor.line_start = line_start;
+
+    return copied;
+}
+
+uint32_t config_json_size(const config_t* config) {
+    char line_buffer[JSON_LINE_MAX];
+    uint32_t size = 0;
+
+    for (uint32_t line = 0; line < JSON_LINE_COUNT; line++) {
+        int n = config_json_line(config, line, line_buffer, sizeof(line_buffer));
+        if (n < 0) break;
+        if (n >= (int)sizeof(line_buffer)) n = sizeof(line_buffer) - 1;
+        size += (uint32_t)n;
+    }
+
+    return size;
+}
+
 bool config_generate_json(const config_t* config, char* buffer, uint32_t buffer_size) {
     // Generate BGG-compatible JSON format
-    int written = snprintf(buffer, buffer_size,
-        "{\n"
-        "  \"version\": \"%s\",\n"
-        "  \"description\": \"%s\",\n"
-        "  \"lastUpdated\": \"%s\",\n"
-        "  \"device_name\": \"%s\",\n"
-        "  \"UP\": \"%s\",\n"
-        "  \"DOWN\": \"%s\",\n"
-        "  \"LEFT\": \"%s\",\n"
-        "  \"RIGHT\": \"%s\",\n"
-        "  \"GREEN_FRET\": \"%s\",\n"
-        "  \"RED_FRET\": \"%s\",\n"
-        "  \"YELLOW_FRET\": \"%s\",\n"
-        "  \"BLUE_FRET\": \"%s\",\n"
-        "  \"ORANGE_FRET\": \"%s\",\n"
-        "  \"STRUM_UP\": \"%s\",\n"
-        "  \"STRUM_DOWN\": \"%s\",\n"
-        "  \"TILT\": \"%s\",\n"
-        "  \"SELECT\": \"%s\",\n"
-        "  \"START\": \"%s\",\n"
-        "  \"GUIDE\": \"%s\",\n"
-        "  \"WHAMMY\": \"%s\",\n"
-        "  \"neopixel_pin\": \"%s\",\n"
-        "  \"joystick_x_pin\": \"%s\",\n"
-        "  \"joystick_y_pin\": \"%s\",\n"
-        "  \"GREEN_FRET_led\": %d,\n"
-        "  \"RED_FRET_led\": %d,\n"
-        "  \"YELLOW_FRET_led\": %d,\n"
-        "  \"BLUE_FRET_led\": %d,\n"
-        "  \"ORANGE_FRET_led\": %d,\n"
-        "  \"STRUM_UP_led\": %d,\n"
-        "  \"STRUM_DOWN_led\": %d,\n"
-        "  \"hat_mode\": \"%s\",\n"
-        "  \"led_brightness\": %.2f,\n"
-        "  \"whammy_min\": %lu,\n"
-        "  \"whammy_max\": %lu,\n"
-        "  \"whammy_reverse\": %s,\n"
-        "  \"tilt_wave_enabled\": %s,\n"
-        "  \"led_color\": [\n"
-        "    \"%s\", \"%s\", \"%s\", \"%s\", \"%s\", \"%s\", \"%s\"\n"
-        "  ],\n"
-        "  \"released_color\": [\n"
-        "    \"%s\", \"%s\", \"%s\", \"%s\", \"%s\", \"%s\", \"%s\"\n"
-        "  ]\n"
-        "}",
-        config->metadata.version,
-        config->metadata.description,
-        config->metadata.lastUpdated,
-        config->device_name,
-        config->UP, config->DOWN, config->LEFT, config->RIGHT,
-        config->GREEN_FRET, config->RED_FRET, config->YELLOW_FRET, config->BLUE_FRET, config->ORANGE_FRET,
-        config->STRUM_UP, config->STRUM_DOWN, config->TILT,
-        config->SELECT, config->START, config->GUIDE,
-        config->WHAMMY, config->neopixel_pin,
-        config->joystick_x_pin, config->joystick_y_pin,
-        config->GREEN_FRET_led, config->RED_FRET_led, config->YELLOW_FRET_led,
-        config->BLUE_FRET_led, config->ORANGE_FRET_led,
-        config->STRUM_UP_led, config->STRUM_DOWN_led,
-        config->hat_mode,
-        config->led_brightness,
-        config->whammy_min, config->whammy_max,
-        config->whammy_reverse ? "true" : "false",
-        config->tilt_wave_enabled ? "true" : "false",
-        config->led_color[0], config->led_color[1], config->led_color[2],
-        config->led_color[3], config->led_color[4], config->led_color[5], config->led_color[6],
-        config->released_color[0], config->released_color[1], config->released_color[2],
-        config->released_color[3], config->released_color[4], config->released_color[5], config->released_color[6]
-    );
-    
-    return (written > 0 && written < (int)buffer_size);
+    uint32_t size = config_json_size(config);
+    if (size + 1 > buffer_size) {
+        return false;
+    }
+
+    config_json_invalidate_cache();
+    config_json_read_at(config, 0, buffer, size);
+    buffer[size] = '\0';
+
+    return true;
 }
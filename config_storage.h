@@ -12,7 +12,7 @@ extern "C" {
 // Flash storage configuration
 #define CONFIG_FLASH_OFFSET     (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE)  // Last 4KB sector
 #define CONFIG_MAGIC_HEADER     0x42474743  // "BGGC" in hex
-#define CONFIG_JSON_MAX_SIZE    2048        // Maximum config JSON size
+#define CONFIG_JSON_MAX_SIZE    3072        // Maximum config JSON size (header + JSON fit the sector)
 #define CONFIG_VERSION          1           // Config format version
 
 // Config storage header
@@ -38,13 +38,22 @@ bool config_storage_get_json(char* buffer, uint32_t buffer_size, uint32_t* actua
 bool config_storage_is_valid(void);
 void config_storage_format(void);
 uint32_t config_storage_calculate_crc32(const void* data, uint32_t size);
+uint32_t config_storage_crc32_update(uint32_t crc, const void* data, uint32_t size);
 
-// Parse JSON config into config_t structure
+// Parse JSON config into config_t structure. Its strings go to a spare set;
+// call config_parse_json_commit() once the result is the active config, so
+// the next parse leaves them alone.
 bool config_parse_json(const char* json, config_t* config);
+void config_parse_json_commit(void);
 
 // Generate JSON from config_t structure  
 bool config_generate_json(const config_t* config, char* buffer, uint32_t buffer_size);
 
+// Stream generated JSON in chunks (no full-size buffer needed)
+uint32_t config_json_size(const config_t* config);
+uint32_t config_json_read_at(const config_t* config, uint32_t offset, char* dst, uint32_t len);
+void config_json_invalidate_cache(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,217 @@
+#include "event_log.h"
+#include "cdc_tx.h"
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include "hardware/uart.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#define EVENT_LOG_CORES         2
+#define EVENT_LOG_MASK          (EVENT_LOG_RECORDS - 1)
+#define EVENT_LOG_DRAIN_BUDGET  4   // Records formatted per event_log_task() call
+
+typedef struct {
+    volatile uint32_t sequence;     // Slot number + 1 once the record is complete
+    const char* format;
+    uint32_t timestamp_us;
+    uint8_t level;
+    uint8_t arg_count;
+    bool has_str;
+    union {
+        uint32_t args[4];
+        char str[EVENT_LOG_STR_MAX];
+    } data;
+} event_log_record_t;
+
+typedef struct {
+    event_log_record_t records[EVENT_LOG_RECORDS];
+    volatile uint32_t head;         // Written by the owning core only
+    volatile uint32_t tail;         // Written by the drain only
+    volatile uint32_t dropped;
+} event_log_ring_t;
+
+static event_log_ring_t rings[EVENT_LOG_CORES];
+
+// Drain state: one formatted line being pushed out to the UART
+static char line[EVENT_LOG_LINE_MAX];
+static uint32_t line_length = 0;
+static uint32_t line_sent = 0;
+static uint32_t dropped_reported = 0;
+static bool cdc_output = false;
+
+//--------------------------------------------------------------------+
+// PRODUCER
+//--------------------------------------------------------------------+
+// Reserve a slot in this core's ring, NULL if full
+static event_log_record_t* reserve(uint32_t* slot) {
+    event_log_ring_t* ring = &rings[get_core_num()];
+
+    // Interrupts off only to make the reservation atomic against ISRs on this core
+    uint32_t interrupts = save_and_disable_interrupts();
+    uint32_t head = ring->head;
+    if (head - ring->tail >= EVENT_LOG_RECORDS) {
+        ring->dropped++;
+        restore_interrupts(interrupts);
+        return NULL;
+    }
+    ring->head = head + 1;
+    restore_interrupts(interrupts);
+
+    *slot = head;
+    return &ring->records[head & EVENT_LOG_MASK];
+}
+
+static inline void publish(event_log_record_t* record, uint32_t slot) {
+    __dmb();
+    record->sequence = slot + 1;
+}
+
+void event_log_write(uint8_t level, const char* format, uint32_t arg_count, ...) {
+    uint32_t slot;
+    event_log_record_t* record = reserve(&slot);
+    if (!record) {
+        return;
+    }
+
+    record->format = format;
+    record->timestamp_us = time_us_32();
+    record->level = level;
+    record->has_str = false;
+    record->arg_count = (uint8_t)(arg_count > 4 ? 4 : arg_count);
+
+    va_list args;
+    va_start(args, arg_count);
+    for (uint32_t i = 0; i < record->arg_count; i++) {
+        record->data.args[i] = va_arg(args, uint32_t);
+    }
+    va_end(args);
+
+    publish(record, slot);
+}
+
+void event_log_write_str(uint8_t level, const char* format, const char* str) {
+    uint32_t slot;
+    event_log_record_t* record = reserve(&slot);
+    if (!record) {
+        return;
+    }
+
+    record->format = format;
+    record->timestamp_us = time_us_32();
+    record->level = level;
+    record->has_str = true;
+    record->arg_count = 1;
+    strncpy(record->data.str, str ? str : "(null)", EVENT_LOG_STR_MAX - 1);
+    record->data.str[EVENT_LOG_STR_MAX - 1] = '\0';
+
+    publish(record, slot);
+}
+
+//--------------------------------------------------------------------+
+// DRAIN
+//--------------------------------------------------------------------+
+void event_log_init(void) {
+    memset(rings, 0, sizeof(rings));
+    line_length = 0;
+    line_sent = 0;
+    dropped_reported = 0;
+}
+
+void event_log_set_cdc_output(bool enabled) {
+    cdc_output = enabled;
+}
+
+uint32_t event_log_get_dropped_count(void) {
+    uint32_t total = 0;
+    for (int core = 0; core < EVENT_LOG_CORES; core++) {
+        total += rings[core].dropped;
+    }
+    return total;
+}
+
+// Oldest complete record across both rings
+static event_log_ring_t* next_ring(void) {
+    event_log_ring_t* best = NULL;
+    for (int core = 0; core < EVENT_LOG_CORES; core++) {
+        event_log_ring_t* ring = &rings[core];
+        uint32_t tail = ring->tail;
+        if (ring->records[tail & EVENT_LOG_MASK].sequence != tail + 1) {
+            continue;
+        }
+        if (!best || (int32_t)(ring->records[tail & EVENT_LOG_MASK].timestamp_us -
+                               best->records[best->tail & EVENT_LOG_MASK].timestamp_us) < 0) {
+            best = ring;
+        }
+    }
+    return best;
+}
+
+static void format_record(const event_log_record_t* record) {
+    static const char level_tags[] = "-EWID";
+    int length = snprintf(line, sizeof(line), "[%lu.%03lu] %c ",
+                          (unsigned long)(record->timestamp_us / 1000000),
+                          (unsigned long)((record->timestamp_us / 1000) % 1000),
+                          level_tags[record->level <= LOG_LEVEL_DEBUG ? record->level : 0]);
+
+    if (record->has_str) {
+        length += snprintf(line + length, sizeof(line) - length, record->format, record->data.str);
+    } else {
+        length += snprintf(line + length, sizeof(line) - length, record->format,
+                           record->data.args[0], record->data.args[1],
+                           record->data.args[2], record->data.args[3]);
+    }
+
+    if (length >= (int)sizeof(line)) {
+        length = sizeof(line) - 1;
+        line[length - 1] = '\n';  // Keep truncated lines terminated
+    }
+    line_length = length;
+    line_sent = 0;
+}
+
+// Push the pending line to the UART without blocking, true once it is all out
+static bool flush_line(void) {
+#ifdef uart_default
+    while (line_sent < line_length && uart_is_writable(uart_default)) {
+        uart_putc_raw(uart_default, line[line_sent++]);
+    }
+#else
+    line_sent = line_length;
+#endif
+    return line_sent >= line_length;
+}
+
+bool event_log_has_work(void) {
+    return line_sent < line_length || event_log_get_dropped_count() != dropped_reported ||
+           next_ring() != NULL;
+}
+
+void event_log_task(void) {
+    for (int budget = EVENT_LOG_DRAIN_BUDGET; budget > 0; budget--) {
+        if (!flush_line()) {
+            return;  // UART busy, carry on next time
+        }
+
+        uint32_t dropped = event_log_get_dropped_count();
+        if (dropped != dropped_reported) {
+            line_length = snprintf(line, sizeof(line), "Log: %lu records dropped\n",
+                                   (unsigned long)(dropped - dropped_reported));
+            line_sent = 0;
+            dropped_reported = dropped;
+        } else {
+            event_log_ring_t* ring = next_ring();
+            if (!ring) {
+                return;
+            }
+
+            __dmb();
+            format_record(&ring->records[ring->tail & EVENT_LOG_MASK]);
+            ring->tail = ring->tail + 1;
+        }
+
+        if (cdc_output) {
+            cdc_tx_write(line, line_length);
+        }
+    }
+}
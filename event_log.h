@@ -0,0 +1,95 @@
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Deferred binary logging.
+//
+// LOG_* calls store a fixed-size record (format string pointer, timestamp
+// and up to four 32-bit arguments) in a per-core RAM ring and return; no
+// formatting or I/O happens on the caller's path. event_log_task() formats
+// queued records later from the main loop and feeds them to the UART
+// without ever waiting on it (and optionally to the CDC port).
+//
+// The format string must be a literal (its address is the record's ID) and
+// may consume at most four int-sized arguments; %f is not supported. Use
+// the *_STR variants to log a transient string, which is copied into the
+// record (truncated to EVENT_LOG_STR_MAX - 1 characters).
+//
+// Each core writes only its own ring and the drain only reads, so the rings
+// need no lock between cores. Records from interrupt handlers on the same
+// core are fine.
+
+#define LOG_LEVEL_NONE      0
+#define LOG_LEVEL_ERROR     1
+#define LOG_LEVEL_WARN      2
+#define LOG_LEVEL_INFO      3
+#define LOG_LEVEL_DEBUG     4
+
+// Compile-time level: calls above it compile to nothing
+#ifndef LOG_LEVEL
+#define LOG_LEVEL           LOG_LEVEL_INFO
+#endif
+
+#define EVENT_LOG_RECORDS   64      // Per core (must be a power of 2)
+#define EVENT_LOG_STR_MAX   20
+#define EVENT_LOG_LINE_MAX  128
+
+// Logging functions (use the LOG_* macros instead)
+void event_log_write(uint8_t level, const char* format, uint32_t arg_count, ...);
+void event_log_write_str(uint8_t level, const char* format, const char* str);
+
+// Drain and configuration
+void event_log_init(void);
+void event_log_task(void);
+bool event_log_has_work(void);  // Records queued or a line still going out
+void event_log_set_cdc_output(bool enabled);
+uint32_t event_log_get_dropped_count(void);
+
+#define LOG_NARGS_(_0, _1, _2, _3, _4, N, ...) N
+#define LOG_NARGS(...) LOG_NARGS_(0, ##__VA_ARGS__, 4, 3, 2, 1, 0)
+
+#define LOG_AT_(level, format, ...) event_log_write(level, format, LOG_NARGS(__VA_ARGS__), ##__VA_ARGS__)
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(format, ...)      LOG_AT_(LOG_LEVEL_ERROR, format, ##__VA_ARGS__)
+#define LOG_ERROR_STR(format, str)  event_log_write_str(LOG_LEVEL_ERROR, format, str)
+#else
+#define LOG_ERROR(format, ...)      ((void)0)
+#define LOG_ERROR_STR(format, str)  ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(format, ...)       LOG_AT_(LOG_LEVEL_WARN, format, ##__VA_ARGS__)
+#define LOG_WARN_STR(format, str)   event_log_write_str(LOG_LEVEL_WARN, format, str)
+#else
+#define LOG_WARN(format, ...)       ((void)0)
+#define LOG_WARN_STR(format, str)   ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(format, ...)       LOG_AT_(LOG_LEVEL_INFO, format, ##__VA_ARGS__)
+#define LOG_INFO_STR(format, str)   event_log_write_str(LOG_LEVEL_INFO, format, str)
+#else
+#define LOG_INFO(format, ...)       ((void)0)
+#define LOG_INFO_STR(format, str)   ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(format, ...)      LOG_AT_(LOG_LEVEL_DEBUG, format, ##__VA_ARGS__)
+#define LOG_DEBUG_STR(format, str)  event_log_write_str(LOG_LEVEL_DEBUG, format, str)
+#else
+#define LOG_DEBUG(format, ...)      ((void)0)
+#define LOG_DEBUG_STR(format, str)  ((void)0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EVENT_LOG_H
@@ -1,80 +1,36 @@
 #include "file_emulation.h"
 #include "config_storage.h"
 #include "config.h"
+#include "cdc_tx.h"
+#include "cdc_rx.h"
+#include "event_log.h"
+#include "perf.h"
+#include "latency.h"
+#include "input_trace.h"
+#include "boot_prof.h"
+#include "sched.h"
+#include "sample_clock.h"
+#include "idle.h"
+#include "adc_stream.h"
+#include "adc_filter.h"
+#include "whammy_cal.h"
+#include "joystick_cal.h"
+#include "response_curve.h"
+#include "remap.h"
+#include "pico/stdlib.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
 #include "tusb.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
-// Virtual file storage
-static virtual_file_t virtual_files[MAX_VIRTUAL_FILES];
-static char line_buffer[512];
-static bool writing_file = false;
-static char write_filename[MAX_FILENAME_LENGTH];
-static char write_buffer[MAX_FILE_CONTENT];
-static uint32_t write_pos = 0;
-
-// Default file contents using BGG Windows App format
-static const char* default_config_json = "{\n"
-"    \"_metadata\": {\n"
-"        \"version\": \"4.0.0\",\n"
-"        \"description\": \"BumbleGum Guitar Controller Configuration\",\n"
-"        \"lastUpdated\": \"2025-08-21\"\n"
-"    },\n"
-"    \"device_name\": \"Guitar Controller\",\n"
-"    \"UP\": \"GP2\",\n"
-"    \"DOWN\": \"GP3\",\n"
-"    \"LEFT\": \"GP4\",\n"
-"    \"RIGHT\": \"GP5\",\n"
-"    \"GREEN_FRET\": \"GP10\",\n"
-"    \"GREEN_FRET_led\": 6,\n"
-"    \"RED_FRET\": \"GP11\",\n"
-"    \"RED_FRET_led\": 5,\n"
-"    \"YELLOW_FRET\": \"GP12\",\n"
-"    \"YELLOW_FRET_led\": 4,\n"
-"    \"BLUE_FRET\": \"GP13\",\n"
-"    \"BLUE_FRET_led\": 3,\n"
-"    \"ORANGE_FRET\": \"GP14\",\n"
-"    \"ORANGE_FRET_led\": 2,\n"
-"    \"STRUM_UP\": \"GP7\",\n"
-"    \"STRUM_UP_led\": 0,\n"
-"    \"STRUM_DOWN\": \"GP8\",\n"
-"    \"STRUM_DOWN_led\": 1,\n"
-"    \"TILT\": \"GP9\",\n"
-"    \"SELECT\": \"GP0\",\n"
-"    \"START\": \"GP1\",\n"
-"    \"GUIDE\": \"GP6\",\n"
-"    \"WHAMMY\": \"GP27\",\n"
-"    \"neopixel_pin\": \"GP23\",\n"
-"    \"joystick_x_pin\": \"GP28\",\n"
-"    \"joystick_y_pin\": \"GP29\",\n"
-"    \"hat_mode\": \"dpad\",\n"
-"    \"led_brightness\": 1.0,\n"
-"    \"whammy_min\": 500,\n"
-"    \"whammy_max\": 65000,\n"
-"    \"whammy_reverse\": false,\n"
-"    \"tilt_wave_enabled\": true,\n"
-"    \"led_color\": [\n"
-"        \"#FFFFFF\",\n"
-"        \"#FFFFFF\",\n"
-"        \"#B33E00\",\n"
-"        \"#0000FF\",\n"
-"        \"#FFFF00\",\n"
-"        \"#FF0000\",\n"
-"        \"#00FF00\"\n"
-"    ],\n"
-"    \"released_color\": [\n"
-"        \"#454545\",\n"
-"        \"#454545\",\n"
-"        \"#521C00\",\n"
-"        \"#000091\",\n"
-"        \"#696B00\",\n"
-"        \"#8C0009\",\n"
-"        \"#003D00\"\n"
-"    ]\n"
-"}";
+#define FILE_EMU_NO_SLOT        0xFF
+#define CONFIG_FILE_INDEX       0
+#define SPARE_FILE_INDEX        (MAX_VIRTUAL_FILES - 1)
 
-static const char* default_presets_json = "{\n"
+// Default file contents using BGG Windows App format (stay in flash, read via XIP)
+static const char default_presets_json[] = "{\n"
 "  \"_metadata\": {\n"
 "    \"version\": \"4.0\",\n"
 "    \"device_type\": \"bgg_xinput\",\n"
@@ -94,174 +50,515 @@ static const char* default_presets_json = "{\n"
 "  }\n"
 "}";
 
-static const char* default_user_presets_json = "{\n"
+static const char default_user_presets_json[] = "{\n"
 "  \"user_presets\": {}\n"
 "}";
 
-bool file_emu_init(void) {
-    // Initialize virtual files array
-    memset(virtual_files, 0, sizeof(virtual_files));
-    
-    // Create default files
-    return file_emu_create_default_files();
+// Built-in files. config.json has no default content because it is generated
+// from the live config; the last entry is a spare for any other filename.
+typedef struct {
+    const char* filename;
+    const char* default_content;
+} builtin_file_t;
+
+static const builtin_file_t builtin_files[MAX_VIRTUAL_FILES] = {
+    { "config.json",       NULL },
+    { "presets.json",      default_presets_json },
+    { "user_presets.json", default_user_presets_json },
+    { NULL,                NULL },
+};
+
+// Active flash slot per file (FILE_EMU_NO_SLOT when only the default exists)
+static uint8_t active_slot[MAX_VIRTUAL_FILES];
+
+// Streaming write state - the page buffer is the only file data held in RAM
+static struct {
+    bool active;
+    bool failed;
+    uint32_t token;
+    int file_index;
+    uint8_t slot;
+    uint32_t sequence;
+    uint32_t size;
+    uint32_t checksum;
+    uint32_t pages_written;
+    uint32_t erased_sectors;
+    uint32_t page_fill;
+    char filename[MAX_FILENAME_LENGTH];
+    uint8_t page[FLASH_PAGE_SIZE];
+} writer;
+
+// Erase-ahead sweep over every slot sector, restarted whenever a slot
+// stops being the active copy
+#define FILE_EMU_SECTORS_PER_SLOT   (FILE_EMU_SLOT_SIZE / FLASH_SECTOR_SIZE)
+#define FILE_EMU_SECTOR_COUNT       (FILE_EMU_FLASH_SIZE / FLASH_SECTOR_SIZE)
+static uint32_t sweep_sector = 0;       // Next sector to look at
+static uint32_t sweep_remaining = 0;    // Sectors left in this sweep
+
+// Text protocol WRITEFILE mode
+static bool writing_file = false;
+static bool line_continued = false;     // Earlier pieces of the current line were appended
+
+//--------------------------------------------------------------------+
+// FLASH SLOTS
+//--------------------------------------------------------------------+
+static inline uint32_t slot_offset(uint8_t slot) {
+    return FILE_EMU_FLASH_OFFSET + (uint32_t)slot * FILE_EMU_SLOT_SIZE;
 }
 
-bool file_emu_create_default_files(void) {
-    // Initialize config.json - try to load from flash first
-    strncpy(virtual_files[0].filename, "config.json", MAX_FILENAME_LENGTH - 1);
-    
-    // Try to get the current config from flash
-    char config_buffer[MAX_FILE_CONTENT];
-    uint32_t config_size;
-    
-    if (config_storage_get_json(config_buffer, sizeof(config_buffer), &config_size)) {
-        // Use config from flash
-        memcpy(virtual_files[0].content, config_buffer, config_size);
-        virtual_files[0].size = config_size;
-        printf("File emulation: Loaded config.json from flash (%lu bytes)\n", config_size);
+static inline const file_emu_header_t* slot_header(uint8_t slot) {
+    return (const file_emu_header_t*)(XIP_BASE + slot_offset(slot));
+}
+
+static inline const uint8_t* slot_data(uint8_t slot) {
+    return (const uint8_t*)(XIP_BASE + slot_offset(slot) + FLASH_PAGE_SIZE);
+}
+
+static bool slot_is_valid(uint8_t slot) {
+    const file_emu_header_t* header = slot_header(slot);
+
+    if (header->magic != FILE_EMU_MAGIC) {
+        return false;
+    }
+    if (header->size > MAX_FILE_CONTENT) {
+        return false;
+    }
+    if (header->filename[0] == '\0' || header->filename[MAX_FILENAME_LENGTH - 1] != '\0') {
+        return false;
+    }
+
+    return config_storage_calculate_crc32(slot_data(slot), header->size) == header->checksum;
+}
+
+static void scan_file_slots(int file_index) {
+    uint8_t slot_a = (uint8_t)(file_index * 2);
+    uint8_t slot_b = slot_a + 1;
+    bool valid_a = slot_is_valid(slot_a);
+    bool valid_b = slot_is_valid(slot_b);
+
+    if (valid_a && valid_b) {
+        // Wrap-safe sequence comparison
+        int32_t delta = (int32_t)(slot_header(slot_b)->sequence - slot_header(slot_a)->sequence);
+        active_slot[file_index] = (delta > 0) ? slot_b : slot_a;
+    } else if (valid_a) {
+        active_slot[file_index] = slot_a;
+    } else if (valid_b) {
+        active_slot[file_index] = slot_b;
     } else {
-        // Fall back to default config
-        strncpy(virtual_files[0].content, default_config_json, MAX_FILE_CONTENT - 1);
-        virtual_files[0].size = strlen(default_config_json);
-        printf("File emulation: Using default config.json\n");
+        active_slot[file_index] = FILE_EMU_NO_SLOT;
+    }
+}
+
+static void file_emu_flash_erase(uint32_t offset) {
+    uint32_t interrupts = save_and_disable_interrupts();
+    flash_range_erase(offset, FLASH_SECTOR_SIZE);
+    restore_interrupts(interrupts);
+}
+
+static bool file_emu_sector_blank(uint32_t offset) {
+    const uint32_t* words = (const uint32_t*)(XIP_BASE + offset);
+    for (uint32_t i = 0; i < FLASH_SECTOR_SIZE / sizeof(uint32_t); i++) {
+        if (words[i] != 0xFFFFFFFFu) return false;
     }
-    virtual_files[0].exists = true;
-    
-    // Initialize presets.json
-    strncpy(virtual_files[1].filename, "presets.json", MAX_FILENAME_LENGTH - 1);
-    strncpy(virtual_files[1].content, default_presets_json, MAX_FILE_CONTENT - 1);
-    virtual_files[1].size = strlen(default_presets_json);
-    virtual_files[1].exists = true;
-    
-    // Initialize user_presets.json
-    strncpy(virtual_files[2].filename, "user_presets.json", MAX_FILENAME_LENGTH - 1);
-    strncpy(virtual_files[2].content, default_user_presets_json, MAX_FILE_CONTENT - 1);
-    virtual_files[2].size = strlen(default_user_presets_json);
-    virtual_files[2].exists = true;
-    
-    printf("File emulation: Created virtual files\n");
     return true;
 }
 
-bool file_emu_exists(const char* filename) {
-    for (int i = 0; i < MAX_VIRTUAL_FILES; i++) {
-        if (virtual_files[i].exists && strcmp(virtual_files[i].filename, filename) == 0) {
-            return true;
+static void file_emu_flash_program(uint32_t offset, const uint8_t* page) {
+    uint32_t interrupts = save_and_disable_interrupts();
+    flash_range_program(offset, page, FLASH_PAGE_SIZE);
+    restore_interrupts(interrupts);
+}
+
+// Make a sector of the target slot writable. file_emu_task has normally
+// erased it already; otherwise the erase (about 45 ms with interrupts off,
+// counted as "missed" by the sample clock) runs here on the command path.
+static void writer_prepare_sector(uint32_t sector) {
+    if (writer.erased_sectors & (1u << sector)) {
+        return;
+    }
+    uint32_t offset = slot_offset(writer.slot) + sector * FLASH_SECTOR_SIZE;
+    if (!file_emu_sector_blank(offset)) {
+        file_emu_flash_erase(offset);
+    }
+    writer.erased_sectors |= (1u << sector);
+}
+
+// Program the buffered page; sectors are made writable as the write reaches them
+static void writer_flush_page(void) {
+    uint32_t page_offset = (writer.pages_written + 1) * FLASH_PAGE_SIZE;
+
+    writer_prepare_sector(page_offset / FLASH_SECTOR_SIZE);
+
+    if (writer.page_fill < FLASH_PAGE_SIZE) {
+        memset(writer.page + writer.page_fill, 0xFF, FLASH_PAGE_SIZE - writer.page_fill);
+    }
+
+    file_emu_flash_program(slot_offset(writer.slot) + page_offset, writer.page);
+    writer.pages_written++;
+    writer.page_fill = 0;
+}
+
+static void writer_put(const uint8_t* data, uint32_t size) {
+    while (size > 0) {
+        uint32_t chunk = FLASH_PAGE_SIZE - writer.page_fill;
+        if (chunk > size) chunk = size;
+
+        memcpy(writer.page + writer.page_fill, data, chunk);
+        writer.page_fill += chunk;
+        data += chunk;
+        size -= chunk;
+
+        if (writer.page_fill == FLASH_PAGE_SIZE) {
+            writer_flush_page();
         }
     }
-    return false;
 }
 
-bool file_emu_read(const char* filename, char* buffer, uint32_t buffer_size, uint32_t* actual_size) {
+//--------------------------------------------------------------------+
+// FILE TABLE
+//--------------------------------------------------------------------+
+const char* file_emu_get_file_name(uint32_t index) {
+    if (index >= MAX_VIRTUAL_FILES) {
+        return NULL;
+    }
+    if (builtin_files[index].filename) {
+        return builtin_files[index].filename;
+    }
+    if (active_slot[index] != FILE_EMU_NO_SLOT) {
+        return slot_header(active_slot[index])->filename;
+    }
+    return NULL;
+}
+
+static int find_file(const char* filename) {
     for (int i = 0; i < MAX_VIRTUAL_FILES; i++) {
-        if (virtual_files[i].exists && strcmp(virtual_files[i].filename, filename) == 0) {
-            uint32_t copy_size = virtual_files[i].size;
-            if (copy_size >= buffer_size) {
-                copy_size = buffer_size - 1;
-            }
-            
-            memcpy(buffer, virtual_files[i].content, copy_size);
-            buffer[copy_size] = '\0';
-            
-            if (actual_size) {
-                *actual_size = copy_size;
-            }
-            
-            return true;
+        const char* name = file_emu_get_file_name(i);
+        if (name && strcmp(name, filename) == 0) {
+            return i;
         }
     }
-    return false;
+    return -1;
 }
 
-bool file_emu_write(const char* filename, const char* content, uint32_t size) {
-    // Find existing file or create new one
-    int file_index = -1;
-    
-    // Look for existing file
+bool file_emu_init(void) {
+    memset(active_slot, FILE_EMU_NO_SLOT, sizeof(active_slot));
+    memset(&writer, 0, sizeof(writer));
+    writing_file = false;
+    sweep_sector = 0;
+    sweep_remaining = FILE_EMU_SECTOR_COUNT;
+
+    return file_emu_create_default_files();
+}
+
+bool file_emu_create_default_files(void) {
+    // Defaults are compiled into the firmware image; just locate any written copies
     for (int i = 0; i < MAX_VIRTUAL_FILES; i++) {
-        if (virtual_files[i].exists && strcmp(virtual_files[i].filename, filename) == 0) {
-            file_index = i;
-            break;
+        scan_file_slots(i);
+
+        const char* name = file_emu_get_file_name(i);
+        if (!name) continue;
+
+        if (i == CONFIG_FILE_INDEX) {
+            printf("File emulation: config.json generated from live config\n");
+        } else if (active_slot[i] != FILE_EMU_NO_SLOT) {
+            printf("File emulation: Loaded %s from flash (%lu bytes)\n",
+                   name, (unsigned long)slot_header(active_slot[i])->size);
+        } else {
+            printf("File emulation: Using default %s\n", name);
         }
     }
-    
-    // If not found, find empty slot
-    if (file_index == -1) {
-        for (int i = 0; i < MAX_VIRTUAL_FILES; i++) {
-            if (!virtual_files[i].exists) {
-                file_index = i;
-                break;
-            }
-        }
+
+    printf("File emulation: Created virtual files\n");
+    return true;
+}
+
+bool file_emu_exists(const char* filename) {
+    return find_file(filename) >= 0;
+}
+
+bool file_emu_get_size(const char* filename, uint32_t* size) {
+    int index = find_file(filename);
+    if (index < 0) {
+        return false;
     }
-    
-    if (file_index == -1) {
-        printf("File emulation: No space for file %s\n", filename);
+
+    if (index == CONFIG_FILE_INDEX) {
+        *size = config_json_size(config_get_current());
+    } else if (active_slot[index] != FILE_EMU_NO_SLOT) {
+        *size = slot_header(active_slot[index])->size;
+    } else {
+        *size = strlen(builtin_files[index].default_content);
+    }
+    return true;
+}
+
+uint32_t file_emu_read_at(const char* filename, uint32_t offset, void* buffer, uint32_t length) {
+    int index = find_file(filename);
+    if (index < 0) {
+        return 0;
+    }
+
+    if (index == CONFIG_FILE_INDEX) {
+        return config_json_read_at(config_get_current(), offset, (char*)buffer, length);
+    }
+
+    const uint8_t* source;
+    uint32_t size;
+    if (active_slot[index] != FILE_EMU_NO_SLOT) {
+        source = slot_data(active_slot[index]);
+        size = slot_header(active_slot[index])->size;
+    } else {
+        source = (const uint8_t*)builtin_files[index].default_content;
+        size = strlen(builtin_files[index].default_content);
+    }
+
+    if (offset >= size) {
+        return 0;
+    }
+    if (length > size - offset) {
+        length = size - offset;
+    }
+
+    memcpy(buffer, source + offset, length);
+    return length;
+}
+
+bool file_emu_read(const char* filename, char* buffer, uint32_t buffer_size, uint32_t* actual_size) {
+    uint32_t size;
+    if (buffer_size == 0 || !file_emu_get_size(filename, &size)) {
         return false;
     }
-    
-    if (size >= MAX_FILE_CONTENT) {
-        printf("File emulation: File %s too large (%lu bytes)\n", filename, size);
+
+    uint32_t copy_size = size;
+    if (copy_size >= buffer_size) {
+        copy_size = buffer_size - 1;
+    }
+
+    copy_size = file_emu_read_at(filename, 0, buffer, copy_size);
+    buffer[copy_size] = '\0';
+
+    if (actual_size) {
+        *actual_size = copy_size;
+    }
+
+    return true;
+}
+
+//--------------------------------------------------------------------+
+// STREAMING WRITES
+//--------------------------------------------------------------------+
+bool file_emu_write_busy(void) {
+    return writer.active;
+}
+
+bool file_emu_write_owned(uint32_t token) {
+    return writer.active && token != 0 && writer.token == token;
+}
+
+uint32_t file_emu_write_begin(const char* filename) {
+    static uint32_t next_token = 0;
+
+    if (writer.active) {
+        // Never take over another caller's write; it finishes or aborts first
+        printf("File emulation: Busy writing %s\n", writer.filename);
+        return 0;
+    }
+
+    size_t name_len = strlen(filename);
+    if (name_len == 0 || name_len >= MAX_FILENAME_LENGTH) {
+        printf("File emulation: Invalid filename\n");
+        return 0;
+    }
+
+    int index = find_file(filename);
+    if (index < 0) {
+        // New names replace whatever occupies the spare entry
+        index = SPARE_FILE_INDEX;
+    }
+
+    // Write into the inactive slot so the current copy survives a failed write
+    uint8_t current = active_slot[index];
+    uint8_t target = (current == (uint8_t)(index * 2)) ? (uint8_t)(index * 2 + 1) : (uint8_t)(index * 2);
+
+    memset(&writer, 0, sizeof(writer));
+    writer.active = true;
+    if (++next_token == 0) next_token = 1;     // 0 means refused
+    writer.token = next_token;
+    writer.file_index = index;
+    writer.slot = target;
+    writer.sequence = (current != FILE_EMU_NO_SLOT) ? slot_header(current)->sequence + 1 : 1;
+    memcpy(writer.filename, filename, name_len + 1);
+
+    // Header page lives in sector 0; erasing it invalidates the target slot
+    writer_prepare_sector(0);
+
+    return writer.token;
+}
+
+bool file_emu_write_append(const void* data, uint32_t size) {
+    if (!writer.active || writer.failed) {
         return false;
     }
-    
-    // Write file data
-    strncpy(virtual_files[file_index].filename, filename, MAX_FILENAME_LENGTH - 1);
-    memcpy(virtual_files[file_index].content, content, size);
-    virtual_files[file_index].content[size] = '\0';
-    virtual_files[file_index].size = size;
-    virtual_files[file_index].exists = true;
-    
-    printf("File emulation: Wrote %s (%lu bytes)\n", filename, size);
-    
+
+    if (writer.size + size > MAX_FILE_CONTENT) {
+        printf("File emulation: File %s too large (> %d bytes)\n", writer.filename, MAX_FILE_CONTENT);
+        writer.failed = true;
+        return false;
+    }
+
+    writer.checksum = config_storage_crc32_update(writer.checksum, data, size);
+    writer.size += size;
+    writer_put((const uint8_t*)data, size);
+    return true;
+}
+
+void file_emu_write_abort(void) {
+    // Target slot has no header yet, so it simply stays invalid; erase it again
+    writer.active = false;
+    sweep_remaining = FILE_EMU_SECTOR_COUNT;
+}
+
+bool file_emu_write_commit(void) {
+    if (!writer.active) {
+        return false;
+    }
+    if (writer.failed) {
+        file_emu_write_abort();
+        return false;
+    }
+
+    // NUL-terminate in flash so content can be parsed in place through XIP
+    const uint8_t terminator = '\0';
+    writer_put(&terminator, 1);
+    if (writer.page_fill > 0) {
+        writer_flush_page();
+    }
+
+    file_emu_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.magic = FILE_EMU_MAGIC;
+    header.sequence = writer.sequence;
+    header.size = writer.size;
+    header.checksum = writer.checksum;
+    memcpy(header.filename, writer.filename, sizeof(header.filename));
+
+    memset(writer.page, 0xFF, sizeof(writer.page));
+    memcpy(writer.page, &header, sizeof(header));
+    file_emu_flash_program(slot_offset(writer.slot), writer.page);
+
+    writer.active = false;
+    sweep_remaining = FILE_EMU_SECTOR_COUNT;   // The slot this write replaced is next
+
+    if (!slot_is_valid(writer.slot)) {
+        printf("File emulation: Flash verification failed for %s\n", writer.filename);
+        return false;
+    }
+    active_slot[writer.file_index] = writer.slot;
+
+    printf("File emulation: Wrote %s (%lu bytes)\n", writer.filename, (unsigned long)writer.size);
+
     // If this is config.json, update the runtime config
-    if (strcmp(filename, "config.json") == 0) {
+    if (writer.file_index == CONFIG_FILE_INDEX) {
         printf("File emulation: Config.json updated, applying new configuration...\n");
-        
+
         // Update the runtime configuration
-        if (config_update_from_json(content)) {
+        if (config_update_from_json((const char*)slot_data(writer.slot))) {
             printf("File emulation: Configuration successfully updated and saved to flash\n");
         } else {
             printf("File emulation: ERROR - Failed to update configuration\n");
             return false;
         }
     }
-    
+
     return true;
 }
 
+void file_emu_task(void) {
+    // Skip (without erasing) active copies, blank sectors and sectors the
+    // writer already uses; stop after the first erase
+    while (sweep_remaining > 0) {
+        uint32_t index = sweep_sector;
+        sweep_sector = (sweep_sector + 1) % FILE_EMU_SECTOR_COUNT;
+        sweep_remaining--;
+
+        uint8_t slot = (uint8_t)(index / FILE_EMU_SECTORS_PER_SLOT);
+        uint32_t sector = index % FILE_EMU_SECTORS_PER_SLOT;
+        if (active_slot[slot / 2] == slot) continue;
+
+        bool writing = writer.active && writer.slot == slot;
+        if (writing && (writer.erased_sectors & (1u << sector))) continue;
+
+        uint32_t offset = slot_offset(slot) + sector * FLASH_SECTOR_SIZE;
+        if (file_emu_sector_blank(offset)) continue;
+
+        file_emu_flash_erase(offset);
+        if (writing) {
+            writer.erased_sectors |= (1u << sector);
+        }
+        return;
+    }
+}
+
+bool file_emu_write(const char* filename, const char* content, uint32_t size) {
+    if (!file_emu_write_begin(filename)) {
+        return false;
+    }
+    if (!file_emu_write_append(content, size)) {
+        file_emu_write_abort();
+        return false;
+    }
+    return file_emu_write_commit();
+}
+
+//--------------------------------------------------------------------+
+// CDC PROTOCOL
+//--------------------------------------------------------------------+
 void file_emu_send_response(const char* response) {
     if (tud_cdc_connected()) {
-        tud_cdc_write_str(response);
-        tud_cdc_write_flush();
+        cdc_tx_write_str(response);
     }
 }
 
+// cdc_tx source callback, context is the file name
+static uint32_t file_emu_tx_source(const void* context, uint32_t offset, void* buffer, uint32_t length) {
+    return file_emu_read_at((const char*)context, offset, buffer, length);
+}
+
+// cdc_tx source callback, context is a NUL-terminated report buffer
+static uint32_t text_tx_source(const void* context, uint32_t offset, void* buffer, uint32_t length) {
+    const char* text = (const char*)context;
+    uint32_t total = strlen(text);
+    if (offset >= total) return 0;
+    if (length > total - offset) length = total - offset;
+    memcpy(buffer, text + offset, length);
+    return length;
+}
+
 void file_emu_send_file_content(const char* filename) {
-    for (int i = 0; i < MAX_VIRTUAL_FILES; i++) {
-        if (virtual_files[i].exists && strcmp(virtual_files[i].filename, filename) == 0) {
-            if (tud_cdc_connected()) {
-                // Send START marker
-                char start_marker[64];
-                snprintf(start_marker, sizeof(start_marker), "START_%s\n", filename);
-                tud_cdc_write_str(start_marker);
-                
-                // Send file content
-                tud_cdc_write(virtual_files[i].content, virtual_files[i].size);
-                
-                // Send END marker
-                char end_marker[64];
-                snprintf(end_marker, sizeof(end_marker), "\nEND_%s\n", filename);
-                tud_cdc_write_str(end_marker);
-                
-                tud_cdc_write_flush();
-                
-                printf("File emulation: Sent file %s (%lu bytes)\n", filename, virtual_files[i].size);
+    uint32_t size;
+    int index = find_file(filename);
+    if (index >= 0 && file_emu_get_size(filename, &size)) {
+        if (tud_cdc_connected()) {
+            // Queue START marker, content and END marker; the TX pump streams
+            // the content straight from flash / the generator as the FIFO drains
+            const char* name = file_emu_get_file_name(index);
+            char marker[64];
+
+            snprintf(marker, sizeof(marker), "START_%s\n", name);
+            bool queued = cdc_tx_write_str(marker);
+            queued = queued && cdc_tx_write_source(file_emu_tx_source, name, size);
+            snprintf(marker, sizeof(marker), "\nEND_%s\n", name);
+            queued = queued && cdc_tx_write_str(marker);
+
+            if (queued) {
+                LOG_INFO_STR("File emulation: Queued %s\n", name);
+            } else {
+                LOG_WARN_STR("File emulation: TX queue full, %s not sent\n", name);
             }
-            return;
         }
+        return;
     }
-    
+
     // File not found
     char error_msg[128];
     snprintf(error_msg, sizeof(error_msg), "ERROR: File not found: %s\n", filename);
@@ -269,12 +566,12 @@ void file_emu_send_file_content(const char* filename) {
 }
 
 void file_emu_process_serial_command(const char* command) {
-    printf("File emulation: Processing command: %s\n", command);
+    LOG_DEBUG_STR("File emulation: Processing command: %s\n", command);
     
     // Handle READFILE command
     if (strncmp(command, "READFILE:", 9) == 0) {
         const char* filename = command + 9;
-        printf("File emulation: Read request for %s\n", filename);
+        LOG_INFO_STR("File emulation: Read request for %s\n", filename);
         file_emu_send_file_content(filename);
         return;
     }
@@ -282,14 +579,18 @@ void file_emu_process_serial_command(const char* command) {
     // Handle WRITEFILE command
     if (strncmp(command, "WRITEFILE:", 10) == 0) {
         const char* filename = command + 10;
-        printf("File emulation: Write request for %s\n", filename);
+        LOG_INFO_STR("File emulation: Write request for %s\n", filename);
         
         // Start write mode
+        if (file_emu_write_busy()) {
+            file_emu_send_response("ERROR: Write busy\n");
+            return;
+        }
+        if (!file_emu_write_begin(filename)) {
+            file_emu_send_response("ERROR: Write failed\n");
+            return;
+        }
         writing_file = true;
-        strncpy(write_filename, filename, MAX_FILENAME_LENGTH - 1);
-        write_filename[MAX_FILENAME_LENGTH - 1] = '\0';
-        write_pos = 0;
-        memset(write_buffer, 0, sizeof(write_buffer));
         
         file_emu_send_response("READY\n");
         return;
@@ -302,7 +603,7 @@ void file_emu_process_serial_command(const char* command) {
             // Finish writing
             writing_file = false;
             
-            if (file_emu_write(write_filename, write_buffer, write_pos)) {
+            if (file_emu_write_commit()) {
                 file_emu_send_response("FILE_WRITTEN\n");
             } else {
                 file_emu_send_response("ERROR: Write failed\n");
@@ -310,19 +611,336 @@ void file_emu_process_serial_command(const char* command) {
             return;
         }
         
-        // Append data to write buffer
+        // Stream line into flash, re-adding the newline stripped by the line reader
         uint32_t cmd_len = strlen(command);
-        if (write_pos + cmd_len < MAX_FILE_CONTENT - 1) {
-            memcpy(write_buffer + write_pos, command, cmd_len);
-            write_pos += cmd_len;
-            // Add newline if not present
-            if (cmd_len > 0 && command[cmd_len - 1] != '\n') {
-                write_buffer[write_pos++] = '\n';
-            }
+        file_emu_write_append(command, cmd_len);
+        if (cmd_len > 0 && command[cmd_len - 1] != '\n') {
+            file_emu_write_append("\n", 1);
         }
         return;
     }
     
+    // Mirror the deferred log to this port
+    if (strcmp(command, "LOG:ON") == 0 || strcmp(command, "LOG:OFF") == 0) {
+        event_log_set_cdc_output(command[5] == 'N');
+        file_emu_send_response("OK\n");
+        return;
+    }
+
+    // Config port receive counters, including lines and frames dropped for size
+    if (strcmp(command, "RX") == 0) {
+        char status[CDC_RX_REPORT_MAX];
+        cdc_rx_format_report(status, sizeof(status));
+        file_emu_send_response(status);
+        return;
+    }
+    if (strcmp(command, "RX:RESET") == 0) {
+        cdc_rx_reset_stats();
+        file_emu_send_response("OK\n");
+        return;
+    }
+
+    // Main loop stage timings
+    if (strcmp(command, "PERF") == 0) {
+        if (!perf_send_text_report()) {
+            file_emu_send_response("ERROR: PERF busy\n");
+        }
+        return;
+    }
+    if (strcmp(command, "PERF:RESET") == 0) {
+        perf_reset();
+        file_emu_send_response("OK\n");
+        return;
+    }
+
+    // Input-to-USB latency per input class
+    if (strcmp(command, "LATENCY") == 0) {
+        static char latency_report[LATENCY_REPORT_MAX];
+        if (!cdc_tx_idle()) {
+            file_emu_send_response("ERROR: LATENCY busy\n");  // Previous report still streaming
+            return;
+        }
+        uint32_t length = latency_format_report(latency_report, sizeof(latency_report));
+        cdc_tx_write_source(text_tx_source, latency_report, length);
+        return;
+    }
+    if (strcmp(command, "LATENCY:RESET") == 0) {
+        latency_reset();
+        file_emu_send_response("OK\n");
+        return;
+    }
+
+    // Main loop task deadlines
+    if (strcmp(command, "SCHED") == 0) {
+        static char sched_report[SCHED_REPORT_MAX];
+        if (!cdc_tx_idle()) {
+            file_emu_send_response("ERROR: SCHED busy\n");
+            return;
+        }
+        uint32_t length = sched_format_report(sched_report, sizeof(sched_report));
+        cdc_tx_write_source(text_tx_source, sched_report, length);
+        return;
+    }
+    if (strcmp(command, "SCHED:RESET") == 0) {
+        sched_reset_stats();
+        file_emu_send_response("OK\n");
+        return;
+    }
+
+    // Input sampling clock: period, missed-tick policy and jitter
+    if (strcmp(command, "CLOCK") == 0) {
+        char status[SAMPLE_CLOCK_REPORT_MAX];
+        sample_clock_format_report(status, sizeof(status));
+        file_emu_send_response(status);
+        return;
+    }
+    if (strcmp(command, "CLOCK:RESET") == 0) {
+        sample_clock_reset_stats();
+        file_emu_send_response("OK\n");
+        return;
+    }
+    if (strncmp(command, "CLOCK:PERIOD=", 13) == 0) {
+        uint32_t period = (uint32_t)strtoul(command + 13, NULL, 10);
+        if (sample_clock_set_period(period)) {
+            // A filter that no longer fits in a report interval is turned off
+            file_emu_send_response(adc_filter_set_scan_period(period) ? "OK\n" : "OK: ADC filter off\n");
+        } else {
+            file_emu_send_response("ERROR: CLOCK period out of range\n");
+        }
+        return;
+    }
+    if (strcmp(command, "CLOCK:SKIP") == 0 || strcmp(command, "CLOCK:CATCHUP") == 0) {
+        sample_clock_set_policy(command[6] == 'S' ? SAMPLE_CLOCK_SKIP : SAMPLE_CLOCK_CATCH_UP);
+        file_emu_send_response("OK\n");
+        return;
+    }
+
+    // Sleep between scheduled work: time asleep and wake latency
+    if (strcmp(command, "IDLE") == 0) {
+        char status[IDLE_REPORT_MAX];
+        idle_format_report(status, sizeof(status));
+        file_emu_send_response(status);
+        return;
+    }
+    if (strcmp(command, "IDLE:RESET") == 0) {
+        idle_reset_stats();
+        file_emu_send_response("OK\n");
+        return;
+    }
+    if (strcmp(command, "IDLE:ON") == 0 || strcmp(command, "IDLE:OFF") == 0) {
+        idle_set_enabled(command[6] == 'N');
+        file_emu_send_response("OK\n");
+        return;
+    }
+
+    // DMA-streamed ADC: age of the analog data in submitted reports
+    if (strcmp(command, "ADC") == 0) {
+        char status[ADC_STREAM_REPORT_MAX];
+        adc_stream_format_report(status, sizeof(status));
+        file_emu_send_response(status);
+
+        char mode[16];
+        adc_filter_format_mode(mode, sizeof(mode));
+        snprintf(status, sizeof(status), "FILTER %s delay_us %lu\n", mode,
+                 (unsigned long)adc_filter_get_delay_us());
+        file_emu_send_response(status);
+        return;
+    }
+    if (strcmp(command, "ADC:RESET") == 0) {
+        adc_stream_reset_stats();
+        file_emu_send_response("OK\n");
+        return;
+    }
+    if (strncmp(command, "ADC:RATIO=", 10) == 0) {
+        if (adc_stream_set_ratio((uint32_t)strtoul(command + 10, NULL, 10))) {
+            file_emu_send_response("OK\n");
+        } else {
+            file_emu_send_response("ERROR: ADC ratio must be a power of 2 up to 64\n");
+        }
+        return;
+    }
+    if (strncmp(command, "ADC:FILTER=", 11) == 0) {
+        // NONE, IIR<shift> or MEDIAN<n>; group delay must stay inside a report interval
+        const char* mode = command + 11;
+        bool ok = false;
+        if (strcmp(mode, "NONE") == 0) {
+            ok = adc_filter_configure(ADC_FILTER_NONE, 0);
+        } else if (strncmp(mode, "IIR", 3) == 0) {
+            ok = adc_filter_configure(ADC_FILTER_IIR, (uint8_t)atoi(mode + 3));
+        } else if (strncmp(mode, "MEDIAN", 6) == 0) {
+            ok = adc_filter_configure(ADC_FILTER_MEDIAN, (uint8_t)atoi(mode + 6));
+        }
+        file_emu_send_response(ok ? "OK\n" : "ERROR: ADC filter not valid at this sample period\n");
+        return;
+    }
+
+    // Whammy calibration; WHAMMY:CAL, work the bar end to end, WHAMMY:SAVE
+    if (strcmp(command, "WHAMMY") == 0) {
+        char status[WHAMMY_CAL_REPORT_MAX];
+        whammy_cal_format_report(status, sizeof(status));
+        file_emu_send_response(status);
+        return;
+    }
+    if (strcmp(command, "WHAMMY:CAL") == 0) {
+        whammy_cal_auto_start();
+        file_emu_send_response("OK\n");
+        return;
+    }
+    if (strcmp(command, "WHAMMY:SAVE") == 0) {
+        uint32_t whammy_min, whammy_max;
+        if (!whammy_cal_auto_finish(&whammy_min, &whammy_max)) {
+            file_emu_send_response("ERROR: Not enough whammy travel, range unchanged\n");
+        } else if (!config_set_whammy_range(whammy_min, whammy_max)) {
+            file_emu_send_response("ERROR: Failed to save whammy range\n");
+        } else {
+            file_emu_send_response("OK\n");
+        }
+        return;
+    }
+    if (strcmp(command, "WHAMMY:CANCEL") == 0) {
+        whammy_cal_auto_cancel();
+        file_emu_send_response("OK\n");
+        return;
+    }
+
+    // Joystick calibration; JOY:CAL with the stick at rest, circle it, JOY:SAVE
+    if (strcmp(command, "JOY") == 0) {
+        char status[JOYSTICK_CAL_REPORT_MAX];
+        joystick_cal_format_report(status, sizeof(status));
+        file_emu_send_response(status);
+        return;
+    }
+    if (strcmp(command, "JOY:CAL") == 0) {
+        joystick_cal_auto_start();
+        file_emu_send_response("OK\n");
+        return;
+    }
+    if (strcmp(command, "JOY:SAVE") == 0) {
+        joystick_axis_range_t ranges[JOYSTICK_CAL_AXES];
+        if (!joystick_cal_auto_finish(ranges)) {
+            file_emu_send_response("ERROR: Not enough joystick travel, calibration unchanged\n");
+        } else if (!config_set_joystick_cal(ranges[0].center, ranges[0].min, ranges[0].max,
+                                            ranges[1].center, ranges[1].min, ranges[1].max)) {
+            file_emu_send_response("ERROR: Failed to save joystick calibration\n");
+        } else {
+            file_emu_send_response("OK\n");
+        }
+        return;
+    }
+    if (strcmp(command, "JOY:CANCEL") == 0) {
+        joystick_cal_auto_cancel();
+        file_emu_send_response("OK\n");
+        return;
+    }
+    if (strncmp(command, "JOY:DEADZONE=", 13) == 0) {
+        if (config_set_joystick_deadzone((uint32_t)strtoul(command + 13, NULL, 10))) {
+            file_emu_send_response("OK\n");
+        } else {
+            file_emu_send_response("ERROR: Joystick deadzone must be 0-16383\n");
+        }
+        return;
+    }
+
+    // Response curves; CURVE:<axis>=<spec> tries one out until the next config load
+    if (strcmp(command, "CURVE") == 0) {
+        char status[RESPONSE_CURVE_REPORT_MAX];
+        response_curve_format_report(status, sizeof(status));
+        file_emu_send_response(status);
+        return;
+    }
+    if (strncmp(command, "CURVE:", 6) == 0) {
+        char axis_name[8];
+        const char* equals = strchr(command + 6, '=');
+        size_t name_length = equals ? (size_t)(equals - (command + 6)) : 0;
+        if (name_length == 0 || name_length >= sizeof(axis_name)) {
+            file_emu_send_response("ERROR: Use CURVE:<whammy|joy_x|joy_y>=<spec>\n");
+            return;
+        }
+        memcpy(axis_name, command + 6, name_length);
+        axis_name[name_length] = '\0';
+        if (response_curve_set(response_curve_find_axis(axis_name), equals + 1)) {
+            file_emu_send_response("OK\n");
+        } else {
+            file_emu_send_response("ERROR: Invalid curve axis or spec\n");
+        }
+        return;
+    }
+
+    // Remap table; REMAP:<control>=<target> tries one out until the next config load
+    if (strcmp(command, "REMAP") == 0) {
+        char status[REMAP_REPORT_MAX];
+        remap_format_report(status, sizeof(status));
+        file_emu_send_response(status);
+        return;
+    }
+    if (strncmp(command, "REMAP:", 6) == 0) {
+        char source_name[12];
+        const char* equals = strchr(command + 6, '=');
+        size_t name_length = equals ? (size_t)(equals - (command + 6)) : 0;
+        if (name_length == 0 || name_length >= sizeof(source_name)) {
+            file_emu_send_response("ERROR: Use REMAP:<control>=<target>\n");
+            return;
+        }
+        memcpy(source_name, command + 6, name_length);
+        source_name[name_length] = '\0';
+        if (remap_set_target(remap_find_source(source_name), equals + 1)) {
+            file_emu_send_response("OK\n");
+        } else {
+            file_emu_send_response("ERROR: Invalid remap control or target\n");
+        }
+        return;
+    }
+
+    // USB mode; MODE:HID or MODE:XINPUT saves it, the device then re-enumerates
+    if (strcmp(command, "MODE") == 0) {
+        char status[32];
+        snprintf(status, sizeof(status), "MODE %s\n", config_get_current()->usb_mode);
+        file_emu_send_response(status);
+        return;
+    }
+    if (strcmp(command, "MODE:XINPUT") == 0 || strcmp(command, "MODE:HID") == 0) {
+        if (config_set_usb_mode(strcmp(command, "MODE:HID") == 0 ? "hid" : "xinput")) {
+            file_emu_send_response("OK\n");
+        } else {
+            file_emu_send_response("ERROR: Failed to save USB mode\n");
+        }
+        return;
+    }
+
+    // Init phase timings and cold-boot-to-first-report time
+    if (strcmp(command, "BOOTPROF") == 0) {
+        static char boot_report[BOOT_PROF_REPORT_MAX];
+        if (!cdc_tx_idle()) {
+            file_emu_send_response("ERROR: BOOTPROF busy\n");
+            return;
+        }
+        uint32_t length = boot_prof_format_report(boot_report, sizeof(boot_report));
+        cdc_tx_write_source(text_tx_source, boot_report, length);
+        return;
+    }
+
+    // Input trace recorder; the trace itself is downloaded in binary
+    if (strcmp(command, "TRACE") == 0) {
+        char status[96];
+        snprintf(status, sizeof(status), "TRACE %s records %lu dropped %lu capacity %u\n",
+                 input_trace_is_armed() ? "armed" : "stopped",
+                 (unsigned long)input_trace_get_count(),
+                 (unsigned long)input_trace_get_dropped(),
+                 INPUT_TRACE_CAPACITY);
+        file_emu_send_response(status);
+        return;
+    }
+    if (strcmp(command, "TRACE:ARM") == 0) {
+        input_trace_arm();
+        file_emu_send_response("OK\n");
+        return;
+    }
+    if (strcmp(command, "TRACE:STOP") == 0) {
+        input_trace_stop();
+        file_emu_send_response("OK\n");
+        return;
+    }
+
     // Handle other commands
     if (strcmp(command, "version") == 0) {
         file_emu_send_response("BGG XInput Firmware v1.0\n");
@@ -334,3 +952,32 @@ void file_emu_process_serial_command(const char* command) {
     snprintf(error_msg, sizeof(error_msg), "ERROR: Unknown command: %s\n", command);
     file_emu_send_response(error_msg);
 }
+
+bool file_emu_accepts_partial_lines(void) {
+    return writing_file;
+}
+
+void file_emu_serial_reset(void) {
+    // The write would hold the writer, and so every other writer, forever
+    if (writing_file) {
+        writing_file = false;
+        line_continued = false;
+        file_emu_write_abort();
+    }
+}
+
+void file_emu_process_serial_span(const char* data, uint32_t length, bool end_of_line) {
+    // Pieces of an over-long content line go straight to flash; END_FILE is
+    // only recognised on a line of its own
+    if (writing_file && (line_continued || !end_of_line)) {
+        file_emu_write_append(data, length);
+        if (end_of_line) {
+            file_emu_write_append("\n", 1);
+        }
+        line_continued = !end_of_line;
+        return;
+    }
+
+    line_continued = false;
+    file_emu_process_serial_command(data);
+}
@@ -3,23 +3,39 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "config_storage.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 // File emulation system - mimics CircuitPython file I/O for BGG app compatibility
+//
+// Files are not held in RAM. config.json is generated on demand from the live
+// configuration, built-in defaults are read straight from the firmware image,
+// and written files live in flash slots that are read back through XIP.
 #define MAX_FILENAME_LENGTH     32
-#define MAX_FILE_CONTENT        8192
 #define MAX_VIRTUAL_FILES       4
 
-// Virtual file structure
+// Flash slots for written files, directly below the config sector.
+// Each file owns two slots (A/B) so a failed write never loses the previous copy.
+#define FILE_EMU_SLOT_SIZE      (2 * FLASH_SECTOR_SIZE)
+#define FILE_EMU_SLOT_COUNT     (MAX_VIRTUAL_FILES * 2)
+#define FILE_EMU_FLASH_SIZE     (FILE_EMU_SLOT_COUNT * FILE_EMU_SLOT_SIZE)
+#define FILE_EMU_FLASH_OFFSET   (CONFIG_FLASH_OFFSET - FILE_EMU_FLASH_SIZE)
+#define FILE_EMU_MAGIC          0x46474742  // "BGGF"
+
+// First page of a slot holds the header, data starts on the next page
+#define MAX_FILE_CONTENT        (FILE_EMU_SLOT_SIZE - FLASH_PAGE_SIZE - 1)
+
+// Slot header, programmed last so a slot only becomes valid once fully written
 typedef struct {
+    uint32_t magic;                         // FILE_EMU_MAGIC
+    uint32_t sequence;                      // Higher sequence wins between A/B
+    uint32_t size;                          // Content size (excluding trailing NUL)
+    uint32_t checksum;                      // CRC32 of content
     char filename[MAX_FILENAME_LENGTH];
-    char content[MAX_FILE_CONTENT];
-    uint32_t size;
-    bool exists;
-} virtual_file_t;
+} file_emu_header_t;
 
 // File emulation functions
 bool file_emu_init(void);
@@ -30,9 +46,44 @@ bool file_emu_exists(const char* filename);
 bool file_emu_read(const char* filename, char* buffer, uint32_t buffer_size, uint32_t* actual_size);
 bool file_emu_write(const char* filename, const char* content, uint32_t size);
 
+// Random access without copying the whole file
+bool file_emu_get_size(const char* filename, uint32_t* size);
+uint32_t file_emu_read_at(const char* filename, uint32_t offset, void* buffer, uint32_t length);
+
+// Streaming writes straight into flash pages. One write at a time: begin
+// returns 0 while another one is in progress (WRITEFILE, the binary
+// protocol or a drive commit); the caller reports that or retries later.
+// Otherwise it returns a token naming this write, never 0, for callers
+// that span requests to check they still own the writer.
+bool file_emu_write_busy(void);
+uint32_t file_emu_write_begin(const char* filename);
+bool file_emu_write_owned(uint32_t token);
+bool file_emu_write_append(const void* data, uint32_t size);
+bool file_emu_write_commit(void);
+void file_emu_write_abort(void);
+
+// Erase the slots the next writes will go to, at most one flash sector per
+// call (call from the main loop). Each file's inactive slot (the copy a
+// write replaced) is erased in the background, so a write normally finds
+// its sectors blank and only programs pages on the command path.
+void file_emu_task(void);
+
+// Directory listing: index 0..MAX_VIRTUAL_FILES-1, NULL for an unused entry
+const char* file_emu_get_file_name(uint32_t index);
+
 // Serial command processing (matches BGG app expectations)
 void file_emu_process_serial_command(const char* command);
 
+// Text input as spans from the CDC receive buffer. A complete line is NUL
+// terminated; a line too long for the buffer arrives in pieces (only
+// accepted while file content is streaming) and only the last piece has
+// end_of_line set.
+void file_emu_process_serial_span(const char* data, uint32_t length, bool end_of_line);
+bool file_emu_accepts_partial_lines(void);
+
+// Terminal disconnected: abandon a WRITEFILE in progress
+void file_emu_serial_reset(void);
+
 // CDC communication
 void file_emu_send_response(const char* response);
 void file_emu_send_file_content(const char* filename);
@@ -0,0 +1,432 @@
+#ifndef GUITAR_CORE_H
+#define GUITAR_CORE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <utility>
+#include "hardware/gpio.h"
+#include "config.h"
+#include "remap.h"
+
+// Scan-to-report core shared by the firmware variants (C++17).
+//
+// A variant is one instantiation of guitar_core::guitar with four policies:
+//   Input      pin levels -> pressed controls, one bit per remap_source_t
+//                fixed_pins<masks...>       pins known at compile time
+//                config_pins<guide, tilt>   pins from config.json
+//   Debounce   no_debounce, lockout_debounce<mask, ms>
+//   Mapping    controls + analog values -> remap_output_t
+//                fixed_map<table>           table known at compile time
+//                table_map                  remap.c, from config.json
+//   Encoder    remap_output_t -> report
+//                xinput_encoder             XInput gamepad body
+//                hid_gamepad_encoder        TUD_HID_REPORT_DESC_GAMEPAD
+//
+//   bgg_xinput_firmware       fixed_pins, no_debounce, fixed_map, xinput_encoder
+//   bgg_xinput_cdc_firmware   config_pins, lockout_debounce (tilt), table_map, xinput_encoder
+//   bgg_hid_firmware          fixed_pins, no_debounce, fixed_map, hid_gamepad_encoder
+//
+// Every policy call is inline and the fixed policies are constexpr, so a
+// fixed pin map reads GPIO once and moves each bit with immediate masks,
+// and a fixed table folds to the same mask/shift program remap.c builds at
+// run time, with no table to load. fixed_map follows the semantics in
+// remap.h exactly; bgg_remap_check checks both against a reference.
+
+namespace guitar_core {
+
+//--------------------------------------------------------------------+
+// REPORTS
+//--------------------------------------------------------------------+
+// XInput gamepad input, after the 2-byte rid/rsize header
+typedef struct {
+    uint16_t buttons;
+    uint8_t lt;
+    uint8_t rt;
+    int16_t lx;
+    int16_t ly;
+    int16_t rx;
+    int16_t ry;
+    uint8_t reserved[6];
+} __attribute__((packed)) xinput_gamepad_t;
+
+// XInput input report as sent on the interrupt IN endpoint
+typedef struct {
+    uint8_t rid;
+    uint8_t rsize;
+    xinput_gamepad_t gamepad;
+} __attribute__((packed)) xinput_wire_report_t;
+
+// TinyUSB TUD_HID_REPORT_DESC_GAMEPAD() report (hid_gamepad_report_t layout)
+typedef struct {
+    int8_t x;
+    int8_t y;
+    int8_t z;
+    int8_t rz;
+    int8_t rx;
+    int8_t ry;
+    uint8_t hat;
+    uint32_t buttons;
+} __attribute__((packed)) hid_gamepad_t;
+
+//--------------------------------------------------------------------+
+// INPUT POLICIES
+//--------------------------------------------------------------------+
+constexpr uint32_t pin(uint8_t gpio) { return 1u << gpio; }
+constexpr uint32_t NO_PIN = 0;
+
+// One pin mask per digital source, in remap_source_t order; several pins in
+// a mask are ORed (a second strum switch), NO_PIN reads as released
+template <uint32_t... Masks>
+struct fixed_pins {
+    static_assert(sizeof...(Masks) == REMAP_DIGITAL_SOURCES, "one pin mask per digital source");
+    static constexpr uint32_t masks[] = { Masks... };
+    static constexpr uint32_t all = (0u | ... | Masks);
+
+    static void init(void) {
+        for (uint8_t gpio = 0; gpio < 32; gpio++) {
+            if (!(all & pin(gpio))) continue;
+            gpio_init(gpio);
+            gpio_set_dir(gpio, GPIO_IN);
+            gpio_pull_up(gpio);
+        }
+    }
+
+    // Active low, from one gpio_get_all() snapshot
+    uint16_t read(uint32_t levels) const {
+        return gather(~levels, std::make_index_sequence<REMAP_DIGITAL_SOURCES>{});
+    }
+
+private:
+    template <size_t... I>
+    static uint16_t gather(uint32_t low, std::index_sequence<I...>) {
+        return (uint16_t)(0u | ... | bit<I>(low));
+    }
+
+    template <size_t I>
+    static uint32_t bit(uint32_t low) {
+        constexpr uint32_t mask = masks[I];
+        if constexpr (mask == NO_PIN) {
+            return 0;
+        } else if constexpr ((mask & (mask - 1)) != 0) {
+            return (uint32_t)((low & mask) != 0) << I;
+        } else {
+            // Single pin: one shift and one AND
+            constexpr int gpio = __builtin_ctz(mask);
+            if constexpr (gpio >= (int)I) return (low >> (gpio - I)) & (1u << I);
+            else return (low << (I - gpio)) & (1u << I);
+        }
+    }
+};
+
+// Pins named in config.json, re-read whenever a config is activated; GUIDE
+// and TILT stay on the pins wired in this build
+template <uint8_t GuidePin, uint8_t TiltPin>
+class config_pins {
+public:
+    uint16_t read(uint32_t levels) {
+        if (generation != config_get_generation()) load();
+        uint32_t low = ~levels;
+        uint32_t pressed = 0;
+        for (int i = 0; i < REMAP_DIGITAL_SOURCES; i++) {
+            pressed |= (uint32_t)((low & masks[i]) != 0) << i;
+        }
+        return (uint16_t)pressed;
+    }
+
+private:
+    uint32_t masks[REMAP_DIGITAL_SOURCES] = {};
+    uint32_t generation = 0;
+
+    void load(void) {
+        const uint8_t pins[REMAP_DIGITAL_SOURCES] = {
+            config_get_green_pin(), config_get_red_pin(), config_get_yellow_pin(),
+            config_get_blue_pin(), config_get_orange_pin(),
+            config_get_strum_up_pin(), config_get_strum_down_pin(),
+            config_get_start_pin(), config_get_select_pin(), GuidePin, TiltPin,
+            config_get_dpad_up_pin(), config_get_dpad_down_pin(),
+            config_get_dpad_left_pin(), config_get_dpad_right_pin()
+        };
+        for (int i = 0; i < REMAP_DIGITAL_SOURCES; i++) {
+            masks[i] = (pins[i] < 32) ? pin(pins[i]) : NO_PIN;
+        }
+        generation = config_get_generation();
+    }
+};
+
+//--------------------------------------------------------------------+
+// DEBOUNCE POLICIES
+//--------------------------------------------------------------------+
+struct no_debounce {
+    uint16_t apply(uint16_t raw, uint32_t now_ms) const {
+        (void)now_ms;
+        return raw;
+    }
+};
+
+// Controls in Mask follow the pin at most once per HoldMs (the tilt switch
+// rattles); the others pass straight through
+template <uint16_t Mask, uint32_t HoldMs>
+class lockout_debounce {
+public:
+    uint16_t apply(uint16_t raw, uint32_t now_ms) {
+        filter(raw, now_ms, std::make_index_sequence<REMAP_DIGITAL_SOURCES>{});
+        return (uint16_t)((raw & ~Mask) | (stable & Mask));
+    }
+
+private:
+    uint16_t stable = 0;
+    uint32_t changed_ms[REMAP_DIGITAL_SOURCES] = {};
+
+    template <size_t... I>
+    void filter(uint16_t raw, uint32_t now_ms, std::index_sequence<I...>) {
+        (step<I>(raw, now_ms), ...);
+    }
+
+    template <size_t I>
+    void step(uint16_t raw, uint32_t now_ms) {
+        if constexpr ((Mask >> I) & 1) {
+            if (((raw ^ stable) >> I) & 1 && now_ms - changed_ms[I] > HoldMs) {
+                stable ^= (uint16_t)(1u << I);
+                changed_ms[I] = now_ms;
+            }
+        }
+    }
+};
+
+//--------------------------------------------------------------------+
+// MAPPING POLICIES
+//--------------------------------------------------------------------+
+// remap.c, compiled from config.json
+struct table_map {
+    void apply(const remap_input_t& input, remap_output_t& output) const {
+        remap_apply(&input, &output);
+    }
+};
+
+// Table entries for fixed_map
+constexpr remap_target_t none(void) { return remap_target_t{ REMAP_TARGET_NONE, 0, 0 }; }
+constexpr remap_target_t button(uint16_t xinput_mask) {
+    return remap_target_t{ REMAP_TARGET_BUTTON, (uint8_t)__builtin_ctz(xinput_mask), 0 };
+}
+constexpr remap_target_t axis(remap_axis_t which, int8_t direction = 0) {
+    return remap_target_t{ REMAP_TARGET_AXIS, (uint8_t)which, direction };
+}
+
+// remap.c's program, built by the compiler
+struct fixed_program {
+    struct shift_op { uint16_t mask; uint8_t left; uint8_t right; };
+    struct axis_op { uint8_t source; uint8_t axis; int32_t value; };   // Digital: delta, analog: sign
+
+    uint8_t shift_count = 0;
+    uint8_t digital_axis_count = 0;
+    uint8_t analog_axis_count = 0;
+    uint8_t analog_button_count = 0;
+    shift_op shifts[REMAP_DIGITAL_SOURCES] = {};
+    axis_op digital_axes[REMAP_DIGITAL_SOURCES] = {};
+    axis_op analog_axes[REMAP_ANALOG_SOURCES] = {};
+    axis_op analog_buttons[REMAP_ANALOG_SOURCES] = {};                  // axis: button bit
+    int32_t axis_base[REMAP_AXES] = {};
+};
+
+constexpr fixed_program compile(const remap_target_t (&targets)[REMAP_SOURCES], bool hat_joystick) {
+    fixed_program program;
+    for (int source = 0; source < REMAP_SOURCES; source++) {
+        remap_target_t target = targets[source];
+        if (hat_joystick && source >= REMAP_UP && source <= REMAP_RIGHT &&
+            target.kind == REMAP_TARGET_BUTTON && target.index <= 3) {
+            const uint8_t stick_axis[4] = { REMAP_AXIS_LY, REMAP_AXIS_LY, REMAP_AXIS_LX, REMAP_AXIS_LX };
+            const int8_t stick_direction[4] = { 1, -1, -1, 1 };
+            target = remap_target_t{ REMAP_TARGET_AXIS, stick_axis[target.index], stick_direction[target.index] };
+        }
+
+        bool digital = source < REMAP_DIGITAL_SOURCES;
+        bool trigger = target.kind == REMAP_TARGET_AXIS && target.index <= REMAP_AXIS_RT;
+        int8_t sign = target.direction < 0 ? -1 : 1;
+
+        if (target.kind == REMAP_TARGET_BUTTON && digital) {
+            int distance = (int)target.index - source;
+            uint8_t left = (uint8_t)(distance > 0 ? distance : 0);
+            uint8_t right = (uint8_t)(distance < 0 ? -distance : 0);
+            int op = program.shift_count;
+            for (int i = 0; i < program.shift_count; i++) {
+                if (program.shifts[i].left == left && program.shifts[i].right == right) op = i;
+            }
+            if (op == program.shift_count) {
+                program.shifts[program.shift_count++] = { 0, left, right };
+            }
+            program.shifts[op].mask = (uint16_t)(program.shifts[op].mask | (1u << source));
+        } else if (target.kind == REMAP_TARGET_BUTTON) {
+            program.analog_buttons[program.analog_button_count++] =
+                { (uint8_t)(source - REMAP_DIGITAL_SOURCES), target.index, sign };
+        } else if (target.kind == REMAP_TARGET_AXIS && digital) {
+            int32_t delta = trigger ? 255 : target.direction > 0 ? 32767 : target.direction < 0 ? -32768 : -65535;
+            if (!trigger && target.direction == 0) program.axis_base[target.index] += 32767;
+            program.digital_axes[program.digital_axis_count++] = { (uint8_t)source, target.index, delta };
+        } else if (target.kind == REMAP_TARGET_AXIS) {
+            program.analog_axes[program.analog_axis_count++] =
+                { (uint8_t)(source - REMAP_DIGITAL_SOURCES), target.index, sign };
+        }
+    }
+    return program;
+}
+
+// Table: a type with
+//   static constexpr remap_target_t targets[REMAP_SOURCES];
+//   static constexpr bool hat_joystick;
+template <typename Table>
+struct fixed_map {
+    static constexpr fixed_program program = compile(Table::targets, Table::hat_joystick);
+
+    void apply(const remap_input_t& input, remap_output_t& output) const {
+        static constexpr int32_t axis_min[REMAP_AXES] = { 0, 0, -32768, -32768, -32768, -32768 };
+        static constexpr int32_t axis_max[REMAP_AXES] = { 255, 255, 32767, 32767, 32767, 32767 };
+        uint32_t digital = input.digital;
+
+        uint32_t buttons = shift_buttons(digital, std::make_index_sequence<program.shift_count>{}) |
+                           analog_buttons(input, std::make_index_sequence<program.analog_button_count>{});
+
+        int32_t axes[REMAP_AXES] = { program.axis_base[0], program.axis_base[1], program.axis_base[2],
+                                     program.axis_base[3], program.axis_base[4], program.axis_base[5] };
+        digital_axes(digital, axes, std::make_index_sequence<program.digital_axis_count>{});
+        analog_axes(input, axes, std::make_index_sequence<program.analog_axis_count>{});
+        for (int i = 0; i < REMAP_AXES; i++) {
+            if (axes[i] < axis_min[i]) axes[i] = axis_min[i];
+            if (axes[i] > axis_max[i]) axes[i] = axis_max[i];
+        }
+
+        output.buttons = (uint16_t)buttons;
+        output.lt = (uint8_t)axes[REMAP_AXIS_LT];
+        output.rt = (uint8_t)axes[REMAP_AXIS_RT];
+        output.lx = (int16_t)axes[REMAP_AXIS_LX];
+        output.ly = (int16_t)axes[REMAP_AXIS_LY];
+        output.rx = (int16_t)axes[REMAP_AXIS_RX];
+        output.ry = (int16_t)axes[REMAP_AXIS_RY];
+    }
+
+private:
+    template <size_t... I>
+    static uint32_t shift_buttons(uint32_t digital, std::index_sequence<I...>) {
+        return (0u | ... | (((digital & program.shifts[I].mask) << program.shifts[I].left) >> program.shifts[I].right));
+    }
+
+    template <size_t... I>
+    static uint32_t analog_buttons(const remap_input_t& input, std::index_sequence<I...>) {
+        return (0u | ... | ((uint32_t)(program.analog_buttons[I].value * input.analog[program.analog_buttons[I].source] > REMAP_ANALOG_BUTTON_THRESHOLD)
+                            << program.analog_buttons[I].axis));
+    }
+
+    template <size_t... I>
+    static void digital_axes(uint32_t digital, int32_t* axes, std::index_sequence<I...>) {
+        ((axes[program.digital_axes[I].axis] +=
+              (int32_t)((digital >> program.digital_axes[I].source) & 1u) * program.digital_axes[I].value), ...);
+    }
+
+    template <size_t... I>
+    static void analog_axes(const remap_input_t& input, int32_t* axes, std::index_sequence<I...>) {
+        ((axes[program.analog_axes[I].axis] += analog_value(program.analog_axes[I], input)), ...);
+    }
+
+    static int32_t analog_value(const fixed_program::axis_op& op, const remap_input_t& input) {
+        int32_t value = op.value * input.analog[op.source];
+        return (op.axis <= REMAP_AXIS_RT) ? (value + 32768) >> 8 : value;
+    }
+};
+
+//--------------------------------------------------------------------+
+// ENCODERS
+//--------------------------------------------------------------------+
+struct xinput_encoder {
+    typedef xinput_gamepad_t report_t;
+
+    static void encode(const remap_output_t& mapped, report_t* report) {
+        report->buttons = mapped.buttons;
+        report->lt = mapped.lt;
+        report->rt = mapped.rt;
+        report->lx = mapped.lx;
+        report->ly = mapped.ly;
+        report->rx = mapped.rx;
+        report->ry = mapped.ry;
+        memset(report->reserved, 0, sizeof(report->reserved));
+    }
+};
+
+// XInput buttons on the TinyUSB GAMEPAD_BUTTON_* bits, the d-pad on the hat,
+// sticks and triggers scaled to -127..127 (HID Y grows downwards)
+struct hid_gamepad_encoder {
+    typedef hid_gamepad_t report_t;
+
+    static void encode(const remap_output_t& mapped, report_t* report) {
+        // GAMEPAD_HAT_*: centered 0, up 1, then clockwise to up-left 8; opposite directions cancel
+        static constexpr uint8_t hat[16] = { 0, 1, 5, 0, 7, 8, 6, 7, 3, 2, 4, 3, 0, 1, 5, 0 };
+
+        report->x = stick(mapped.lx);
+        report->y = stick(-(int32_t)mapped.ly);
+        report->z = stick(mapped.rx);
+        report->rz = stick(-(int32_t)mapped.ry);
+        report->rx = trigger(mapped.lt);
+        report->ry = trigger(mapped.rt);
+        report->hat = hat[mapped.buttons & 0x0F];
+        report->buttons = buttons(mapped.buttons, std::make_index_sequence<sizeof(button_bits) / sizeof(button_bits[0])>{});
+    }
+
+private:
+    struct button_bit { uint8_t xinput; uint8_t hid; };
+    static constexpr button_bit button_bits[] = {
+        { 12, 0 },  { 13, 1 },  { 14, 3 },  { 15, 4 },      // A B X Y -> GAMEPAD_BUTTON_A B X Y (south east north west)
+        { 8, 6 },   { 9, 7 },                               // LB RB -> TL TR
+        { 5, 10 },  { 4, 11 },  { 10, 12 },                 // Back Start Guide -> select start mode
+        { 6, 13 },  { 7, 14 },                              // Thumbs
+    };
+
+    template <size_t... I>
+    static uint32_t buttons(uint32_t xinput, std::index_sequence<I...>) {
+        return (0u | ... | (((xinput >> button_bits[I].xinput) & 1u) << button_bits[I].hid));
+    }
+
+    static int8_t stick(int32_t value) {
+        value >>= 8;
+        return (int8_t)(value < -127 ? -127 : value > 127 ? 127 : value);
+    }
+
+    static int8_t trigger(uint8_t value) {
+        int32_t centered = (int32_t)value - 128;
+        return (int8_t)(centered < -127 ? -127 : centered);
+    }
+};
+
+//--------------------------------------------------------------------+
+// CORE
+//--------------------------------------------------------------------+
+template <typename Input, typename Debounce, typename Mapping, typename Encoder>
+class guitar {
+public:
+    typedef typename Encoder::report_t report_t;
+
+    Input input;
+    Debounce debounce;
+    Mapping mapping;
+
+    // Pressed controls, one bit per remap_source_t, from one snapshot of the pin levels
+    uint16_t read(uint32_t gpio_levels, uint32_t now_ms) {
+        return debounce.apply(input.read(gpio_levels), now_ms);
+    }
+
+    // Report from the controls and the analog values (stick form, whammy: travel - 32768)
+    remap_output_t build(uint16_t digital, int16_t whammy, int16_t joy_x, int16_t joy_y, report_t* report) {
+        remap_input_t mapped_input;
+        mapped_input.digital = digital;
+        mapped_input.analog[REMAP_WHAMMY - REMAP_DIGITAL_SOURCES] = whammy;
+        mapped_input.analog[REMAP_JOY_X - REMAP_DIGITAL_SOURCES] = joy_x;
+        mapped_input.analog[REMAP_JOY_Y - REMAP_DIGITAL_SOURCES] = joy_y;
+
+        remap_output_t mapped;
+        mapping.apply(mapped_input, mapped);
+        Encoder::encode(mapped, report);
+        return mapped;
+    }
+};
+
+} // namespace guitar_core
+
+#endif // GUITAR_CORE_H
@@ -0,0 +1,123 @@
+#include "idle.h"
+#include "pico/stdlib.h"
+#include "hardware/timer.h"
+#include "hardware/sync.h"
+#include <stdio.h>
+#include <string.h>
+
+static int alarm_num = -1;
+static bool enabled = true;
+
+static uint32_t sleep_count = 0;
+static uint32_t timed_wake_count = 0;
+static uint32_t wake_max_us = 0;
+static uint64_t wake_total_us = 0;
+static uint64_t slept_us = 0;
+static uint64_t window_start_us = 0;
+
+// Only there to wake the core; the loop does the work
+static void wake_callback(uint alarm) {
+    (void)alarm;
+}
+
+//--------------------------------------------------------------------+
+// IDLE CONTROL
+//--------------------------------------------------------------------+
+void idle_init(void) {
+    if (alarm_num < 0) {
+        alarm_num = hardware_alarm_claim_unused(false);
+        if (alarm_num < 0) {
+            printf("Idle: No free hardware alarm, timed wakes off\n");
+        } else {
+            hardware_alarm_set_callback((uint)alarm_num, wake_callback);
+        }
+    }
+    idle_reset_stats();
+}
+
+void idle_set_enabled(bool enable) {
+    enabled = enable;
+}
+
+bool idle_is_enabled(void) {
+    return enabled;
+}
+
+void idle_wait(uint32_t wake_us, bool (*work_pending)(void)) {
+    if (!enabled) {
+        return;
+    }
+
+    uint32_t interrupts = save_and_disable_interrupts();
+    if (work_pending && work_pending()) {
+        restore_interrupts(interrupts);
+        return;
+    }
+
+    // Without an alarm of its own the sample clock tick still wakes the core
+    uint64_t start_us = time_us_64();
+    bool timed = wake_us != 0 && alarm_num >= 0;
+    if (timed) {
+        int32_t until_us = (int32_t)(wake_us - (uint32_t)start_us);
+        if (until_us < IDLE_MIN_SLEEP_US ||
+            hardware_alarm_set_target((uint)alarm_num, from_us_since_boot(start_us + (uint32_t)until_us))) {
+            restore_interrupts(interrupts);
+            return;
+        }
+    }
+
+    __wfi();
+
+    uint64_t woke_us = time_us_64();
+    restore_interrupts(interrupts);     // Pending handlers run here
+    uint32_t resumed_us = time_us_32();
+
+    if (timed) {
+        hardware_alarm_cancel((uint)alarm_num);
+    }
+
+    sleep_count++;
+    slept_us += woke_us - start_us;
+
+    // Woken by the alarm itself: how long until the loop got going again
+    if (timed && (int32_t)(resumed_us - wake_us) >= 0) {
+        uint32_t latency_us = resumed_us - wake_us;
+        timed_wake_count++;
+        wake_total_us += latency_us;
+        if (latency_us > wake_max_us) wake_max_us = latency_us;
+    }
+}
+
+//--------------------------------------------------------------------+
+// STATISTICS
+//--------------------------------------------------------------------+
+void idle_get_stats(idle_stats_t* stats) {
+    stats->sleeps = sleep_count;
+    stats->timed_wakes = timed_wake_count;
+    stats->wake_max_us = wake_max_us;
+    stats->wake_mean_us = timed_wake_count ? (uint32_t)(wake_total_us / timed_wake_count) : 0;
+    stats->slept_us = slept_us;
+    stats->window_us = time_us_64() - window_start_us;
+}
+
+void idle_reset_stats(void) {
+    sleep_count = 0;
+    timed_wake_count = 0;
+    wake_max_us = 0;
+    wake_total_us = 0;
+    slept_us = 0;
+    window_start_us = time_us_64();
+}
+
+uint32_t idle_format_report(char* out, uint32_t size) {
+    idle_stats_t stats;
+    idle_get_stats(&stats);
+
+    uint32_t idle_pct = stats.window_us ? (uint32_t)(stats.slept_us * 100 / stats.window_us) : 0;
+    int length = snprintf(out, size,
+                          "IDLE %s sleeps %lu idle_pct %lu timed_wakes %lu wake_max_us %lu wake_mean_us %lu\n",
+                          enabled ? "on" : "off", (unsigned long)stats.sleeps, (unsigned long)idle_pct,
+                          (unsigned long)stats.timed_wakes, (unsigned long)stats.wake_max_us,
+                          (unsigned long)stats.wake_mean_us);
+    return (length < (int)size) ? (uint32_t)length : size - 1;
+}
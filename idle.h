@@ -0,0 +1,56 @@
+#ifndef IDLE_H
+#define IDLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Low-power idle between scheduled work.
+//
+// idle_wait() sleeps the core in WFI until the next interrupt: the sample
+// clock tick, a USB interrupt, a GPIO edge, or its own wake alarm set for
+// the next scheduled release. Interrupts are masked while it checks for
+// pending work and goes to sleep, so an interrupt that arrives in between
+// still wakes the core (WFI wakes on a pending interrupt even when masked)
+// and its handler runs as soon as they are restored.
+//
+// For wakes by its own alarm the time from the target to the loop running
+// again is measured; together with the time spent asleep it is returned by
+// the "IDLE" text command.
+
+#define IDLE_MIN_SLEEP_US   20      // Closer releases are not worth a sleep
+#define IDLE_REPORT_MAX     256
+
+typedef struct {
+    uint32_t sleeps;
+    uint32_t timed_wakes;       // Woken by the wake alarm rather than another interrupt
+    uint32_t wake_max_us;       // Worst wake target -> loop running again
+    uint32_t wake_mean_us;
+    uint64_t slept_us;
+    uint64_t window_us;         // Time since the statistics were reset
+} idle_stats_t;
+
+// Idle functions
+void idle_init(void);
+void idle_set_enabled(bool enabled);
+bool idle_is_enabled(void);
+
+// Sleep until an interrupt unless work_pending() says there is work;
+// wake_us is the time_us_32() to be back by, 0 = no timed wake
+void idle_wait(uint32_t wake_us, bool (*work_pending)(void));
+
+// Statistics
+void idle_get_stats(idle_stats_t* stats);
+void idle_reset_stats(void);
+
+// Render the text report ("IDLE" command), returns its length
+uint32_t idle_format_report(char* out, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IDLE_H
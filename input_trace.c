@@ -0,0 +1,122 @@
+#include "input_trace.h"
+#include <string.h>
+
+static input_trace_record_t ring[INPUT_TRACE_CAPACITY];
+static uint32_t ring_head = 0;          // Next record to write
+static uint32_t ring_count = 0;
+static uint32_t dropped = 0;
+static bool armed = false;
+static bool first_sample = false;
+static input_trace_record_t last;       // Last stored inputs, for change detection
+
+static inline bool adc_moved(uint16_t sample, uint16_t previous) {
+    uint16_t delta = sample > previous ? sample - previous : previous - sample;
+    return delta > INPUT_TRACE_ADC_DELTA;
+}
+
+//--------------------------------------------------------------------+
+// RECORDING
+//--------------------------------------------------------------------+
+void input_trace_init(void) {
+    armed = false;
+    ring_head = 0;
+    ring_count = 0;
+    dropped = 0;
+}
+
+void input_trace_arm(void) {
+    ring_head = 0;
+    ring_count = 0;
+    dropped = 0;
+    first_sample = true;
+    armed = true;
+}
+
+void input_trace_stop(void) {
+    armed = false;
+}
+
+bool input_trace_is_armed(void) {
+    return armed;
+}
+
+void input_trace_sample(uint32_t now_us, uint32_t gpio, uint16_t whammy, uint16_t joy_x, uint16_t joy_y) {
+    if (!armed) return;
+
+    // Only changes are stored; inputs hold their value between records
+    if (!first_sample && gpio == last.gpio && !adc_moved(whammy, last.whammy) &&
+        !adc_moved(joy_x, last.joy_x) && !adc_moved(joy_y, last.joy_y)) {
+        return;
+    }
+
+    input_trace_record_t* record = &ring[ring_head];
+    record->time_us = now_us;
+    record->gpio = gpio;
+    record->whammy = whammy;
+    record->joy_x = joy_x;
+    record->joy_y = joy_y;
+    record->flags = first_sample ? INPUT_TRACE_FLAG_FIRST : 0;
+    last = *record;
+    first_sample = false;
+
+    ring_head = (ring_head + 1) % INPUT_TRACE_CAPACITY;
+    if (ring_count < INPUT_TRACE_CAPACITY) {
+        ring_count++;
+    } else {
+        dropped++;
+    }
+}
+
+//--------------------------------------------------------------------+
+// DOWNLOAD
+//--------------------------------------------------------------------+
+uint32_t input_trace_get_count(void) {
+    return ring_count;
+}
+
+uint32_t input_trace_get_dropped(void) {
+    return dropped;
+}
+
+uint32_t input_trace_get_image_size(void) {
+    return sizeof(input_trace_header_t) + ring_count * sizeof(input_trace_record_t);
+}
+
+uint32_t input_trace_read_image(uint32_t offset, void* buffer, uint32_t length) {
+    input_trace_header_t header;
+    header.magic = INPUT_TRACE_MAGIC;
+    header.version = INPUT_TRACE_VERSION;
+    header.record_size = sizeof(input_trace_record_t);
+    header.record_count = ring_count;
+    header.dropped = dropped;
+
+    uint32_t size = input_trace_get_image_size();
+    if (offset >= size) return 0;
+    if (length > size - offset) length = size - offset;
+
+    // Oldest record sits at the head once the ring has wrapped
+    uint32_t oldest = (ring_count == INPUT_TRACE_CAPACITY) ? ring_head : 0;
+    uint8_t* out = (uint8_t*)buffer;
+    uint32_t copied = 0;
+
+    while (copied < length) {
+        uint32_t pos = offset + copied;
+        const uint8_t* source;
+        uint32_t available;
+
+        if (pos < sizeof(header)) {
+            source = (const uint8_t*)&header + pos;
+            available = sizeof(header) - pos;
+        } else {
+            uint32_t index = (pos - sizeof(header)) / sizeof(input_trace_record_t);
+            uint32_t within = (pos - sizeof(header)) % sizeof(input_trace_record_t);
+            source = (const uint8_t*)&ring[(oldest + index) % INPUT_TRACE_CAPACITY] + within;
+            available = sizeof(input_trace_record_t) - within;
+        }
+
+        uint32_t chunk = length - copied < available ? length - copied : available;
+        memcpy(out + copied, source, chunk);
+        copied += chunk;
+    }
+    return copied;
+}
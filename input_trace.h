@@ -0,0 +1,64 @@
+#ifndef INPUT_TRACE_H
+#define INPUT_TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Input trace recorder for chasing ghost inputs.
+//
+// While armed, every input scan whose raw GPIO levels changed (or whose ADC
+// samples moved by more than INPUT_TRACE_ADC_DELTA) is stored as a
+// timestamped record in a RAM ring; once full, the oldest records are
+// overwritten so the trace always ends at the moment it was stopped.
+// A stopped trace is downloaded as one image, header then records oldest
+// first, all little endian, and replayed on the host by sim/replay.c.
+
+#define INPUT_TRACE_CAPACITY    1024    // Records kept in RAM (16 KB)
+#define INPUT_TRACE_ADC_DELTA   16      // One whammy step (4096 / 256)
+#define INPUT_TRACE_MAGIC       0x54474742  // "BGGT"
+#define INPUT_TRACE_VERSION     1
+
+// Record flags
+#define INPUT_TRACE_FLAG_FIRST  0x0001  // First scan after arming
+
+typedef struct {
+    uint32_t magic;             // INPUT_TRACE_MAGIC
+    uint16_t version;           // INPUT_TRACE_VERSION
+    uint16_t record_size;       // sizeof(input_trace_record_t)
+    uint32_t record_count;      // Records following the header
+    uint32_t dropped;           // Older records overwritten by the ring
+} __attribute__((packed)) input_trace_header_t;
+
+typedef struct {
+    uint32_t time_us;           // time_us_32() of the scan
+    uint32_t gpio;              // gpio_get_all(), 1 = high (released)
+    uint16_t whammy;            // Raw 12-bit ADC samples
+    uint16_t joy_x;
+    uint16_t joy_y;
+    uint16_t flags;
+} __attribute__((packed)) input_trace_record_t;
+
+// Recorder functions
+void input_trace_init(void);
+void input_trace_arm(void);     // Clears the ring and starts recording
+void input_trace_stop(void);
+bool input_trace_is_armed(void);
+
+// Called once per input scan with the raw inputs it used
+void input_trace_sample(uint32_t now_us, uint32_t gpio, uint16_t whammy, uint16_t joy_x, uint16_t joy_y);
+
+// Downloading (only while stopped, so the image does not move underneath)
+uint32_t input_trace_get_count(void);
+uint32_t input_trace_get_dropped(void);
+uint32_t input_trace_get_image_size(void);
+uint32_t input_trace_read_image(uint32_t offset, void* buffer, uint32_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // INPUT_TRACE_H
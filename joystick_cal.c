@@ -0,0 +1,257 @@
+#include "joystick_cal.h"
+#include "hardware/sync.h"
+#include <stdio.h>
+#include <string.h>
+
+typedef struct {
+    int32_t center;
+    uint32_t neg_span;              // center - min
+    uint32_t pos_span;              // max - center
+    uint32_t neg_scale;             // Q16, 32767 / neg_span
+    uint32_t pos_scale;             // Q16, 32767 / pos_span
+} axis_cal_t;
+
+typedef struct {
+    axis_cal_t axis[JOYSTICK_CAL_AXES];
+    joystick_axis_range_t ranges[JOYSTICK_CAL_AXES];
+    uint32_t deadzone;
+    uint32_t deadzone_sq;
+    uint32_t gain_scale;            // Q15, 32767 / (32767 - deadzone)
+} joystick_cal_t;
+
+typedef enum {
+    CAPTURE_NONE = 0,
+    CAPTURE_BOOT,                   // Re-center for the session
+    CAPTURE_CENTER,                 // JOY:CAL, stick at rest
+    CAPTURE_RANGE                   // JOY:CAL, stick being circled
+} capture_t;
+
+// Read in the sample clock interrupt; changed from the main loop with
+// interrupts disabled, or from the interrupt itself when a capture ends
+static joystick_cal_t cal;
+
+static volatile capture_t capture = CAPTURE_NONE;
+static uint32_t capture_scans = 0;
+static uint32_t capture_sum[JOYSTICK_CAL_AXES];
+static uint16_t captured_center[JOYSTICK_CAL_AXES];
+static uint16_t seen_min[JOYSTICK_CAL_AXES];
+static uint16_t seen_max[JOYSTICK_CAL_AXES];
+
+static const char* const capture_names[] = { "off", "boot", "center", "range" };
+
+// Rounded up so the end of each side lands on 32767
+static uint32_t side_scale(uint32_t span) {
+    return ((32767u << 16) + span - 1) / span;
+}
+
+static void compile(joystick_cal_t* target, const joystick_axis_range_t ranges[JOYSTICK_CAL_AXES], uint32_t deadzone) {
+    for (int i = 0; i < JOYSTICK_CAL_AXES; i++) {
+        joystick_axis_range_t range = ranges[i];
+        if (range.max > 65535) range.max = 65535;
+        if (range.center >= range.max) range.center = range.max - 1;
+        if (range.min >= range.center) range.min = range.center - 1;
+
+        axis_cal_t* axis = &target->axis[i];
+        axis->center = (int32_t)range.center;
+        axis->neg_span = range.center - range.min;
+        axis->pos_span = range.max - range.center;
+        axis->neg_scale = side_scale(axis->neg_span);
+        axis->pos_scale = side_scale(axis->pos_span);
+        target->ranges[i] = range;
+    }
+
+    if (deadzone > JOYSTICK_CAL_DEADZONE_MAX) deadzone = JOYSTICK_CAL_DEADZONE_MAX;
+    target->deadzone = deadzone;
+    target->deadzone_sq = deadzone * deadzone;
+    target->gain_scale = ((32767u << 15) + (32767 - deadzone) - 1) / (32767 - deadzone);  // Rounded up: the rim stays 32767
+}
+
+// Offset from the center, clamped to the calibrated travel, as +/-32767
+static int32_t axis_value(const axis_cal_t* axis, uint16_t raw) {
+    int32_t offset = (int32_t)raw - axis->center;
+    if (offset >= 0) {
+        uint32_t distance = (uint32_t)offset;
+        if (distance > axis->pos_span) distance = axis->pos_span;
+        return (int32_t)((distance * axis->pos_scale) >> 16);
+    }
+    uint32_t distance = (uint32_t)-offset;
+    if (distance > axis->neg_span) distance = axis->neg_span;
+    return -(int32_t)((distance * axis->neg_scale) >> 16);
+}
+
+// Bit-by-bit integer square root: 16 iterations for any 32-bit input
+static uint32_t isqrt(uint32_t value) {
+    uint32_t root = 0;
+    for (uint32_t bit = 1u << 30; bit != 0; bit >>= 2) {
+        if (value >= root + bit) {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+    }
+    return root;
+}
+
+static int16_t clamp_stick(int32_t value) {
+    if (value > 32767) return 32767;
+    if (value < -32767) return -32767;
+    return (int16_t)value;
+}
+
+//--------------------------------------------------------------------+
+// CAPTURE
+//--------------------------------------------------------------------+
+static void capture_start(capture_t kind) {
+    capture_scans = 0;
+    memset(capture_sum, 0, sizeof(capture_sum));
+    capture = kind;
+}
+
+static void capture_center_done(void) {
+    for (int i = 0; i < JOYSTICK_CAL_AXES; i++) {
+        captured_center[i] = (uint16_t)(capture_sum[i] / JOYSTICK_CAL_BOOT_SCANS);
+    }
+
+    if (capture == CAPTURE_CENTER) {
+        for (int i = 0; i < JOYSTICK_CAL_AXES; i++) {
+            seen_min[i] = captured_center[i];
+            seen_max[i] = captured_center[i];
+        }
+        capture = CAPTURE_RANGE;
+        return;
+    }
+
+    // Boot: only a stick that is plausibly at rest moves the center
+    joystick_axis_range_t ranges[JOYSTICK_CAL_AXES];
+    memcpy(ranges, cal.ranges, sizeof(ranges));
+    for (int i = 0; i < JOYSTICK_CAL_AXES; i++) {
+        uint32_t stored = ranges[i].center;
+        uint32_t drift = captured_center[i] > stored ? captured_center[i] - stored : stored - captured_center[i];
+        if (drift > JOYSTICK_CAL_BOOT_TOLERANCE) {
+            capture = CAPTURE_NONE;
+            return;
+        }
+        ranges[i].center = captured_center[i];
+    }
+    compile(&cal, ranges, cal.deadzone);
+    capture = CAPTURE_NONE;
+}
+
+static void capture_sample(const uint16_t raw[JOYSTICK_CAL_AXES]) {
+    if (capture == CAPTURE_RANGE) {
+        for (int i = 0; i < JOYSTICK_CAL_AXES; i++) {
+            if (raw[i] < seen_min[i]) seen_min[i] = raw[i];
+            if (raw[i] > seen_max[i]) seen_max[i] = raw[i];
+        }
+        return;
+    }
+
+    capture_scans++;
+    if (capture_scans <= JOYSTICK_CAL_BOOT_SKIP) return;
+    for (int i = 0; i < JOYSTICK_CAL_AXES; i++) {
+        capture_sum[i] += raw[i];
+    }
+    if (capture_scans == JOYSTICK_CAL_BOOT_SKIP + JOYSTICK_CAL_BOOT_SCANS) {
+        capture_center_done();
+    }
+}
+
+//--------------------------------------------------------------------+
+// CALIBRATION
+//--------------------------------------------------------------------+
+void joystick_cal_set(const joystick_axis_range_t ranges[JOYSTICK_CAL_AXES], uint32_t deadzone) {
+    joystick_cal_t next;
+    compile(&next, ranges, deadzone);
+
+    uint32_t interrupts = save_and_disable_interrupts();
+    cal = next;
+    capture = CAPTURE_NONE;
+    restore_interrupts(interrupts);
+}
+
+void joystick_cal_load(const config_t* config) {
+    const joystick_axis_range_t ranges[JOYSTICK_CAL_AXES] = {
+        { config->joystick_x_center, config->joystick_x_min, config->joystick_x_max },
+        { config->joystick_y_center, config->joystick_y_min, config->joystick_y_max },
+    };
+    joystick_cal_set(ranges, config->joystick_deadzone);
+}
+
+void joystick_cal_boot_capture(void) {
+    uint32_t interrupts = save_and_disable_interrupts();
+    capture_start(CAPTURE_BOOT);
+    restore_interrupts(interrupts);
+}
+
+void joystick_cal_apply(uint16_t raw_x, uint16_t raw_y, int16_t* x, int16_t* y) {
+    if (capture != CAPTURE_NONE) {
+        const uint16_t raw[JOYSTICK_CAL_AXES] = { raw_x, raw_y };
+        capture_sample(raw);
+    }
+
+    int32_t vx = axis_value(&cal.axis[0], raw_x);
+    int32_t vy = axis_value(&cal.axis[1], raw_y);
+
+    // |v| <= 32767 per axis, so the squared length fits in 31 bits
+    uint32_t length_sq = (uint32_t)(vx * vx) + (uint32_t)(vy * vy);
+    if (length_sq <= cal.deadzone_sq) {
+        *x = 0;
+        *y = 0;
+        return;
+    }
+
+    // (length - deadzone) <= 46341 and gain_scale <= 65534: fits in 32 bits
+    uint32_t length = isqrt(length_sq);
+    int32_t gain = (int32_t)(((length - cal.deadzone) * cal.gain_scale) / length);
+    *x = clamp_stick((vx * gain) >> 15);
+    *y = clamp_stick((vy * gain) >> 15);
+}
+
+//--------------------------------------------------------------------+
+// COMMAND CALIBRATION
+//--------------------------------------------------------------------+
+void joystick_cal_auto_start(void) {
+    uint32_t interrupts = save_and_disable_interrupts();
+    capture_start(CAPTURE_CENTER);
+    restore_interrupts(interrupts);
+}
+
+bool joystick_cal_auto_active(void) {
+    return capture == CAPTURE_CENTER || capture == CAPTURE_RANGE;
+}
+
+bool joystick_cal_auto_finish(joystick_axis_range_t ranges[JOYSTICK_CAL_AXES]) {
+    uint32_t interrupts = save_and_disable_interrupts();
+    bool enough = (capture == CAPTURE_RANGE);
+    for (int i = 0; enough && i < JOYSTICK_CAL_AXES; i++) {
+        uint32_t center = captured_center[i];
+        if (center - seen_min[i] < JOYSTICK_CAL_MIN_SPAN || seen_max[i] - center < JOYSTICK_CAL_MIN_SPAN) {
+            enough = false;
+            break;
+        }
+        ranges[i].center = center;
+        ranges[i].min = seen_min[i] + (center - seen_min[i]) / JOYSTICK_CAL_MARGIN_DIV;
+        ranges[i].max = seen_max[i] - (seen_max[i] - center) / JOYSTICK_CAL_MARGIN_DIV;
+    }
+    if (joystick_cal_auto_active()) capture = CAPTURE_NONE;
+    restore_interrupts(interrupts);
+    return enough;
+}
+
+void joystick_cal_auto_cancel(void) {
+    uint32_t interrupts = save_and_disable_interrupts();
+    if (joystick_cal_auto_active()) capture = CAPTURE_NONE;
+    restore_interrupts(interrupts);
+}
+
+uint32_t joystick_cal_format_report(char* out, uint32_t size) {
+    const joystick_axis_range_t* x = &cal.ranges[0];
+    const joystick_axis_range_t* y = &cal.ranges[1];
+    int length = snprintf(out, size,
+                          "JOY x center %lu min %lu max %lu y center %lu min %lu max %lu deadzone %lu cal %s\n",
+                          (unsigned long)x->center, (unsigned long)x->min, (unsigned long)x->max,
+                          (unsigned long)y->center, (unsigned long)y->min, (unsigned long)y->max,
+                          (unsigned long)cal.deadzone, capture_names[capture]);
+    return (length < (int)size) ? (uint32_t)length : size - 1;
+}
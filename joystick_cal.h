@@ -0,0 +1,74 @@
+#ifndef JOYSTICK_CAL_H
+#define JOYSTICK_CAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Joystick calibration and radial deadzone.
+//
+// Each axis has a center, min and max in 16-bit oversampled ADC units
+// (joystick_x_center... in config.json). Either side of the center is
+// compiled into its own Q16 scale so the travel on that side reaches
+// +/-32767 whatever the stick's offset:
+//   v = clamp(raw - center, min - center, max - center) * scale >> 16
+//
+// The deadzone is radial: with r = |(x, y)|, anything inside r <= deadzone
+// is 0, and outside it the vector keeps its direction while its length is
+// rescaled so the edge of the deadzone is 0 and the rim is still 32767:
+//   gain = (r - deadzone) / r * 32767 / (32767 - deadzone)
+// All of it is integer: one bit-by-bit square root (16 fixed steps) and one
+// 32-bit divide per scan, so the cost is bounded whatever the input.
+//
+// Centering: at boot the stick is assumed to be at rest; the mean of
+// JOYSTICK_CAL_BOOT_SCANS scans replaces the stored center for the session
+// if it lies within JOYSTICK_CAL_BOOT_TOLERANCE of it (otherwise someone
+// is holding the stick and the stored center stays). The "JOY:CAL" command
+// captures the center the same way and then tracks the extremes while the
+// stick is circled; "JOY:SAVE" stores the result in config.json.
+
+#define JOYSTICK_CAL_AXES           2
+#define JOYSTICK_CAL_DEFAULT_CENTER 32768
+#define JOYSTICK_CAL_DEFAULT_MIN    0
+#define JOYSTICK_CAL_DEFAULT_MAX    65520    // Full-scale oversampled reading
+#define JOYSTICK_CAL_DEFAULT_DEADZONE 2048   // ~6% of full deflection
+#define JOYSTICK_CAL_DEADZONE_MAX   16383    // Half the radius
+#define JOYSTICK_CAL_MIN_SPAN       4096     // Travel required on each side of the center
+#define JOYSTICK_CAL_MARGIN_DIV     32       // Saved ends pulled in by 1/32 of their side
+#define JOYSTICK_CAL_BOOT_SKIP      16       // Scans while the oversampling window fills
+#define JOYSTICK_CAL_BOOT_SCANS     64
+#define JOYSTICK_CAL_BOOT_TOLERANCE 4096
+#define JOYSTICK_CAL_REPORT_MAX     192
+
+typedef struct {
+    uint32_t center;
+    uint32_t min;
+    uint32_t max;
+} joystick_axis_range_t;
+
+// Calibration functions
+void joystick_cal_set(const joystick_axis_range_t ranges[JOYSTICK_CAL_AXES], uint32_t deadzone);
+void joystick_cal_load(const config_t* config);
+void joystick_cal_boot_capture(void);   // Re-center from the next scans, session only
+
+// Raw oversampled axes (0-65520) to calibrated, deadzoned stick values
+void joystick_cal_apply(uint16_t raw_x, uint16_t raw_y, int16_t* x, int16_t* y);
+
+// Command calibration
+void joystick_cal_auto_start(void);
+bool joystick_cal_auto_active(void);
+bool joystick_cal_auto_finish(joystick_axis_range_t ranges[JOYSTICK_CAL_AXES]);  // false: not enough travel seen
+void joystick_cal_auto_cancel(void);
+
+// Render the text report ("JOY" command), returns its length
+uint32_t joystick_cal_format_report(char* out, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // JOYSTICK_CAL_H
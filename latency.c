@@ -0,0 +1,178 @@
+#include "latency.h"
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "hardware/sync.h"
+#include <stdio.h>
+#include <string.h>
+
+#define LATENCY_MAX_PINS    30
+#define LATENCY_NO_CLASS    0xFF
+
+typedef enum {
+    TRACE_IDLE = 0,
+    TRACE_EDGE,         // Pin edge seen, not yet confirmed by a scan
+    TRACE_CONFIRMED,    // Scan saw the change, waiting for a report
+    TRACE_BUILT         // In a submitted report, waiting for completion
+} trace_state_t;
+
+typedef struct {
+    volatile uint8_t state;
+    volatile uint32_t edge_us;
+    uint32_t built_us;
+
+    uint32_t count;
+    uint32_t max_us;
+    uint32_t window_pos;
+    uint32_t e2e_us[LATENCY_WINDOW];
+    uint32_t build_us[LATENCY_WINDOW];
+} latency_trace_t;
+
+static latency_trace_t traces[LATENCY_CLASS_COUNT];
+static uint8_t pin_class[LATENCY_MAX_PINS];
+
+static const char* const class_names[LATENCY_CLASS_COUNT] = {
+    "fret",
+    "strum",
+    "dpad",
+    "button",
+    "tilt",
+};
+
+//--------------------------------------------------------------------+
+// TRACING
+//--------------------------------------------------------------------+
+static void latency_gpio_irq(uint gpio, uint32_t events) {
+    (void)events;
+    if (gpio >= LATENCY_MAX_PINS || pin_class[gpio] == LATENCY_NO_CLASS) {
+        return;
+    }
+
+    // First edge wins until the change has been reported
+    latency_trace_t* trace = &traces[pin_class[gpio]];
+    if (trace->state == TRACE_IDLE) {
+        trace->edge_us = time_us_32();
+        trace->state = TRACE_EDGE;
+    }
+}
+
+void latency_init(void) {
+    memset(pin_class, LATENCY_NO_CLASS, sizeof(pin_class));
+    latency_reset();
+}
+
+void latency_reset(void) {
+    uint32_t interrupts = save_and_disable_interrupts();
+    memset(traces, 0, sizeof(traces));
+    restore_interrupts(interrupts);
+}
+
+void latency_watch_pin(uint32_t pin, latency_class_t input_class) {
+    if (pin >= LATENCY_MAX_PINS || input_class >= LATENCY_CLASS_COUNT) {
+        return;
+    }
+    pin_class[pin] = (uint8_t)input_class;
+    gpio_set_irq_enabled_with_callback(pin, GPIO_IRQ_EDGE_FALL | GPIO_IRQ_EDGE_RISE, true, &latency_gpio_irq);
+}
+
+void latency_input_changed(latency_class_t input_class, uint32_t now_us) {
+    latency_trace_t* trace = &traces[input_class];
+
+    uint32_t interrupts = save_and_disable_interrupts();
+    if (trace->state == TRACE_IDLE) {
+        trace->edge_us = now_us;    // No pin IRQ, sample time is the best we know
+        trace->state = TRACE_CONFIRMED;
+    } else if (trace->state == TRACE_EDGE) {
+        trace->state = TRACE_CONFIRMED;
+    }
+    restore_interrupts(interrupts);
+}
+
+void latency_report_built(uint32_t now_us) {
+    uint32_t interrupts = save_and_disable_interrupts();
+    for (int i = 0; i < LATENCY_CLASS_COUNT; i++) {
+        latency_trace_t* trace = &traces[i];
+        if (trace->state == TRACE_CONFIRMED) {
+            trace->built_us = now_us;
+            trace->state = TRACE_BUILT;
+        } else if (trace->state == TRACE_EDGE && now_us - trace->edge_us > LATENCY_GLITCH_US) {
+            trace->state = TRACE_IDLE;  // Bounce that never became a state change
+        }
+    }
+    restore_interrupts(interrupts);
+}
+
+void latency_report_complete(uint32_t now_us) {
+    for (int i = 0; i < LATENCY_CLASS_COUNT; i++) {
+        latency_trace_t* trace = &traces[i];
+        if (trace->state != TRACE_BUILT) {
+            continue;
+        }
+
+        uint32_t e2e = now_us - trace->edge_us;
+        trace->e2e_us[trace->window_pos] = e2e;
+        trace->build_us[trace->window_pos] = trace->built_us - trace->edge_us;
+        trace->window_pos = (trace->window_pos + 1) % LATENCY_WINDOW;
+        trace->count++;
+        if (e2e > trace->max_us) trace->max_us = e2e;
+
+        trace->state = TRACE_IDLE;
+    }
+}
+
+//--------------------------------------------------------------------+
+// RESULTS
+//--------------------------------------------------------------------+
+bool latency_get_summary(latency_class_t input_class, latency_summary_t* summary) {
+    if (input_class >= LATENCY_CLASS_COUNT) {
+        return false;
+    }
+
+    const latency_trace_t* trace = &traces[input_class];
+    uint32_t samples = trace->count < LATENCY_WINDOW ? trace->count : LATENCY_WINDOW;
+
+    memset(summary, 0, sizeof(*summary));
+    summary->count = trace->count;
+    summary->max_us = trace->max_us;
+    if (samples == 0) {
+        return true;
+    }
+
+    // Insertion sort of a copy; only runs on demand
+    uint32_t sorted[LATENCY_WINDOW];
+    uint64_t build_total = 0;
+    for (uint32_t i = 0; i < samples; i++) {
+        uint32_t value = trace->e2e_us[i];
+        uint32_t j = i;
+        while (j > 0 && sorted[j - 1] > value) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = value;
+        build_total += trace->build_us[i];
+    }
+
+    summary->p50_us = sorted[(samples - 1) * 50 / 100];
+    summary->p99_us = sorted[(samples - 1) * 99 / 100];
+    summary->mean_build_us = (uint32_t)(build_total / samples);
+    return true;
+}
+
+const char* latency_get_class_name(latency_class_t input_class) {
+    return (input_class < LATENCY_CLASS_COUNT) ? class_names[input_class] : NULL;
+}
+
+uint32_t latency_format_report(char* out, uint32_t size) {
+    uint32_t pos = snprintf(out, size, "LATENCY class count p50_us p99_us max_us build_us\n");
+
+    for (int i = 0; i < LATENCY_CLASS_COUNT && pos < size; i++) {
+        latency_summary_t summary;
+        latency_get_summary((latency_class_t)i, &summary);
+        pos += snprintf(out + pos, size - pos, "%s %lu %lu %lu %lu %lu\n", class_names[i],
+                        (unsigned long)summary.count, (unsigned long)summary.p50_us,
+                        (unsigned long)summary.p99_us, (unsigned long)summary.max_us,
+                        (unsigned long)summary.mean_build_us);
+    }
+
+    if (pos < size) pos += snprintf(out + pos, size - pos, "END_LATENCY\n");
+    return (pos < size) ? pos : size - 1;
+}
@@ -0,0 +1,66 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// End-to-end input latency tracer.
+//
+// For each input class the tracer follows one change at a time:
+//   edge      first GPIO edge (pin IRQ), or the scan that saw the change
+//   built     the report carrying the change was handed to the USB stack
+//   complete  the IN transfer for that report completed
+// edge -> complete is the end-to-end latency. The last LATENCY_WINDOW
+// samples per class are kept for p50/p99, max is kept since reset.
+
+typedef enum {
+    LATENCY_CLASS_FRET = 0,
+    LATENCY_CLASS_STRUM,
+    LATENCY_CLASS_DPAD,
+    LATENCY_CLASS_BUTTON,       // Start, select, guide
+    LATENCY_CLASS_TILT,
+    LATENCY_CLASS_COUNT
+} latency_class_t;
+
+#define LATENCY_WINDOW          128     // Samples kept per class for percentiles
+#define LATENCY_GLITCH_US       20000   // Unconfirmed edges older than this are dropped
+#define LATENCY_REPORT_MAX      512
+
+typedef struct {
+    uint32_t count;             // Completed measurements since reset
+    uint32_t p50_us;
+    uint32_t p99_us;
+    uint32_t max_us;
+    uint32_t mean_build_us;     // edge -> report built, over the window
+} latency_summary_t;
+
+// Tracer functions
+void latency_init(void);
+void latency_reset(void);
+
+// Timestamp edges on a pin in the GPIO interrupt
+void latency_watch_pin(uint32_t pin, latency_class_t input_class);
+
+// Input scan saw the class change state (uses this time if no edge was seen)
+void latency_input_changed(latency_class_t input_class, uint32_t now_us);
+
+// Report containing the current input state was submitted / its transfer completed
+void latency_report_built(uint32_t now_us);
+void latency_report_complete(uint32_t now_us);
+
+// Results
+bool latency_get_summary(latency_class_t input_class, latency_summary_t* summary);
+const char* latency_get_class_name(latency_class_t input_class);
+
+// Render the text report ("LATENCY" command), returns its length
+uint32_t latency_format_report(char* out, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LATENCY_H
@@ -9,6 +9,26 @@
 #include "config.h"
 #include "config_storage.h"
 #include "file_emulation.h"
+#include "virtual_fs.h"
+#include "binary_protocol.h"
+#include "cdc_tx.h"
+#include "cdc_rx.h"
+#include "event_log.h"
+#include "perf.h"
+#include "latency.h"
+#include "input_trace.h"
+#include "boot_lights.h"
+#include "boot_prof.h"
+#include "sched.h"
+#include "sample_clock.h"
+#include "idle.h"
+#include "adc_stream.h"
+#include "adc_filter.h"
+#include "whammy_cal.h"
+#include "joystick_cal.h"
+#include "response_curve.h"
+#include "remap.h"
+#include "guitar_core.h"
 #include "neopixel.h"
 #include "ws2812.pio.h"
 #include "tusb.h"
@@ -22,7 +42,6 @@
 #include <string.h>
 
 // Global variables
-static config_t device_config;
 static bool neopixel_initialized = false;
 
 //--------------------------------------------------------------------+
@@ -34,34 +53,33 @@ static bool neopixel_initialized = false;
 //--------------------------------------------------------------------+
 // USB MODE SELECTION
 //--------------------------------------------------------------------+
-// USB mode enum (temporary definition until we re-enable interface system)
+// XInput: vendor interface polled by the XInput driver, reports every 8 ms.
+// HID: standard gamepad for hosts and games that mishandle XInput, reports
+// every 1 ms. The mode is usb_mode in config.json (flash); a boot combo, the
+// MODE: command or a new config.json changes it.
 typedef enum {
     USB_MODE_XINPUT = 0,
     USB_MODE_HID = 1
 } usb_mode_enum_t;
 
-// Use the enum from usb_mode_storage.h to avoid conflicts
+static const char* const usb_mode_names[] = { "xinput", "hid" };
+
 static usb_mode_enum_t current_usb_mode = USB_MODE_XINPUT;
+static bool usb_mode_save_pending = false;  // Boot combo changed the mode, save once boot is done
 
-// Forward declarations
-usb_mode_enum_t detect_boot_combo(void);
+#define USB_MODE_SWITCH_DELAY_MS    50      // Lets the reply to MODE: reach the host first
+#define USB_MODE_RECONNECT_MS       50      // Off the bus long enough for the host to see an unplug
+#define XINPUT_REPORT_PERIOD_US     8000
+#define HID_REPORT_PERIOD_US        1000
+#define REPORT_TASK                 0       // main_tasks[] entry of task_report
 
-// Simple flash storage for future use
-#define USB_MODE_FLASH_OFFSET (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE)
+// Forward declarations
+usb_mode_enum_t detect_boot_combo(usb_mode_enum_t saved_mode);
 
 //--------------------------------------------------------------------+
-// XINPUT REPORT STRUCTURE (EXACT COPY FROM WORKING VERSION)
+// XINPUT REPORT STRUCTURE
 //--------------------------------------------------------------------+
-typedef struct {
-    uint16_t buttons;        // Digital buttons
-    uint8_t lt;              // Left trigger
-    uint8_t rt;              // Right trigger
-    int16_t lx;              // Left stick X
-    int16_t ly;              // Left stick Y
-    int16_t rx;              // Right stick X
-    int16_t ry;              // Right stick Y
-    uint8_t reserved[6];     // Reserved
-} __attribute__((packed)) xinput_report_t;
+typedef guitar_core::xinput_gamepad_t xinput_report_t;
 
 // XInput button bit masks (EXACT COPY FROM WORKING VERSION)
 #define XINPUT_DPAD_UP       0x0001
@@ -112,6 +130,7 @@ enum {
     ITF_NUM_VENDOR = 0,
     ITF_NUM_CDC = 1,
     ITF_NUM_CDC_DATA = 2,
+    ITF_NUM_MSC = 3,
     ITF_NUM_TOTAL
 };
 
@@ -120,8 +139,13 @@ enum {
 #define EPNUM_CDC_NOTIF   0x82
 #define EPNUM_CDC_IN      0x83
 #define EPNUM_CDC_OUT     0x03
+#define EPNUM_MSC_OUT     0x04
+#define EPNUM_MSC_IN      0x84
 
-#define CONFIG_TOTAL_LEN    (TUD_CONFIG_DESC_LEN + 9 + 17 + 7 + 7 + TUD_CDC_DESC_LEN)
+// Interface + XInput class descriptor (0x21) + IN and OUT endpoints
+#define XINPUT_CLASS_DESC_LEN   17
+#define XINPUT_DESC_LEN     (9 + XINPUT_CLASS_DESC_LEN + 7 + 7)
+#define CONFIG_TOTAL_LEN    (TUD_CONFIG_DESC_LEN + XINPUT_DESC_LEN + TUD_CDC_DESC_LEN + TUD_MSC_DESC_LEN)
 
 uint8_t const desc_configuration[] = {
     // Config descriptor: config number, interface count, string index, total length, attribute, power in mA
@@ -139,7 +163,7 @@ uint8_t const desc_configuration[] = {
     0x00,        // iInterface
 
     // CRITICAL: XInput Unknown Descriptor (0x21) - This is what Microsoft driver looks for!
-    0x11,        // bLength (17 bytes)
+    XINPUT_CLASS_DESC_LEN,  // bLength (17 bytes)
     0x21,        // bDescriptorType (Unknown/Vendor specific)
     0x00, 0x01, 0x01, 0x25, 0x81, 0x14, 0x00, 0x00,
     0x00, 0x00, 0x13, 0x01, 0x08, 0x00, 0x00,
@@ -161,9 +185,15 @@ uint8_t const desc_configuration[] = {
     0x08,        // bInterval (8ms)
 
     // CDC Interface (Control and Data) - temporary for enumeration test
-    TUD_CDC_DESCRIPTOR(ITF_NUM_CDC, 4, EPNUM_CDC_NOTIF, 8, EPNUM_CDC_OUT, EPNUM_CDC_IN, 64)
+    TUD_CDC_DESCRIPTOR(ITF_NUM_CDC, 4, EPNUM_CDC_NOTIF, 8, EPNUM_CDC_OUT, EPNUM_CDC_IN, 64),
+
+    // Mass storage interface - virtual FAT12 drive with the config files
+    TUD_MSC_DESCRIPTOR(ITF_NUM_MSC, 5, EPNUM_MSC_OUT, EPNUM_MSC_IN, 64)
 };
 
+static_assert(sizeof(desc_configuration) == CONFIG_TOTAL_LEN,
+              "CONFIG_TOTAL_LEN does not match desc_configuration");
+
 // String Descriptors  
 char const* string_desc_arr[] = {
     (const char[]){0x09, 0x04}, // 0: Language (English)
@@ -171,26 +201,84 @@ char const* string_desc_arr[] = {
     "Controller (XBOX 360 For Windows)", // 2: Product
     "1234567890ABCDEF",        // 3: Serial number
     "BGG Test Port",           // 4: CDC Interface
+    "BGG Config Drive",        // 5: MSC Interface
 };
 
 //--------------------------------------------------------------------+
-// USB MODE STORAGE (PLACEHOLDER FOR FUTURE)
+// HID MODE DESCRIPTORS
 //--------------------------------------------------------------------+
-void usb_mode_save(usb_mode_enum_t mode) {
-    // Future implementation
-    (void)mode;
+// Own product ID, so the host keeps separate driver bindings for the two modes
+tusb_desc_device_t const desc_device_hid = {
+    .bLength            = sizeof(tusb_desc_device_t),
+    .bDescriptorType    = TUSB_DESC_DEVICE,
+    .bcdUSB             = 0x0110,
+    .bDeviceClass       = 0x00,
+    .bDeviceSubClass    = 0x00,
+    .bDeviceProtocol    = 0x00,
+    .bMaxPacketSize0    = 64,
+    .idVendor           = 0x1234,
+    .idProduct          = 0x5679,
+    .bcdDevice          = 0x0100,
+    .iManufacturer      = 1,
+    .iProduct           = 2,
+    .iSerialNumber      = 3,
+    .bNumConfigurations = 1
+};
+
+// X Y Z Rz Rx Ry, hat switch D-pad, 32 buttons (guitar_core::hid_gamepad_t)
+uint8_t const desc_hid_report[] = {
+    TUD_HID_REPORT_DESC_GAMEPAD()
+};
+
+#define ITF_NUM_HID         ITF_NUM_VENDOR  // The gamepad takes the XInput interface's place
+#define EPNUM_HID_IN        0x81
+#define HID_CONFIG_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_HID_DESC_LEN + TUD_CDC_DESC_LEN + TUD_MSC_DESC_LEN)
+
+uint8_t const desc_configuration_hid[] = {
+    TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, HID_CONFIG_TOTAL_LEN, 0x80, 500),
+
+    // Gamepad, polled every 1 ms (bInterval 1)
+    TUD_HID_DESCRIPTOR(ITF_NUM_HID, 0, HID_ITF_PROTOCOL_NONE, sizeof(desc_hid_report), EPNUM_HID_IN,
+                       CFG_TUD_HID_EP_BUFSIZE, 1),
+
+    // Same config port and drive as in XInput mode
+    TUD_CDC_DESCRIPTOR(ITF_NUM_CDC, 4, EPNUM_CDC_NOTIF, 8, EPNUM_CDC_OUT, EPNUM_CDC_IN, 64),
+    TUD_MSC_DESCRIPTOR(ITF_NUM_MSC, 5, EPNUM_MSC_OUT, EPNUM_MSC_IN, 64)
+};
+
+static_assert(sizeof(desc_configuration_hid) == HID_CONFIG_TOTAL_LEN,
+              "HID_CONFIG_TOTAL_LEN does not match desc_configuration_hid");
+
+char const* hid_string_desc_arr[] = {
+    (const char[]){0x09, 0x04}, // 0: Language (English)
+    "BumbleGum Guitars",        // 1: Manufacturer
+    "BGG Guitar Controller",    // 2: Product
+    "1234567890ABCDEF",        // 3: Serial number
+    "BGG Test Port",           // 4: CDC Interface
+    "BGG Config Drive",        // 5: MSC Interface
+};
+
+static_assert(sizeof(hid_string_desc_arr) == sizeof(string_desc_arr),
+              "hid_string_desc_arr and string_desc_arr must have the same indexes");
+
+//--------------------------------------------------------------------+
+// USB MODE STORAGE
+//--------------------------------------------------------------------+
+// Saved with the rest of the configuration (usb_mode in config.json)
+bool usb_mode_save(usb_mode_enum_t mode) {
+    return config_set_usb_mode(usb_mode_names[mode]);
 }
 
 usb_mode_enum_t usb_mode_load(void) {
-    // For now, use boot combo detection - later can add flash storage
-    return detect_boot_combo();
+    const char* mode = config_get_current()->usb_mode;
+    return (mode && strcmp(mode, usb_mode_names[USB_MODE_HID]) == 0) ? USB_MODE_HID : USB_MODE_XINPUT;
 }
 
 //--------------------------------------------------------------------+
 // BOOT COMBO DETECTION
 //--------------------------------------------------------------------+
-usb_mode_enum_t detect_boot_combo(void) {
-    // Check if Green button is pressed at boot for XInput mode (already default)
+usb_mode_enum_t detect_boot_combo(usb_mode_enum_t saved_mode) {
+    // Check if Green button is pressed at boot for XInput mode
     if (!gpio_get(config_get_green_pin())) {
         printf("BOOT COMBO: Green button detected - XInput mode selected\n");
         return USB_MODE_XINPUT;
@@ -202,9 +290,9 @@ usb_mode_enum_t detect_boot_combo(void) {
         return USB_MODE_HID;
     }
     
-    // No combo detected, use default
-    printf("BOOT COMBO: No combo detected - using default XInput mode\n");
-    return USB_MODE_XINPUT;
+    // No combo detected, keep the saved mode
+    printf("BOOT COMBO: No combo detected - using saved %s mode\n", usb_mode_names[saved_mode]);
+    return saved_mode;
 }
 
 //--------------------------------------------------------------------+
@@ -238,13 +326,16 @@ void tud_resume_cb(void) {
 
 // Invoked when received GET DEVICE DESCRIPTOR
 uint8_t const* tud_descriptor_device_cb(void) {
+    if (current_usb_mode == USB_MODE_HID) {
+        return (uint8_t const*) &desc_device_hid;
+    }
     return (uint8_t const*) &desc_device;
 }
 
 // Invoked when received GET CONFIGURATION DESCRIPTOR
 uint8_t const* tud_descriptor_configuration_cb(uint8_t index) {
     (void) index; // for multiple configurations
-    return desc_configuration;
+    return (current_usb_mode == USB_MODE_HID) ? desc_configuration_hid : desc_configuration;
 }
 
 // Invoked when received GET STRING DESCRIPTOR request
@@ -253,11 +344,15 @@ uint16_t const* tud_descriptor_string_cb(uint8_t index, uint16_t langid) {
     
     static uint16_t _desc_str[32];
     uint8_t chr_count;
+    char const* const* strings = (current_usb_mode == USB_MODE_HID) ? hid_string_desc_arr : string_desc_arr;
 
     if (index == 0) {
-        memcpy(&_desc_str[1], string_desc_arr[0], 2);
+        memcpy(&_desc_str[1], strings[0], 2);
         chr_count = 1;
     } else if (index == 0xEE) {
+        // XInput only: without it Windows leaves the HID gamepad to its HID driver
+        if (current_usb_mode == USB_MODE_HID) return NULL;
+
         // Microsoft OS String Descriptor - CRITICAL for XInput recognition!
         static const char msft_os_desc[] = "MSFT100\x01"; // Microsoft OS 1.0, vendor code 0x01
         chr_count = strlen(msft_os_desc);
@@ -270,7 +365,7 @@ uint16_t const* tud_descriptor_string_cb(uint8_t index, uint16_t langid) {
         // Regular string descriptors
         if (!(index < sizeof(string_desc_arr) / sizeof(string_desc_arr[0]))) return NULL;
 
-        const char* str = string_desc_arr[index];
+        const char* str = strings[index];
 
         // Cap at max char
         chr_count = strlen(str);
@@ -370,12 +465,19 @@ void tud_vendor_rx_cb(uint8_t itf) {
     (void) count;
 }
 
+// Invoked when an IN transfer on the vendor endpoint completed
+void tud_vendor_tx_cb(uint8_t itf, uint32_t sent_bytes) {
+    (void) itf;
+    (void) sent_bytes;
+
+    // Input report reached the host: closes the latency measurement
+    latency_report_complete(time_us_32());
+    boot_prof_first_report();
+}
+
 //--------------------------------------------------------------------+
 // CDC (Serial) CALLBACKS for BGG App Compatibility
 //--------------------------------------------------------------------+
-static char cdc_line_buffer[256];
-static uint32_t cdc_line_pos = 0;
-
 // Invoked when cdc when line state changed e.g connected/disconnected
 void tud_cdc_line_state_cb(uint8_t itf, bool dtr, bool rts) {
     (void) itf;
@@ -383,46 +485,15 @@ void tud_cdc_line_state_cb(uint8_t itf, bool dtr, bool rts) {
     
     // DTR = true means terminal connected
     if (dtr) {
-        printf("CDC: Terminal connected\n");
+        LOG_INFO("CDC: Terminal connected\n");
         // Send welcome message
-        tud_cdc_write_str("BGG XInput Firmware v1.0 Ready\n");
-        tud_cdc_write_flush();
+        cdc_tx_write_str("BGG XInput Firmware v1.0 Ready\n");
     } else {
-        printf("CDC: Terminal disconnected\n");
-    }
-}
-
-// Invoked when CDC interface received data from host
-void tud_cdc_rx_cb(uint8_t itf) {
-    (void) itf;
-    
-    char buf[64];
-    uint32_t count = tud_cdc_read(buf, sizeof(buf) - 1);
-    
-    if (count > 0) {
-        buf[count] = '\0';
-        
-        // Process character by character to handle line buffering
-        for (uint32_t i = 0; i < count; i++) {
-            char c = buf[i];
-            
-            if (c == '\n' || c == '\r') {
-                // End of line - process command
-                if (cdc_line_pos > 0) {
-                    cdc_line_buffer[cdc_line_pos] = '\0';
-                    printf("CDC: Received command: %s\n", cdc_line_buffer);
-                    
-                    // Process the command through file emulation
-                    file_emu_process_serial_command(cdc_line_buffer);
-                    
-                    // Reset line buffer
-                    cdc_line_pos = 0;
-                }
-            } else if (cdc_line_pos < sizeof(cdc_line_buffer) - 1) {
-                // Add character to line buffer
-                cdc_line_buffer[cdc_line_pos++] = c;
-            }
-        }
+        LOG_INFO("CDC: Terminal disconnected\n");
+        cdc_rx_reset();
+        cdc_tx_reset();
+        file_emu_serial_reset();
+        bin_proto_reset();
     }
 }
 
@@ -430,6 +501,10 @@ void tud_cdc_rx_cb(uint8_t itf) {
 // GLOBAL VARIABLES
 //--------------------------------------------------------------------+
 static xinput_report_t xinput_report;  // Remove volatile, try different approach
+static guitar_core::hid_gamepad_t hid_report;   // Same scan for the HID gamepad, HID mode only
+static uint32_t analog_age_us = 0;     // Oldest ADC sample in xinput_report when scanned
+static uint32_t analog_scan_us = 0;
+static adc_filter_t whammy_filter, joy_x_filter, joy_y_filter;
 
 // Global button state variables for USB interface system
 static bool green, red, yellow, blue, orange;
@@ -438,6 +513,54 @@ static bool dpad_up, dpad_down, dpad_left, dpad_right;
 static uint16_t whammy_value;
 static int16_t tilt_x, tilt_y;
 
+// Scan-to-report core of this build: config.json pins (guide and tilt wired to GP6 and GP9),
+// tilt debounce, config.json remap table, XInput report
+static guitar_core::guitar<guitar_core::config_pins<6, 9>,
+                           guitar_core::lockout_debounce<1u << REMAP_TILT, 50>,
+                           guitar_core::table_map,
+                           guitar_core::xinput_encoder> guitar;
+
+//--------------------------------------------------------------------+
+// HID CALLBACKS (HID MODE)
+//--------------------------------------------------------------------+
+// Invoked when received GET HID REPORT DESCRIPTOR
+uint8_t const* tud_hid_descriptor_report_cb(uint8_t instance) {
+    (void) instance;
+    return desc_hid_report;
+}
+
+// Invoked when received GET_REPORT control request: the current gamepad state
+uint16_t tud_hid_get_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type,
+                               uint8_t* buffer, uint16_t reqlen) {
+    (void) instance;
+    (void) report_id;
+    if (report_type != HID_REPORT_TYPE_INPUT || reqlen < sizeof(hid_report)) return 0;
+
+    uint32_t saved_interrupts = save_and_disable_interrupts();
+    memcpy(buffer, &hid_report, sizeof(hid_report));
+    restore_interrupts(saved_interrupts);
+    return sizeof(hid_report);
+}
+
+// Invoked when received SET_REPORT control request or OUT data: the gamepad has no outputs
+void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type,
+                           uint8_t const* buffer, uint16_t bufsize) {
+    (void) instance;
+    (void) report_id;
+    (void) report_type;
+    (void) buffer;
+    (void) bufsize;
+}
+
+// Invoked when an input report reached the host: closes the latency measurement
+void tud_hid_report_complete_cb(uint8_t instance, uint8_t const* report, uint16_t len) {
+    (void) instance;
+    (void) report;
+    (void) len;
+    latency_report_complete(time_us_32());
+    boot_prof_first_report();
+}
+
 //--------------------------------------------------------------------+
 // GUITAR HERO BUTTON MAPPING (EXACT FROM WORKING VERSION)
 //--------------------------------------------------------------------+
@@ -446,17 +569,9 @@ void read_guitar_buttons(void) {
     static uint32_t guide_trigger_count = 0;
     static uint32_t last_count_report = 0;
     uint32_t now = time_us_32() / 1000; // Convert to milliseconds
-    
-    // Read digital button states (active LOW with internal pull-ups) using config values
-    green = !gpio_get(config_get_green_pin());
-    red = !gpio_get(config_get_red_pin());
-    yellow = !gpio_get(config_get_yellow_pin());
-    blue = !gpio_get(config_get_blue_pin());
-    orange = !gpio_get(config_get_orange_pin());
-    strum_up = !gpio_get(config_get_strum_up_pin());
-    strum_down = !gpio_get(config_get_strum_down_pin());
-    start = !gpio_get(config_get_start_pin());
-    select = !gpio_get(config_get_select_pin());
+
+    // Raw levels of every pin for the input trace, taken alongside the reads below
+    uint32_t gpio_snapshot = gpio_get_all();
     
     // Initialize GPIO pins for tilt sensor and guide button separately
     static bool extra_gpio_initialized = false;
@@ -483,67 +598,45 @@ void read_guitar_buttons(void) {
         extra_gpio_initialized = true;
     }
     
-    // Read tilt sensor (GPIO 9) with debouncing
-    static uint32_t tilt_debounce_time = 0;
-    static bool tilt_last_state = false;
-    bool tilt_raw = !gpio_get(9);
-    
-    bool tilt_active = tilt_last_state;  // Default to last stable state
-    if (tilt_raw != tilt_last_state) {
-        if (now - tilt_debounce_time > 50) {  // 50ms debounce
-            tilt_active = tilt_raw;
-            tilt_last_state = tilt_raw;
-            tilt_debounce_time = now;
-            printf("Tilt sensor %s\n", tilt_active ? "ACTIVE" : "INACTIVE");
+    // Every control from the one snapshot (active LOW with internal pull-ups), pins from
+    // config.json; the tilt sensor is held for 50 ms after each change
+    uint16_t digital = guitar.read(gpio_snapshot, now);
+    green = digital & (1u << REMAP_GREEN);
+    red = digital & (1u << REMAP_RED);
+    yellow = digital & (1u << REMAP_YELLOW);
+    blue = digital & (1u << REMAP_BLUE);
+    orange = digital & (1u << REMAP_ORANGE);
+    strum_up = digital & (1u << REMAP_STRUM_UP);
+    strum_down = digital & (1u << REMAP_STRUM_DOWN);
+    start = digital & (1u << REMAP_START);
+    select = digital & (1u << REMAP_SELECT);
+    guide = digital & (1u << REMAP_GUIDE);
+    dpad_up = digital & (1u << REMAP_UP);
+    dpad_down = digital & (1u << REMAP_DOWN);
+    dpad_left = digital & (1u << REMAP_LEFT);
+    dpad_right = digital & (1u << REMAP_RIGHT);
+    bool tilt_active = digital & (1u << REMAP_TILT);
+
+    // Tell the latency tracer which input classes changed since the last scan
+    static uint8_t last_state[LATENCY_CLASS_COUNT];
+    uint8_t state[LATENCY_CLASS_COUNT];
+    state[LATENCY_CLASS_FRET] = green | (red << 1) | (yellow << 2) | (blue << 3) | (orange << 4);
+    state[LATENCY_CLASS_STRUM] = strum_up | (strum_down << 1);
+    state[LATENCY_CLASS_DPAD] = dpad_up | (dpad_down << 1) | (dpad_left << 2) | (dpad_right << 3);
+    state[LATENCY_CLASS_BUTTON] = start | (select << 1) | (guide << 2);
+    state[LATENCY_CLASS_TILT] = tilt_active;
+
+    uint32_t now_us = time_us_32();
+    for (int i = 0; i < LATENCY_CLASS_COUNT; i++) {
+        if (state[i] != last_state[i]) {
+            latency_input_changed((latency_class_t)i, now_us);
+            last_state[i] = state[i];
         }
     }
-    
-    // Guide button (GPIO 6) - Back to original simple version that was working
-    guide = !gpio_get(6);
-    
-    // Read all D-Pad inputs independently - no conflicts, just multiple inputs -> same output
-    bool gpio2_pressed = !gpio_get(2);    // GPIO 2 -> HAT UP
-    bool gpio7_pressed = !gpio_get(7);    // GPIO 7 -> HAT UP (independent of strum)
-    bool gpio3_pressed = !gpio_get(3);    // GPIO 3 -> HAT DOWN  
-    bool gpio8_pressed = !gpio_get(8);    // GPIO 8 -> HAT DOWN (independent of strum)
-    
-    dpad_up = !gpio_get(config_get_dpad_up_pin());
-    dpad_down = !gpio_get(config_get_dpad_down_pin());
-    dpad_left = !gpio_get(config_get_dpad_left_pin());
-    dpad_right = !gpio_get(config_get_dpad_right_pin());
 
-    // Map Guitar Hero controls to XInput gamepad - COMPLETELY ZERO TO PREVENT GHOST SIGNALS
-    // COMPLETELY zero out the entire structure to prevent any ghost Guide button signals
-    memset(&xinput_report, 0, sizeof(xinput_report));
-    xinput_report.buttons = 0;  // Explicitly clear buttons
-    
-    // Fret buttons -> Face buttons (EXACT MAPPING FROM WORKING VERSION)
-    if (green) xinput_report.buttons |= XINPUT_A;        // Green -> A (should be Button 1)
-    if (red) xinput_report.buttons |= XINPUT_B;          // Red -> B (should be Button 2) 
-    if (yellow) xinput_report.buttons |= XINPUT_Y;       // Yellow -> Y (should be Button 4)
-    if (blue) xinput_report.buttons |= XINPUT_X;         // Blue -> X (should be Button 3)
-    if (orange) xinput_report.buttons |= XINPUT_LB;      // Orange -> LB (should be Button 5)
-    
-    // Strum bar -> D-Pad mapping for Clone Hero compatibility (EXACT FROM WORKING VERSION)
-    if (strum_up) xinput_report.buttons |= XINPUT_DPAD_UP;      // Strum up -> D-Pad Up
-    if (strum_down) xinput_report.buttons |= XINPUT_DPAD_DOWN;  // Strum down -> D-Pad Down
-    
-    // Control buttons
-    if (start) xinput_report.buttons |= XINPUT_START;    // Start -> Start button
-    
-    // Star Power logic: Only Select button (tilt moved to Right Stick Y-axis)
-    if (select) {
-        xinput_report.buttons |= XINPUT_BACK;    // Select -> Back button (Star Power in games)
-        // Debug removed for simplicity
-    }
-    
+    // Guide presses, counted for the debug report below
     if (guide) {
-        xinput_report.buttons |= XINPUT_GUIDE;    // Guide button (GPIO 6) -> Xbox Guide menu
         guide_trigger_count++;  // Count every frame the guide is active
-        
-        // NO CONSTANT NEOPIXEL UPDATES - only flash on new presses to prevent flickering
-    } else {
-        // NO CONSTANT OFF UPDATES - keep LEDs stable
     }
     
     // DISABLED - No more NeoPixel count reporting to prevent LED corruption
@@ -551,100 +644,108 @@ void read_guitar_buttons(void) {
         last_count_report = now;
         guide_trigger_count = 0;  // Reset counter
     }
-    
-    // Multiple GPIO inputs -> Same HAT directions (completely independent)
-    if (gpio2_pressed || gpio7_pressed) {
-        xinput_report.buttons |= XINPUT_DPAD_UP;        // GPIO 2 OR GPIO 7 -> HAT UP ONLY
-    }
-    if (gpio3_pressed || gpio8_pressed) {
-        xinput_report.buttons |= XINPUT_DPAD_DOWN;      // GPIO 3 OR GPIO 8 -> HAT DOWN ONLY
-    }
-    if (dpad_left) xinput_report.buttons |= XINPUT_DPAD_LEFT;             // GPIO 4 -> HAT LEFT
-    if (dpad_right) xinput_report.buttons |= XINPUT_DPAD_RIGHT;           // GPIO 5 -> HAT RIGHT
-    
-    // Strum bar -> Shoulder buttons (REMOVED - no longer using GPIO 7/8 for strum)
-    // if (strum_up) xinput_report.buttons |= XINPUT_RB;          // DISABLED
-    // if (strum_down) xinput_report.buttons |= XINPUT_LSTICK;    // DISABLED
 
     // Read analog inputs (ADC) - EXACT FROM WORKING VERSION
     // GPIO to ADC mapping: GPIO26=ADC0, GPIO27=ADC1, GPIO28=ADC2, GPIO29=ADC3
     // Use config value for whammy pin - convert GPIO to ADC channel
+    // Oversampled DMA-streamed conversions, no waiting; remember the oldest one's age
+    uint32_t age_us;
     uint8_t whammy_adc_channel = config_get_whammy_pin() - 26; // GPIO27 -> ADC1
-    adc_select_input(whammy_adc_channel);
-    uint16_t whammy_raw = adc_read();
+    uint16_t whammy_16 = adc_filter_apply(&whammy_filter, adc_stream_read_oversampled(whammy_adc_channel, &analog_age_us));
     
-    // Standard Guitar Hero whammy mapping - 8-bit trigger (0-255) - EXACT FROM WORKING VERSION
-    whammy_value = (uint16_t)((whammy_raw * 255UL) / 4095UL);
+    // Calibrated travel (whammy_min/max/reverse) through the response curve, 8-bit for the trigger style users
+    uint16_t whammy_travel = response_curve_apply(RESPONSE_CURVE_WHAMMY, whammy_cal_apply(whammy_16));
+    whammy_value = whammy_travel >> 8;
     
-    adc_select_input(2); // GPIO 28 = ADC channel 2 (Joystick X)
-    uint16_t joy_x_raw = adc_read();
-    int16_t joy_x_value = (int16_t)((joy_x_raw - 2048) * 16); // Convert to signed 16-bit, centered
+    uint16_t joy_x_16 = adc_filter_apply(&joy_x_filter, adc_stream_read_oversampled(2, &age_us)); // GPIO 28 = ADC channel 2 (Joystick X)
+    if (age_us > analog_age_us) analog_age_us = age_us;
     
-    adc_select_input(3); // GPIO 29 = ADC channel 3 (Joystick Y)
-    uint16_t joy_y_raw = adc_read();
-    int16_t joy_y_value = (int16_t)((joy_y_raw - 2048) * 16); // Convert to signed 16-bit, centered
-
-    // Standard Guitar Hero controller mapping - UPDATED FOR TILT/WHAMMY ON RIGHT STICK
-    xinput_report.lt = 0;                                 // Left trigger -> unused
-    xinput_report.rt = 0;                                 // Right trigger -> unused (whammy moved to stick)
-    xinput_report.lx = joy_x_value;                       // Left stick X -> Joystick X
-    xinput_report.ly = joy_y_value;                       // Left stick Y -> Joystick Y  
-    
-    // Right stick mapping - NEW!
-    // Whammy bar -> Right stick X-axis (0-255 mapped to -32768 to 32767)
-    int16_t whammy_stick_value = (int16_t)((whammy_value * 65535UL) / 255UL) - 32768;
-    xinput_report.rx = whammy_stick_value;                // Right stick X -> Whammy bar
-    tilt_x = whammy_stick_value;                          // For USB interface system
-    
-    // Tilt sensor -> Right stick Y-axis (INVERTED: 0=on, 255=off)
-    int16_t tilt_stick_value = tilt_active ? -32768 : 32767;
-    xinput_report.ry = tilt_stick_value;                  // Right stick Y -> Tilt sensor (inverted: 0% when tilted, 100% when not tilted)
-    tilt_y = tilt_stick_value;                            // For USB interface system
+    uint16_t joy_y_16 = adc_filter_apply(&joy_y_filter, adc_stream_read_oversampled(3, &age_us)); // GPIO 29 = ADC channel 3 (Joystick Y)
+    if (age_us > analog_age_us) analog_age_us = age_us;
+
+    // Calibrated center and range, radial deadzone; signed 16-bit
+    int16_t joy_x_value, joy_y_value;
+    joystick_cal_apply(joy_x_16, joy_y_16, &joy_x_value, &joy_y_value);
+    joy_x_value = response_curve_apply_signed(RESPONSE_CURVE_JOY_X, joy_x_value);
+    joy_y_value = response_curve_apply_signed(RESPONSE_CURVE_JOY_Y, joy_y_value);
+    analog_age_us += adc_filter_get_delay_scans() * sample_clock_get_period();
+    analog_scan_us = now_us;
+
+    // The status LED is an output; its blinking is not an input change
+    input_trace_sample(now_us, gpio_snapshot & ~(1u << BOOT_LIGHTS_STATUS_PIN), whammy_16 >> 4, joy_x_16 >> 4, joy_y_16 >> 4);
+
+    // Controls -> XInput through the compiled remap table (config.json *_map, hat_mode).
+    // Default: frets on A/B/Y/X/LB, strum and d-pad on the d-pad, whammy on right stick X,
+    // tilt swinging right stick Y (+32767 level, -32768 tilted)
+    remap_output_t mapped = guitar.build(digital, (int16_t)(whammy_travel - 32768), joy_x_value, joy_y_value,
+                                         &xinput_report);
+    if (current_usb_mode == USB_MODE_HID) {
+        guitar_core::hid_gamepad_encoder::encode(mapped, &hid_report);
+    }
+    tilt_x = mapped.rx;                                   // For USB interface system
+    tilt_y = mapped.ry;
+}
+
+// Holding Start + Select for 3 seconds arms the input trace, or stops it if armed
+static void check_trace_combo(void) {
+    static uint32_t held_since_ms = 0;
+    static bool toggled = false;
+
+    if (!(start && select)) {
+        held_since_ms = 0;
+        toggled = false;
+        return;
+    }
+
+    uint32_t now_ms = board_millis();
+    if (held_since_ms == 0) {
+        held_since_ms = now_ms;
+    } else if (!toggled && now_ms - held_since_ms >= 3000) {
+        if (input_trace_is_armed()) {
+            input_trace_stop();
+            LOG_INFO("Trace: Stopped\n");
+        } else {
+            input_trace_arm();
+            LOG_INFO("Trace: Armed\n");
+        }
+        toggled = true;
+    }
 }
 
 //--------------------------------------------------------------------+
-// MAIN FUNCTIONS
+// BOOT PHASES
 //--------------------------------------------------------------------+
-int main(void) {
-    board_init();
+static void init_diagnostics(void) {
+    // Deferred logging first so every later module can use it
+    event_log_init();
+    perf_init();
+    latency_init();
+    input_trace_init();
+}
 
-    // Initialize configuration system
+static void init_config(void) {
+    // Storage check, flash load (or defaults) and JSON parse, all in one place
     config_init();
-    
-    // Initialize config storage system
-    config_storage_init();
-    
-    // Load device configuration from flash
-    if (!config_storage_load_from_flash(&device_config)) {
-        printf("Warning: Failed to load config from flash, using defaults\n");
-        // Config should still be valid from config_init()
-    }
-    
+}
+
+static void init_files(void) {
     // Initialize file emulation for BGG app compatibility
     file_emu_init();
+}
 
-    // MOVE NeoPixel initialization AFTER USB to prevent interference
-    // neopixel_init(&device_config);
-    // neopixel_initialized = true;
-    // printf("NeoPixel initialized successfully\n");
-    
-    // MOVE NeoPixel test sequence AFTER USB to prevent interference
-    // printf("Running NeoPixel test sequence...\n");
-    // neopixel_test();
-    // printf("NeoPixel test sequence complete\n");
-
-    // Initialize built-in LED for status indication
-    gpio_init(25);  // Built-in LED (PIN 25)
-    gpio_set_dir(25, GPIO_OUT);
-    
-    // Flash LED to indicate startup
-    for (int i = 0; i < 5; i++) {
-        gpio_put(25, 1);  // Built-in LED
-        sleep_ms(100);
-        gpio_put(25, 0);
-        sleep_ms(100);
-    }
+static void init_drive(void) {
+    // Expose the same files as a USB drive
+    vfs_init();
+}
+
+static void init_protocol(void) {
+    // Framed binary protocol alongside the text commands
+    cdc_rx_init();
+    cdc_tx_init();
+    bin_proto_init();
+}
 
+static void init_inputs(void) {
     // Initialize GPIO pins with pull-ups using config values - EXACT FROM WORKING VERSION
     // Fret buttons
     gpio_init(config_get_green_pin());
@@ -702,143 +803,330 @@ int main(void) {
     gpio_set_dir(config_get_dpad_right_pin(), GPIO_IN);
     gpio_pull_up(config_get_dpad_right_pin());
 
+    // Timestamp the first edge of every input change for the latency tracer
+    latency_watch_pin(config_get_green_pin(), LATENCY_CLASS_FRET);
+    latency_watch_pin(config_get_red_pin(), LATENCY_CLASS_FRET);
+    latency_watch_pin(config_get_yellow_pin(), LATENCY_CLASS_FRET);
+    latency_watch_pin(config_get_blue_pin(), LATENCY_CLASS_FRET);
+    latency_watch_pin(config_get_orange_pin(), LATENCY_CLASS_FRET);
+    latency_watch_pin(config_get_strum_up_pin(), LATENCY_CLASS_STRUM);
+    latency_watch_pin(config_get_strum_down_pin(), LATENCY_CLASS_STRUM);
+    latency_watch_pin(config_get_dpad_up_pin(), LATENCY_CLASS_DPAD);
+    latency_watch_pin(config_get_dpad_down_pin(), LATENCY_CLASS_DPAD);
+    latency_watch_pin(config_get_dpad_left_pin(), LATENCY_CLASS_DPAD);
+    latency_watch_pin(config_get_dpad_right_pin(), LATENCY_CLASS_DPAD);
+    latency_watch_pin(config_get_start_pin(), LATENCY_CLASS_BUTTON);
+    latency_watch_pin(config_get_select_pin(), LATENCY_CLASS_BUTTON);
+    latency_watch_pin(6, LATENCY_CLASS_BUTTON);     // Guide
+    latency_watch_pin(9, LATENCY_CLASS_TILT);
+
     // Initialize ADC for analog inputs using config values - EXACT FROM WORKING VERSION
     adc_init();
     adc_gpio_init(config_get_whammy_pin());   // Whammy bar
     adc_gpio_init(config_get_joystick_x_pin());    // Joystick X
     adc_gpio_init(config_get_joystick_y_pin());    // Joystick Y
+    adc_stream_start();
 
-    // Detect boot combo for initial USB mode
-    current_usb_mode = detect_boot_combo();
+    // The stick should be at rest while powering up: take its center from the first scans
+    joystick_cal_boot_capture();
+}
 
-    // TODO: Re-enable USB interface system when issues are fixed
-    // printf("Initializing USB interface for mode: %s\n", 
-    //        current_usb_mode == USB_MODE_HID ? "HID" : "XInput");
-    // usb_interface_init((usb_mode_enum_t)current_usb_mode);
+static void init_usb(void) {
+    // Saved mode, unless a boot combo picks one; flash is written once boot is done
+    usb_mode_enum_t saved_mode = usb_mode_load();
+    current_usb_mode = detect_boot_combo(saved_mode);
+    usb_mode_save_pending = current_usb_mode != saved_mode;
+    printf("Initializing USB interface for mode: %s\n", usb_mode_names[current_usb_mode]);
 
-    // Initialize XInput report structure
+    // Initialize report structures
     memset(&xinput_report, 0, sizeof(xinput_report));
+    memset(&hid_report, 0, sizeof(hid_report));
 
-    // Initialize TinyUSB
+    // Initialize TinyUSB; enumeration proceeds from the first tud_task()
     tusb_init();
     
     // Initialize stdio for debug output (this enables serial console)
     stdio_init_all();
-    sleep_ms(2000);  // Give time for USB to enumerate before sending debug output
-    
-    // NOW initialize NeoPixels AFTER USB to prevent PIO conflicts
-    printf("Initializing NeoPixels after USB...\n");
-    neopixel_init(&device_config);
+}
+
+static void init_leds(void) {
+    // NeoPixels after USB to prevent PIO conflicts
+    neopixel_init(config_get_current());
     neopixel_initialized = true;
-    printf("NeoPixel initialized successfully after USB\n");
+
+    // Boot light show plays from the main loop instead of sleeping here
+    boot_lights_start(current_usb_mode == USB_MODE_XINPUT, board_millis());
+}
+
+// Boot order. Config goes first on core 0: on first boot (or a bad load) it
+// saves defaults to flash, and core 1 is only launched once it is done.
+// Core 1 then takes the file scans and protocol setup while core 0 sets up
+// the pins, USB and LEDs; neither writes flash until boot is over.
+enum {
+    BOOT_DIAGNOSTICS = 0,
+    BOOT_CONFIG,
+    BOOT_FILES,
+    BOOT_DRIVE,
+    BOOT_PROTOCOL,
+    BOOT_INPUTS,
+    BOOT_USB,
+    BOOT_LEDS,
+    BOOT_PHASE_COUNT
+};
+
+static const boot_phase_t boot_phases[BOOT_PHASE_COUNT] = {
+    { "diagnostics", init_diagnostics, 0, 0 },
+    { "config", init_config, BOOT_DEP(BOOT_DIAGNOSTICS), 0 },
+    { "files", init_files, BOOT_DEP(BOOT_CONFIG), 1 },
+    { "drive", init_drive, BOOT_DEP(BOOT_FILES), 1 },
+    { "protocol", init_protocol, BOOT_DEP(BOOT_CONFIG), 1 },
+    { "inputs", init_inputs, BOOT_DEP(BOOT_CONFIG), 0 },
+    { "usb", init_usb, BOOT_DEP(BOOT_INPUTS), 0 },
+    { "leds", init_leds, BOOT_DEP(BOOT_CONFIG) | BOOT_DEP(BOOT_USB), 0 },
+};
+
+//--------------------------------------------------------------------+
+// MAIN LOOP TASKS
+//--------------------------------------------------------------------+
+// Sample clock tick, in the timer alarm interrupt: one input scan per period
+static void sample_inputs(uint32_t now_us) {
+    (void)now_us;
+
+    // Read guitar buttons and controls
+    PERF_BEGIN(PERF_STAGE_INPUT);
+    read_guitar_buttons();
+    check_trace_combo();
+    PERF_END(PERF_STAGE_INPUT);
+}
+
+// HID mode: the gamepad report built by the last scan, on every 1 ms frame
+static bool task_hid_report(void) {
+    if (!tud_mounted()) {
+        return true;  // Nothing to send this period
+    }
+    if (!tud_hid_ready()) {
+        return false;  // Endpoint still busy, retry on the next pass
+    }
+
+    PERF_BEGIN(PERF_STAGE_REPORT);
+
+    uint32_t saved_interrupts = save_and_disable_interrupts();
+    guitar_core::hid_gamepad_t report = hid_report;
+    uint32_t sample_age_us = analog_age_us;
+    uint32_t scan_us = analog_scan_us;
+    // Same critical section as the snapshot: a scan landing in between would
+    // have its confirmed change timed against a report that does not hold it
+    uint32_t built_us = time_us_32();
+    latency_report_built(built_us);
+    restore_interrupts(saved_interrupts);
+
+    adc_stream_report_built(sample_age_us + (built_us - scan_us));
+    tud_hid_report(0, &report, sizeof(report));
+
+    PERF_END(PERF_STAGE_REPORT);
+    return true;
+}
+
+static bool task_report(void) {
+    if (current_usb_mode == USB_MODE_HID) {
+        return task_hid_report();
+    }
+
+    if (!tud_vendor_mounted()) {
+        return true;  // Nothing to send this period
+    }
+    if (tud_vendor_write_available() < sizeof(xinput_report) + 2) {
+        return false;  // Endpoint still busy, retry on the next pass
+    }
+
+    PERF_BEGIN(PERF_STAGE_REPORT);
+
+    // CRITICAL: Disable all interrupts during packet creation to prevent corruption
+    uint32_t saved_interrupts = save_and_disable_interrupts();
+    
+    // Send XInput input report (20 bytes data + 2 byte header = 22 bytes total)
+    uint8_t report_packet[22];
+    memset(report_packet, 0, sizeof(report_packet));  // CRITICAL: Clear all garbage data
     
-    // Run NeoPixel test sequence
-    printf("Running NeoPixel test sequence...\n");
-    neopixel_test();
-    printf("NeoPixel test sequence complete\n");
+    report_packet[0] = 0x00; // Message type: input report
+    report_packet[1] = 0x14; // Report size: 20 bytes
     
-    // Initialize NeoPixels for debugging random menu popups - DISABLED to prevent white LED issues
-    // neopixel_init();
-    // neopixel_set_all(RGB_GREEN);    // Green = System Ready  
-    // sleep_ms(1000);
-    // neopixel_set_all(RGB_OFF);
+    // Copy the XInput report data (20 bytes) with interrupts disabled
+    memcpy(&report_packet[2], (void*)&xinput_report, sizeof(xinput_report));
+    uint32_t sample_age_us = analog_age_us;
+    uint32_t scan_us = analog_scan_us;
+    uint32_t built_us = time_us_32();
+    latency_report_built(built_us);  // With the snapshot, see task_hid_report()
     
-    // Flash LED pattern to indicate boot combo detected
-    if (current_usb_mode == USB_MODE_XINPUT) {
-        // XInput mode: 2 long flashes (like Xbox button) 
-        for (int i = 0; i < 2; i++) {
-            gpio_put(25, 1);  // Built-in LED
-            sleep_ms(500);    // Long flash
-            gpio_put(25, 0);
-            sleep_ms(500);
+    // Re-enable interrupts before USB write
+    restore_interrupts(saved_interrupts);
+
+    adc_stream_report_built(sample_age_us + (built_us - scan_us));
+    tud_vendor_write(report_packet, sizeof(report_packet));
+    tud_vendor_write_flush();
+
+    PERF_END(PERF_STAGE_REPORT);
+    return true;
+}
+
+static bool task_usb(void) {
+    // TinyUSB device task
+    PERF_BEGIN(PERF_STAGE_USB);
+    tud_task();
+    PERF_END(PERF_STAGE_USB);
+    return true;
+}
+
+static bool task_cdc(void) {
+    // Serial commands (text lines and binary frames), then drain
+    // as much pending output as the CDC FIFO takes without blocking
+    PERF_BEGIN(PERF_STAGE_CDC);
+    cdc_rx_task();
+    cdc_tx_task();
+    PERF_END(PERF_STAGE_CDC);
+    return true;
+}
+
+static bool usb_has_work(void) {
+    return tud_task_event_ready();
+}
+
+static bool cdc_has_work(void) {
+    // Output only counts while the FIFO has room; a USB interrupt makes more
+    return cdc_rx_has_work() ||
+           (!cdc_tx_idle() && (!tud_cdc_connected() || tud_cdc_write_available() > 0));
+}
+
+static bool task_leds(void) {
+    if (!neopixel_initialized) {
+        return true;
+    }
+
+    // Update NeoPixel LEDs based on button states; the boot light show
+    // has them until it ends or the player touches a fret
+    PERF_BEGIN(PERF_STAGE_LEDS);
+    bool fret_states[5] = {green, red, yellow, blue, orange};
+    if (boot_lights_active() && (green || red || yellow || blue || orange || strum_up || strum_down)) {
+        boot_lights_cancel();
+    }
+    boot_lights_task(board_millis());
+    if (!boot_lights_active()) {
+        neopixel_update_button_state(config_get_current(), fret_states, strum_up, strum_down);
+    }
+    PERF_END(PERF_STAGE_LEDS);
+    return true;
+}
+
+static bool task_vfs(void) {
+    // Commit files written over USB mass storage once the host is done
+    PERF_BEGIN(PERF_STAGE_VFS);
+    vfs_task();
+    PERF_END(PERF_STAGE_VFS);
+    return true;
+}
+
+static bool task_files(void) {
+    // Erase the flash slots of the next file writes ahead of time
+    file_emu_task();
+    return true;
+}
+
+static bool task_log(void) {
+    // Lowest priority: format queued log records while the UART has room
+    PERF_BEGIN(PERF_STAGE_LOG);
+    event_log_task();
+    PERF_END(PERF_STAGE_LOG);
+    return true;
+}
+
+// Active mode and its report rate; the ADC filter's delay budget follows the rate
+static void usb_mode_apply(usb_mode_enum_t mode) {
+    uint32_t report_period_us = mode == USB_MODE_HID ? HID_REPORT_PERIOD_US : XINPUT_REPORT_PERIOD_US;
+    current_usb_mode = mode;
+    sched_set_period(REPORT_TASK, report_period_us);
+    adc_filter_set_report_interval(report_period_us);
+}
+
+// A new usb_mode (MODE: command, config.json over the drive) takes effect by
+// dropping off the bus and enumerating again as the other device
+static bool task_usb_mode(void) {
+    static uint32_t seen_generation = 0;
+    static uint32_t switch_at_ms = 0;
+    static uint32_t reconnect_at_ms = 0;
+    uint32_t now_ms = board_millis();
+
+    if (reconnect_at_ms) {
+        if ((int32_t)(now_ms - reconnect_at_ms) >= 0) {
+            reconnect_at_ms = 0;
+            tud_connect();
         }
+        return true;
+    }
+
+    if (config_get_generation() != seen_generation) {
+        seen_generation = config_get_generation();
+        switch_at_ms = (usb_mode_load() != current_usb_mode) ? now_ms + USB_MODE_SWITCH_DELAY_MS : 0;
+    }
+    if (switch_at_ms == 0 || (int32_t)(now_ms - switch_at_ms) < 0) {
+        return true;
     }
 
+    switch_at_ms = 0;
+    usb_mode_enum_t mode = usb_mode_load();
+    LOG_INFO_STR("USB: Switching to %s mode\n", usb_mode_names[mode]);
+    tud_disconnect();
+    usb_mode_apply(mode);
+    reconnect_at_ms = now_ms + USB_MODE_RECONNECT_MS;
+    return true;
+}
+
+// Inputs are scanned by the sample clock; the report path comes first and
+// goes out on its slot: 8 ms in XInput mode (125 Hz - absolutely stable
+// rate), every 1 ms frame in HID mode. The event driven tasks only run when
+// they have work, so the loop can sleep between releases
+static const sched_task_t main_tasks[] = {
+    // name      run            period                   deadline  priority  has_work
+    { "report", task_report,   XINPUT_REPORT_PERIOD_US, 1000,     0,        NULL },
+    { "usb",    task_usb,      0,                       1000,     1,        usb_has_work },
+    { "cdc",    task_cdc,      0,                       4000,     2,        cdc_has_work },
+    { "leds",   task_leds,     10000,                   10000,    3,        NULL },
+    { "vfs",    task_vfs,      10000,                   0,        4,        NULL },
+    { "mode",   task_usb_mode, 10000,                   0,        4,        NULL },
+    { "files",  task_files,    10000,                   0,        4,        NULL },
+    { "log",    task_log,      0,                       0,        5,        event_log_has_work },
+};
+
+//--------------------------------------------------------------------+
+// MAIN FUNCTIONS
+//--------------------------------------------------------------------+
+int main(void) {
+    board_init();
+
+    // Every subsystem once; main loop starts when all phases are done
+    boot_prof_run(boot_phases, BOOT_PHASE_COUNT);
+
     printf("Guitar Hero Controller with Boot Combo Detection\n");
-    printf("Current mode: XInput (Green button detected at boot forces XInput)\n");
-    printf("Boot combos: Green=XInput, Red=Future HID mode\n");
-    
-    // Initialize NeoPixel system with proper config loading
-    neopixel_init(&device_config);
-    neopixel_initialized = true;
-    printf("NeoPixel system initialized successfully\n");
-    
-    // Set startup colors to indicate successful boot
-    neopixel_set_all(0xFF000000);  // White startup indicator  
-    neopixel_show();
-    sleep_ms(500);
-    
-    // Show RGB test pattern
-    neopixel_set_all(0x00FF0000);  // Red
-    neopixel_show();
-    sleep_ms(300);
-    neopixel_set_all(0x0000FF00);  // Green  
-    neopixel_show();
-    sleep_ms(300);
-    neopixel_set_all(0x000000FF);  // Blue
-    neopixel_show();
-    sleep_ms(300);
-    neopixel_set_all(0x00000000);  // Off
-    neopixel_show();
+    printf("Current mode: %s\n", current_usb_mode == USB_MODE_HID ? "HID gamepad" : "XInput");
+    printf("Boot combos: Green=XInput, Red=HID (remembered)\n");
 
-    while (1) {
-        // TinyUSB device task
-        tud_task();
-        
-        // Read guitar buttons and controls
-        read_guitar_buttons();
+    // Core 1 is done with flash: keep the mode a boot combo picked
+    if (usb_mode_save_pending && !usb_mode_save(current_usb_mode)) {
+        printf("USB mode: Failed to save %s mode\n", usb_mode_names[current_usb_mode]);
+    }
 
-        // Update NeoPixel LEDs based on button states
-        if (neopixel_initialized) {
-            bool fret_states[5] = {green, red, yellow, blue, orange};
-            neopixel_update_button_state(&device_config, fret_states, strum_up, strum_down);
-        }
+    // Input scans run in the timer interrupt from here on
+    sample_clock_start(SAMPLE_CLOCK_DEFAULT_US, SAMPLE_CLOCK_SKIP, sample_inputs);
+    sched_init(main_tasks, sizeof(main_tasks) / sizeof(main_tasks[0]));
+    usb_mode_apply(current_usb_mode);
+    idle_init();
 
-        // TODO: Re-enable USB interface system calls when ready
-        // // Create button state for USB interface system
-        // button_state_t button_state = {0};
-        // // Map internal state to button_state structure
-        // button_state.green = green;
-        // // ... (mapping code) ...
-        // // Send reports through USB interface system
-        // const usb_interface_t* interface = usb_interface_get();
-        // if (interface && interface->ready && interface->ready()) {
-        //     if (interface->send_report) {
-        //         interface->send_report(&button_state);
-        //     }
-        // }
-
-        // XInput code (works for both modes until HID is fully implemented)
-        // Send XInput reports regardless of mode for now - both work as XInput
-        {
-            // Send XInput report at 500Hz if device is ready
-            static uint32_t last_report_time = 0;
-            uint32_t current_time = board_millis();
-            if (tud_vendor_mounted() && (current_time - last_report_time >= 8)) {  // 125Hz - absolutely stable rate
-                // CRITICAL: Disable all interrupts during packet creation to prevent corruption
-                uint32_t saved_interrupts = save_and_disable_interrupts();
-                
-                // Send XInput input report (20 bytes data + 2 byte header = 22 bytes total)
-                uint8_t report_packet[22];
-                memset(report_packet, 0, sizeof(report_packet));  // CRITICAL: Clear all garbage data
-                
-                report_packet[0] = 0x00; // Message type: input report
-                report_packet[1] = 0x14; // Report size: 20 bytes
-                
-                // Copy the XInput report data (20 bytes) with interrupts disabled
-                memcpy(&report_packet[2], (void*)&xinput_report, sizeof(xinput_report));
-                
-                // Re-enable interrupts before USB write
-                restore_interrupts(saved_interrupts);
-
-                if (tud_vendor_write_available() >= sizeof(report_packet)) {
-                    tud_vendor_write(report_packet, sizeof(report_packet));
-                    tud_vendor_write_flush();
-                    last_report_time = current_time;
-                }
-            }
-        }
-        // TODO: Add HID mode support here when interface system is ready
+    while (1) {
+        PERF_BEGIN(PERF_STAGE_LOOP);
+        sched_run();
+        PERF_END(PERF_STAGE_LOOP);
+
+        // Nothing left to do: sleep until the next release or interrupt
+        idle_wait(sched_next_release_us(), sched_work_pending);
     }
 
     return 0;
@@ -10,8 +10,19 @@
 #include "pico/time.h"
 #include "hardware/gpio.h"
 #include "hardware/adc.h"
+#include "hardware/sync.h"
 #include "tusb.h"
 #include "device/usbd_pvt.h"
+#include "latency.h"
+#include "sample_clock.h"
+#include "idle.h"
+#include "adc_stream.h"
+#include "adc_filter.h"
+#include "whammy_cal.h"
+#include "joystick_cal.h"
+#include "remap.h"
+#include "guitar_core.h"
+#include <stdio.h>
 #include <string.h>
 
 //--------------------------------------------------------------------+
@@ -63,22 +74,49 @@
 #define XINPUT_GAMEPAD_Y                0x8000
 
 // XInput report structure (exactly as fluffymadness)
-typedef struct {
-    uint8_t rid;
-    uint8_t rsize;
-    uint8_t digital_buttons_1;
-    uint8_t digital_buttons_2;
-    uint8_t lt;
-    uint8_t rt;
-    int16_t l_x;      // Changed: int16_t for proper Xbox 360 format
-    int16_t l_y;
-    int16_t r_x;
-    int16_t r_y;
-    uint8_t reserved_1[6];
-} ReportDataXinput;
+typedef guitar_core::xinput_wire_report_t ReportDataXinput;
 
 ReportDataXinput XboxButtonData;
 
+// Fixed mapping of this build: tilt only pushes right stick Y up, the
+// secondary strum pins stand in for d-pad up/down
+struct fluffy_table {
+    static constexpr bool hat_joystick = false;
+    static constexpr remap_target_t targets[REMAP_SOURCES] = {
+        guitar_core::button(XINPUT_GAMEPAD_A),              // Green
+        guitar_core::button(XINPUT_GAMEPAD_B),              // Red
+        guitar_core::button(XINPUT_GAMEPAD_Y),              // Yellow
+        guitar_core::button(XINPUT_GAMEPAD_X),              // Blue
+        guitar_core::button(XINPUT_GAMEPAD_LEFT_SHOULDER),  // Orange
+        guitar_core::button(XINPUT_GAMEPAD_DPAD_UP),        // Strum up
+        guitar_core::button(XINPUT_GAMEPAD_DPAD_DOWN),      // Strum down
+        guitar_core::button(XINPUT_GAMEPAD_START),
+        guitar_core::button(XINPUT_GAMEPAD_BACK),           // Select
+        guitar_core::button(XINPUT_GAMEPAD_GUIDE),
+        guitar_core::axis(REMAP_AXIS_RY, 1),                // Tilt
+        guitar_core::none(), guitar_core::none(),           // No d-pad up/down switches
+        guitar_core::button(XINPUT_GAMEPAD_DPAD_LEFT),
+        guitar_core::button(XINPUT_GAMEPAD_DPAD_RIGHT),
+        guitar_core::axis(REMAP_AXIS_RX),                   // Whammy
+        guitar_core::axis(REMAP_AXIS_LX),                   // Joystick
+        guitar_core::axis(REMAP_AXIS_LY),
+    };
+};
+
+// Scan-to-report core of this build: every pin, map and report layout fixed at compile time
+static guitar_core::guitar<
+    guitar_core::fixed_pins<
+        guitar_core::pin(PIN_GREEN), guitar_core::pin(PIN_RED), guitar_core::pin(PIN_YELLOW),
+        guitar_core::pin(PIN_BLUE), guitar_core::pin(PIN_ORANGE),
+        guitar_core::pin(PIN_STRUM_UP) | guitar_core::pin(PIN_STRUM_UP_2),
+        guitar_core::pin(PIN_STRUM_DOWN) | guitar_core::pin(PIN_STRUM_DOWN_2),
+        guitar_core::pin(PIN_START), guitar_core::pin(PIN_SELECT), guitar_core::pin(PIN_GUIDE),
+        guitar_core::pin(PIN_TILT), guitar_core::NO_PIN, guitar_core::NO_PIN,
+        guitar_core::pin(PIN_DPAD_LEFT), guitar_core::pin(PIN_DPAD_RIGHT)>,
+    guitar_core::no_debounce,
+    guitar_core::fixed_map<fluffy_table>,
+    guitar_core::xinput_encoder> guitar;
+
 //--------------------------------------------------------------------+
 // USB DESCRIPTORS (Exact fluffymadness format)
 //--------------------------------------------------------------------+
@@ -101,12 +139,17 @@ tusb_desc_device_t const xinputDeviceDescriptor = {
     .bNumConfigurations = 0x01
 };
 
+// Interface + XInput class descriptor (0x21) + IN and OUT endpoints
+#define XINPUT_CLASS_DESC_LEN   16
+#define XINPUT_DESC_LEN         (9 + XINPUT_CLASS_DESC_LEN + 7 + 7)
+#define XINPUT_CONFIG_TOTAL_LEN (TUD_CONFIG_DESC_LEN + XINPUT_DESC_LEN)
+
 // Configuration Descriptor (Raw bytes - exact fluffymadness format)
 const uint8_t xinputConfigurationDescriptor[] = {
     // Configuration Descriptor:
     0x09,   // bLength
     0x02,   // bDescriptorType
-    0x30,0x00,  // wTotalLength (48 bytes)
+    U16_TO_U8S_LE(XINPUT_CONFIG_TOTAL_LEN),  // wTotalLength (48 bytes)
     0x01,   // bNumInterfaces
     0x01,   // bConfigurationValue
     0x00,   // iConfiguration
@@ -125,7 +168,7 @@ const uint8_t xinputConfigurationDescriptor[] = {
     0x00,   // iInterface
 
     // Unknown Descriptor:
-    0x10,
+    XINPUT_CLASS_DESC_LEN,
     0x21, 
     0x10, 
     0x01, 
@@ -159,6 +202,9 @@ const uint8_t xinputConfigurationDescriptor[] = {
     0x08,   // bInterval (8 frames)
 };
 
+static_assert(sizeof(xinputConfigurationDescriptor) == XINPUT_CONFIG_TOTAL_LEN,
+              "XINPUT_CONFIG_TOTAL_LEN does not match the configuration descriptor");
+
 // String descriptors
 char const *string_desc_arr_xinput[] = {
     (const char[]){0x09, 0x04}, // 0: Language (English)
@@ -186,16 +232,18 @@ static void xinput_reset(uint8_t __unused rhport) {
 }
 
 static uint16_t xinput_open(uint8_t __unused rhport, tusb_desc_interface_t const *itf_desc, uint16_t max_len) {
-    // +16 is for the unknown descriptor 
-    uint16_t const drv_len = sizeof(tusb_desc_interface_t) + itf_desc->bNumEndpoints*sizeof(tusb_desc_endpoint_t) + 16;
-    TU_VERIFY(max_len >= drv_len, 0);
+    TU_VERIFY(itf_desc->bInterfaceClass == TUSB_CLASS_VENDOR_SPECIFIC && itf_desc->bInterfaceSubClass == 0x5D, 0);
 
+    // Claim everything up to the next interface: the XInput class descriptor
+    // and the endpoints, whatever their lengths
     uint8_t const * p_desc = tu_desc_next(itf_desc);
+    uint8_t const * desc_end = (uint8_t const *)itf_desc + max_len;
     uint8_t found_endpoints = 0;
-    while ( (found_endpoints < itf_desc->bNumEndpoints) && (drv_len <= max_len) ) {
-        tusb_desc_endpoint_t const * desc_ep = (tusb_desc_endpoint_t const *) p_desc;
-        if ( TUSB_DESC_ENDPOINT == tu_desc_type(desc_ep) ) {
-            TU_ASSERT(usbd_edpt_open(rhport, desc_ep));
+    while ( (p_desc < desc_end) && (tu_desc_type(p_desc) != TUSB_DESC_INTERFACE) &&
+            (tu_desc_type(p_desc) != TUSB_DESC_INTERFACE_ASSOCIATION) ) {
+        if ( TUSB_DESC_ENDPOINT == tu_desc_type(p_desc) ) {
+            tusb_desc_endpoint_t const * desc_ep = (tusb_desc_endpoint_t const *) p_desc;
+            TU_ASSERT(usbd_edpt_open(rhport, desc_ep), 0);
 
             if ( tu_edpt_dir(desc_ep->bEndpointAddress) == TUSB_DIR_IN ) {
                 endpoint_in = desc_ep->bEndpointAddress;
@@ -206,18 +254,20 @@ static uint16_t xinput_open(uint8_t __unused rhport, tusb_desc_interface_t const
         }
         p_desc = tu_desc_next(p_desc);
     }
-    return drv_len;
-}
+    TU_VERIFY(found_endpoints == itf_desc->bNumEndpoints, 0);
 
-static bool xinput_device_control_request(uint8_t rhport, uint8_t stage, tusb_control_request_t const *request) {
-    return true;
+    return (uint16_t)(p_desc - (uint8_t const *)itf_desc);
 }
 
-static bool xinput_control_complete_cb(uint8_t __unused rhport, tusb_control_request_t __unused const *request) {
+static bool xinput_device_control_request(uint8_t __unused rhport, uint8_t __unused stage, tusb_control_request_t __unused const *request) {
     return true;
 }
 
-static bool xinput_xfer_cb(uint8_t __unused rhport, uint8_t __unused ep_addr, xfer_result_t __unused result, uint32_t __unused xferred_bytes) {
+static bool xinput_xfer_cb(uint8_t __unused rhport, uint8_t ep_addr, xfer_result_t result, uint32_t __unused xferred_bytes) {
+    // Input report reached the host: closes the latency measurement
+    if (ep_addr == endpoint_in && result == XFER_RESULT_SUCCESS) {
+        latency_report_complete(time_us_32());
+    }
     return true;
 }
 
@@ -287,101 +337,142 @@ uint8_t const *tud_hid_descriptor_report_cb(void) {
 //--------------------------------------------------------------------+
 static void init_gpio(void) {
     // Initialize button pins with internal pullups
-    const uint8_t button_pins[] = {
-        PIN_GREEN, PIN_RED, PIN_YELLOW, PIN_BLUE, PIN_ORANGE,
-        PIN_START, PIN_SELECT, PIN_STRUM_UP, PIN_STRUM_DOWN,
-        PIN_STRUM_UP_2, PIN_STRUM_DOWN_2, PIN_DPAD_LEFT, PIN_DPAD_RIGHT, PIN_TILT, PIN_GUIDE
-    };
-    
-    for (int i = 0; i < sizeof(button_pins); i++) {
-        gpio_init(button_pins[i]);
-        gpio_set_dir(button_pins[i], GPIO_IN);
-        gpio_pull_up(button_pins[i]);
-    }
+    guitar.input.init();
+
+    // Timestamp the first edge of every input change for the latency tracer
+    latency_init();
+    latency_watch_pin(PIN_GREEN, LATENCY_CLASS_FRET);
+    latency_watch_pin(PIN_RED, LATENCY_CLASS_FRET);
+    latency_watch_pin(PIN_YELLOW, LATENCY_CLASS_FRET);
+    latency_watch_pin(PIN_BLUE, LATENCY_CLASS_FRET);
+    latency_watch_pin(PIN_ORANGE, LATENCY_CLASS_FRET);
+    latency_watch_pin(PIN_STRUM_UP, LATENCY_CLASS_STRUM);
+    latency_watch_pin(PIN_STRUM_DOWN, LATENCY_CLASS_STRUM);
+    latency_watch_pin(PIN_STRUM_UP_2, LATENCY_CLASS_STRUM);
+    latency_watch_pin(PIN_STRUM_DOWN_2, LATENCY_CLASS_STRUM);
+    latency_watch_pin(PIN_DPAD_LEFT, LATENCY_CLASS_DPAD);
+    latency_watch_pin(PIN_DPAD_RIGHT, LATENCY_CLASS_DPAD);
+    latency_watch_pin(PIN_START, LATENCY_CLASS_BUTTON);
+    latency_watch_pin(PIN_SELECT, LATENCY_CLASS_BUTTON);
+    latency_watch_pin(PIN_GUIDE, LATENCY_CLASS_BUTTON);
+    latency_watch_pin(PIN_TILT, LATENCY_CLASS_TILT);
     
     // Initialize ADC for analog inputs
     adc_init();
     adc_gpio_init(PIN_WHAMMY);     // ADC1
     adc_gpio_init(PIN_JOYSTICK_X); // ADC2
     adc_gpio_init(PIN_JOYSTICK_Y); // ADC3
+    adc_stream_start();
+
+    // No config.json in this build: the default whammy range
+    whammy_cal_set(WHAMMY_CAL_DEFAULT_MIN, WHAMMY_CAL_DEFAULT_MAX, false);
+
+    // Nor a stored joystick calibration: full range, center taken at power-up
+    const joystick_axis_range_t joystick_ranges[JOYSTICK_CAL_AXES] = {
+        { JOYSTICK_CAL_DEFAULT_CENTER, JOYSTICK_CAL_DEFAULT_MIN, JOYSTICK_CAL_DEFAULT_MAX },
+        { JOYSTICK_CAL_DEFAULT_CENTER, JOYSTICK_CAL_DEFAULT_MIN, JOYSTICK_CAL_DEFAULT_MAX },
+    };
+    joystick_cal_set(joystick_ranges, JOYSTICK_CAL_DEFAULT_DEADZONE);
+    joystick_cal_boot_capture();
 }
 
 //--------------------------------------------------------------------+
 // INPUT READING AND REPORT GENERATION
 //--------------------------------------------------------------------+
+static uint32_t analog_age_us = 0;     // Oldest ADC sample in XboxButtonData when scanned
+static uint32_t analog_scan_us = 0;
+static adc_filter_t whammy_filter, joy_x_filter, joy_y_filter;
+
 static void read_guitar_inputs(void) {
-    // Clear button state
-    XboxButtonData.digital_buttons_1 = 0;
-    XboxButtonData.digital_buttons_2 = 0;
-    
-    // Xbox 360 Controller Button Layout per your mapping:
-    // digital_buttons_1: [DPad_Right][DPad_Left][DPad_Down][DPad_Up][Start][Back][L3][R3]
-    // digital_buttons_2: [Y][X][B][A][unused][unused][RB][LB]
-    
-    // Map guitar fret buttons exactly as specified
-    if (!gpio_get(PIN_GREEN))     XboxButtonData.digital_buttons_2 |= 0x10; // Green -> A (bit 4)
-    if (!gpio_get(PIN_RED))       XboxButtonData.digital_buttons_2 |= 0x20; // Red -> B (bit 5)  
-    if (!gpio_get(PIN_YELLOW))    XboxButtonData.digital_buttons_2 |= 0x80; // Yellow -> Y (bit 7)
-    if (!gpio_get(PIN_BLUE))      XboxButtonData.digital_buttons_2 |= 0x40; // Blue -> X (bit 6)
-    if (!gpio_get(PIN_ORANGE))    XboxButtonData.digital_buttons_2 |= 0x01; // Orange -> Left Shoulder (bit 0)
-    
-    // Map DPad - fix the bit positions
-    bool strum_up = !gpio_get(PIN_STRUM_UP) || !gpio_get(PIN_STRUM_UP_2);
-    bool strum_down = !gpio_get(PIN_STRUM_DOWN) || !gpio_get(PIN_STRUM_DOWN_2);
-    
-    if (strum_up)                 XboxButtonData.digital_buttons_1 |= 0x01; // Strum Up -> DPad Up (bit 0)
-    if (strum_down)               XboxButtonData.digital_buttons_1 |= 0x02; // Strum Down -> DPad Down (bit 1)
-    if (!gpio_get(PIN_DPAD_LEFT)) XboxButtonData.digital_buttons_1 |= 0x04; // Left -> DPad Left (bit 2)
-    if (!gpio_get(PIN_DPAD_RIGHT)) XboxButtonData.digital_buttons_1 |= 0x08; // Right -> DPad Right (bit 3)
-    
-    // Map control buttons
-    if (!gpio_get(PIN_START))     XboxButtonData.digital_buttons_1 |= 0x10; // Start -> Start (bit 4)
-    if (!gpio_get(PIN_SELECT))    XboxButtonData.digital_buttons_1 |= 0x20; // Select -> Back (bit 5)
-    
-    // Guide button - needs to be in digital_buttons_2 as per Xbox 360 protocol
-    if (!gpio_get(PIN_GUIDE))     XboxButtonData.digital_buttons_2 |= 0x04; // Guide -> bit 10 (0x0400 >> 8 = 0x04)
+    // Physical controls, one bit each in remap_source_t order
+    uint16_t digital = guitar.read(gpio_get_all(), 0);
     
     // Read analog inputs - standard mapping per pin assignments
     // GP26 = ADC0, GP27 = ADC1, GP28 = ADC2, GP29 = ADC3
     
-    // Joystick X-Axis (GP28) -> Left Stick X-Axis (direct mapping)
-    adc_select_input(2);  // GP28 = ADC2
-    uint16_t joy_x = adc_read();
-    XboxButtonData.l_x = (int16_t)((joy_x - 2048) << 4);
+    // Oversampled DMA-streamed conversions, no waiting; keep the oldest one's age
+    uint32_t age_us;
+
+    // Joystick (GP28, GP29), centered with the radial deadzone
+    uint16_t joy_x = adc_filter_apply(&joy_x_filter, adc_stream_read_oversampled(2, &analog_age_us));  // GP28 = ADC2
+    uint16_t joy_y = adc_filter_apply(&joy_y_filter, adc_stream_read_oversampled(3, &age_us));  // GP29 = ADC3
+    if (age_us > analog_age_us) analog_age_us = age_us;
+    int16_t stick_x, stick_y;
+    joystick_cal_apply(joy_x, joy_y, &stick_x, &stick_y);
     
-    // Joystick Y-Axis (GP29) -> Left Stick Y-Axis (direct mapping)
-    adc_select_input(3);  // GP29 = ADC3
-    uint16_t joy_y = adc_read();
-    XboxButtonData.l_y = (int16_t)((joy_y - 2048) << 4);
-    
-    // Whammy (GP27) -> Right Stick X-Axis (direct mapping)
-    adc_select_input(1);  // GP27 = ADC1
-    uint16_t whammy = adc_read();
-    XboxButtonData.r_x = (int16_t)((whammy - 2048) << 4);
-    
-    // Tilt (GP9, digital) -> Right Stick Y-Axis
-    bool tilt_active = !gpio_get(PIN_TILT);
-    if (tilt_active) {
-        XboxButtonData.r_y = 32767;   // Full positive when tilt is pressed (100% up/left)
-    } else {
-        XboxButtonData.r_y = 0;       // Centered when not pressed (neutral 0%)
+    // Whammy (GP27)
+    uint16_t whammy = adc_filter_apply(&whammy_filter, adc_stream_read_oversampled(1, &age_us));  // GP27 = ADC1
+    if (age_us > analog_age_us) analog_age_us = age_us;
+    analog_age_us += adc_filter_get_delay_scans() * sample_clock_get_period();
+    analog_scan_us = time_us_32();
+
+    // Xbox 360 Controller Button Layout:
+    // buttons low byte:  [DPad_Right][DPad_Left][DPad_Down][DPad_Up][Start][Back][L3][R3]
+    // buttons high byte: [Y][X][B][A][unused][Guide][RB][LB]
+    guitar.build(digital, (int16_t)(whammy_cal_apply(whammy) - 32768), stick_x, stick_y, &XboxButtonData.gamepad);
+    bool tilt_active = digital & (1u << REMAP_TILT);
+
+    // Tell the latency tracer which input classes changed since the last scan
+    static uint8_t last_state[LATENCY_CLASS_COUNT];
+    uint8_t state[LATENCY_CLASS_COUNT];
+    state[LATENCY_CLASS_FRET] = (uint8_t)(digital & 0x1F);
+    state[LATENCY_CLASS_STRUM] = (uint8_t)((digital >> REMAP_STRUM_UP) & 0x03);
+    state[LATENCY_CLASS_DPAD] = (uint8_t)((digital >> REMAP_LEFT) & 0x03);
+    state[LATENCY_CLASS_BUTTON] = (uint8_t)((digital >> REMAP_START) & 0x07);
+    state[LATENCY_CLASS_TILT] = tilt_active;
+
+    uint32_t now_us = time_us_32();
+    for (int i = 0; i < LATENCY_CLASS_COUNT; i++) {
+        if (state[i] != last_state[i]) {
+            latency_input_changed((latency_class_t)i, now_us);
+            last_state[i] = state[i];
+        }
     }
-    
-    // Clear triggers
-    XboxButtonData.lt = 0;
-    XboxButtonData.rt = 0;
-    
-    // Clear reserved bytes
-    memset(XboxButtonData.reserved_1, 0, sizeof(XboxButtonData.reserved_1));
+}
+
+// Start + Select held for 2 seconds prints the latency, sample clock, idle and ADC reports on the UART
+static void check_latency_dump(void) {
+    static uint32_t held_since_ms = 0;
+    static bool dumped = false;
+
+    if ((XboxButtonData.gamepad.buttons & (XINPUT_GAMEPAD_START | XINPUT_GAMEPAD_BACK)) !=
+        (XINPUT_GAMEPAD_START | XINPUT_GAMEPAD_BACK)) {
+        held_since_ms = 0;
+        dumped = false;
+        return;
+    }
+
+    uint32_t now_ms = board_millis();
+    if (held_since_ms == 0) {
+        held_since_ms = now_ms;
+    } else if (!dumped && now_ms - held_since_ms >= 2000) {
+        static char report[LATENCY_REPORT_MAX];
+        latency_format_report(report, sizeof(report));
+        printf("%s", report);
+        sample_clock_format_report(report, sizeof(report));
+        printf("%s", report);
+        idle_format_report(report, sizeof(report));
+        printf("%s", report);
+        adc_stream_format_report(report, sizeof(report));
+        printf("%s", report);
+        dumped = true;
+    }
+}
+
+// Sample clock tick, in the timer alarm interrupt: scan inputs once per period
+static volatile bool sample_ready = false;
+
+static void sample_inputs(uint32_t now_us) {
+    (void)now_us;
+    read_guitar_inputs();
+    sample_ready = true;
 }
 
 static void sendReportData(void) {
-    // Poll every 1ms
-    const uint32_t interval_ms = 1;
-    static uint32_t start_ms = 0;
+    // One report per input sample (1 ms sample clock)
+    static ReportDataXinput report;
 
-    if (board_millis() - start_ms < interval_ms) return;  // not enough time
-    start_ms += interval_ms;
+    if (!sample_ready) return;  // no new sample yet
 
     // Remote wakeup
     if (tud_suspended()) {
@@ -390,21 +481,37 @@ static void sendReportData(void) {
         tud_remote_wakeup();
     }
 
-    // Update report data
-    read_guitar_inputs();
-    
-    // Set report header
-    XboxButtonData.rid = 0;
-    XboxButtonData.rsize = 20;
+    check_latency_dump();
     
     // Send report if ready
     if ((tud_ready()) && ((endpoint_in != 0)) && (!usbd_edpt_busy(0, endpoint_in))) {
+        // Snapshot the sample so the tick cannot change it mid-copy
+        uint32_t interrupts = save_and_disable_interrupts();
+        report = XboxButtonData;
+        uint32_t sample_age_us = analog_age_us;
+        uint32_t scan_us = analog_scan_us;
+        sample_ready = false;
+        uint32_t built_us = time_us_32();
+        latency_report_built(built_us);  // With the snapshot, as in main.cpp
+        restore_interrupts(interrupts);
+
+        // Set report header
+        report.rid = 0;
+        report.rsize = 20;
+
         usbd_edpt_claim(0, endpoint_in);
-        usbd_edpt_xfer(0, endpoint_in, (uint8_t*)&XboxButtonData, 20);
+        adc_stream_report_built(sample_age_us + (built_us - scan_us));
+        usbd_edpt_xfer(0, endpoint_in, (uint8_t*)&report, 20);
         usbd_edpt_release(0, endpoint_in);
     }   
 }
 
+// A sample waiting for a free endpoint, or a USB event to handle
+static bool work_pending(void) {
+    return tud_task_event_ready() ||
+           (sample_ready && tud_ready() && endpoint_in != 0 && !usbd_edpt_busy(0, endpoint_in));
+}
+
 //--------------------------------------------------------------------+
 // MAIN APPLICATION
 //--------------------------------------------------------------------+
@@ -415,11 +522,16 @@ int main(void) {
     
     // Initialize USB
     tusb_init();
+
+    // Input scans run in the timer interrupt from here on
+    sample_clock_start(SAMPLE_CLOCK_DEFAULT_US, SAMPLE_CLOCK_SKIP, sample_inputs);
+    idle_init();
     
-    // Main loop
+    // Main loop; sleeps until the next sample tick or USB interrupt
     while (1) {
         sendReportData();
         tud_task();  // tinyusb device task
+        idle_wait(0, work_pending);
     }
     
     return 0;
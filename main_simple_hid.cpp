@@ -1,14 +1,22 @@
 /*
  * BGG Guitar Controller - Simple HID Gamepad
- * Basic implementation to test USB enumeration
+ * Plain HID gamepad on the same sample clock and ADC stream as the XInput build
  * 
  * Hardware: Raspberry Pi Pico
- * Purpose: Simple HID gamepad that Windows will definitely recognize
+ * Purpose: Simple HID gamepad that Windows will definitely recognize,
+ *          scanned and reported at 1 kHz (bInterval 1)
  */
 
 #include "pico/stdlib.h"
+#include "hardware/adc.h"
+#include "hardware/sync.h"
 #include "bsp/board.h"
 #include "tusb.h"
+#include "guitar_core.h"
+#include "sample_clock.h"
+#include "idle.h"
+#include "adc_stream.h"
+#include <string.h>
 
 //--------------------------------------------------------------------+
 // HARDWARE CONFIGURATION
@@ -57,7 +65,7 @@ uint8_t const desc_configuration[] = {
     TUD_CONFIG_DESCRIPTOR(1, 1, 0, TUD_CONFIG_DESC_LEN + TUD_HID_DESC_LEN, TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100),
 
     // Interface number, string index, protocol, report descriptor len, EP In address, size & polling interval
-    TUD_HID_DESCRIPTOR(0, 0, HID_ITF_PROTOCOL_NONE, sizeof(desc_hid_report), 0x81, CFG_TUD_HID_EP_BUFSIZE, 10)
+    TUD_HID_DESCRIPTOR(0, 0, HID_ITF_PROTOCOL_NONE, sizeof(desc_hid_report), 0x81, CFG_TUD_HID_EP_BUFSIZE, 1)
 };
 
 char const* string_desc_arr[] = {
@@ -70,69 +78,68 @@ char const* string_desc_arr[] = {
 //--------------------------------------------------------------------+
 // HID GAMEPAD REPORT
 //--------------------------------------------------------------------+
-typedef struct TU_ATTR_PACKED {
-    int8_t  x;         ///< Delta x  movement of left analog-stick
-    int8_t  y;         ///< Delta y  movement of left analog-stick
-    int8_t  z;         ///< Delta z  movement of right analog-stick
-    int8_t  rz;        ///< Delta Rz movement of right analog-stick
-    int8_t  rx;        ///< Delta Rx movement of analog left trigger
-    int8_t  ry;        ///< Delta Ry movement of analog right trigger
-    uint8_t hat;       ///< Buttons mask for currently pressed buttons (see HID_GAMEPAD_BUTTON_* masks)
-    uint32_t buttons;  ///< Buttons mask for currently pressed buttons (see HID_GAMEPAD_BUTTON_* masks)
-} hid_gamepad_report_t;
+// XInput-style names for the table; the encoder moves them to GAMEPAD_BUTTON_*
+#define XINPUT_START    0x0010
+#define XINPUT_BACK     0x0020
+#define XINPUT_LB       0x0100
+#define XINPUT_A        0x1000
+#define XINPUT_B        0x2000
+#define XINPUT_X        0x4000
+#define XINPUT_Y        0x8000
+
+// Green -> A, Red -> B, Yellow -> X, Blue -> Y, Orange -> L1, whammy -> right trigger
+struct simple_hid_table {
+    static constexpr bool hat_joystick = false;
+    static constexpr remap_target_t targets[REMAP_SOURCES] = {
+        guitar_core::button(XINPUT_A), guitar_core::button(XINPUT_B), guitar_core::button(XINPUT_X),
+        guitar_core::button(XINPUT_Y), guitar_core::button(XINPUT_LB),
+        guitar_core::none(), guitar_core::none(),                        // No strum switches
+        guitar_core::button(XINPUT_START), guitar_core::button(XINPUT_BACK),
+        guitar_core::none(), guitar_core::none(),                        // No guide, no tilt
+        guitar_core::none(), guitar_core::none(), guitar_core::none(), guitar_core::none(),
+        guitar_core::axis(REMAP_AXIS_RT),                                // Whammy
+        guitar_core::none(), guitar_core::none(),                        // No joystick
+    };
+};
+
+static guitar_core::guitar<
+    guitar_core::fixed_pins<
+        guitar_core::pin(PIN_GREEN), guitar_core::pin(PIN_RED), guitar_core::pin(PIN_YELLOW),
+        guitar_core::pin(PIN_BLUE), guitar_core::pin(PIN_ORANGE),
+        guitar_core::NO_PIN, guitar_core::NO_PIN,
+        guitar_core::pin(PIN_START), guitar_core::pin(PIN_SELECT),
+        guitar_core::NO_PIN, guitar_core::NO_PIN,
+        guitar_core::NO_PIN, guitar_core::NO_PIN, guitar_core::NO_PIN, guitar_core::NO_PIN>,
+    guitar_core::no_debounce,
+    guitar_core::fixed_map<simple_hid_table>,
+    guitar_core::hid_gamepad_encoder> guitar;
 
 // Global gamepad state
-static hid_gamepad_report_t gamepad_report = {0};
+static guitar_core::hid_gamepad_t gamepad_report = {};
 
 //--------------------------------------------------------------------+
 // HARDWARE INITIALIZATION
 //--------------------------------------------------------------------+
 static void init_gpio(void) {
     // Initialize button pins with internal pullups
-    const uint8_t button_pins[] = {
-        PIN_GREEN, PIN_RED, PIN_YELLOW, PIN_BLUE, PIN_ORANGE,
-        PIN_START, PIN_SELECT
-    };
-    
-    for (int i = 0; i < sizeof(button_pins); i++) {
-        gpio_init(button_pins[i]);
-        gpio_set_dir(button_pins[i], GPIO_IN);
-        gpio_pull_up(button_pins[i]);
-    }
+    guitar.input.init();
     
-    // Initialize ADC for whammy bar
+    // Whammy bar through the free-running ADC stream
     adc_init();
     adc_gpio_init(PIN_WHAMMY);
+    adc_stream_start();
 }
 
 //--------------------------------------------------------------------+
 // INPUT READING
 //--------------------------------------------------------------------+
 static void read_guitar_inputs(void) {
-    // Clear previous button state
-    gamepad_report.buttons = 0;
-    
-    // Read digital buttons (active low) and map to gamepad buttons
-    if (!gpio_get(PIN_GREEN))  gamepad_report.buttons |= GAMEPAD_BUTTON_A;     // Green -> A
-    if (!gpio_get(PIN_RED))    gamepad_report.buttons |= GAMEPAD_BUTTON_B;     // Red -> B
-    if (!gpio_get(PIN_YELLOW)) gamepad_report.buttons |= GAMEPAD_BUTTON_X;     // Yellow -> X
-    if (!gpio_get(PIN_BLUE))   gamepad_report.buttons |= GAMEPAD_BUTTON_Y;     // Blue -> Y
-    if (!gpio_get(PIN_ORANGE)) gamepad_report.buttons |= GAMEPAD_BUTTON_TL;    // Orange -> L1
-    if (!gpio_get(PIN_START))  gamepad_report.buttons |= GAMEPAD_BUTTON_START; // Start -> Start
-    if (!gpio_get(PIN_SELECT)) gamepad_report.buttons |= GAMEPAD_BUTTON_SELECT;// Select -> Select
-    
-    // Read whammy bar (12-bit ADC) and map to right trigger
-    adc_select_input(0);
-    uint16_t whammy = adc_read();
-    gamepad_report.ry = (int8_t)((whammy >> 5) - 64); // Convert to signed 8-bit
-    
-    // Clear other analog inputs
-    gamepad_report.x = 0;
-    gamepad_report.y = 0;
-    gamepad_report.z = 0;
-    gamepad_report.rz = 0;
-    gamepad_report.rx = 0;
-    gamepad_report.hat = 0;
+    // Latest oversampled whammy reading (0-65520), centered for the mapper
+    uint32_t age_us;
+    int16_t whammy = (int16_t)(adc_stream_read_oversampled(0, &age_us) - 32768);  // GP26 = ADC0
+
+    // Buttons (active low) and whammy -> gamepad report
+    guitar.build(guitar.read(gpio_get_all(), 0), whammy, 0, 0, &gamepad_report);
 }
 
 //--------------------------------------------------------------------+
@@ -197,6 +204,40 @@ void tud_hid_set_report_cb(uint8_t itf, uint8_t report_id, hid_report_type_t rep
     (void)bufsize;
 }
 
+//--------------------------------------------------------------------+
+// REPORTING
+//--------------------------------------------------------------------+
+// Sample clock tick, in the timer alarm interrupt: scan inputs once per period
+static volatile bool sample_ready = false;
+
+static void sample_inputs(uint32_t now_us) {
+    (void)now_us;
+    read_guitar_inputs();
+    sample_ready = true;
+}
+
+static void send_report(void) {
+    // One report per input sample (1 ms sample clock)
+    static guitar_core::hid_gamepad_t report;
+
+    if (!sample_ready) return;  // no new sample yet
+
+    if (tud_hid_ready()) {
+        // Snapshot the sample so the tick cannot change it mid-copy
+        uint32_t interrupts = save_and_disable_interrupts();
+        report = gamepad_report;
+        sample_ready = false;
+        restore_interrupts(interrupts);
+
+        tud_hid_report(0, &report, sizeof(report));
+    }
+}
+
+// A sample waiting for a free endpoint, or a USB event to handle
+static bool work_pending(void) {
+    return tud_task_event_ready() || (sample_ready && tud_hid_ready());
+}
+
 //--------------------------------------------------------------------+
 // MAIN APPLICATION
 //--------------------------------------------------------------------+
@@ -207,22 +248,16 @@ int main(void) {
     
     // Initialize USB device
     tud_init(0);
+
+    // Input scans run in the timer interrupt from here on
+    sample_clock_start(SAMPLE_CLOCK_DEFAULT_US, SAMPLE_CLOCK_SKIP, sample_inputs);
+    idle_init();
     
-    // Main loop
+    // Main loop; sleeps until the next sample tick or USB interrupt
     while (1) {
-        // Service USB tasks
+        send_report();
         tud_task();
-        
-        // Read guitar inputs
-        read_guitar_inputs();
-        
-        // Send HID report if USB is ready
-        if (tud_hid_ready()) {
-            tud_hid_report(0, &gamepad_report, sizeof(gamepad_report));
-        }
-        
-        // Small delay
-        sleep_ms(10);
+        idle_wait(0, work_pending);
     }
     
     return 0;
@@ -40,13 +40,7 @@ void neopixel_init(const config_t* config) {
     // Configure WS2812 program
     ws2812_program_init(pio, sm, offset, neopixel_pin, 800000, false);
     
-    // Simple startup test - single white flash
-    printf("NeoPixel: Startup flash test\n");
-    neopixel_set_pixel(0, 0xFFFFFF); // Use proper function for RGB->GRB conversion
-    neopixel_show();
-    sleep_ms(500);
-    
-    // Clear using proper function
+    // Start dark; the startup flash is part of the boot light show (boot_lights.c)
     neopixel_clear();
     neopixel_show();
     
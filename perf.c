@@ -0,0 +1,126 @@
+#include "perf.h"
+#include "cdc_tx.h"
+#include "hardware/clocks.h"
+#include <stdio.h>
+#include <string.h>
+
+static perf_stage_stats_t stages[PERF_STAGE_COUNT];
+static uint32_t cycles_per_us = 125;
+
+static const char* const stage_names[PERF_STAGE_COUNT] = {
+    "loop",
+    "usb",
+    "cdc",
+    "vfs",
+    "input",
+    "leds",
+    "report",
+    "log",
+};
+
+// Text report, rendered once per PERF command and streamed by the TX pump
+static char report[PERF_REPORT_MAX];
+static uint32_t report_length = 0;
+
+void perf_init(void) {
+    // Free-running SysTick on the processor clock, no interrupt
+    systick_hw->csr = 0;
+    systick_hw->rvr = PERF_SYSTICK_MASK;
+    systick_hw->cvr = 0;
+    systick_hw->csr = 0x5;  // ENABLE | CLKSOURCE
+
+    cycles_per_us = clock_get_hz(clk_sys) / 1000000;
+    if (cycles_per_us == 0) {
+        cycles_per_us = 1;
+    }
+    perf_reset();
+}
+
+void perf_reset(void) {
+    memset(stages, 0, sizeof(stages));
+    for (int i = 0; i < PERF_STAGE_COUNT; i++) {
+        stages[i].min = UINT32_MAX;
+    }
+}
+
+void perf_record(perf_stage_t stage, uint32_t cycles) {
+    perf_stage_stats_t* stats = &stages[stage];
+
+    stats->count++;
+    stats->total += cycles;
+    if (cycles < stats->min) stats->min = cycles;
+    if (cycles > stats->max) stats->max = cycles;
+
+    // Bucket = bit length of the duration
+    uint32_t bucket = cycles ? 32 - __builtin_clz(cycles) : 0;
+    if (bucket >= PERF_HIST_BUCKETS) bucket = PERF_HIST_BUCKETS - 1;
+    stats->histogram[bucket]++;
+}
+
+const perf_stage_stats_t* perf_get_stage(perf_stage_t stage) {
+    return (stage < PERF_STAGE_COUNT) ? &stages[stage] : NULL;
+}
+
+const char* perf_get_stage_name(perf_stage_t stage) {
+    return (stage < PERF_STAGE_COUNT) ? stage_names[stage] : NULL;
+}
+
+uint32_t perf_get_cycles_per_us(void) {
+    return cycles_per_us;
+}
+
+//--------------------------------------------------------------------+
+// TEXT REPORT
+//--------------------------------------------------------------------+
+// Append cycles as microseconds with two decimals
+static int format_us(char* out, uint32_t size, uint64_t cycles) {
+    uint64_t hundredths = cycles * 100 / cycles_per_us;
+    return snprintf(out, size, " %lu.%02lu", (unsigned long)(hundredths / 100), (unsigned long)(hundredths % 100));
+}
+
+static uint32_t report_source(const void* context, uint32_t offset, void* buffer, uint32_t length) {
+    (void)context;
+    if (offset >= report_length) return 0;
+    if (length > report_length - offset) length = report_length - offset;
+    memcpy(buffer, report + offset, length);
+    return length;
+}
+
+bool perf_send_text_report(void) {
+    if (!cdc_tx_idle()) {
+        return false;  // The report buffer may still be streaming
+    }
+
+    uint32_t pos = 0;
+    uint32_t size = sizeof(report);
+
+    pos += snprintf(report + pos, size - pos, "PERF stage count min_us mean_us max_us (%lu MHz)\n",
+                    (unsigned long)cycles_per_us);
+
+    for (int i = 0; i < PERF_STAGE_COUNT && pos < size; i++) {
+        const perf_stage_stats_t* stats = &stages[i];
+        uint32_t mean = stats->count ? (uint32_t)(stats->total / stats->count) : 0;
+
+        pos += snprintf(report + pos, size - pos, "%s %lu", stage_names[i], (unsigned long)stats->count);
+        if (pos < size) pos += format_us(report + pos, size - pos, stats->count ? stats->min : 0);
+        if (pos < size) pos += format_us(report + pos, size - pos, mean);
+        if (pos < size) pos += format_us(report + pos, size - pos, stats->max);
+        if (pos < size) pos += snprintf(report + pos, size - pos, "\n");
+    }
+
+    // Histograms: "<stage> <bucket>:<count> ..." for non-empty buckets (bucket n < 2^n cycles)
+    for (int i = 0; i < PERF_STAGE_COUNT && pos < size; i++) {
+        pos += snprintf(report + pos, size - pos, "HIST %s", stage_names[i]);
+        for (int b = 0; b < PERF_HIST_BUCKETS && pos < size; b++) {
+            if (stages[i].histogram[b]) {
+                pos += snprintf(report + pos, size - pos, " %d:%lu", b, (unsigned long)stages[i].histogram[b]);
+            }
+        }
+        if (pos < size) pos += snprintf(report + pos, size - pos, "\n");
+    }
+
+    if (pos < size) pos += snprintf(report + pos, size - pos, "END_PERF\n");
+    report_length = (pos < size) ? pos : size - 1;
+
+    return cdc_tx_write_source(report_source, NULL, report_length);
+}
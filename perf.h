@@ -0,0 +1,81 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "hardware/structs/systick.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Per-stage cycle profiler for the main loop.
+//
+// Stages are timed with the SysTick counter running at clk_sys (24 bit,
+// counts down, wraps every ~134 ms at 125 MHz, so longer stages alias).
+// Each stage keeps count, min, max, total and a log2 histogram: bucket n
+// holds durations of [2^(n-1), 2^n) cycles. Results are returned by the
+// "PERF" text command and the BIN_OP_PERF binary request.
+
+#ifndef PERF_ENABLED
+#define PERF_ENABLED 1
+#endif
+
+typedef enum {
+    PERF_STAGE_LOOP = 0,        // Whole main loop iteration
+    PERF_STAGE_USB,             // tud_task()
+    PERF_STAGE_CDC,             // Command receive and TX pump
+    PERF_STAGE_VFS,             // USB drive commit
+    PERF_STAGE_INPUT,           // read_guitar_buttons()
+    PERF_STAGE_LEDS,            // neopixel_update_button_state()
+    PERF_STAGE_REPORT,          // Report build and submission
+    PERF_STAGE_LOG,             // Deferred log drain
+    PERF_STAGE_COUNT
+} perf_stage_t;
+
+#define PERF_HIST_BUCKETS   25  // Covers the full 24-bit SysTick range
+#define PERF_REPORT_MAX     2048
+
+typedef struct {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+    uint32_t histogram[PERF_HIST_BUCKETS];
+} perf_stage_stats_t;
+
+#define PERF_SYSTICK_MASK   0x00FFFFFF
+
+// Current cycle count (counts up, 24 bit)
+static inline uint32_t perf_now(void) {
+    return PERF_SYSTICK_MASK - (systick_hw->cvr & PERF_SYSTICK_MASK);
+}
+
+static inline uint32_t perf_elapsed(uint32_t start) {
+    return (perf_now() - start) & PERF_SYSTICK_MASK;
+}
+
+// Profiler functions
+void perf_init(void);
+void perf_reset(void);
+void perf_record(perf_stage_t stage, uint32_t cycles);
+const perf_stage_stats_t* perf_get_stage(perf_stage_t stage);
+const char* perf_get_stage_name(perf_stage_t stage);
+uint32_t perf_get_cycles_per_us(void);
+
+// Queue the text report on the CDC port, false if a previous one is still sending
+bool perf_send_text_report(void);
+
+#if PERF_ENABLED
+#define PERF_BEGIN(stage)   uint32_t perf_start_##stage = perf_now()
+#define PERF_END(stage)     perf_record(stage, perf_elapsed(perf_start_##stage))
+#else
+#define PERF_BEGIN(stage)   ((void)0)
+#define PERF_END(stage)     ((void)0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PERF_H
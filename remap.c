@@ -0,0 +1,301 @@
+#include "remap.h"
+#include "hardware/sync.h"
+#include <stdio.h>
+#include <string.h>
+
+typedef struct {
+    uint16_t mask;                          // Source bits moved by this distance
+    uint8_t left;
+    uint8_t right;
+} shift_op_t;
+
+typedef struct {
+    uint8_t source;
+    uint8_t axis;
+    int32_t delta;                          // Added while pressed
+} digital_axis_op_t;
+
+typedef struct {
+    uint8_t source;                         // Index into remap_input_t.analog
+    uint8_t axis;
+    int8_t sign;
+    int32_t offset;                         // Triggers: 32768 then >> 8
+    uint8_t shift;
+} analog_axis_op_t;
+
+typedef struct {
+    uint8_t source;
+    int8_t sign;
+    uint8_t bit;
+} analog_button_op_t;
+
+typedef struct {
+    uint8_t shift_count;
+    uint8_t digital_axis_count;
+    uint8_t analog_axis_count;
+    uint8_t analog_button_count;
+    shift_op_t shifts[REMAP_DIGITAL_SOURCES];
+    digital_axis_op_t digital_axes[REMAP_DIGITAL_SOURCES];
+    analog_axis_op_t analog_axes[REMAP_ANALOG_SOURCES];
+    analog_button_op_t analog_buttons[REMAP_ANALOG_SOURCES];
+    int32_t axis_base[REMAP_AXES];
+    bool hat_joystick;
+    char targets[REMAP_SOURCES][REMAP_TARGET_MAX];
+} remap_program_t;
+
+const char* const remap_default_targets[REMAP_SOURCES] = {
+    "a", "b", "y", "x", "lb",                       // Frets
+    "dpad_up", "dpad_down",                         // Strum, for Clone Hero
+    "start", "back", "guide",
+    "ry",                                           // Tilt
+    "dpad_up", "dpad_down", "dpad_left", "dpad_right",
+    "rx", "lx", "ly"                                // Whammy, joystick
+};
+
+static const char* const source_keys[REMAP_SOURCES] = {
+    "GREEN_FRET_map", "RED_FRET_map", "YELLOW_FRET_map", "BLUE_FRET_map", "ORANGE_FRET_map",
+    "STRUM_UP_map", "STRUM_DOWN_map", "START_map", "SELECT_map", "GUIDE_map", "TILT_map",
+    "UP_map", "DOWN_map", "LEFT_map", "RIGHT_map",
+    "WHAMMY_map", "joystick_x_map", "joystick_y_map"
+};
+
+static const char* const source_names[REMAP_SOURCES] = {
+    "green", "red", "yellow", "blue", "orange", "strum_up", "strum_down", "start", "select", "guide", "tilt",
+    "up", "down", "left", "right", "whammy", "joy_x", "joy_y"
+};
+
+static const struct {
+    const char* name;
+    uint8_t bit;
+} button_names[] = {
+    { "dpad_up", 0 }, { "dpad_down", 1 }, { "dpad_left", 2 }, { "dpad_right", 3 },
+    { "start", 4 }, { "back", 5 }, { "lstick", 6 }, { "rstick", 7 },
+    { "lb", 8 }, { "rb", 9 }, { "guide", 10 },
+    { "a", 12 }, { "b", 13 }, { "x", 14 }, { "y", 15 },
+};
+
+static const char* const axis_names[REMAP_AXES] = { "lt", "rt", "lx", "ly", "rx", "ry" };
+
+static const int32_t axis_min[REMAP_AXES] = { 0, 0, -32768, -32768, -32768, -32768 };
+static const int32_t axis_max[REMAP_AXES] = { 255, 255, 32767, 32767, 32767, 32767 };
+
+// Read in the sample clock interrupt; replaced with interrupts disabled
+static remap_program_t program;
+
+//--------------------------------------------------------------------+
+// TABLE
+//--------------------------------------------------------------------+
+bool remap_parse_target(const char* name, remap_target_t* target) {
+    memset(target, 0, sizeof(*target));
+    if (!name) return false;
+    if (strcmp(name, "none") == 0) return true;
+
+    for (size_t i = 0; i < sizeof(button_names) / sizeof(button_names[0]); i++) {
+        if (strcmp(name, button_names[i].name) == 0) {
+            target->kind = REMAP_TARGET_BUTTON;
+            target->index = button_names[i].bit;
+            return true;
+        }
+    }
+
+    for (int i = 0; i < REMAP_AXES; i++) {
+        size_t length = strlen(axis_names[i]);
+        if (strncmp(name, axis_names[i], length) != 0) continue;
+
+        const char* suffix = name + length;
+        if (suffix[0] != '\0' && (suffix[1] != '\0' || (suffix[0] != '+' && suffix[0] != '-'))) {
+            return false;
+        }
+        target->kind = REMAP_TARGET_AXIS;
+        target->index = (uint8_t)i;
+        target->direction = (int8_t)((suffix[0] == '+') - (suffix[0] == '-'));
+        return true;
+    }
+    return false;
+}
+
+bool remap_validate_target(remap_source_t source, const char* name) {
+    remap_target_t target;
+    return source < REMAP_SOURCES && remap_parse_target(name, &target) && strlen(name) < REMAP_TARGET_MAX;
+}
+
+// The d-pad as the left stick: up is +Y
+static void hat_to_stick(remap_target_t* target) {
+    static const struct { uint8_t axis; int8_t direction; } stick[4] = {
+        { REMAP_AXIS_LY, 1 }, { REMAP_AXIS_LY, -1 }, { REMAP_AXIS_LX, -1 }, { REMAP_AXIS_LX, 1 }
+    };
+    if (target->kind != REMAP_TARGET_BUTTON || target->index > 3) return;
+
+    uint8_t dpad = target->index;
+    target->kind = REMAP_TARGET_AXIS;
+    target->index = stick[dpad].axis;
+    target->direction = stick[dpad].direction;
+}
+
+static bool compile(remap_program_t* next, const char* const targets[REMAP_SOURCES], bool hat_joystick) {
+    memset(next, 0, sizeof(*next));
+    next->hat_joystick = hat_joystick;
+
+    for (int source = 0; source < REMAP_SOURCES; source++) {
+        remap_target_t target;
+        if (!remap_validate_target((remap_source_t)source, targets[source])) {
+            return false;
+        }
+        remap_parse_target(targets[source], &target);
+        snprintf(next->targets[source], REMAP_TARGET_MAX, "%s", targets[source]);
+        if (hat_joystick && source >= REMAP_UP && source <= REMAP_RIGHT) {
+            hat_to_stick(&target);
+        }
+
+        bool digital = source < REMAP_DIGITAL_SOURCES;
+        bool trigger = target.kind == REMAP_TARGET_AXIS && target.index <= REMAP_AXIS_RT;
+
+        if (target.kind == REMAP_TARGET_BUTTON && digital) {
+            // One op per distance between source and target bit
+            int distance = (int)target.index - source;
+            uint8_t left = (uint8_t)(distance > 0 ? distance : 0);
+            uint8_t right = (uint8_t)(distance < 0 ? -distance : 0);
+            shift_op_t* op = NULL;
+            for (uint8_t i = 0; i < next->shift_count; i++) {
+                if (next->shifts[i].left == left && next->shifts[i].right == right) op = &next->shifts[i];
+            }
+            if (!op) {
+                op = &next->shifts[next->shift_count++];
+                op->left = left;
+                op->right = right;
+            }
+            op->mask |= (uint16_t)(1u << source);
+        } else if (target.kind == REMAP_TARGET_BUTTON) {
+            analog_button_op_t* op = &next->analog_buttons[next->analog_button_count++];
+            op->source = (uint8_t)(source - REMAP_DIGITAL_SOURCES);
+            op->sign = (int8_t)(target.direction < 0 ? -1 : 1);
+            op->bit = target.index;
+        } else if (target.kind == REMAP_TARGET_AXIS && digital) {
+            digital_axis_op_t* op = &next->digital_axes[next->digital_axis_count++];
+            op->source = (uint8_t)source;
+            op->axis = target.index;
+            if (trigger) {
+                op->delta = 255;
+            } else if (target.direction > 0) {
+                op->delta = 32767;
+            } else if (target.direction < 0) {
+                op->delta = -32768;
+            } else {
+                // Whole-axis swing
+                next->axis_base[target.index] += 32767;
+                op->delta = -65535;
+            }
+        } else if (target.kind == REMAP_TARGET_AXIS) {
+            analog_axis_op_t* op = &next->analog_axes[next->analog_axis_count++];
+            op->source = (uint8_t)(source - REMAP_DIGITAL_SOURCES);
+            op->axis = target.index;
+            op->sign = (int8_t)(target.direction < 0 ? -1 : 1);
+            op->offset = trigger ? 32768 : 0;
+            op->shift = trigger ? 8 : 0;
+        }
+    }
+    return true;
+}
+
+bool remap_set(const char* const targets[REMAP_SOURCES], bool hat_joystick) {
+    static remap_program_t next;            // Too big for the stack of a command handler
+    if (!compile(&next, targets, hat_joystick)) {
+        return false;
+    }
+
+    uint32_t interrupts = save_and_disable_interrupts();
+    program = next;
+    restore_interrupts(interrupts);
+    return true;
+}
+
+void remap_load(const config_t* config) {
+    const char* const targets[REMAP_SOURCES] = {
+        config->GREEN_FRET_map, config->RED_FRET_map, config->YELLOW_FRET_map, config->BLUE_FRET_map,
+        config->ORANGE_FRET_map, config->STRUM_UP_map, config->STRUM_DOWN_map, config->START_map,
+        config->SELECT_map, config->GUIDE_map, config->TILT_map,
+        config->UP_map, config->DOWN_map, config->LEFT_map, config->RIGHT_map,
+        config->WHAMMY_map, config->joystick_x_map, config->joystick_y_map
+    };
+
+    // config_validate() has checked the targets; an invalid table stays as it was
+    remap_set(targets, config->hat_mode && strcmp(config->hat_mode, "joystick") == 0);
+}
+
+bool remap_set_target(remap_source_t source, const char* name) {
+    if (!remap_validate_target(source, name)) {
+        return false;
+    }
+
+    // Only the main loop changes the table, so the current one can be read as is
+    const char* targets[REMAP_SOURCES];
+    for (int i = 0; i < REMAP_SOURCES; i++) {
+        targets[i] = program.targets[i];
+    }
+    targets[source] = name;
+    return remap_set(targets, program.hat_joystick);
+}
+
+const char* remap_source_key(remap_source_t source) {
+    return source < REMAP_SOURCES ? source_keys[source] : NULL;
+}
+
+remap_source_t remap_find_source(const char* name) {
+    for (int i = 0; i < REMAP_SOURCES; i++) {
+        if (strcmp(name, source_names[i]) == 0) return (remap_source_t)i;
+    }
+    return REMAP_SOURCES;
+}
+
+//--------------------------------------------------------------------+
+// MAPPING
+//--------------------------------------------------------------------+
+void remap_apply(const remap_input_t* input, remap_output_t* output) {
+    const remap_program_t* p = &program;
+    uint32_t digital = input->digital;
+
+    uint32_t buttons = 0;
+    for (uint8_t i = 0; i < p->shift_count; i++) {
+        buttons |= ((digital & p->shifts[i].mask) << p->shifts[i].left) >> p->shifts[i].right;
+    }
+    for (uint8_t i = 0; i < p->analog_button_count; i++) {
+        const analog_button_op_t* op = &p->analog_buttons[i];
+        int32_t value = op->sign * input->analog[op->source];
+        buttons |= ((uint32_t)(REMAP_ANALOG_BUTTON_THRESHOLD - value) >> 31) << op->bit;
+    }
+
+    int32_t axes[REMAP_AXES];
+    memcpy(axes, p->axis_base, sizeof(axes));
+    for (uint8_t i = 0; i < p->digital_axis_count; i++) {
+        const digital_axis_op_t* op = &p->digital_axes[i];
+        axes[op->axis] += (int32_t)((digital >> op->source) & 1u) * op->delta;
+    }
+    for (uint8_t i = 0; i < p->analog_axis_count; i++) {
+        const analog_axis_op_t* op = &p->analog_axes[i];
+        axes[op->axis] += (op->sign * input->analog[op->source] + op->offset) >> op->shift;
+    }
+    for (int i = 0; i < REMAP_AXES; i++) {
+        if (axes[i] < axis_min[i]) axes[i] = axis_min[i];
+        if (axes[i] > axis_max[i]) axes[i] = axis_max[i];
+    }
+
+    output->buttons = (uint16_t)buttons;
+    output->lt = (uint8_t)axes[REMAP_AXIS_LT];
+    output->rt = (uint8_t)axes[REMAP_AXIS_RT];
+    output->lx = (int16_t)axes[REMAP_AXIS_LX];
+    output->ly = (int16_t)axes[REMAP_AXIS_LY];
+    output->rx = (int16_t)axes[REMAP_AXIS_RX];
+    output->ry = (int16_t)axes[REMAP_AXIS_RY];
+}
+
+uint32_t remap_format_report(char* out, uint32_t size) {
+    int length = snprintf(out, size, "REMAP hat %s shifts %u", program.hat_joystick ? "joystick" : "dpad",
+                          program.shift_count);
+    for (int i = 0; i < REMAP_SOURCES && length > 0 && length < (int)size; i++) {
+        length += snprintf(out + length, size - length, " %s:%s", source_names[i], program.targets[i]);
+    }
+    if (length > 0 && length < (int)size) {
+        length += snprintf(out + length, size - length, "\n");
+    }
+    return (length < (int)size) ? (uint32_t)length : size - 1;
+}
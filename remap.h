@@ -0,0 +1,133 @@
+#ifndef REMAP_H
+#define REMAP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Input remapping: physical controls to XInput controls.
+//
+// config.json names an XInput target for every source ("GREEN_FRET_map":
+// "a", "WHAMMY_map": "rx"...). Targets:
+//   a b x y lb rb start back guide lstick rstick
+//   dpad_up dpad_down dpad_left dpad_right      buttons
+//   lt rt                                       triggers, 0-255
+//   lx ly rx ry                                 stick axes
+//   none
+// An axis name may end in "+" or "-":
+//   button on "lx+" / "lx-"   adds full deflection that way while pressed
+//   button on "ry"            swings the whole axis: +32767 released,
+//                             -32768 pressed (the Guitar Hero tilt convention)
+//   analog on "lx-"           inverted
+//   analog on a button        pressed past half travel from centre
+//                             (REMAP_ANALOG_BUTTON_THRESHOLD)
+// Several sources on one button are ORed; on an axis they add up, clamped.
+// hat_mode "joystick" moves the UP/DOWN/LEFT/RIGHT sources that target the
+// d-pad onto the left stick.
+//
+// The table is compiled at config load. Buttons become one mask-and-shift
+// per distinct distance between a source bit and its target bit, so the
+// common case is a handful of AND/shift/OR steps with no branches; axes
+// become a base plus a multiply-add per source.
+
+// Analog value a source mapped to a button must exceed: half of the stick's
+// deflection, so a centred stick (0) reads released
+#define REMAP_ANALOG_BUTTON_THRESHOLD   16383
+
+typedef enum {
+    REMAP_GREEN = 0,
+    REMAP_RED,
+    REMAP_YELLOW,
+    REMAP_BLUE,
+    REMAP_ORANGE,
+    REMAP_STRUM_UP,
+    REMAP_STRUM_DOWN,
+    REMAP_START,
+    REMAP_SELECT,
+    REMAP_GUIDE,
+    REMAP_TILT,
+    REMAP_UP,
+    REMAP_DOWN,
+    REMAP_LEFT,
+    REMAP_RIGHT,
+    REMAP_DIGITAL_SOURCES,                  // Bits of remap_input_t.digital
+
+    REMAP_WHAMMY = REMAP_DIGITAL_SOURCES,
+    REMAP_JOY_X,
+    REMAP_JOY_Y,
+    REMAP_SOURCES
+} remap_source_t;
+
+#define REMAP_ANALOG_SOURCES    (REMAP_SOURCES - REMAP_DIGITAL_SOURCES)
+#define REMAP_TARGET_MAX        16          // Longest target name kept from config.json
+#define REMAP_REPORT_MAX        384
+
+typedef enum {
+    REMAP_AXIS_LT = 0,
+    REMAP_AXIS_RT,
+    REMAP_AXIS_LX,
+    REMAP_AXIS_LY,
+    REMAP_AXIS_RX,
+    REMAP_AXIS_RY,
+    REMAP_AXES
+} remap_axis_t;
+
+typedef enum {
+    REMAP_TARGET_NONE = 0,
+    REMAP_TARGET_BUTTON,                    // index: bit in wButtons
+    REMAP_TARGET_AXIS                       // index: remap_axis_t
+} remap_target_kind_t;
+
+typedef struct {
+    remap_target_kind_t kind;
+    uint8_t index;
+    int8_t direction;                       // Axis suffix: +1, -1, 0 for none
+} remap_target_t;
+
+typedef struct {
+    uint16_t digital;                       // Bit per digital source, 1 = pressed
+    int16_t analog[REMAP_ANALOG_SOURCES];   // Stick form, -32768 to 32767 (whammy: travel - 32768)
+} remap_input_t;
+
+typedef struct {
+    uint16_t buttons;                       // XInput wButtons
+    uint8_t lt;
+    uint8_t rt;
+    int16_t lx;
+    int16_t ly;
+    int16_t rx;
+    int16_t ry;
+} remap_output_t;
+
+// Table functions
+bool remap_parse_target(const char* name, remap_target_t* target);
+bool remap_validate_target(remap_source_t source, const char* name);
+bool remap_set(const char* const targets[REMAP_SOURCES], bool hat_joystick);   // false: invalid, table unchanged
+void remap_load(const config_t* config);
+
+// Built-in table: the default config.json mapping
+extern const char* const remap_default_targets[REMAP_SOURCES];
+
+// Retarget one source of the current table ("REMAP:" command), false: invalid
+bool remap_set_target(remap_source_t source, const char* name);
+
+// Config key of a source ("GREEN_FRET_map"...)
+const char* remap_source_key(remap_source_t source);
+
+// Source by its command name ("green", "strum_up", "whammy"...); REMAP_SOURCES if unknown
+remap_source_t remap_find_source(const char* name);
+
+void remap_apply(const remap_input_t* input, remap_output_t* output);
+
+// Render the text report ("REMAP" command), returns its length
+uint32_t remap_format_report(char* out, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // REMAP_H
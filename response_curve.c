@@ -0,0 +1,185 @@
+#include "response_curve.h"
+#include "hardware/sync.h"
+#include <stdio.h>
+#include <string.h>
+
+#define SEGMENT_BITS    10      // 65536 / RESPONSE_CURVE_SEGMENTS
+
+typedef enum {
+    CURVE_LINEAR = 0,
+    CURVE_EXPO,
+    CURVE_SCURVE,
+    CURVE_POINTS
+} curve_kind_t;
+
+typedef struct {
+    curve_kind_t kind;
+    uint8_t weight;                                 // expo / scurve, percent
+    uint8_t points[RESPONSE_CURVE_POINTS_MAX];      // percent
+    uint8_t point_count;
+} curve_spec_t;
+
+typedef struct {
+    bool linear;
+    uint16_t table[RESPONSE_CURVE_SEGMENTS + 1];
+    char spec[RESPONSE_CURVE_SPEC_MAX];
+} curve_t;
+
+// Read in the sample clock interrupt; replaced with interrupts disabled
+static curve_t curves[RESPONSE_CURVE_AXES] = {
+    { .linear = true, .spec = "linear" },
+    { .linear = true, .spec = "linear" },
+    { .linear = true, .spec = "linear" },
+};
+
+static const char* const axis_names[RESPONSE_CURVE_AXES] = { "whammy", "joy_x", "joy_y" };
+
+//--------------------------------------------------------------------+
+// SPEC PARSING
+//--------------------------------------------------------------------+
+// 0-100, returns the character after it or NULL
+static const char* parse_percent(const char* text, uint8_t* value) {
+    uint32_t number = 0;
+    int digits = 0;
+    while (*text >= '0' && *text <= '9') {
+        number = number * 10 + (uint32_t)(*text++ - '0');
+        if (++digits > 3) return NULL;
+    }
+    if (digits == 0 || number > 100) return NULL;
+    *value = (uint8_t)number;
+    return text;
+}
+
+static bool parse_spec(const char* spec, curve_spec_t* curve) {
+    memset(curve, 0, sizeof(*curve));
+    if (!spec || strlen(spec) >= RESPONSE_CURVE_SPEC_MAX) return false;
+
+    if (strcmp(spec, "linear") == 0) {
+        curve->kind = CURVE_LINEAR;
+        return true;
+    }
+    if (strncmp(spec, "expo:", 5) == 0 || strncmp(spec, "scurve:", 7) == 0) {
+        curve->kind = (spec[0] == 'e') ? CURVE_EXPO : CURVE_SCURVE;
+        const char* end = parse_percent(strchr(spec, ':') + 1, &curve->weight);
+        return end && *end == '\0';
+    }
+    if (strncmp(spec, "points:", 7) == 0) {
+        curve->kind = CURVE_POINTS;
+        const char* text = spec + 7;
+        while (curve->point_count < RESPONSE_CURVE_POINTS_MAX) {
+            text = parse_percent(text, &curve->points[curve->point_count]);
+            if (!text) return false;
+            curve->point_count++;
+            if (*text == '\0') return curve->point_count >= 2;
+            if (*text++ != ',') return false;
+        }
+        return false;
+    }
+    return false;
+}
+
+//--------------------------------------------------------------------+
+// COMPILATION
+//--------------------------------------------------------------------+
+// Exact curve value for an input of 0-65535; only used to fill the table
+static uint32_t curve_level(const curve_spec_t* curve, uint32_t x) {
+    uint64_t x3 = (uint64_t)x * x * x / (65535ull * 65535ull);
+
+    switch (curve->kind) {
+        case CURVE_EXPO:
+            return ((100u - curve->weight) * x + curve->weight * (uint32_t)x3) / 100u;
+        case CURVE_SCURVE: {
+            uint32_t x2 = (uint32_t)((uint64_t)x * x / 65535u);
+            uint32_t smooth = 3 * x2 - 2 * (uint32_t)x3;
+            return ((100u - curve->weight) * x + curve->weight * smooth) / 100u;
+        }
+        case CURVE_POINTS: {
+            uint32_t position = x * (uint32_t)(curve->point_count - 1);   // < 2^20
+            uint32_t segment = position / 65535u;
+            if (segment >= (uint32_t)(curve->point_count - 1)) {
+                return curve->points[curve->point_count - 1] * 65535u / 100u;
+            }
+            int32_t from = (int32_t)(curve->points[segment] * 65535u / 100u);
+            int32_t to = (int32_t)(curve->points[segment + 1] * 65535u / 100u);
+            return (uint32_t)(from + (int32_t)((int64_t)(to - from) * (position % 65535u) / 65535));
+        }
+        default:
+            return x;
+    }
+}
+
+static void compile(curve_t* target, const curve_spec_t* curve, const char* spec) {
+    target->linear = (curve->kind == CURVE_LINEAR);
+    for (uint32_t i = 0; i <= RESPONSE_CURVE_SEGMENTS; i++) {
+        uint32_t x = i << SEGMENT_BITS;
+        if (x > 65535) x = 65535;
+        uint32_t level = curve_level(curve, x);
+        target->table[i] = (uint16_t)(level > 65535 ? 65535 : level);
+    }
+    snprintf(target->spec, sizeof(target->spec), "%s", spec);
+}
+
+//--------------------------------------------------------------------+
+// CURVES
+//--------------------------------------------------------------------+
+bool response_curve_validate(const char* spec) {
+    curve_spec_t curve;
+    return parse_spec(spec, &curve);
+}
+
+bool response_curve_set(response_curve_axis_t axis, const char* spec) {
+    curve_spec_t curve;
+    if (axis >= RESPONSE_CURVE_AXES || !parse_spec(spec, &curve)) {
+        return false;
+    }
+
+    curve_t next;
+    compile(&next, &curve, spec);
+
+    uint32_t interrupts = save_and_disable_interrupts();
+    curves[axis] = next;
+    restore_interrupts(interrupts);
+    return true;
+}
+
+void response_curve_load(const config_t* config) {
+    // config_validate() has checked the specs; an invalid one stays as it was
+    response_curve_set(RESPONSE_CURVE_WHAMMY, config->whammy_curve);
+    response_curve_set(RESPONSE_CURVE_JOY_X, config->joystick_x_curve);
+    response_curve_set(RESPONSE_CURVE_JOY_Y, config->joystick_y_curve);
+}
+
+uint16_t response_curve_apply(response_curve_axis_t axis, uint16_t value) {
+    const curve_t* curve = &curves[axis];
+    if (curve->linear) return value;
+
+    uint32_t segment = value >> SEGMENT_BITS;
+    int32_t from = curve->table[segment];
+    int32_t to = curve->table[segment + 1];
+    int32_t fraction = value & ((1 << SEGMENT_BITS) - 1);
+    return (uint16_t)(from + (((to - from) * fraction) >> SEGMENT_BITS));
+}
+
+int16_t response_curve_apply_signed(response_curve_axis_t axis, int16_t value) {
+    if (curves[axis].linear) return value;
+
+    // Distance from center 0-32767, bit-extended so 32767 maps to 65535
+    uint32_t distance = (value < 0) ? (uint32_t)-(int32_t)value : (uint32_t)value;
+    if (distance > 32767) distance = 32767;
+    uint32_t shaped = response_curve_apply(axis, (uint16_t)((distance << 1) | (distance >> 14))) >> 1;
+    return (value < 0) ? (int16_t)-(int32_t)shaped : (int16_t)shaped;
+}
+
+response_curve_axis_t response_curve_find_axis(const char* name) {
+    for (int i = 0; i < RESPONSE_CURVE_AXES; i++) {
+        if (strcmp(name, axis_names[i]) == 0) return (response_curve_axis_t)i;
+    }
+    return RESPONSE_CURVE_AXES;
+}
+
+uint32_t response_curve_format_report(char* out, uint32_t size) {
+    int length = snprintf(out, size, "CURVE %s %s %s %s %s %s\n",
+                          axis_names[0], curves[0].spec, axis_names[1], curves[1].spec,
+                          axis_names[2], curves[2].spec);
+    return (length < (int)size) ? (uint32_t)length : size - 1;
+}
@@ -0,0 +1,62 @@
+#ifndef RESPONSE_CURVE_H
+#define RESPONSE_CURVE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Analog response curves.
+//
+// Each axis has a curve spec in config.json (whammy_curve,
+// joystick_x_curve, joystick_y_curve):
+//   "linear"                  output = input
+//   "expo:<k>"                (1 - k) x + k x^3, k in percent: finer
+//                             control near the rest position
+//   "scurve:<k>"              (1 - k) x + k (3x^2 - 2x^3): soft at both
+//                             ends, steep in the middle
+//   "points:<p0>,...,<pn>"    2-9 output levels in percent, evenly spaced
+//                             over the input travel, joined by lines
+// Whatever the spec, it is compiled at config load into a table of
+// RESPONSE_CURVE_SEGMENTS + 1 levels over the 16-bit input. A sample costs
+// one lookup and one multiply-add to interpolate within its segment.
+// "linear" skips the table and is exact.
+//
+// The whammy curve runs on its calibrated 0-65535 travel. The joystick
+// curves run on the distance from center and keep the sign, so "expo"
+// gives precision around the center in both directions.
+
+#define RESPONSE_CURVE_SEGMENTS     64
+#define RESPONSE_CURVE_POINTS_MAX   9
+#define RESPONSE_CURVE_SPEC_MAX     48  // Longest spec kept from config.json
+#define RESPONSE_CURVE_REPORT_MAX   192
+
+typedef enum {
+    RESPONSE_CURVE_WHAMMY = 0,
+    RESPONSE_CURVE_JOY_X,
+    RESPONSE_CURVE_JOY_Y,
+    RESPONSE_CURVE_AXES
+} response_curve_axis_t;
+
+// Curve functions
+bool response_curve_validate(const char* spec);
+bool response_curve_set(response_curve_axis_t axis, const char* spec);  // false: invalid, curve unchanged
+void response_curve_load(const config_t* config);
+
+uint16_t response_curve_apply(response_curve_axis_t axis, uint16_t value);
+int16_t response_curve_apply_signed(response_curve_axis_t axis, int16_t value);
+
+// Axis by its command name ("whammy", "joy_x", "joy_y"); RESPONSE_CURVE_AXES if unknown
+response_curve_axis_t response_curve_find_axis(const char* name);
+
+// Render the text report ("CURVE" command), returns its length
+uint32_t response_curve_format_report(char* out, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RESPONSE_CURVE_H
@@ -0,0 +1,165 @@
+#include "sample_clock.h"
+#include "pico/stdlib.h"
+#include "hardware/timer.h"
+#include "hardware/sync.h"
+#include <stdio.h>
+#include <string.h>
+
+static int alarm_num = -1;
+static bool running = false;
+static uint32_t period_us = SAMPLE_CLOCK_DEFAULT_US;
+static sample_clock_policy_t policy = SAMPLE_CLOCK_SKIP;
+static sample_clock_callback_t tick_callback = NULL;
+static uint64_t target_us = 0;          // Grid point the alarm is armed for
+static uint64_t last_tick_us = 0;       // 0 = no previous tick to measure against
+
+// Written in the alarm interrupt; read with interrupts disabled
+static uint32_t tick_count = 0;
+static uint32_t missed_count = 0;
+static uint32_t late_max_us = 0;
+static uint64_t late_total_us = 0;
+static uint32_t jitter_max_us = 0;
+
+static void run_tick(uint64_t target) {
+    uint64_t now = time_us_64();
+    uint32_t late = (uint32_t)(now - target);
+
+    if (late > late_max_us) late_max_us = late;
+    late_total_us += late;
+
+    if (last_tick_us) {
+        uint32_t interval = (uint32_t)(now - last_tick_us);
+        uint32_t jitter = interval > period_us ? interval - period_us : period_us - interval;
+        if (jitter > jitter_max_us) jitter_max_us = jitter;
+    }
+    last_tick_us = now;
+    tick_count++;
+
+    tick_callback((uint32_t)now);
+}
+
+static void alarm_callback(uint alarm) {
+    uint32_t burst = 0;
+
+    while (true) {
+        run_tick(target_us);
+
+        // Next grid point, never "now + period", so lateness does not accumulate
+        target_us += period_us;
+
+        uint64_t now = time_us_64();
+        if (now >= target_us) {
+            if (policy == SAMPLE_CLOCK_CATCH_UP && ++burst < SAMPLE_CLOCK_MAX_BURST) {
+                continue;
+            }
+            uint32_t behind = (uint32_t)((now - target_us) / period_us) + 1;
+            missed_count += behind;
+            target_us += (uint64_t)behind * period_us;
+        }
+
+        if (!hardware_alarm_set_target(alarm, from_us_since_boot(target_us))) {
+            return;
+        }
+        // The target passed while arming: serve it straight away
+    }
+}
+
+//--------------------------------------------------------------------+
+// CLOCK CONTROL
+//--------------------------------------------------------------------+
+bool sample_clock_start(uint32_t period, sample_clock_policy_t tick_policy, sample_clock_callback_t callback) {
+    if (period < SAMPLE_CLOCK_MIN_US || period > SAMPLE_CLOCK_MAX_US || !callback) {
+        return false;
+    }
+
+    if (alarm_num < 0) {
+        alarm_num = hardware_alarm_claim_unused(false);
+        if (alarm_num < 0) {
+            printf("Sample clock: No free hardware alarm\n");
+            return false;
+        }
+        hardware_alarm_set_callback((uint)alarm_num, alarm_callback);
+    }
+
+    period_us = period;
+    policy = tick_policy;
+    tick_callback = callback;
+    last_tick_us = 0;
+    sample_clock_reset_stats();
+
+    target_us = time_us_64() + period_us;
+    running = true;
+    while (hardware_alarm_set_target((uint)alarm_num, from_us_since_boot(target_us))) {
+        target_us += period_us;
+    }
+    return true;
+}
+
+void sample_clock_stop(void) {
+    if (running) {
+        hardware_alarm_cancel((uint)alarm_num);
+        running = false;
+    }
+}
+
+bool sample_clock_set_period(uint32_t period) {
+    if (period < SAMPLE_CLOCK_MIN_US || period > SAMPLE_CLOCK_MAX_US) {
+        return false;
+    }
+
+    // Takes effect from the target already armed
+    uint32_t interrupts = save_and_disable_interrupts();
+    period_us = period;
+    last_tick_us = 0;
+    restore_interrupts(interrupts);
+    return true;
+}
+
+void sample_clock_set_policy(sample_clock_policy_t tick_policy) {
+    policy = tick_policy;
+}
+
+uint32_t sample_clock_get_period(void) {
+    return period_us;
+}
+
+sample_clock_policy_t sample_clock_get_policy(void) {
+    return policy;
+}
+
+//--------------------------------------------------------------------+
+// STATISTICS
+//--------------------------------------------------------------------+
+void sample_clock_get_stats(sample_clock_stats_t* stats) {
+    uint32_t interrupts = save_and_disable_interrupts();
+    stats->ticks = tick_count;
+    stats->missed = missed_count;
+    stats->late_max_us = late_max_us;
+    stats->late_mean_us = tick_count ? (uint32_t)(late_total_us / tick_count) : 0;
+    stats->jitter_max_us = jitter_max_us;
+    restore_interrupts(interrupts);
+}
+
+void sample_clock_reset_stats(void) {
+    uint32_t interrupts = save_and_disable_interrupts();
+    tick_count = 0;
+    missed_count = 0;
+    late_max_us = 0;
+    late_total_us = 0;
+    jitter_max_us = 0;
+    restore_interrupts(interrupts);
+}
+
+uint32_t sample_clock_format_report(char* out, uint32_t size) {
+    sample_clock_stats_t stats;
+    sample_clock_get_stats(&stats);
+
+    int length = snprintf(out, size,
+                          "CLOCK period_us %lu policy %s ticks %lu missed %lu late_max_us %lu "
+                          "late_mean_us %lu jitter_max_us %lu\n",
+                          (unsigned long)period_us, policy == SAMPLE_CLOCK_CATCH_UP ? "catchup" : "skip",
+                          (unsigned long)stats.ticks, (unsigned long)stats.missed,
+                          (unsigned long)stats.late_max_us, (unsigned long)stats.late_mean_us,
+                          (unsigned long)stats.jitter_max_us);
+    return (length < (int)size) ? (uint32_t)length : size - 1;
+}
@@ -0,0 +1,65 @@
+#ifndef SAMPLE_CLOCK_H
+#define SAMPLE_CLOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Input sampling clock on a hardware timer alarm.
+//
+// The tick callback runs in the alarm interrupt at a fixed microsecond
+// period. Targets are kept on the grid start + n * period, so the clock
+// never drifts however late an interrupt is served. When ticks are missed
+// (interrupts held off, e.g. by a flash erase: a config save, the drive's
+// log erase-ahead in vfs_task or the file slot erase-ahead in file_emu_task,
+// about 45 ms per sector) the policy decides:
+//   SKIP      drop the missed ticks, resume on the next grid point
+//   CATCH_UP  run the missed ticks back to back, at most
+//             SAMPLE_CLOCK_MAX_BURST of them, then skip the rest
+// Lateness (tick run time - target) and the interval between consecutive
+// ticks are tracked; the "CLOCK" command reports them.
+
+#define SAMPLE_CLOCK_MIN_US         125
+#define SAMPLE_CLOCK_MAX_US         8000
+#define SAMPLE_CLOCK_DEFAULT_US     1000
+#define SAMPLE_CLOCK_MAX_BURST      4
+#define SAMPLE_CLOCK_REPORT_MAX     256
+
+typedef enum {
+    SAMPLE_CLOCK_SKIP = 0,
+    SAMPLE_CLOCK_CATCH_UP
+} sample_clock_policy_t;
+
+typedef void (*sample_clock_callback_t)(uint32_t now_us);
+
+typedef struct {
+    uint32_t ticks;
+    uint32_t missed;            // Grid points dropped by the policy
+    uint32_t late_max_us;       // Worst tick run time - target
+    uint32_t late_mean_us;
+    uint32_t jitter_max_us;     // Worst |interval - period| between ticks
+} sample_clock_stats_t;
+
+// Clock functions
+bool sample_clock_start(uint32_t period_us, sample_clock_policy_t policy, sample_clock_callback_t callback);
+void sample_clock_stop(void);
+bool sample_clock_set_period(uint32_t period_us);   // false if out of range
+void sample_clock_set_policy(sample_clock_policy_t policy);
+uint32_t sample_clock_get_period(void);
+sample_clock_policy_t sample_clock_get_policy(void);
+
+// Statistics
+void sample_clock_get_stats(sample_clock_stats_t* stats);
+void sample_clock_reset_stats(void);
+
+// Render the text report ("CLOCK" command), returns its length
+uint32_t sample_clock_format_report(char* out, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SAMPLE_CLOCK_H
@@ -0,0 +1,181 @@
+#include "sched.h"
+#include "pico/stdlib.h"
+#include <stdio.h>
+#include <string.h>
+
+typedef struct {
+    uint32_t release_us;        // Release being served (valid while released)
+    uint32_t next_us;           // Next periodic release
+    uint32_t period_us;         // From the table unless changed with sched_set_period()
+    bool released;
+} sched_state_t;
+
+static const sched_task_t* task_table = NULL;
+static uint8_t task_count = 0;
+static uint8_t order[SCHED_MAX_TASKS];  // Task indexes, most urgent first
+static sched_state_t state[SCHED_MAX_TASKS];
+static sched_stats_t stats[SCHED_MAX_TASKS];
+
+static void release_tasks(uint32_t now_us) {
+    for (uint8_t i = 0; i < task_count; i++) {
+        const sched_task_t* task = &task_table[i];
+        sched_state_t* s = &state[i];
+
+        if (s->period_us == 0) {
+            if (!s->released && (!task->has_work || task->has_work())) {
+                s->released = true;
+                s->release_us = now_us;
+            }
+            continue;
+        }
+
+        if ((int32_t)(now_us - s->next_us) < 0) continue;
+
+        if (s->released) {
+            stats[i].skipped++;
+        } else {
+            s->released = true;
+            s->release_us = s->next_us;
+        }
+        s->next_us += s->period_us;
+
+        // More than a period behind: drop the missed releases, keep the phase
+        if ((int32_t)(now_us - s->next_us) >= 0) {
+            uint32_t behind = (now_us - s->next_us) / s->period_us + 1;
+            stats[i].skipped += behind;
+            s->next_us += behind * s->period_us;
+        }
+    }
+}
+
+//--------------------------------------------------------------------+
+// SCHEDULING
+//--------------------------------------------------------------------+
+void sched_init(const sched_task_t* tasks, uint8_t count) {
+    task_table = tasks;
+    task_count = count > SCHED_MAX_TASKS ? SCHED_MAX_TASKS : count;
+
+    // Stable sort by priority, so equal priorities keep table order
+    for (uint8_t i = 0; i < task_count; i++) {
+        uint8_t j = i;
+        while (j > 0 && tasks[order[j - 1]].priority > tasks[i].priority) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+
+    uint32_t now_us = time_us_32();
+    for (uint8_t i = 0; i < task_count; i++) {
+        state[i].released = false;
+        state[i].next_us = now_us;
+        state[i].period_us = tasks[i].period_us;
+    }
+    sched_reset_stats();
+}
+
+bool sched_set_period(uint8_t task, uint32_t period_us) {
+    // Event-driven tasks stay event driven
+    if (task >= task_count || task_table[task].period_us == 0 || period_us == 0) return false;
+
+    state[task].period_us = period_us;
+    state[task].next_us = time_us_32() + period_us;
+    return true;
+}
+
+void sched_run(void) {
+    uint32_t ran = 0;   // Each task gets at most one slice per pass
+
+    release_tasks(time_us_32());
+
+    while (true) {
+        int pick = -1;
+        for (uint8_t n = 0; n < task_count; n++) {
+            uint8_t i = order[n];
+            if (state[i].released && !(ran & (1u << i))) {
+                pick = i;
+                break;
+            }
+        }
+        if (pick < 0) return;
+
+        const sched_task_t* task = &task_table[pick];
+        sched_stats_t* task_stats = &stats[pick];
+        ran |= 1u << pick;
+
+        uint32_t start_us = time_us_32();
+        bool finished = task->run();
+        uint32_t end_us = time_us_32();
+
+        task_stats->runs++;
+        if (end_us - start_us > task_stats->max_run_us) {
+            task_stats->max_run_us = end_us - start_us;
+        }
+
+        if (finished) {
+            uint32_t late_us = end_us - state[pick].release_us;
+            state[pick].released = false;
+            if (late_us > task_stats->max_late_us) task_stats->max_late_us = late_us;
+            if (task->deadline_us && late_us > task->deadline_us) task_stats->overruns++;
+        }
+
+        // Releases that came due during the slice compete straight away
+        release_tasks(end_us);
+    }
+}
+
+bool sched_work_pending(void) {
+    uint32_t now_us = time_us_32();
+
+    for (uint8_t i = 0; i < task_count; i++) {
+        const sched_task_t* task = &task_table[i];
+        if (state[i].released) return true;
+        if (state[i].period_us == 0) {
+            if (!task->has_work || task->has_work()) return true;
+        } else if ((int32_t)(now_us - state[i].next_us) >= 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t sched_next_release_us(void) {
+    uint32_t now_us = time_us_32();
+    uint32_t next_us = now_us + SCHED_IDLE_MAX_US;
+
+    for (uint8_t i = 0; i < task_count; i++) {
+        if (state[i].period_us && (int32_t)(state[i].next_us - next_us) < 0) {
+            next_us = state[i].next_us;
+        }
+    }
+    return next_us;
+}
+
+//--------------------------------------------------------------------+
+// RESULTS
+//--------------------------------------------------------------------+
+void sched_reset_stats(void) {
+    memset(stats, 0, sizeof(stats));
+}
+
+const sched_stats_t* sched_get_stats(uint8_t task) {
+    return (task < task_count) ? &stats[task] : NULL;
+}
+
+uint32_t sched_format_report(char* out, uint32_t size) {
+    uint32_t pos = snprintf(out, size,
+                            "SCHED task prio period_us deadline_us runs overruns skipped max_late_us max_run_us\n");
+
+    for (uint8_t n = 0; n < task_count && pos < size; n++) {
+        uint8_t i = order[n];
+        const sched_task_t* task = &task_table[i];
+        pos += snprintf(out + pos, size - pos, "%s %u %lu %lu %lu %lu %lu %lu %lu\n", task->name,
+                        task->priority, (unsigned long)state[i].period_us,
+                        (unsigned long)task->deadline_us, (unsigned long)stats[i].runs,
+                        (unsigned long)stats[i].overruns, (unsigned long)stats[i].skipped,
+                        (unsigned long)stats[i].max_late_us, (unsigned long)stats[i].max_run_us);
+    }
+
+    if (pos < size) pos += snprintf(out + pos, size - pos, "END_SCHED\n");
+    return (pos < size) ? pos : size - 1;
+}
@@ -0,0 +1,72 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Cooperative deadline-aware scheduler for the main loop.
+//
+// Every task is released once per period (period 0: on every pass) and
+// has to finish within its deadline of that release. sched_run() runs the
+// released tasks one at a time, most urgent priority first, choosing again
+// after each one, so a released high-priority task waits for at most one
+// lower-priority slice. Tasks keep their slices short themselves (bounded
+// work per call); a task that returns false stays released and runs again
+// on the next pass with its original release time.
+//
+// A task with period 0 can name a has_work() check; it is then released
+// only when there is something to do, which lets the loop tell when it
+// may sleep until the next periodic release (see idle.h).
+//
+// A run that ends past release + deadline counts as an overrun, so the
+// counters show whether the loop meets its real-time contract under load.
+// Results are returned by the "SCHED" text command.
+
+#define SCHED_MAX_TASKS     12
+#define SCHED_REPORT_MAX    768
+#define SCHED_IDLE_MAX_US   10000   // Longest sleep sched_next_release_us() allows
+
+typedef struct {
+    const char* name;
+    bool (*run)(void);          // false = not done, run again next pass
+    uint32_t period_us;         // 0 = released on every pass
+    uint32_t deadline_us;       // After release; 0 = no deadline
+    uint8_t priority;           // 0 = most urgent
+    bool (*has_work)(void);     // Period 0 only; NULL = released on every pass
+} sched_task_t;
+
+typedef struct {
+    uint32_t runs;
+    uint32_t overruns;          // Runs that finished past their deadline
+    uint32_t skipped;           // Releases lost because the previous one was still pending
+    uint32_t max_late_us;       // Worst release -> finish time
+    uint32_t max_run_us;        // Longest single slice
+} sched_stats_t;
+
+// Scheduler functions
+void sched_init(const sched_task_t* tasks, uint8_t count);
+void sched_run(void);           // One pass of the main loop
+
+// New period for a periodic task (index in the table), first release one
+// period from now; false for an event-driven task or period 0
+bool sched_set_period(uint8_t task, uint32_t period_us);
+
+void sched_reset_stats(void);
+const sched_stats_t* sched_get_stats(uint8_t task);
+
+// Idle support: is anything released or due, and when is the next release
+bool sched_work_pending(void);
+uint32_t sched_next_release_us(void);
+
+// Render the text report ("SCHED" command), returns its length
+uint32_t sched_format_report(char* out, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SCHED_H
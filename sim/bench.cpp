@@ -0,0 +1,529 @@
+// Host benchmarks for the firmware's hot functions.
+//
+// Each benchmark runs its body in batches of at least BENCH_MIN_TIME_MS,
+// BENCH_REPETITIONS times, and reports the fastest batch in ns/op plus heap
+// bytes and allocations per op (counted by replacing malloc). Results can be
+// saved as a baseline and compared on a later run; anything slower than the
+// threshold is flagged and makes the run exit non-zero. Baselines are only
+// comparable on the same machine.
+//
+//   bgg_bench [--filter text] [--baseline file] [--save file] [--threshold pct]
+
+#include "sim.h"
+#include "config.h"
+#include "config_storage.h"
+#include "neopixel.h"
+#include "joystick_cal.h"
+#include "response_curve.h"
+#include "remap.h"
+#include "guitar_core.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void __libc_free(void* ptr);
+}
+
+// Defined in main.cpp
+void read_guitar_buttons(void);
+
+#define BENCH_MIN_TIME_MS       50
+#define BENCH_REPETITIONS       5
+#define BENCH_MAX_RESULTS       64
+#define BENCH_DEFAULT_THRESHOLD 10.0
+
+//--------------------------------------------------------------------+
+// ALLOCATION COUNTING
+//--------------------------------------------------------------------+
+static bool counting = false;
+static uint64_t allocated_bytes = 0;
+static uint64_t allocation_count = 0;
+
+extern "C" void* malloc(size_t size) {
+    if (counting) {
+        allocated_bytes += size;
+        allocation_count++;
+    }
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size) {
+    if (counting) {
+        allocated_bytes += count * size;
+        allocation_count++;
+    }
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size) {
+    if (counting) {
+        allocated_bytes += size;
+        allocation_count++;
+    }
+    return __libc_realloc(ptr, size);
+}
+
+extern "C" void free(void* ptr) {
+    __libc_free(ptr);
+}
+
+//--------------------------------------------------------------------+
+// HARNESS
+//--------------------------------------------------------------------+
+typedef struct {
+    uint64_t iterations;
+    uint64_t remaining;
+} bench_state_t;
+
+typedef void (*bench_fn_t)(bench_state_t* state);
+
+typedef struct {
+    const char* name;
+    bench_fn_t fn;
+} bench_t;
+
+typedef struct {
+    char name[48];
+    double ns_per_op;
+    double bytes_per_op;
+    double allocs_per_op;
+} bench_result_t;
+
+static volatile uint32_t sink;
+
+static inline bool bench_running(bench_state_t* state) {
+    if (state->remaining == 0) return false;
+    state->remaining--;
+    return true;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// One timed batch; allocation counters cover just this batch
+static uint64_t run_batch(const bench_t* bench, uint64_t iterations) {
+    bench_state_t state = { iterations, iterations };
+    allocated_bytes = 0;
+    allocation_count = 0;
+
+    counting = true;
+    uint64_t start = now_ns();
+    bench->fn(&state);
+    uint64_t elapsed = now_ns() - start;
+    counting = false;
+    return elapsed;
+}
+
+static bench_result_t run_bench(const bench_t* bench) {
+    bench_result_t result;
+    memset(&result, 0, sizeof(result));
+    snprintf(result.name, sizeof(result.name), "%s", bench->name);
+
+    // Grow the batch until it takes at least the minimum time
+    uint64_t iterations = 1;
+    uint64_t elapsed;
+    while ((elapsed = run_batch(bench, iterations)) < BENCH_MIN_TIME_MS * 1000000ull && iterations < (1ull << 32)) {
+        // Aim a little past the minimum, at most 10x per step
+        uint64_t target = elapsed ? iterations * (BENCH_MIN_TIME_MS * 1400000ull) / elapsed : iterations * 10;
+        if (target > iterations * 10) target = iterations * 10;
+        if (target <= iterations) target = iterations + 1;
+        iterations = target;
+    }
+
+    // Fastest of the repetitions; noise only ever adds time
+    double best = (double)elapsed / iterations;
+    for (int i = 1; i < BENCH_REPETITIONS; i++) {
+        double ns = (double)run_batch(bench, iterations) / iterations;
+        if (ns < best) best = ns;
+    }
+
+    result.ns_per_op = best;
+    result.bytes_per_op = (double)allocated_bytes / iterations;
+    result.allocs_per_op = (double)allocation_count / iterations;
+    return result;
+}
+
+//--------------------------------------------------------------------+
+// INPUTS
+//--------------------------------------------------------------------+
+static char default_json[CONFIG_JSON_MAX_SIZE];
+static uint32_t default_json_length;
+
+// Every field present with the longest values the parser keeps
+static const char maximal_json[] =
+    "{\n"
+    "  \"metadata\": {\n"
+    "    \"version\": \"99.99.99-rc.99\",\n"
+    "    \"description\": \"Maximal configuration used by the host benchmarks, 63 chars!\",\n"
+    "    \"lastUpdated\": \"2099-12-31T23:59\"\n"
+    "  },\n"
+    "  \"device_name\": \"BumbleGum Guitars Custom Controller With A Long Product Name\",\n"
+    "  \"UP\": \"GP22\", \"DOWN\": \"GP21\", \"LEFT\": \"GP20\", \"RIGHT\": \"GP19\",\n"
+    "  \"GREEN_FRET\": \"GP10\", \"GREEN_FRET_led\": 6,\n"
+    "  \"RED_FRET\": \"GP11\", \"RED_FRET_led\": 5,\n"
+    "  \"YELLOW_FRET\": \"GP12\", \"YELLOW_FRET_led\": 4,\n"
+    "  \"BLUE_FRET\": \"GP13\", \"BLUE_FRET_led\": 3,\n"
+    "  \"ORANGE_FRET\": \"GP14\", \"ORANGE_FRET_led\": 2,\n"
+    "  \"STRUM_UP\": \"GP17\", \"STRUM_UP_led\": 0,\n"
+    "  \"STRUM_DOWN\": \"GP18\", \"STRUM_DOWN_led\": 1,\n"
+    "  \"TILT\": \"GP9\", \"SELECT\": \"GP15\", \"START\": \"GP16\", \"GUIDE\": \"GP6\",\n"
+    "  \"WHAMMY\": \"GP27\", \"neopixel_pin\": \"GP23\",\n"
+    "  \"joystick_x_pin\": \"GP28\", \"joystick_y_pin\": \"GP29\",\n"
+    "  \"hat_mode\": \"joystick_hat_xx\", \"usb_mode\": \"xinput\",\n"
+    "  \"led_brightness\": 0.875,\n"
+    "  \"whammy_min\": 12345, \"whammy_max\": 65535, \"whammy_reverse\": true,\n"
+    "  \"tilt_wave_enabled\": true,\n"
+    "  \"joystick_x_center\": 31234, \"joystick_x_min\": 1234, \"joystick_x_max\": 64321,\n"
+    "  \"joystick_y_center\": 34567, \"joystick_y_min\": 2345, \"joystick_y_max\": 63210,\n"
+    "  \"joystick_deadzone\": 16383,\n"
+    "  \"whammy_curve\": \"points:0,5,10,20,35,50,70,85,100\",\n"
+    "  \"joystick_x_curve\": \"scurve:100\", \"joystick_y_curve\": \"expo:100\",\n"
+    "  \"GREEN_FRET_map\": \"dpad_right\", \"RED_FRET_map\": \"dpad_down\", \"YELLOW_FRET_map\": \"dpad_left\",\n"
+    "  \"BLUE_FRET_map\": \"dpad_up\", \"ORANGE_FRET_map\": \"lstick\",\n"
+    "  \"STRUM_UP_map\": \"rstick\", \"STRUM_DOWN_map\": \"start\",\n"
+    "  \"START_map\": \"guide\", \"SELECT_map\": \"back\", \"GUIDE_map\": \"ly+\", \"TILT_map\": \"ry-\",\n"
+    "  \"UP_map\": \"dpad_right\", \"DOWN_map\": \"dpad_left\", \"LEFT_map\": \"dpad_down\", \"RIGHT_map\": \"dpad_up\",\n"
+    "  \"WHAMMY_map\": \"rt-\", \"joystick_x_map\": \"rx-\", \"joystick_y_map\": \"ry-\",\n"
+    "  \"led_color\": [\"#FFFFFF\", \"#FEFEFE\", \"#B33E00\", \"#0000FF\", \"#FFFF00\", \"#FF0000\", \"#00FF00\"],\n"
+    "  \"released_color\": [\"#454545\", \"#444444\", \"#521C00\", \"#000091\", \"#696B00\", \"#8C0009\", \"#003D00\"]\n"
+    "}\n";
+
+static config_t maximal_config;
+
+static const uint8_t button_pins[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14 };
+
+static void set_all_buttons(bool pressed) {
+    for (size_t i = 0; i < sizeof(button_pins); i++) {
+        sim_gpio_drive(button_pins[i], !pressed);  // Active low
+    }
+}
+
+//--------------------------------------------------------------------+
+// BENCHMARKS
+//--------------------------------------------------------------------+
+static void bm_crc32_default_json(bench_state_t* state) {
+    while (bench_running(state)) {
+        sink = config_storage_calculate_crc32(default_json, default_json_length);
+    }
+}
+
+static void bm_crc32_sector(bench_state_t* state) {
+    static uint8_t sector[4096];
+    while (bench_running(state)) {
+        sink = config_storage_calculate_crc32(sector, sizeof(sector));
+    }
+}
+
+static void bm_parse_default(bench_state_t* state) {
+    config_t config;
+    while (bench_running(state)) {
+        sink = config_parse_json(default_json, &config);
+    }
+}
+
+static void bm_parse_maximal(bench_state_t* state) {
+    config_t config;
+    while (bench_running(state)) {
+        sink = config_parse_json(maximal_json, &config);
+    }
+}
+
+static void bm_generate_default(bench_state_t* state) {
+    static char buffer[CONFIG_JSON_MAX_SIZE];
+    while (bench_running(state)) {
+        sink = config_generate_json(config_get_current(), buffer, sizeof(buffer));
+    }
+}
+
+static void bm_generate_maximal(bench_state_t* state) {
+    static char buffer[CONFIG_JSON_MAX_SIZE];
+    while (bench_running(state)) {
+        sink = config_generate_json(&maximal_config, buffer, sizeof(buffer));
+    }
+}
+
+static void bm_parse_color(bench_state_t* state) {
+    static const char* const colors[] = { "#FFFFFF", "#B33E00", "#0000FF", "#8C0009", "bad" };
+    uint32_t i = 0;
+    while (bench_running(state)) {
+        sink = neopixel_parse_color(colors[i++ % 5]);
+    }
+}
+
+// Inside the deadzone: the early exit
+static void bm_joystick_rest(bench_state_t* state) {
+    int16_t x, y;
+    uint32_t i = 0;
+    while (bench_running(state)) {
+        i++;
+        joystick_cal_apply((uint16_t)(32768 + (i & 255)), (uint16_t)(32768 - (i & 127)), &x, &y);
+        sink = (uint16_t)x ^ (uint16_t)y;
+    }
+}
+
+// Full path (square root and rescale) over the whole input range
+static void bm_joystick_sweep(bench_state_t* state) {
+    int16_t x, y;
+    uint32_t i = 0;
+    while (bench_running(state)) {
+        i += 40503;
+        joystick_cal_apply((uint16_t)i, (uint16_t)(i >> 16), &x, &y);
+        sink = (uint16_t)x ^ (uint16_t)y;
+    }
+}
+
+// Table lookup and interpolation; the curve shape does not change the cost
+static void bm_curve_points(bench_state_t* state) {
+    response_curve_set(RESPONSE_CURVE_WHAMMY, "points:0,5,10,20,35,50,70,85,100");
+    uint32_t i = 0;
+    while (bench_running(state)) {
+        i += 40503;
+        sink = response_curve_apply(RESPONSE_CURVE_WHAMMY, (uint16_t)i);
+    }
+    response_curve_set(RESPONSE_CURVE_WHAMMY, "linear");
+}
+
+// Every source on a different shift distance or an axis: the slowest table
+static void bm_remap_scattered(bench_state_t* state) {
+    static const char* const targets[REMAP_SOURCES] = {
+        "dpad_right", "dpad_down", "lb", "a", "start", "b", "x", "guide", "y", "lx+", "ry",
+        "back", "rb", "lstick", "rstick", "lt", "rx-", "ly"
+    };
+    remap_set(targets, true);
+    remap_input_t input = { 0, { 0, 0, 0 } };
+    remap_output_t output;
+    uint32_t i = 0;
+    while (bench_running(state)) {
+        i += 40503;
+        input.digital = (uint16_t)i;
+        input.analog[0] = (int16_t)(i >> 8);
+        remap_apply(&input, &output);
+        sink = output.buttons ^ (uint16_t)output.rx;
+    }
+    remap_set(remap_default_targets, false);
+}
+
+// guitar_core.h scan to report, over changing pin levels. fixed: the
+// bgg_xinput_firmware instantiation (pins and table constant); config: the
+// bgg_xinput_cdc_firmware one (pins from config, remap.c table)
+namespace bench_core {
+using namespace guitar_core;
+
+struct fluffy_table {
+    static constexpr bool hat_joystick = false;
+    static constexpr remap_target_t targets[REMAP_SOURCES] = {
+        button(0x1000), button(0x2000), button(0x8000), button(0x4000), button(0x0100),
+        button(0x0001), button(0x0002), button(0x0010), button(0x0020), button(0x0400),
+        axis(REMAP_AXIS_RY, 1), none(), none(), button(0x0004), button(0x0008),
+        axis(REMAP_AXIS_RX), axis(REMAP_AXIS_LX), axis(REMAP_AXIS_LY),
+    };
+};
+
+typedef fixed_pins<pin(10), pin(11), pin(12), pin(13), pin(14), pin(7) | pin(2), pin(8) | pin(3),
+                   pin(1), pin(0), pin(6), pin(9), NO_PIN, NO_PIN, pin(4), pin(5)> fluffy_pins;
+
+static guitar<fluffy_pins, no_debounce, fixed_map<fluffy_table>, xinput_encoder> fixed_xinput;
+static guitar<fluffy_pins, no_debounce, fixed_map<fluffy_table>, hid_gamepad_encoder> fixed_hid;
+static guitar<config_pins<6, 9>, lockout_debounce<1u << REMAP_TILT, 50>, table_map, xinput_encoder> config_xinput;
+
+template <typename Guitar>
+static void scan(bench_state_t* state, Guitar& core) {
+    typename Guitar::report_t report;
+    uint32_t i = 0;
+    while (bench_running(state)) {
+        i += 40503;
+        remap_output_t mapped = core.build(core.read(i, i >> 10), (int16_t)i, (int16_t)(i >> 8), 0, &report);
+        sink = mapped.buttons ^ (uint16_t)mapped.rx;
+    }
+}
+}
+
+static void bm_core_fixed_xinput(bench_state_t* state) {
+    bench_core::scan(state, bench_core::fixed_xinput);
+}
+
+static void bm_core_fixed_hid(bench_state_t* state) {
+    bench_core::scan(state, bench_core::fixed_hid);
+}
+
+static void bm_core_config_xinput(bench_state_t* state) {
+    bench_core::scan(state, bench_core::config_xinput);
+}
+
+static void bm_report_idle(bench_state_t* state) {
+    set_all_buttons(false);
+    while (bench_running(state)) {
+        read_guitar_buttons();
+    }
+}
+
+static void bm_report_all_pressed(bench_state_t* state) {
+    set_all_buttons(true);
+    while (bench_running(state)) {
+        read_guitar_buttons();
+    }
+    set_all_buttons(false);
+}
+
+static void bm_report_toggling(bench_state_t* state) {
+    bool pressed = false;
+    while (bench_running(state)) {
+        pressed = !pressed;
+        set_all_buttons(pressed);
+        read_guitar_buttons();
+    }
+    set_all_buttons(false);
+}
+
+static const bench_t benches[] = {
+    { "crc32/default_json",         bm_crc32_default_json },
+    { "crc32/sector_4k",            bm_crc32_sector },
+    { "parse_json/default",         bm_parse_default },
+    { "parse_json/maximal",         bm_parse_maximal },
+    { "generate_json/default",      bm_generate_default },
+    { "generate_json/maximal",      bm_generate_maximal },
+    { "parse_color",                bm_parse_color },
+    { "joystick/rest",              bm_joystick_rest },
+    { "joystick/sweep",             bm_joystick_sweep },
+    { "curve/points",               bm_curve_points },
+    { "remap/scattered",            bm_remap_scattered },
+    { "core/fixed_xinput",          bm_core_fixed_xinput },
+    { "core/fixed_hid",             bm_core_fixed_hid },
+    { "core/config_xinput",         bm_core_config_xinput },
+    { "report/idle",                bm_report_idle },
+    { "report/all_pressed",         bm_report_all_pressed },
+    { "report/toggling",            bm_report_toggling },
+};
+
+//--------------------------------------------------------------------+
+// BASELINES
+//--------------------------------------------------------------------+
+static bench_result_t baseline[BENCH_MAX_RESULTS];
+static int baseline_count = 0;
+
+static bool load_baseline(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "bench: cannot open baseline %s\n", path);
+        return false;
+    }
+
+    char line[160];
+    while (fgets(line, sizeof(line), file) && baseline_count < BENCH_MAX_RESULTS) {
+        bench_result_t* entry = &baseline[baseline_count];
+        if (line[0] == '#') continue;
+        if (sscanf(line, "%47s %lf %lf %lf", entry->name, &entry->ns_per_op,
+                   &entry->bytes_per_op, &entry->allocs_per_op) == 4) {
+            baseline_count++;
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+static const bench_result_t* find_baseline(const char* name) {
+    for (int i = 0; i < baseline_count; i++) {
+        if (strcmp(baseline[i].name, name) == 0) return &baseline[i];
+    }
+    return NULL;
+}
+
+static bool save_results(const char* path, const bench_result_t* results, int count) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "bench: cannot write %s\n", path);
+        return false;
+    }
+    fprintf(file, "# name ns_per_op bytes_per_op allocs_per_op\n");
+    for (int i = 0; i < count; i++) {
+        fprintf(file, "%s %.1f %.1f %.2f\n", results[i].name, results[i].ns_per_op,
+                results[i].bytes_per_op, results[i].allocs_per_op);
+    }
+    fclose(file);
+    return true;
+}
+
+//--------------------------------------------------------------------+
+// MAIN
+//--------------------------------------------------------------------+
+// The firmware calls tud_task() only from its main loop, which never runs here
+extern "C" void sim_loop_hook(void) {
+}
+
+int main(int argc, char** argv) {
+    const char* filter = NULL;
+    const char* baseline_path = NULL;
+    const char* save_path = NULL;
+    double threshold = BENCH_DEFAULT_THRESHOLD;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            baseline_path = argv[++i];
+        } else if (strcmp(argv[i], "--save") == 0 && i + 1 < argc) {
+            save_path = argv[++i];
+        } else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            threshold = atof(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: bgg_bench [--filter text] [--baseline file] [--save file] [--threshold pct]\n");
+            return 2;
+        }
+    }
+    if (baseline_path && !load_baseline(baseline_path)) {
+        return 2;
+    }
+
+    // Firmware state the benchmarks run against: default config in an erased flash
+    sim_uart_set_quiet(true);
+    sim_flash_open(NULL);
+    FILE* console = stdout;
+    stdout = fopen("/dev/null", "w");
+    config_init();
+    config_generate_json(config_get_current(), default_json, sizeof(default_json));
+    default_json_length = strlen(default_json);
+    config_parse_json(maximal_json, &maximal_config);
+    read_guitar_buttons();
+    fclose(stdout);
+    stdout = console;
+
+    bench_result_t results[BENCH_MAX_RESULTS];
+    int count = 0;
+    int regressions = 0;
+
+    printf("%-24s %12s %10s %10s %10s\n", "benchmark", "ns/op", "bytes/op", "allocs/op", "vs base");
+    for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+        if (filter && !strstr(benches[i].name, filter)) continue;
+
+        bench_result_t result = run_bench(&benches[i]);
+        results[count++] = result;
+
+        char delta[24] = "";
+        const bench_result_t* base = find_baseline(result.name);
+        if (base && base->ns_per_op > 0) {
+            double change = (result.ns_per_op - base->ns_per_op) * 100.0 / base->ns_per_op;
+            bool slower = change > threshold || result.bytes_per_op > base->bytes_per_op;
+            snprintf(delta, sizeof(delta), "%+.1f%%%s", change, slower ? " SLOWER" : "");
+            if (slower) regressions++;
+        }
+        printf("%-24s %12.1f %10.1f %10.2f %10s\n", result.name, result.ns_per_op,
+               result.bytes_per_op, result.allocs_per_op, delta);
+    }
+
+    if (save_path && !save_results(save_path, results, count)) {
+        return 2;
+    }
+    if (regressions) {
+        printf("%d benchmark(s) regressed more than %.0f%% against %s\n", regressions, threshold, baseline_path);
+        return 1;
+    }
+    return 0;
+}
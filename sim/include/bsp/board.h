@@ -0,0 +1,14 @@
+#ifndef SIM_BSP_BOARD_H
+#define SIM_BSP_BOARD_H
+
+#include <stdint.h>
+#include "pico/time.h"
+
+static inline void board_init(void) {
+}
+
+static inline uint32_t board_millis(void) {
+    return (uint32_t)(time_us_64() / 1000);
+}
+
+#endif // SIM_BSP_BOARD_H
@@ -0,0 +1,6 @@
+#ifndef SIM_CLASS_HID_HID_DEVICE_H
+#define SIM_CLASS_HID_HID_DEVICE_H
+
+#include "tusb.h"
+
+#endif // SIM_CLASS_HID_HID_DEVICE_H
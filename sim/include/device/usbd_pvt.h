@@ -0,0 +1,6 @@
+#ifndef SIM_DEVICE_USBD_PVT_H
+#define SIM_DEVICE_USBD_PVT_H
+
+#include "tusb.h"
+
+#endif // SIM_DEVICE_USBD_PVT_H
@@ -0,0 +1,44 @@
+#ifndef SIM_HARDWARE_ADC_H
+#define SIM_HARDWARE_ADC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "hardware/gpio.h"
+#include "hardware/address_mapped.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Free-running conversions happen in virtual time; each result goes to
+// the DMA channel paced by DREQ_ADC, or sets OVER when none is running
+typedef struct {
+    io_rw_32 cs;
+    io_ro_32 result;
+    io_rw_32 fcs;
+    io_ro_32 fifo;
+    io_rw_32 div;
+} adc_hw_t;
+
+extern adc_hw_t sim_adc_hw;
+#define adc_hw              (&sim_adc_hw)
+
+#define ADC_FCS_OVER_BITS   0x00000800u
+#define ADC_FCS_UNDER_BITS  0x00000400u
+
+void adc_init(void);
+void adc_gpio_init(uint gpio);
+void adc_select_input(uint input);
+uint16_t adc_read(void);
+
+void adc_set_round_robin(uint input_mask);
+void adc_fifo_setup(bool en, bool dreq_en, uint16_t dreq_thresh, bool err_in_fifo, bool byte_shift);
+void adc_set_clkdiv(float clkdiv);
+void adc_run(bool run);
+void adc_fifo_drain(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SIM_HARDWARE_ADC_H
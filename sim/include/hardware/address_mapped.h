@@ -0,0 +1,29 @@
+#ifndef SIM_HARDWARE_ADDRESS_MAPPED_H
+#define SIM_HARDWARE_ADDRESS_MAPPED_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Registers are plain memory in the sim; address fields are pointer sized
+typedef volatile uint32_t io_rw_32;
+typedef volatile uint32_t io_ro_32;
+
+// Set alias; write-1-to-clear status bits clear instead (sim_hal.c)
+void sim_hw_set_bits(io_rw_32* addr, uint32_t mask);
+
+static inline void hw_set_bits(io_rw_32* addr, uint32_t mask) {
+    sim_hw_set_bits(addr, mask);
+}
+
+static inline void hw_clear_bits(io_rw_32* addr, uint32_t mask) {
+    *addr &= ~mask;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SIM_HARDWARE_ADDRESS_MAPPED_H
@@ -0,0 +1,23 @@
+#ifndef SIM_HARDWARE_CLOCKS_H
+#define SIM_HARDWARE_CLOCKS_H
+
+#include <stdint.h>
+
+#define SIM_CLK_SYS_HZ      125000000u
+
+enum clock_index {
+    clk_gpout0 = 0,
+    clk_ref = 4,
+    clk_sys = 5,
+    clk_peri,
+    clk_usb,
+    clk_adc,
+    clk_rtc,
+};
+
+static inline uint32_t clock_get_hz(enum clock_index clk_index) {
+    (void)clk_index;
+    return SIM_CLK_SYS_HZ;
+}
+
+#endif // SIM_HARDWARE_CLOCKS_H
@@ -0,0 +1,83 @@
+#ifndef SIM_HARDWARE_DMA_H
+#define SIM_HARDWARE_DMA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "hardware/gpio.h"
+#include "hardware/address_mapped.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Only what the firmware uses: DREQ_ADC paced transfers into a ring, and
+// unpaced word copies that re-trigger another channel through its
+// al1_transfer_count_trig register. Addresses are host pointers.
+#define SIM_DMA_CHANNELS    12
+
+enum dma_channel_transfer_size {
+    DMA_SIZE_8 = 0,
+    DMA_SIZE_16 = 1,
+    DMA_SIZE_32 = 2
+};
+
+#define DREQ_ADC            36
+#define DREQ_FORCE          0x3f
+
+typedef struct {
+    volatile uintptr_t read_addr;
+    volatile uintptr_t write_addr;
+    io_rw_32 transfer_count;
+    io_rw_32 al1_transfer_count_trig;
+} dma_channel_hw_t;
+
+typedef struct {
+    uint8_t size;
+    bool read_increment;
+    bool write_increment;
+    uint8_t ring_bits;
+    bool ring_write;
+    uint8_t dreq;
+    uint8_t chain_to;
+} dma_channel_config;
+
+dma_channel_hw_t* dma_channel_hw_addr(uint channel);
+
+int dma_claim_unused_channel(bool required);
+void dma_channel_unclaim(uint channel);
+dma_channel_config dma_channel_get_default_config(uint channel);
+void dma_channel_configure(uint channel, const dma_channel_config* config, volatile void* write_addr,
+                           const volatile void* read_addr, uint32_t transfer_count, bool trigger);
+void dma_channel_abort(uint channel);
+bool dma_channel_is_busy(uint channel);
+
+static inline void channel_config_set_transfer_data_size(dma_channel_config* c, enum dma_channel_transfer_size size) {
+    c->size = (uint8_t)size;
+}
+
+static inline void channel_config_set_read_increment(dma_channel_config* c, bool incr) {
+    c->read_increment = incr;
+}
+
+static inline void channel_config_set_write_increment(dma_channel_config* c, bool incr) {
+    c->write_increment = incr;
+}
+
+static inline void channel_config_set_ring(dma_channel_config* c, bool write, uint size_bits) {
+    c->ring_write = write;
+    c->ring_bits = (uint8_t)size_bits;
+}
+
+static inline void channel_config_set_dreq(dma_channel_config* c, uint dreq) {
+    c->dreq = (uint8_t)dreq;
+}
+
+static inline void channel_config_set_chain_to(dma_channel_config* c, uint chain_to) {
+    c->chain_to = (uint8_t)chain_to;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SIM_HARDWARE_DMA_H
@@ -0,0 +1,25 @@
+#ifndef SIM_HARDWARE_FLASH_H
+#define SIM_HARDWARE_FLASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FLASH_PAGE_SIZE     (1u << 8)
+#define FLASH_SECTOR_SIZE   (1u << 12)
+
+// Memory-mapped flash image, persisted to the file given to the simulator
+extern uint8_t sim_flash_image[];
+#define XIP_BASE            ((uintptr_t)sim_flash_image)
+
+void flash_range_erase(uint32_t flash_offs, size_t count);
+void flash_range_program(uint32_t flash_offs, const uint8_t* data, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SIM_HARDWARE_FLASH_H
@@ -0,0 +1,50 @@
+#ifndef SIM_HARDWARE_PIO_H
+#define SIM_HARDWARE_PIO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "hardware/gpio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct pio_hw {
+    int index;
+} pio_hw_t;
+
+typedef pio_hw_t* PIO;
+
+extern pio_hw_t sim_pio[2];
+#define pio0                (&sim_pio[0])
+#define pio1                (&sim_pio[1])
+
+typedef struct {
+    const uint16_t* instructions;
+    uint8_t length;
+    int8_t origin;
+} pio_program_t;
+
+typedef struct {
+    uint32_t clkdiv;
+} pio_sm_config;
+
+enum pio_fifo_join {
+    PIO_FIFO_JOIN_NONE = 0,
+    PIO_FIFO_JOIN_TX = 1,
+    PIO_FIFO_JOIN_RX = 2,
+};
+
+bool pio_sm_is_claimed(PIO pio, uint sm);
+void pio_sm_claim(PIO pio, uint sm);
+void pio_sm_unclaim(PIO pio, uint sm);
+uint pio_add_program(PIO pio, const pio_program_t* program);
+
+// TX FIFO writes are captured as LED frames
+void pio_sm_put_blocking(PIO pio, uint sm, uint32_t data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SIM_HARDWARE_PIO_H
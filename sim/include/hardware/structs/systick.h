@@ -0,0 +1,25 @@
+#ifndef SIM_HARDWARE_STRUCTS_SYSTICK_H
+#define SIM_HARDWARE_STRUCTS_SYSTICK_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t csr;
+    uint32_t rvr;
+    uint32_t cvr;
+    uint32_t calib;
+} systick_hw_t;
+
+// cvr is refreshed from virtual time whenever the simulator clock moves
+extern systick_hw_t sim_systick;
+#define systick_hw          (&sim_systick)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SIM_HARDWARE_STRUCTS_SYSTICK_H
@@ -0,0 +1,38 @@
+#ifndef SIM_HARDWARE_SYNC_H
+#define SIM_HARDWARE_SYNC_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// No interrupts on the host; core 1 is a thread, so barriers are real
+static inline uint32_t save_and_disable_interrupts(void) {
+    return 0;
+}
+
+static inline void restore_interrupts(uint32_t status) {
+    (void)status;
+}
+
+static inline void __dmb(void) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+// Sleeping hands the loop's time to the scenario until an alarm fires
+void sim_wfi(void);
+
+static inline void __wfi(void) {
+    sim_wfi();
+}
+
+static inline void __wfe(void) {
+    sim_wfi();
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SIM_HARDWARE_SYNC_H
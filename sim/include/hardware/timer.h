@@ -0,0 +1,28 @@
+#ifndef SIM_HARDWARE_TIMER_H
+#define SIM_HARDWARE_TIMER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pico/time.h"
+#include "hardware/gpio.h"     // uint
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Alarms fire in virtual time, from inside sim_advance_us()
+#define SIM_ALARM_COUNT     4
+
+typedef void (*hardware_alarm_callback_t)(uint alarm_num);
+
+int hardware_alarm_claim_unused(bool required);
+void hardware_alarm_unclaim(uint alarm_num);
+void hardware_alarm_set_callback(uint alarm_num, hardware_alarm_callback_t callback);
+bool hardware_alarm_set_target(uint alarm_num, absolute_time_t t);
+void hardware_alarm_cancel(uint alarm_num);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SIM_HARDWARE_TIMER_H
@@ -0,0 +1,22 @@
+#ifndef SIM_HARDWARE_UART_H
+#define SIM_HARDWARE_UART_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct uart_inst uart_inst_t;
+extern uart_inst_t* const sim_uart0;
+#define uart_default        sim_uart0
+
+bool uart_is_writable(uart_inst_t* uart);
+void uart_putc_raw(uart_inst_t* uart, char c);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SIM_HARDWARE_UART_H
@@ -0,0 +1,16 @@
+#ifndef SIM_PICO_BOOTROM_H
+#define SIM_PICO_BOOTROM_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void reset_usb_boot(uint32_t gpio_activity_pin_mask, uint32_t disable_interface_mask);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SIM_PICO_BOOTROM_H
@@ -0,0 +1,16 @@
+#ifndef SIM_PICO_MULTICORE_H
+#define SIM_PICO_MULTICORE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Core 1 runs as a host thread (see sim_hal.c)
+void multicore_launch_core1(void (*entry)(void));
+void multicore_reset_core1(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SIM_PICO_MULTICORE_H
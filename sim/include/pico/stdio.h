@@ -0,0 +1,6 @@
+#ifndef SIM_PICO_STDIO_H
+#define SIM_PICO_STDIO_H
+
+#include "pico/stdlib.h"
+
+#endif // SIM_PICO_STDIO_H
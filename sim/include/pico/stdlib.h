@@ -0,0 +1,43 @@
+#ifndef SIM_PICO_STDLIB_H
+#define SIM_PICO_STDLIB_H
+
+// Host stand-in for the Pico SDK: only the calls the firmware makes.
+// Time is virtual and only moves when the simulator advances it.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "pico/time.h"
+#include "hardware/sync.h"
+#include "hardware/gpio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PICO_FLASH_SIZE_BYTES   (2 * 1024 * 1024)
+#define PICO_DEFAULT_LED_PIN    25
+
+#ifndef __unused
+#define __unused                __attribute__((unused))
+#endif
+
+extern __thread uint sim_core_num;    // 1 on the core 1 thread
+
+static inline uint get_core_num(void) {
+    return sim_core_num;
+}
+
+static inline void tight_loop_contents(void) {
+}
+
+static inline bool stdio_init_all(void) {
+    return true;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SIM_PICO_STDLIB_H
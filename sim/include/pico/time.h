@@ -0,0 +1,40 @@
+#ifndef SIM_PICO_TIME_H
+#define SIM_PICO_TIME_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint64_t absolute_time_t;
+
+uint64_t time_us_64(void);
+void sleep_us(uint64_t us);
+void sleep_ms(uint32_t ms);
+
+static inline uint32_t time_us_32(void) {
+    return (uint32_t)time_us_64();
+}
+
+static inline absolute_time_t get_absolute_time(void) {
+    return time_us_64();
+}
+
+static inline uint32_t to_ms_since_boot(absolute_time_t t) {
+    return (uint32_t)(t / 1000);
+}
+
+static inline uint64_t to_us_since_boot(absolute_time_t t) {
+    return t;
+}
+
+static inline absolute_time_t from_us_since_boot(uint64_t us) {
+    return us;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SIM_PICO_TIME_H
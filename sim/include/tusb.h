@@ -0,0 +1,360 @@
+#ifndef SIM_TUSB_H
+#define SIM_TUSB_H
+
+// Host stand-in for TinyUSB: the device API the firmware calls, with the
+// simulated host on the other side (see sim_usb.c). Descriptor layouts and
+// macros follow TinyUSB so the firmware's descriptors build unchanged.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "tusb_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TU_ATTR_PACKED          __attribute__((packed))
+#define TU_ATTR_WEAK            __attribute__((weak))
+#define TU_BIT(n)               (1UL << (n))
+#define TU_U16_LOW(u16)         ((uint8_t)((u16) & 0x00ff))
+#define TU_U16_HIGH(u16)        ((uint8_t)(((u16) >> 8) & 0x00ff))
+#define U16_TO_U8S_LE(u16)      TU_U16_LOW(u16), TU_U16_HIGH(u16)
+
+// Return-on-failure checks: TU_VERIFY(cond) or TU_VERIFY(cond, ret)
+#define TU_GET_3RD_ARG_(a, b, c, ...)   c
+#define TU_VERIFY_1ARG_(cond)           do { if (!(cond)) return false; } while (0)
+#define TU_VERIFY_2ARG_(cond, ret)      do { if (!(cond)) return ret; } while (0)
+#define TU_VERIFY(...)          TU_GET_3RD_ARG_(__VA_ARGS__, TU_VERIFY_2ARG_, TU_VERIFY_1ARG_, _)(__VA_ARGS__)
+#define TU_ASSERT(...)          TU_VERIFY(__VA_ARGS__)
+
+//--------------------------------------------------------------------+
+// TYPES
+//--------------------------------------------------------------------+
+typedef enum {
+    TUSB_DESC_DEVICE = 0x01,
+    TUSB_DESC_CONFIGURATION = 0x02,
+    TUSB_DESC_STRING = 0x03,
+    TUSB_DESC_INTERFACE = 0x04,
+    TUSB_DESC_ENDPOINT = 0x05,
+    TUSB_DESC_INTERFACE_ASSOCIATION = 0x0B,
+    TUSB_DESC_CS_INTERFACE = 0x24,
+} tusb_desc_type_t;
+
+typedef enum {
+    TUSB_DIR_OUT = 0,
+    TUSB_DIR_IN = 1,
+    TUSB_DIR_IN_MASK = 0x80
+} tusb_dir_t;
+
+typedef enum {
+    TUSB_XFER_CONTROL = 0,
+    TUSB_XFER_ISOCHRONOUS,
+    TUSB_XFER_BULK,
+    TUSB_XFER_INTERRUPT
+} tusb_xfer_type_t;
+
+enum {
+    TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP = 1u << 5,
+    TUSB_DESC_CONFIG_ATT_SELF_POWERED = 1u << 6,
+};
+
+typedef enum {
+    TUSB_CLASS_CDC = 2,
+    TUSB_CLASS_HID = 3,
+    TUSB_CLASS_MSC = 8,
+    TUSB_CLASS_CDC_DATA = 10,
+    TUSB_CLASS_VENDOR_SPECIFIC = 0xFF
+} tusb_class_code_t;
+
+typedef enum {
+    TUSB_REQ_TYPE_STANDARD = 0,
+    TUSB_REQ_TYPE_CLASS,
+    TUSB_REQ_TYPE_VENDOR,
+    TUSB_REQ_TYPE_INVALID
+} tusb_request_type_t;
+
+enum {
+    CONTROL_STAGE_IDLE,
+    CONTROL_STAGE_SETUP,
+    CONTROL_STAGE_DATA,
+    CONTROL_STAGE_ACK
+};
+
+typedef enum {
+    XFER_RESULT_SUCCESS = 0,
+    XFER_RESULT_FAILED,
+    XFER_RESULT_STALLED,
+    XFER_RESULT_TIMEOUT,
+    XFER_RESULT_INVALID
+} xfer_result_t;
+
+typedef struct TU_ATTR_PACKED {
+    uint8_t  bLength;
+    uint8_t  bDescriptorType;
+    uint16_t bcdUSB;
+    uint8_t  bDeviceClass;
+    uint8_t  bDeviceSubClass;
+    uint8_t  bDeviceProtocol;
+    uint8_t  bMaxPacketSize0;
+    uint16_t idVendor;
+    uint16_t idProduct;
+    uint16_t bcdDevice;
+    uint8_t  iManufacturer;
+    uint8_t  iProduct;
+    uint8_t  iSerialNumber;
+    uint8_t  bNumConfigurations;
+} tusb_desc_device_t;
+
+typedef struct TU_ATTR_PACKED {
+    uint8_t  bLength;
+    uint8_t  bDescriptorType;
+    uint16_t wTotalLength;
+    uint8_t  bNumInterfaces;
+    uint8_t  bConfigurationValue;
+    uint8_t  iConfiguration;
+    uint8_t  bmAttributes;
+    uint8_t  bMaxPower;
+} tusb_desc_configuration_t;
+
+typedef struct TU_ATTR_PACKED {
+    uint8_t  bLength;
+    uint8_t  bDescriptorType;
+    uint8_t  bInterfaceNumber;
+    uint8_t  bAlternateSetting;
+    uint8_t  bNumEndpoints;
+    uint8_t  bInterfaceClass;
+    uint8_t  bInterfaceSubClass;
+    uint8_t  bInterfaceProtocol;
+    uint8_t  iInterface;
+} tusb_desc_interface_t;
+
+typedef struct TU_ATTR_PACKED {
+    uint8_t  bLength;
+    uint8_t  bDescriptorType;
+    uint8_t  bEndpointAddress;
+    struct TU_ATTR_PACKED {
+        uint8_t xfer  : 2;
+        uint8_t sync  : 2;
+        uint8_t usage : 2;
+        uint8_t       : 2;
+    } bmAttributes;
+    uint16_t wMaxPacketSize;
+    uint8_t  bInterval;
+} tusb_desc_endpoint_t;
+
+typedef struct TU_ATTR_PACKED {
+    union {
+        struct TU_ATTR_PACKED {
+            uint8_t recipient : 5;
+            uint8_t type : 2;
+            uint8_t direction : 1;
+        } bmRequestType_bit;
+        uint8_t bmRequestType;
+    };
+    uint8_t  bRequest;
+    uint16_t wValue;
+    uint16_t wIndex;
+    uint16_t wLength;
+} tusb_control_request_t;
+
+static inline uint8_t const* tu_desc_next(void const* desc) {
+    uint8_t const* desc8 = (uint8_t const*)desc;
+    return desc8 + desc8[0];
+}
+
+static inline uint8_t tu_desc_type(void const* desc) {
+    return ((uint8_t const*)desc)[1];
+}
+
+static inline uint8_t tu_desc_len(void const* desc) {
+    return ((uint8_t const*)desc)[0];
+}
+
+static inline tusb_dir_t tu_edpt_dir(uint8_t addr) {
+    return (addr & TUSB_DIR_IN_MASK) ? TUSB_DIR_IN : TUSB_DIR_OUT;
+}
+
+//--------------------------------------------------------------------+
+// DESCRIPTOR TEMPLATES
+//--------------------------------------------------------------------+
+#define CDC_COMM_SUBCLASS_ABSTRACT_CONTROL_MODEL    0x02
+#define CDC_COMM_PROTOCOL_NONE                      0x00
+#define CDC_FUNC_DESC_HEADER                        0x00
+#define CDC_FUNC_DESC_CALL_MANAGEMENT               0x01
+#define CDC_FUNC_DESC_ABSTRACT_CONTROL_MANAGEMENT   0x02
+#define CDC_FUNC_DESC_UNION                         0x06
+#define MSC_SUBCLASS_SCSI                           0x06
+#define MSC_PROTOCOL_BOT                            0x50
+
+#define TUD_CONFIG_DESC_LEN     (9)
+#define TUD_CONFIG_DESCRIPTOR(config_num, _itfcount, _stridx, _total_len, _attribute, _power_ma) \
+    9, TUSB_DESC_CONFIGURATION, U16_TO_U8S_LE(_total_len), _itfcount, config_num, _stridx, \
+    TU_BIT(7) | _attribute, (_power_ma) / 2
+
+#define TUD_CDC_DESC_LEN        (8 + 9 + 5 + 5 + 4 + 5 + 7 + 9 + 7 + 7)
+#define TUD_CDC_DESCRIPTOR(_itfnum, _stridx, _ep_notif, _ep_notif_size, _epout, _epin, _epsize) \
+    8, TUSB_DESC_INTERFACE_ASSOCIATION, _itfnum, 2, TUSB_CLASS_CDC, \
+    CDC_COMM_SUBCLASS_ABSTRACT_CONTROL_MODEL, CDC_COMM_PROTOCOL_NONE, 0, \
+    9, TUSB_DESC_INTERFACE, _itfnum, 0, 1, TUSB_CLASS_CDC, \
+    CDC_COMM_SUBCLASS_ABSTRACT_CONTROL_MODEL, CDC_COMM_PROTOCOL_NONE, _stridx, \
+    5, TUSB_DESC_CS_INTERFACE, CDC_FUNC_DESC_HEADER, U16_TO_U8S_LE(0x0120), \
+    5, TUSB_DESC_CS_INTERFACE, CDC_FUNC_DESC_CALL_MANAGEMENT, 0, (uint8_t)((_itfnum) + 1), \
+    4, TUSB_DESC_CS_INTERFACE, CDC_FUNC_DESC_ABSTRACT_CONTROL_MANAGEMENT, 6, \
+    5, TUSB_DESC_CS_INTERFACE, CDC_FUNC_DESC_UNION, _itfnum, (uint8_t)((_itfnum) + 1), \
+    7, TUSB_DESC_ENDPOINT, _ep_notif, TUSB_XFER_INTERRUPT, U16_TO_U8S_LE(_ep_notif_size), 16, \
+    9, TUSB_DESC_INTERFACE, (uint8_t)((_itfnum) + 1), 0, 2, TUSB_CLASS_CDC_DATA, 0, 0, 0, \
+    7, TUSB_DESC_ENDPOINT, _epout, TUSB_XFER_BULK, U16_TO_U8S_LE(_epsize), 0, \
+    7, TUSB_DESC_ENDPOINT, _epin, TUSB_XFER_BULK, U16_TO_U8S_LE(_epsize), 0
+
+#define HID_SUBCLASS_NONE                           0x00
+#define HID_SUBCLASS_BOOT                           0x01
+#define HID_ITF_PROTOCOL_NONE                       0x00
+#define HID_DESC_TYPE_HID                           0x21
+#define HID_DESC_TYPE_REPORT                        0x22
+
+#define TUD_HID_DESC_LEN        (9 + 9 + 7)
+#define TUD_HID_DESCRIPTOR(_itfnum, _stridx, _boot_protocol, _report_desc_len, _epin, _epsize, _ep_interval) \
+    9, TUSB_DESC_INTERFACE, _itfnum, 0, 1, TUSB_CLASS_HID, \
+    (uint8_t)((_boot_protocol) ? HID_SUBCLASS_BOOT : HID_SUBCLASS_NONE), _boot_protocol, _stridx, \
+    9, HID_DESC_TYPE_HID, U16_TO_U8S_LE(0x0111), 0, 1, HID_DESC_TYPE_REPORT, U16_TO_U8S_LE(_report_desc_len), \
+    7, TUSB_DESC_ENDPOINT, _epin, TUSB_XFER_INTERRUPT, U16_TO_U8S_LE(_epsize), _ep_interval
+
+// TinyUSB's gamepad report (hid_gamepad_report_t): X Y Z Rz Rx Ry at
+// -127..127, an 8-way hat (1-8, 0 centered) and 32 buttons, 11 bytes
+#define TUD_HID_REPORT_DESC_GAMEPAD(...) \
+    0x05, 0x01, 0x09, 0x05, 0xA1, 0x01, __VA_ARGS__ \
+    0x05, 0x01, 0x09, 0x30, 0x09, 0x31, 0x09, 0x32, 0x09, 0x35, 0x09, 0x33, 0x09, 0x34, \
+    0x15, 0x81, 0x25, 0x7F, 0x95, 0x06, 0x75, 0x08, 0x81, 0x02, \
+    0x05, 0x01, 0x09, 0x39, 0x15, 0x01, 0x25, 0x08, 0x35, 0x00, 0x46, 0x3B, 0x01, \
+    0x95, 0x01, 0x75, 0x08, 0x81, 0x02, \
+    0x05, 0x09, 0x19, 0x01, 0x29, 0x20, 0x15, 0x00, 0x25, 0x01, 0x95, 0x20, 0x75, 0x01, 0x81, 0x02, \
+    0xC0
+
+#define TUD_MSC_DESC_LEN        (9 + 7 + 7)
+#define TUD_MSC_DESCRIPTOR(_itfnum, _stridx, _epout, _epin, _epsize) \
+    9, TUSB_DESC_INTERFACE, _itfnum, 0, 2, TUSB_CLASS_MSC, MSC_SUBCLASS_SCSI, MSC_PROTOCOL_BOT, _stridx, \
+    7, TUSB_DESC_ENDPOINT, _epout, TUSB_XFER_BULK, U16_TO_U8S_LE(_epsize), 0, \
+    7, TUSB_DESC_ENDPOINT, _epin, TUSB_XFER_BULK, U16_TO_U8S_LE(_epsize), 0
+
+//--------------------------------------------------------------------+
+// DEVICE API
+//--------------------------------------------------------------------+
+// The simulated host learns which built-in classes the firmware was built with
+bool sim_tusb_init(bool vendor, bool cdc, bool msc, bool hid);
+
+static inline bool tusb_init(void) {
+    return sim_tusb_init(CFG_TUD_VENDOR, CFG_TUD_CDC, CFG_TUD_MSC, CFG_TUD_HID);
+}
+
+static inline bool tud_init(uint8_t rhport) {
+    (void)rhport;
+    return tusb_init();
+}
+
+void tud_task(void);
+bool tud_task_event_ready(void);
+bool tud_mounted(void);
+bool tud_ready(void);
+bool tud_suspended(void);
+bool tud_remote_wakeup(void);
+bool tud_disconnect(void);                  // Drop off the bus; the host sees an unplug
+bool tud_connect(void);                     // Back on the bus: the host enumerates again
+bool tud_control_xfer(uint8_t rhport, tusb_control_request_t const* request, void* buffer, uint16_t len);
+bool tud_control_status(uint8_t rhport, tusb_control_request_t const* request);
+
+// Application callbacks
+uint8_t const* tud_descriptor_device_cb(void);
+uint8_t const* tud_descriptor_configuration_cb(uint8_t index);
+uint16_t const* tud_descriptor_string_cb(uint8_t index, uint16_t langid);
+TU_ATTR_WEAK void tud_mount_cb(void);
+TU_ATTR_WEAK void tud_umount_cb(void);
+TU_ATTR_WEAK void tud_suspend_cb(bool remote_wakeup_en);
+TU_ATTR_WEAK void tud_resume_cb(void);
+
+// Vendor class
+bool tud_vendor_mounted(void);
+uint32_t tud_vendor_available(void);
+uint32_t tud_vendor_read(void* buffer, uint32_t bufsize);
+uint32_t tud_vendor_write(void const* buffer, uint32_t bufsize);
+uint32_t tud_vendor_write_flush(void);
+uint32_t tud_vendor_write_available(void);
+TU_ATTR_WEAK void tud_vendor_rx_cb(uint8_t itf);
+TU_ATTR_WEAK void tud_vendor_tx_cb(uint8_t itf, uint32_t sent_bytes);
+TU_ATTR_WEAK bool tud_vendor_control_xfer_cb(uint8_t rhport, uint8_t stage, tusb_control_request_t const* request);
+
+// CDC class
+bool tud_cdc_connected(void);
+uint32_t tud_cdc_available(void);
+uint32_t tud_cdc_read(void* buffer, uint32_t bufsize);
+uint32_t tud_cdc_write(void const* buffer, uint32_t bufsize);
+uint32_t tud_cdc_write_flush(void);
+uint32_t tud_cdc_write_available(void);
+TU_ATTR_WEAK void tud_cdc_line_state_cb(uint8_t itf, bool dtr, bool rts);
+TU_ATTR_WEAK void tud_cdc_rx_cb(uint8_t itf);
+
+// HID class
+#ifndef CFG_TUD_HID_EP_BUFSIZE
+#define CFG_TUD_HID_EP_BUFSIZE  64
+#endif
+
+typedef enum {
+    HID_REPORT_TYPE_INVALID = 0,
+    HID_REPORT_TYPE_INPUT,
+    HID_REPORT_TYPE_OUTPUT,
+    HID_REPORT_TYPE_FEATURE
+} hid_report_type_t;
+
+bool tud_hid_ready(void);
+bool tud_hid_report(uint8_t report_id, void const* report, uint16_t len);
+TU_ATTR_WEAK uint8_t const* tud_hid_descriptor_report_cb(uint8_t instance);
+uint16_t tud_hid_get_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type,
+                               uint8_t* buffer, uint16_t reqlen);
+void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type,
+                           uint8_t const* buffer, uint16_t bufsize);
+TU_ATTR_WEAK void tud_hid_report_complete_cb(uint8_t instance, uint8_t const* report, uint16_t len);
+
+// Application class drivers (device/usbd_pvt.h). The simulated host opens
+// them at SET_CONFIGURATION the way TinyUSB's usbd does.
+typedef struct {
+#if CFG_TUSB_DEBUG >= 2
+    char const* name;
+#endif
+    void     (*init)(void);
+    void     (*reset)(uint8_t rhport);
+    uint16_t (*open)(uint8_t rhport, tusb_desc_interface_t const* desc_intf, uint16_t max_len);
+    bool     (*control_xfer_cb)(uint8_t rhport, uint8_t stage, tusb_control_request_t const* request);
+    bool     (*xfer_cb)(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes);
+    void     (*sof)(uint8_t rhport, uint32_t frame_count);
+} usbd_class_driver_t;
+
+TU_ATTR_WEAK usbd_class_driver_t const* usbd_app_driver_get_cb(uint8_t* driver_count);
+
+bool usbd_edpt_open(uint8_t rhport, tusb_desc_endpoint_t const* desc_ep);
+bool usbd_edpt_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t* buffer, uint16_t total_bytes);
+bool usbd_edpt_busy(uint8_t rhport, uint8_t ep_addr);
+bool usbd_edpt_claim(uint8_t rhport, uint8_t ep_addr);
+bool usbd_edpt_release(uint8_t rhport, uint8_t ep_addr);
+
+// MSC class
+#define SCSI_CMD_PREVENT_ALLOW_MEDIUM_REMOVAL   0x1E
+#define SCSI_SENSE_NONE                         0x00
+#define SCSI_SENSE_NOT_READY                    0x02
+#define SCSI_SENSE_ILLEGAL_REQUEST              0x05
+#define SCSI_SENSE_UNIT_ATTENTION               0x06
+
+bool tud_msc_set_sense(uint8_t lun, uint8_t sense_key, uint8_t add_sense_code, uint8_t add_sense_qualifier);
+void tud_msc_inquiry_cb(uint8_t lun, uint8_t vendor_id[8], uint8_t product_id[16], uint8_t product_rev[4]);
+bool tud_msc_test_unit_ready_cb(uint8_t lun);
+void tud_msc_capacity_cb(uint8_t lun, uint32_t* block_count, uint16_t* block_size);
+TU_ATTR_WEAK bool tud_msc_start_stop_cb(uint8_t lun, uint8_t power_condition, bool start, bool load_eject);
+int32_t tud_msc_read10_cb(uint8_t lun, uint32_t lba, uint32_t offset, void* buffer, uint32_t bufsize);
+TU_ATTR_WEAK bool tud_msc_is_writable_cb(uint8_t lun);
+int32_t tud_msc_write10_cb(uint8_t lun, uint32_t lba, uint32_t offset, uint8_t* buffer, uint32_t bufsize);
+int32_t tud_msc_scsi_cb(uint8_t lun, uint8_t const scsi_cmd[16], void* buffer, uint16_t bufsize);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SIM_TUSB_H
@@ -0,0 +1,22 @@
+#ifndef SIM_WS2812_PIO_H
+#define SIM_WS2812_PIO_H
+
+// Stands in for the pioasm output; the simulator captures FIFO words only
+
+#include "hardware/pio.h"
+
+static const uint16_t ws2812_program_instructions[] = {
+    0x6221, 0x1123, 0x1400, 0xa442,
+};
+
+static const pio_program_t ws2812_program = {
+    ws2812_program_instructions,
+    4,
+    -1,
+};
+
+static inline void ws2812_program_init(PIO pio, uint sm, uint offset, uint pin, float freq, bool rgbw) {
+    (void)pio; (void)sm; (void)offset; (void)pin; (void)freq; (void)rgbw;
+}
+
+#endif // SIM_WS2812_PIO_H
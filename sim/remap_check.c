@@ -0,0 +1,292 @@
+#include "remap.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Checks the compiled remap program (remap.c) against a plain reference
+// mapper over every one of the 2^15 digital input states, with a set of
+// analog values, for the built-in tables and a run of pseudo-random ones.
+//
+//   bgg_remap_check [-n random-tables]
+//
+// The compile-time mapper in guitar_core.h is checked against remap.c in
+// remap_check_fixed.cpp. Exits non-zero on any table with a mismatch.
+
+#define RANDOM_TABLES_DEFAULT   200
+#define MISMATCH_PRINT_MAX      8
+
+// remap_check_fixed.cpp: fixed_map tables against remap.c, returns the failed table count
+uint32_t remap_check_fixed(uint32_t* tables);
+
+static const char* const all_targets[] = {
+    "none",
+    "a", "b", "x", "y", "lb", "rb", "start", "back", "guide", "lstick", "rstick",
+    "dpad_up", "dpad_down", "dpad_left", "dpad_right",
+    "lt", "lt+", "lt-", "rt", "rt+", "rt-",
+    "lx", "lx+", "lx-", "ly", "ly+", "ly-", "rx", "rx+", "rx-", "ry", "ry+", "ry-",
+};
+
+#define TARGET_COUNT    (sizeof(all_targets) / sizeof(all_targets[0]))
+
+static const int16_t analog_sets[][REMAP_ANALOG_SOURCES] = {
+    { -32768, 0, 0 },                       // Whammy at rest, sticks centered
+    { 32767, 32767, -32768 },
+    { -1, -32768, 32767 },
+    { 0, 12345, -20000 },
+    { 255, -1, 1 },
+    { 0, 16383, -16384 },                   // Either side of the analog button threshold
+};
+
+#define ANALOG_SET_COUNT    (sizeof(analog_sets) / sizeof(analog_sets[0]))
+
+static uint32_t rng_state = 0x2545F491;
+
+static uint32_t rng_next(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+//--------------------------------------------------------------------+
+// REFERENCE MAPPER
+//--------------------------------------------------------------------+
+// One source at a time, straight from the documented semantics in remap.h
+static void reference_map(const remap_target_t targets[REMAP_SOURCES], bool hat_joystick,
+                          const remap_input_t* input, remap_output_t* output) {
+    static const int32_t minimum[REMAP_AXES] = { 0, 0, -32768, -32768, -32768, -32768 };
+    static const int32_t maximum[REMAP_AXES] = { 255, 255, 32767, 32767, 32767, 32767 };
+    int32_t axes[REMAP_AXES] = { 0 };
+    uint32_t buttons = 0;
+
+    for (int source = 0; source < REMAP_SOURCES; source++) {
+        remap_target_t target = targets[source];
+
+        // hat_mode "joystick": d-pad targets of the d-pad sources become the left stick
+        if (hat_joystick && source >= REMAP_UP && source <= REMAP_RIGHT &&
+            target.kind == REMAP_TARGET_BUTTON && target.index <= 3) {
+            if (target.index == 0) { target.index = REMAP_AXIS_LY; target.direction = 1; }
+            else if (target.index == 1) { target.index = REMAP_AXIS_LY; target.direction = -1; }
+            else if (target.index == 2) { target.index = REMAP_AXIS_LX; target.direction = -1; }
+            else { target.index = REMAP_AXIS_LX; target.direction = 1; }
+            target.kind = REMAP_TARGET_AXIS;
+        }
+
+        bool trigger = target.index == REMAP_AXIS_LT || target.index == REMAP_AXIS_RT;
+        if (source < REMAP_DIGITAL_SOURCES) {
+            bool pressed = (input->digital >> source) & 1;
+            if (target.kind == REMAP_TARGET_BUTTON) {
+                if (pressed) buttons |= 1u << target.index;
+            } else if (target.kind == REMAP_TARGET_AXIS) {
+                if (trigger) {
+                    if (pressed) axes[target.index] += 255;
+                } else if (target.direction > 0) {
+                    if (pressed) axes[target.index] += 32767;
+                } else if (target.direction < 0) {
+                    if (pressed) axes[target.index] -= 32768;
+                } else {
+                    axes[target.index] += pressed ? -32768 : 32767;
+                }
+            }
+        } else {
+            int32_t value = input->analog[source - REMAP_DIGITAL_SOURCES];
+            if (target.direction < 0) value = -value;
+            if (target.kind == REMAP_TARGET_BUTTON) {
+                if (value > REMAP_ANALOG_BUTTON_THRESHOLD) buttons |= 1u << target.index;
+            } else if (target.kind == REMAP_TARGET_AXIS) {
+                axes[target.index] += trigger ? (value + 32768) / 256 : value;
+            }
+        }
+    }
+
+    for (int i = 0; i < REMAP_AXES; i++) {
+        if (axes[i] < minimum[i]) axes[i] = minimum[i];
+        if (axes[i] > maximum[i]) axes[i] = maximum[i];
+    }
+    output->buttons = (uint16_t)buttons;
+    output->lt = (uint8_t)axes[REMAP_AXIS_LT];
+    output->rt = (uint8_t)axes[REMAP_AXIS_RT];
+    output->lx = (int16_t)axes[REMAP_AXIS_LX];
+    output->ly = (int16_t)axes[REMAP_AXIS_LY];
+    output->rx = (int16_t)axes[REMAP_AXIS_RX];
+    output->ry = (int16_t)axes[REMAP_AXIS_RY];
+}
+
+//--------------------------------------------------------------------+
+// CHECKS
+//--------------------------------------------------------------------+
+static bool same_output(const remap_output_t* a, const remap_output_t* b) {
+    return a->buttons == b->buttons && a->lt == b->lt && a->rt == b->rt &&
+           a->lx == b->lx && a->ly == b->ly && a->rx == b->rx && a->ry == b->ry;
+}
+
+static void print_output(const char* label, const remap_output_t* o) {
+    printf("    %-9s buttons 0x%04x lt %u rt %u lx %d ly %d rx %d ry %d\n", label, o->buttons, o->lt, o->rt,
+           o->lx, o->ly, o->rx, o->ry);
+}
+
+static void print_table(const char* const targets[REMAP_SOURCES], bool hat_joystick) {
+    printf("  hat %s:", hat_joystick ? "joystick" : "dpad");
+    for (int i = 0; i < REMAP_SOURCES; i++) {
+        printf(" %s=%s", remap_source_key((remap_source_t)i), targets[i]);
+    }
+    printf("\n");
+}
+
+// Every digital state with every analog set; returns the mismatch count
+static uint32_t check_table(const char* name, const char* const targets[REMAP_SOURCES], bool hat_joystick) {
+    if (!remap_set(targets, hat_joystick)) {
+        printf("FAIL %s: table rejected\n", name);
+        print_table(targets, hat_joystick);
+        return 1;
+    }
+
+    remap_target_t parsed[REMAP_SOURCES];
+    for (int i = 0; i < REMAP_SOURCES; i++) {
+        remap_parse_target(targets[i], &parsed[i]);
+    }
+
+    uint32_t mismatches = 0;
+    for (uint32_t digital = 0; digital < (1u << REMAP_DIGITAL_SOURCES); digital++) {
+        for (uint32_t a = 0; a < ANALOG_SET_COUNT; a++) {
+            remap_input_t input;
+            input.digital = (uint16_t)digital;
+            memcpy(input.analog, analog_sets[a], sizeof(input.analog));
+
+            remap_output_t expected, actual;
+            reference_map(parsed, hat_joystick, &input, &expected);
+            remap_apply(&input, &actual);
+            if (same_output(&expected, &actual)) continue;
+
+            if (mismatches == 0) {
+                printf("FAIL %s\n", name);
+                print_table(targets, hat_joystick);
+            }
+            if (++mismatches <= MISMATCH_PRINT_MAX) {
+                printf("  digital 0x%04x analog %d %d %d\n", input.digital,
+                       input.analog[0], input.analog[1], input.analog[2]);
+                print_output("expected", &expected);
+                print_output("actual", &actual);
+            }
+        }
+    }
+    return mismatches;
+}
+
+// Analog sources on buttons, against fixed answers rather than the reference
+// mapper: a centred stick or a whammy at rest must not hold a button
+static uint32_t check_analog_buttons(void) {
+    static const struct {
+        int16_t analog[REMAP_ANALOG_SOURCES];
+        uint16_t buttons;
+    } cases[] = {
+        { { -32768, 0, 0 }, 0x0000 },               // Whammy at rest, sticks centred
+        { { 0, 16383, -16383 }, 0x0000 },           // Half travel is not past it
+        { { 16384, 16384, 0 }, 0x5000 },
+        { { 32767, -32768, 32767 }, 0x6000 },
+    };
+    const char* targets[REMAP_SOURCES];
+    for (int i = 0; i < REMAP_SOURCES; i++) targets[i] = "none";
+    targets[REMAP_WHAMMY] = "x";
+    targets[REMAP_JOY_X] = "a";
+    targets[REMAP_JOY_Y] = "b";
+
+    uint32_t failures = check_table("sticks on buttons", targets, false) != 0;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        remap_input_t input = { .digital = 0 };
+        memcpy(input.analog, cases[i].analog, sizeof(input.analog));
+        remap_output_t output;
+        remap_apply(&input, &output);
+        if (output.buttons != cases[i].buttons) {
+            printf("FAIL analog buttons: analog %d %d %d gave 0x%04x, expected 0x%04x\n",
+                   input.analog[0], input.analog[1], input.analog[2], output.buttons, cases[i].buttons);
+            failures++;
+        }
+    }
+    return failures;
+}
+
+// Invalid names must be refused, and refusing one must leave the program alone
+static uint32_t check_rejects(void) {
+    static const char* const invalid[] = { "", "A", "lx+-", "lxx", "l", "rt*", "dpad", "dpad_up+", "nothing" };
+    uint32_t failures = 0;
+
+    remap_set(remap_default_targets, false);
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+        const char* targets[REMAP_SOURCES];
+        memcpy(targets, remap_default_targets, sizeof(targets));
+        targets[i % REMAP_SOURCES] = invalid[i];
+        if (remap_validate_target((remap_source_t)(i % REMAP_SOURCES), invalid[i]) || remap_set(targets, true)) {
+            printf("FAIL reject: \"%s\" accepted\n", invalid[i]);
+            failures++;
+        }
+    }
+    if (remap_validate_target(REMAP_GREEN, NULL)) {
+        printf("FAIL reject: NULL accepted\n");
+        failures++;
+    }
+
+    remap_input_t input = { .digital = 1u << REMAP_GREEN, .analog = { 0, 0, 0 } };
+    remap_output_t output;
+    remap_apply(&input, &output);
+    if (output.buttons != 0x1000) {
+        printf("FAIL reject: rejected table replaced the default (buttons 0x%04x)\n", output.buttons);
+        failures++;
+    }
+    return failures;
+}
+
+int main(int argc, char** argv) {
+    uint32_t random_tables = RANDOM_TABLES_DEFAULT;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        if (opt == 'n') {
+            random_tables = (uint32_t)strtoul(optarg, NULL, 10);
+        } else {
+            fprintf(stderr, "usage: %s [-n random-tables]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    static const char* const fluffy[REMAP_SOURCES] = {
+        "a", "b", "y", "x", "lb", "dpad_up", "dpad_down", "start", "back", "guide", "ry+",
+        "none", "none", "dpad_left", "dpad_right", "rx", "lx", "ly"
+    };
+    // Everything piled onto a few outputs: ORed buttons, summed and clamped axes
+    static const char* const pileup[REMAP_SOURCES] = {
+        "a", "a", "ry", "ry", "ry-", "lt", "lt", "rt+", "lx+", "lx-", "lx",
+        "dpad_up", "dpad_up", "dpad_left", "dpad_left", "lt-", "lx", "a"
+    };
+
+    uint32_t failures = check_rejects();
+    uint32_t tables = 1;
+
+    failures += check_analog_buttons();
+
+    failures += check_table("default", remap_default_targets, false) != 0; tables++;
+    failures += check_table("default, hat joystick", remap_default_targets, true) != 0; tables++;
+    failures += check_table("fluffymadness", fluffy, false) != 0; tables++;
+    failures += check_table("pileup", pileup, false) != 0; tables++;
+    failures += check_table("pileup, hat joystick", pileup, true) != 0; tables++;
+
+    for (uint32_t t = 0; t < random_tables; t++) {
+        const char* targets[REMAP_SOURCES];
+        for (int i = 0; i < REMAP_SOURCES; i++) {
+            targets[i] = all_targets[rng_next() % TARGET_COUNT];
+        }
+        char name[32];
+        snprintf(name, sizeof(name), "random %lu", (unsigned long)t);
+        failures += check_table(name, targets, (t & 1) != 0) != 0;
+        tables++;
+    }
+
+    uint32_t fixed_tables = 0;
+    failures += remap_check_fixed(&fixed_tables);
+    tables += fixed_tables;
+
+    printf("remap check: %lu tables x %u digital states x %lu analog sets, %lu failed\n",
+           (unsigned long)tables, 1u << REMAP_DIGITAL_SOURCES, (unsigned long)ANALOG_SET_COUNT,
+           (unsigned long)failures);
+    return failures ? 1 : 0;
+}
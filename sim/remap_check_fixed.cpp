@@ -0,0 +1,113 @@
+#include "guitar_core.h"
+#include <stdio.h>
+#include <string.h>
+
+// The compile-time mapper (guitar_core::fixed_map) against remap.c: the
+// same table given both ways must map every input alike. Part of
+// bgg_remap_check, after remap.c itself has been checked.
+
+using guitar_core::axis;
+using guitar_core::button;
+using guitar_core::none;
+
+// remap_default_targets
+struct default_table {
+    static constexpr bool hat_joystick = false;
+    static constexpr remap_target_t targets[REMAP_SOURCES] = {
+        button(0x1000), button(0x2000), button(0x8000), button(0x4000), button(0x0100),
+        button(0x0001), button(0x0002), button(0x0010), button(0x0020), button(0x0400),
+        axis(REMAP_AXIS_RY),
+        button(0x0001), button(0x0002), button(0x0004), button(0x0008),
+        axis(REMAP_AXIS_RX), axis(REMAP_AXIS_LX), axis(REMAP_AXIS_LY),
+    };
+    static constexpr const char* names[REMAP_SOURCES] = {
+        "a", "b", "y", "x", "lb", "dpad_up", "dpad_down", "start", "back", "guide", "ry",
+        "dpad_up", "dpad_down", "dpad_left", "dpad_right", "rx", "lx", "ly"
+    };
+};
+
+struct default_hat_table : default_table {
+    static constexpr bool hat_joystick = true;
+};
+
+// bgg_xinput_firmware
+struct fluffy_table {
+    static constexpr bool hat_joystick = false;
+    static constexpr remap_target_t targets[REMAP_SOURCES] = {
+        button(0x1000), button(0x2000), button(0x8000), button(0x4000), button(0x0100),
+        button(0x0001), button(0x0002), button(0x0010), button(0x0020), button(0x0400),
+        axis(REMAP_AXIS_RY, 1),
+        none(), none(), button(0x0004), button(0x0008),
+        axis(REMAP_AXIS_RX), axis(REMAP_AXIS_LX), axis(REMAP_AXIS_LY),
+    };
+    static constexpr const char* names[REMAP_SOURCES] = {
+        "a", "b", "y", "x", "lb", "dpad_up", "dpad_down", "start", "back", "guide", "ry+",
+        "none", "none", "dpad_left", "dpad_right", "rx", "lx", "ly"
+    };
+};
+
+// Shared outputs, both trigger forms and analog sources on buttons
+struct pileup_table {
+    static constexpr bool hat_joystick = true;
+    static constexpr remap_target_t targets[REMAP_SOURCES] = {
+        button(0x1000), button(0x1000), axis(REMAP_AXIS_RY), axis(REMAP_AXIS_RY), axis(REMAP_AXIS_RY, -1),
+        axis(REMAP_AXIS_LT), axis(REMAP_AXIS_LT), axis(REMAP_AXIS_RT, 1), axis(REMAP_AXIS_LX, 1),
+        axis(REMAP_AXIS_LX, -1), axis(REMAP_AXIS_LX),
+        button(0x0001), button(0x0002), button(0x0004), button(0x0008),
+        axis(REMAP_AXIS_LT, -1), button(0x0200), button(0x8000),
+    };
+    static constexpr const char* names[REMAP_SOURCES] = {
+        "a", "a", "ry", "ry", "ry-", "lt", "lt", "rt+", "lx+", "lx-", "lx",
+        "dpad_up", "dpad_down", "dpad_left", "dpad_right", "lt-", "rb", "y"
+    };
+};
+
+static const int16_t analog_sets[][REMAP_ANALOG_SOURCES] = {
+    { -32768, 0, 0 },
+    { 32767, 32767, -32768 },
+    { -1, -32768, 32767 },
+    { 0, 12345, -20000 },
+};
+
+template <typename Table>
+static uint32_t check(const char* name) {
+    guitar_core::fixed_map<Table> fixed;
+    if (!remap_set(Table::names, Table::hat_joystick)) {
+        printf("FAIL fixed %s: table rejected by remap.c\n", name);
+        return 1;
+    }
+
+    uint32_t mismatches = 0;
+    for (uint32_t digital = 0; digital < (1u << REMAP_DIGITAL_SOURCES); digital++) {
+        for (size_t a = 0; a < sizeof(analog_sets) / sizeof(analog_sets[0]); a++) {
+            remap_input_t input;
+            input.digital = (uint16_t)digital;
+            memcpy(input.analog, analog_sets[a], sizeof(input.analog));
+
+            remap_output_t expected, actual;
+            remap_apply(&input, &expected);
+            fixed.apply(input, actual);
+            if (memcmp(&expected, &actual, sizeof(expected)) == 0) continue;
+
+            if (++mismatches == 1) {
+                printf("FAIL fixed %s: digital 0x%04x analog %d %d %d\n", name, input.digital,
+                       input.analog[0], input.analog[1], input.analog[2]);
+                printf("    remap.c   buttons 0x%04x lt %u rt %u lx %d ly %d rx %d ry %d\n", expected.buttons,
+                       expected.lt, expected.rt, expected.lx, expected.ly, expected.rx, expected.ry);
+                printf("    fixed     buttons 0x%04x lt %u rt %u lx %d ly %d rx %d ry %d\n", actual.buttons,
+                       actual.lt, actual.rt, actual.lx, actual.ly, actual.rx, actual.ry);
+            }
+        }
+    }
+    return mismatches != 0;
+}
+
+extern "C" uint32_t remap_check_fixed(uint32_t* tables) {
+    uint32_t failures = 0;
+    failures += check<default_table>("default");
+    failures += check<default_hat_table>("default, hat joystick");
+    failures += check<fluffy_table>("fluffymadness");
+    failures += check<pileup_table>("pileup");
+    *tables = 4;
+    return failures;
+}
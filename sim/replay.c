@@ -0,0 +1,227 @@
+#include "sim.h"
+#include "config.h"
+#include "input_trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Replays an input trace (TRACE_READ image, see input_trace.h) through the
+// simulated firmware and prints every XInput report that changes, so a ghost
+// input can be traced back to the raw pin levels that produced it.
+//
+//   bgg_replay [-f flash.bin] [-r first-last] [-v] trace.bin
+//
+// Every record holds the complete input state, so any range of records can
+// be replayed on its own to bisect a trace. Pin mapping comes from the
+// config in the flash image (defaults without -f), which should match the
+// device the trace was taken on.
+
+int firmware_main(void);
+
+#define REPLAY_LOOP_US      50
+#define REPLAY_SETTLE_US    100000  // After enumeration, before the first record
+#define REPLAY_TAIL_US      50000   // After the last record
+
+static input_trace_record_t* records = NULL;
+static uint32_t record_count = 0;
+static uint32_t next_record = 0;
+static bool verbose = false;
+static FILE* out = NULL;            // Real stdout; the firmware console is muted
+
+static bool started = false;
+static uint64_t base_us = 0;        // Virtual time of the first record
+static uint64_t end_us = 0;
+static uint32_t seen_reports = 0;
+static uint8_t last_report[SIM_REPORT_SIZE];
+static bool have_report = false;
+static uint32_t changes = 0;
+
+static const struct {
+    uint16_t mask;
+    const char* name;
+} buttons[] = {
+    { 0x0001, "UP" }, { 0x0002, "DOWN" }, { 0x0004, "LEFT" }, { 0x0008, "RIGHT" },
+    { 0x0010, "START" }, { 0x0020, "BACK" }, { 0x0040, "LS" }, { 0x0080, "RS" },
+    { 0x0100, "LB" }, { 0x0200, "RB" }, { 0x0400, "GUIDE" },
+    { 0x1000, "A" }, { 0x2000, "B" }, { 0x4000, "X" }, { 0x8000, "Y" },
+};
+
+static inline int16_t get_s16(const uint8_t* p) {
+    return (int16_t)(p[0] | (p[1] << 8));
+}
+
+static double trace_ms(uint64_t now_us) {
+    return (double)(int64_t)(now_us - base_us) / 1000.0;
+}
+
+//--------------------------------------------------------------------+
+// REPLAY
+//--------------------------------------------------------------------+
+static void apply_record(const input_trace_record_t* record) {
+    for (uint32_t pin = 0; pin < SIM_GPIO_COUNT; pin++) {
+        sim_gpio_drive(pin, (record->gpio >> pin) & 1);
+    }
+    sim_adc_set(config_get_whammy_pin() - 26, record->whammy);
+    sim_adc_set(2, record->joy_x);
+    sim_adc_set(3, record->joy_y);
+
+    if (verbose) {
+        fprintf(out, "%10.3f ms  in   ", trace_ms(sim_now_us()));
+        for (uint32_t pin = 0; pin < SIM_GPIO_COUNT; pin++) {
+            if (!((record->gpio >> pin) & 1)) fprintf(out, " GP%lu", (unsigned long)pin);
+        }
+        fprintf(out, "  whammy %u joy %u,%u\n", record->whammy, record->joy_x, record->joy_y);
+    }
+}
+
+static void print_report(const uint8_t* report) {
+    uint16_t mask = report[2] | (report[3] << 8);
+    char names[96] = "";
+
+    for (size_t i = 0; i < sizeof(buttons) / sizeof(buttons[0]); i++) {
+        if (mask & buttons[i].mask) {
+            strncat(names, " ", sizeof(names) - strlen(names) - 1);
+            strncat(names, buttons[i].name, sizeof(names) - strlen(names) - 1);
+        }
+    }
+
+    fprintf(out, "%10.3f ms  out  %04X%-28s lx %6d ly %6d rx %6d ry %6d\n",
+            trace_ms(sim_now_us()), mask, names, get_s16(&report[6]), get_s16(&report[8]),
+            get_s16(&report[10]), get_s16(&report[12]));
+}
+
+static void finish(void) {
+    fflush(out);
+    fprintf(stderr, "REPLAY: %lu records, %lu report changes\n",
+            (unsigned long)record_count, (unsigned long)changes);
+    exit(0);
+}
+
+void sim_loop_hook(void) {
+    sim_advance_us(REPLAY_LOOP_US);
+    uint64_t now = sim_now_us();
+
+    if (!started) {
+        if (!sim_usb_mounted()) return;
+        base_us = now + REPLAY_SETTLE_US;
+        started = true;
+    }
+
+    // Records keep their spacing from the device
+    while (next_record < record_count &&
+           now >= base_us + (uint32_t)(records[next_record].time_us - records[0].time_us)) {
+        apply_record(&records[next_record++]);
+        if (next_record == record_count) end_us = now + REPLAY_TAIL_US;
+    }
+
+    // Reports the host received since the first record
+    if (now >= base_us && sim_usb_report_count() != seen_reports) {
+        seen_reports = sim_usb_report_count();
+        const uint8_t* report = sim_usb_last_report();
+        if (!have_report || memcmp(report, last_report, SIM_REPORT_SIZE) != 0) {
+            memcpy(last_report, report, SIM_REPORT_SIZE);
+            have_report = true;
+            changes++;
+            print_report(report);
+        }
+    }
+
+    if (next_record == record_count && now >= end_us) {
+        finish();
+    }
+}
+
+//--------------------------------------------------------------------+
+// TRACE FILE
+//--------------------------------------------------------------------+
+static bool load_trace(const char* path, uint32_t first, uint32_t last) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "REPLAY: Cannot open %s\n", path);
+        return false;
+    }
+
+    input_trace_header_t header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != INPUT_TRACE_MAGIC ||
+        header.version != INPUT_TRACE_VERSION || header.record_size != sizeof(input_trace_record_t)) {
+        fprintf(stderr, "REPLAY: %s is not an input trace\n", path);
+        fclose(file);
+        return false;
+    }
+
+    records = (input_trace_record_t*)calloc(header.record_count ? header.record_count : 1, sizeof(input_trace_record_t));
+    uint32_t count = (uint32_t)fread(records, sizeof(input_trace_record_t), header.record_count, file);
+    fclose(file);
+    if (count != header.record_count) {
+        fprintf(stderr, "REPLAY: %s truncated, %lu of %lu records\n", path,
+                (unsigned long)count, (unsigned long)header.record_count);
+    }
+    if (header.dropped) {
+        fprintf(stderr, "REPLAY: %lu older records were overwritten on the device\n",
+                (unsigned long)header.dropped);
+    }
+
+    // Record range for bisecting
+    if (last >= count) last = count ? count - 1 : 0;
+    if (count == 0 || first > last) {
+        fprintf(stderr, "REPLAY: No records to replay\n");
+        return false;
+    }
+    memmove(records, records + first, (last - first + 1) * sizeof(input_trace_record_t));
+    record_count = last - first + 1;
+    return true;
+}
+
+//--------------------------------------------------------------------+
+// MAIN
+//--------------------------------------------------------------------+
+static void usage(void) {
+    fprintf(stderr,
+            "usage: bgg_replay [-f flash.bin] [-r first-last] [-v] trace.bin\n"
+            "  -f  flash image holding the device config (default: built-in config)\n"
+            "  -r  replay only records first..last (0-based, inclusive)\n"
+            "  -v  also print every input record\n");
+}
+
+int main(int argc, char** argv) {
+    const char* flash_path = NULL;
+    const char* trace_path = NULL;
+    unsigned long first = 0;
+    unsigned long last = UINT32_MAX;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            flash_path = argv[++i];
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%lu-%lu", &first, &last) < 1) {
+                usage();
+                return 2;
+            }
+        } else if (strcmp(argv[i], "-v") == 0) {
+            verbose = true;
+        } else if (argv[i][0] != '-' && !trace_path) {
+            trace_path = argv[i];
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (!trace_path) {
+        usage();
+        return 2;
+    }
+
+    if (!sim_flash_open(flash_path) || !load_trace(trace_path, (uint32_t)first, (uint32_t)last)) {
+        return 2;
+    }
+
+    // Keep our output, mute the firmware console
+    out = fdopen(dup(STDOUT_FILENO), "w");
+    sim_uart_set_quiet(true);
+    if (!out || !freopen("/dev/null", "w", stdout)) return 2;
+
+    firmware_main();
+    finish();
+    return 0;
+}
@@ -0,0 +1,78 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Host simulation of the BGG firmware.
+//
+// The firmware sources build unchanged against the shims in sim/include.
+// Time is virtual: it moves by the configured loop cost on every tud_task()
+// call and instantly through sleep_ms(), so scripted scenarios run far
+// faster than real time. The scenario runner (sim_main.c) gets control once
+// per main loop iteration through sim_loop_hook().
+
+#define SIM_GPIO_COUNT          30
+#define SIM_ADC_CHANNELS        4
+#define SIM_LED_MAX             16
+#define SIM_REPORT_SIZE         22      // Vendor XInput packet: 2 byte header + 20 byte report
+#define SIM_CDC_CAPTURE_SIZE    65536
+
+// Clock
+uint64_t sim_now_us(void);
+void sim_advance_us(uint64_t us);
+
+// Pins and ADC, driven by the scenario
+void sim_gpio_drive(uint32_t pin, bool level);
+bool sim_gpio_level(uint32_t pin);
+void sim_adc_set(uint32_t channel, uint16_t value);
+
+// Flash image backed by a file, NULL keeps it in memory only
+bool sim_flash_open(const char* path);
+uint32_t sim_flash_erase_count(void);
+
+// WS2812 frames captured from the PIO FIFO, colours as 0xRRGGBB
+uint32_t sim_led_get(uint32_t index);
+uint32_t sim_led_frame_count(void);
+
+// UART console
+void sim_uart_set_quiet(bool quiet);
+
+// Simulated USB host
+void sim_usb_service(void);
+void sim_usb_cdc_open(bool dtr);
+void sim_usb_cdc_send(const char* data, uint32_t length);
+const char* sim_usb_cdc_output(uint32_t* length);
+void sim_usb_cdc_consume(uint32_t length);
+void sim_usb_cdc_set_echo(bool echo);
+bool sim_usb_mounted(void);
+uint64_t sim_usb_mount_time_us(void);
+uint32_t sim_usb_descriptor_errors(void);
+uint32_t sim_usb_report_count(void);
+uint32_t sim_usb_mount_report_count(void);  // sim_usb_report_count() at the latest enumeration
+uint64_t sim_usb_first_report_us(void);
+const uint8_t* sim_usb_last_report(void);
+const uint8_t* sim_usb_last_hid_report(uint16_t* length);
+uint16_t sim_usb_product_id(void);          // 0 while not mounted
+
+// Simulated USB drive host: saves a file over MSC one sector per frame
+bool sim_msc_save(const char* name, uint32_t size, uint32_t seed);
+void sim_msc_service(void);
+bool sim_msc_event_ready(void);
+uint32_t sim_msc_pending(void);             // Sectors still to write
+uint32_t sim_msc_errors(void);              // Failed writes and erases inside the write callback
+uint32_t sim_msc_retries(void);             // Writes refused with NOT READY and retried
+const uint8_t* sim_msc_saved(const char* name, uint32_t* size);
+
+// Scenario runner, called from tud_task() once per firmware loop
+void sim_loop_hook(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SIM_H
@@ -0,0 +1,13 @@
+#ifndef SIM_FIRMWARE_H
+#define SIM_FIRMWARE_H
+
+// Forced into main.cpp by the sim build: the scenario runner owns main(),
+// the firmware's main() becomes firmware_main() with C linkage.
+
+#ifdef __cplusplus
+extern "C" int firmware_main(void);
+#endif
+
+#define main firmware_main
+
+#endif // SIM_FIRMWARE_H
@@ -0,0 +1,622 @@
+#include "sim.h"
+#include "pico/stdlib.h"
+#include "pico/bootrom.h"
+#include "pico/multicore.h"
+#include "hardware/adc.h"
+#include "hardware/dma.h"
+#include "hardware/flash.h"
+#include "hardware/pio.h"
+#include "hardware/uart.h"
+#include "hardware/clocks.h"
+#include "hardware/timer.h"
+#include "hardware/structs/systick.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+//--------------------------------------------------------------------+
+// CLOCK
+//--------------------------------------------------------------------+
+static uint64_t now_us = 0;
+systick_hw_t sim_systick;
+
+uint64_t sim_now_us(void) {
+    return now_us;
+}
+
+static struct {
+    bool claimed;
+    bool armed;
+    uint64_t target_us;
+    hardware_alarm_callback_t callback;
+} alarms[SIM_ALARM_COUNT];
+
+static void adc_stream_update(void);
+
+static void set_now(uint64_t us) {
+    now_us = us;
+
+    // SysTick counts clk_sys cycles down from its reload value
+    uint64_t cycles = now_us * (SIM_CLK_SYS_HZ / 1000000);
+    sim_systick.cvr = 0x00FFFFFF - (uint32_t)(cycles & 0x00FFFFFF);
+
+    adc_stream_update();
+}
+
+static int next_alarm(uint64_t until_us) {
+    int next = -1;
+    for (int i = 0; i < SIM_ALARM_COUNT; i++) {
+        if (alarms[i].armed && alarms[i].target_us <= until_us &&
+            (next < 0 || alarms[i].target_us < alarms[next].target_us)) {
+            next = i;
+        }
+    }
+    return next;
+}
+
+static bool sleeping = false;    // Core in WFI: the first interrupt ends the advance
+
+void sim_advance_us(uint64_t us) {
+    uint64_t end_us = now_us + us;
+
+    // Alarm interrupts fire at their target on the way, in target order
+    int alarm;
+    while ((alarm = next_alarm(end_us)) >= 0) {
+        if (alarms[alarm].target_us > now_us) set_now(alarms[alarm].target_us);
+        alarms[alarm].armed = false;
+        if (alarms[alarm].callback) alarms[alarm].callback((uint)alarm);
+        if (sleeping) {
+            sleeping = false;
+            return;
+        }
+    }
+    set_now(end_us);
+}
+
+void sim_wfi(void) {
+    sleeping = true;
+    sim_loop_hook();
+    sleeping = false;
+}
+
+uint64_t time_us_64(void) {
+    return now_us;
+}
+
+void sleep_us(uint64_t us) {
+    sim_advance_us(us);
+}
+
+void sleep_ms(uint32_t ms) {
+    sim_advance_us((uint64_t)ms * 1000);
+}
+
+//--------------------------------------------------------------------+
+// TIMER ALARMS
+//--------------------------------------------------------------------+
+int hardware_alarm_claim_unused(bool required) {
+    for (int i = 0; i < SIM_ALARM_COUNT; i++) {
+        if (!alarms[i].claimed) {
+            alarms[i].claimed = true;
+            return i;
+        }
+    }
+    if (required) {
+        fprintf(stderr, "SIM: No free hardware alarm\n");
+        exit(2);
+    }
+    return -1;
+}
+
+void hardware_alarm_unclaim(uint alarm_num) {
+    if (alarm_num < SIM_ALARM_COUNT) memset(&alarms[alarm_num], 0, sizeof(alarms[alarm_num]));
+}
+
+void hardware_alarm_set_callback(uint alarm_num, hardware_alarm_callback_t callback) {
+    if (alarm_num < SIM_ALARM_COUNT) alarms[alarm_num].callback = callback;
+}
+
+bool hardware_alarm_set_target(uint alarm_num, absolute_time_t t) {
+    if (alarm_num >= SIM_ALARM_COUNT) return true;
+    if (t <= now_us) {
+        alarms[alarm_num].armed = false;
+        return true;    // Already passed, like the SDK
+    }
+    alarms[alarm_num].armed = true;
+    alarms[alarm_num].target_us = t;
+    return false;
+}
+
+void hardware_alarm_cancel(uint alarm_num) {
+    if (alarm_num < SIM_ALARM_COUNT) alarms[alarm_num].armed = false;
+}
+
+//--------------------------------------------------------------------+
+// CORE 1
+//--------------------------------------------------------------------+
+// Core 1 only runs boot phases, so a plain thread is enough: the boot graph
+// orders it against core 0 and it is joined again before the main loop.
+__thread uint sim_core_num = 0;
+static pthread_t core1_thread;
+static bool core1_running = false;
+
+static void* core1_main(void* entry) {
+    sim_core_num = 1;
+    ((void (*)(void))entry)();
+    return NULL;
+}
+
+void multicore_launch_core1(void (*entry)(void)) {
+    if (core1_running) multicore_reset_core1();
+    core1_running = pthread_create(&core1_thread, NULL, core1_main, (void*)entry) == 0;
+}
+
+void multicore_reset_core1(void) {
+    if (!core1_running) return;
+    pthread_join(core1_thread, NULL);
+    core1_running = false;
+}
+
+//--------------------------------------------------------------------+
+// GPIO
+//--------------------------------------------------------------------+
+static struct {
+    bool output;
+    bool out_level;
+    bool in_level;          // Level driven from outside (buttons)
+    uint32_t irq_events;
+} pins[SIM_GPIO_COUNT];
+
+static gpio_irq_callback_t irq_callback = NULL;
+static bool pins_ready = false;
+
+static void pins_init(void) {
+    // Buttons are active low against pull-ups: released reads high
+    for (int i = 0; i < SIM_GPIO_COUNT; i++) {
+        pins[i].in_level = true;
+    }
+    pins_ready = true;
+}
+
+void gpio_init(uint gpio) {
+    if (!pins_ready) pins_init();
+    if (gpio < SIM_GPIO_COUNT) {
+        pins[gpio].output = false;
+        pins[gpio].out_level = false;
+    }
+}
+
+void gpio_set_dir(uint gpio, bool out) {
+    if (gpio < SIM_GPIO_COUNT) pins[gpio].output = out;
+}
+
+void gpio_pull_up(uint gpio) {
+    (void)gpio;
+}
+
+void gpio_pull_down(uint gpio) {
+    (void)gpio;
+}
+
+bool gpio_get(uint gpio) {
+    if (!pins_ready) pins_init();
+    if (gpio >= SIM_GPIO_COUNT) return false;
+    return pins[gpio].output ? pins[gpio].out_level : pins[gpio].in_level;
+}
+
+uint32_t gpio_get_all(void) {
+    uint32_t levels = 0;
+    for (uint i = 0; i < SIM_GPIO_COUNT; i++) {
+        if (gpio_get(i)) levels |= 1u << i;
+    }
+    return levels;
+}
+
+void gpio_put(uint gpio, bool value) {
+    if (gpio < SIM_GPIO_COUNT) pins[gpio].out_level = value;
+}
+
+void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t event_mask, bool enabled, gpio_irq_callback_t callback) {
+    if (gpio >= SIM_GPIO_COUNT) return;
+    if (enabled) {
+        pins[gpio].irq_events |= event_mask;
+    } else {
+        pins[gpio].irq_events &= ~event_mask;
+    }
+    irq_callback = callback;
+}
+
+void sim_gpio_drive(uint32_t pin, bool level) {
+    if (!pins_ready) pins_init();
+    if (pin >= SIM_GPIO_COUNT || pins[pin].in_level == level) return;
+
+    pins[pin].in_level = level;
+    uint32_t event = level ? GPIO_IRQ_EDGE_RISE : GPIO_IRQ_EDGE_FALL;
+    if (irq_callback && (pins[pin].irq_events & event)) {
+        irq_callback(pin, event);
+    }
+}
+
+bool sim_gpio_level(uint32_t pin) {
+    return gpio_get(pin);
+}
+
+//--------------------------------------------------------------------+
+// ADC
+//--------------------------------------------------------------------+
+static uint16_t adc_values[SIM_ADC_CHANNELS] = { 2048, 2048, 2048, 2048 };
+static uint adc_channel = 0;
+adc_hw_t sim_adc_hw;
+
+static struct {
+    bool running;
+    bool fifo_dreq;
+    uint32_t round_robin;       // Input mask
+    uint64_t period_ns;         // One conversion
+    uint64_t next_ns;           // Next conversion result
+} adc_stream;
+
+void adc_init(void) {
+    memset(&sim_adc_hw, 0, sizeof(sim_adc_hw));
+    memset(&adc_stream, 0, sizeof(adc_stream));
+    adc_stream.period_ns = 2000;    // 96 cycles at 48 MHz
+}
+
+void adc_gpio_init(uint gpio) {
+    (void)gpio;
+}
+
+void adc_select_input(uint input) {
+    adc_channel = input < SIM_ADC_CHANNELS ? input : 0;
+}
+
+uint16_t adc_read(void) {
+    return adc_values[adc_channel];
+}
+
+void adc_set_round_robin(uint input_mask) {
+    adc_stream.round_robin = input_mask & ((1u << SIM_ADC_CHANNELS) - 1);
+}
+
+void adc_fifo_setup(bool en, bool dreq_en, uint16_t dreq_thresh, bool err_in_fifo, bool byte_shift) {
+    (void)dreq_thresh;
+    (void)err_in_fifo;
+    (void)byte_shift;
+    adc_stream.fifo_dreq = en && dreq_en;
+}
+
+void adc_set_clkdiv(float clkdiv) {
+    // A conversion takes 96 cycles or 1 + div cycles, whichever is longer
+    float cycles = clkdiv + 1.0f > 96.0f ? clkdiv + 1.0f : 96.0f;
+    adc_stream.period_ns = (uint64_t)(cycles * 1000.0f / 48.0f + 0.5f);
+}
+
+void adc_run(bool run) {
+    adc_stream.running = run;
+    adc_stream.next_ns = (now_us * 1000) + adc_stream.period_ns;
+}
+
+void adc_fifo_drain(void) {
+}
+
+void sim_hw_set_bits(io_rw_32* addr, uint32_t mask) {
+    uint32_t clear = (addr == &sim_adc_hw.fcs) ? (ADC_FCS_OVER_BITS | ADC_FCS_UNDER_BITS) : 0;
+    *addr = (*addr | (mask & ~clear)) & ~(mask & clear);
+}
+
+//--------------------------------------------------------------------+
+// DMA
+//--------------------------------------------------------------------+
+static dma_channel_hw_t dma_regs[SIM_DMA_CHANNELS];
+static struct {
+    bool claimed;
+    bool busy;
+    uint32_t count;             // Last count written; every trigger reloads it
+    dma_channel_config config;
+} dma_state[SIM_DMA_CHANNELS];
+
+dma_channel_hw_t* dma_channel_hw_addr(uint channel) {
+    return &dma_regs[channel < SIM_DMA_CHANNELS ? channel : 0];
+}
+
+int dma_claim_unused_channel(bool required) {
+    for (int i = 0; i < SIM_DMA_CHANNELS; i++) {
+        if (!dma_state[i].claimed) {
+            dma_state[i].claimed = true;
+            return i;
+        }
+    }
+    if (required) {
+        fprintf(stderr, "SIM: No free DMA channel\n");
+        exit(1);
+    }
+    return -1;
+}
+
+void dma_channel_unclaim(uint channel) {
+    if (channel < SIM_DMA_CHANNELS) memset(&dma_state[channel], 0, sizeof(dma_state[channel]));
+}
+
+dma_channel_config dma_channel_get_default_config(uint channel) {
+    dma_channel_config config = { DMA_SIZE_32, true, false, 0, false, DREQ_FORCE, (uint8_t)channel };
+    return config;
+}
+
+static void dma_run_unpaced(uint channel);
+
+static void dma_trigger(uint channel) {
+    dma_regs[channel].transfer_count = dma_state[channel].count;
+    dma_state[channel].busy = dma_state[channel].count != 0;
+    if (dma_state[channel].busy && dma_state[channel].config.dreq == DREQ_FORCE) {
+        dma_run_unpaced(channel);
+    }
+}
+
+static void dma_complete(uint channel) {
+    dma_state[channel].busy = false;
+    if (dma_state[channel].config.chain_to != channel) {
+        dma_trigger(dma_state[channel].config.chain_to);
+    }
+}
+
+// One transfer; a write to another channel's trigger alias starts it
+static void dma_transfer(uint channel, uint32_t value) {
+    dma_channel_hw_t* regs = &dma_regs[channel];
+    const dma_channel_config* config = &dma_state[channel].config;
+    uint32_t bytes = 1u << config->size;
+
+    if (config->size == DMA_SIZE_32) {
+        *(volatile uint32_t*)regs->write_addr = value;
+    } else if (config->size == DMA_SIZE_16) {
+        *(volatile uint16_t*)regs->write_addr = (uint16_t)value;
+    } else {
+        *(volatile uint8_t*)regs->write_addr = (uint8_t)value;
+    }
+
+    for (uint i = 0; i < SIM_DMA_CHANNELS; i++) {
+        if (regs->write_addr == (uintptr_t)&dma_regs[i].al1_transfer_count_trig) {
+            dma_state[i].count = value;
+            dma_trigger(i);
+        }
+    }
+
+    if (config->write_increment) {
+        uintptr_t next = regs->write_addr + bytes;
+        if (config->ring_write && config->ring_bits) {
+            uintptr_t mask = ((uintptr_t)1 << config->ring_bits) - 1;
+            next = (regs->write_addr & ~mask) | (next & mask);
+        }
+        regs->write_addr = next;
+    }
+    if (config->read_increment) regs->read_addr += bytes;
+    if (--regs->transfer_count == 0) dma_complete(channel);
+}
+
+static void dma_run_unpaced(uint channel) {
+    while (dma_state[channel].busy) {
+        uint32_t value = *(const volatile uint32_t*)dma_regs[channel].read_addr;
+        dma_transfer(channel, value);
+    }
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config* config, volatile void* write_addr,
+                           const volatile void* read_addr, uint32_t transfer_count, bool trigger) {
+    if (channel >= SIM_DMA_CHANNELS) return;
+    dma_state[channel].config = *config;
+    dma_regs[channel].write_addr = (uintptr_t)write_addr;
+    dma_regs[channel].read_addr = (uintptr_t)read_addr;
+    dma_regs[channel].transfer_count = transfer_count;
+    dma_state[channel].count = transfer_count;
+    if (trigger) dma_trigger(channel);
+}
+
+void dma_channel_abort(uint channel) {
+    if (channel < SIM_DMA_CHANNELS) dma_state[channel].busy = false;
+}
+
+bool dma_channel_is_busy(uint channel) {
+    return channel < SIM_DMA_CHANNELS && dma_state[channel].busy;
+}
+
+// Conversions due by now, each handed to the channel paced by DREQ_ADC
+static void adc_stream_update(void) {
+    if (!adc_stream.running || !adc_stream.round_robin) return;
+
+    uint64_t until_ns = now_us * 1000;
+    while (adc_stream.next_ns <= until_ns) {
+        adc_stream.next_ns += adc_stream.period_ns;
+        uint16_t value = adc_values[adc_channel];
+        do {
+            adc_channel = (adc_channel + 1) % SIM_ADC_CHANNELS;
+        } while (!(adc_stream.round_robin & (1u << adc_channel)));
+
+        int paced = -1;
+        for (int i = 0; i < SIM_DMA_CHANNELS; i++) {
+            if (dma_state[i].busy && dma_state[i].config.dreq == DREQ_ADC) paced = i;
+        }
+        if (!adc_stream.fifo_dreq) continue;
+        if (paced < 0) {
+            sim_adc_hw.fcs |= ADC_FCS_OVER_BITS;
+            continue;
+        }
+        dma_transfer((uint)paced, value);
+    }
+}
+
+void sim_adc_set(uint32_t channel, uint16_t value) {
+    if (channel < SIM_ADC_CHANNELS) adc_values[channel] = value & 0x0FFF;
+}
+
+//--------------------------------------------------------------------+
+// FLASH
+//--------------------------------------------------------------------+
+uint8_t sim_flash_image[PICO_FLASH_SIZE_BYTES];
+static FILE* flash_file = NULL;
+static bool flash_ready = false;
+static uint32_t flash_erase_count = 0;
+
+static void flash_init(void) {
+    if (!flash_ready) {
+        memset(sim_flash_image, 0xFF, sizeof(sim_flash_image));
+        flash_ready = true;
+    }
+}
+
+static void flash_persist(uint32_t offset, size_t count) {
+    if (flash_file) {
+        fseek(flash_file, offset, SEEK_SET);
+        fwrite(&sim_flash_image[offset], 1, count, flash_file);
+        fflush(flash_file);
+    }
+}
+
+bool sim_flash_open(const char* path) {
+    flash_init();
+    if (!path) return true;
+
+    flash_file = fopen(path, "r+b");
+    if (flash_file) {
+        size_t loaded = fread(sim_flash_image, 1, sizeof(sim_flash_image), flash_file);
+        fprintf(stderr, "SIM: Flash image %s (%lu bytes)\n", path, (unsigned long)loaded);
+        return true;
+    }
+
+    // New image: start fully erased
+    flash_file = fopen(path, "w+b");
+    if (!flash_file) {
+        fprintf(stderr, "SIM: Cannot open flash image %s\n", path);
+        return false;
+    }
+    flash_persist(0, sizeof(sim_flash_image));
+    return true;
+}
+
+void flash_range_erase(uint32_t flash_offs, size_t count) {
+    flash_init();
+    if ((flash_offs % FLASH_SECTOR_SIZE) || (count % FLASH_SECTOR_SIZE) ||
+        flash_offs + count > sizeof(sim_flash_image)) {
+        fprintf(stderr, "SIM: Bad flash erase 0x%06lx + %lu\n", (unsigned long)flash_offs, (unsigned long)count);
+        abort();
+    }
+    memset(&sim_flash_image[flash_offs], 0xFF, count);
+    flash_persist(flash_offs, count);
+    flash_erase_count++;
+}
+
+uint32_t sim_flash_erase_count(void) {
+    return flash_erase_count;
+}
+
+void flash_range_program(uint32_t flash_offs, const uint8_t* data, size_t count) {
+    flash_init();
+    if ((flash_offs % FLASH_PAGE_SIZE) || (count % FLASH_PAGE_SIZE) ||
+        flash_offs + count > sizeof(sim_flash_image)) {
+        fprintf(stderr, "SIM: Bad flash program 0x%06lx + %lu\n", (unsigned long)flash_offs, (unsigned long)count);
+        abort();
+    }
+
+    // NOR flash: programming can only clear bits
+    for (size_t i = 0; i < count; i++) {
+        sim_flash_image[flash_offs + i] &= data[i];
+    }
+    flash_persist(flash_offs, count);
+}
+
+//--------------------------------------------------------------------+
+// PIO (WS2812)
+//--------------------------------------------------------------------+
+pio_hw_t sim_pio[2] = { { 0 }, { 1 } };
+static bool sm_claimed[2][4];
+
+static uint32_t led_frame[SIM_LED_MAX];      // Last latched frame, GRB
+static uint32_t led_pending[SIM_LED_MAX];
+static uint32_t led_pending_count = 0;
+static uint64_t led_last_put_us = UINT64_MAX;
+static uint32_t led_frames = 0;
+
+bool pio_sm_is_claimed(PIO pio, uint sm) {
+    return sm_claimed[pio->index][sm & 3];
+}
+
+void pio_sm_claim(PIO pio, uint sm) {
+    sm_claimed[pio->index][sm & 3] = true;
+}
+
+void pio_sm_unclaim(PIO pio, uint sm) {
+    sm_claimed[pio->index][sm & 3] = false;
+}
+
+uint pio_add_program(PIO pio, const pio_program_t* program) {
+    (void)pio;
+    (void)program;
+    return 0;
+}
+
+static void led_latch(void) {
+    if (led_pending_count) {
+        memcpy(led_frame, led_pending, sizeof(led_frame));
+        led_frames++;
+        led_pending_count = 0;
+    }
+}
+
+void pio_sm_put_blocking(PIO pio, uint sm, uint32_t data) {
+    (void)pio;
+    (void)sm;
+
+    // WS2812 latches once the line idles, i.e. when time moved between words
+    if (now_us != led_last_put_us) {
+        led_latch();
+    }
+    led_last_put_us = now_us;
+
+    if (led_pending_count < SIM_LED_MAX) {
+        led_pending[led_pending_count++] = data >> 8;
+    }
+}
+
+uint32_t sim_led_get(uint32_t index) {
+    if (now_us != led_last_put_us) led_latch();
+    if (index >= SIM_LED_MAX) return 0;
+
+    uint32_t grb = led_frame[index];
+    return ((grb & 0x00FF00) << 8) | ((grb & 0xFF0000) >> 8) | (grb & 0x0000FF);
+}
+
+uint32_t sim_led_frame_count(void) {
+    if (now_us != led_last_put_us) led_latch();
+    return led_frames;
+}
+
+//--------------------------------------------------------------------+
+// UART AND BOOTROM
+//--------------------------------------------------------------------+
+struct uart_inst {
+    int index;
+};
+
+static struct uart_inst uart0_inst = { 0 };
+uart_inst_t* const sim_uart0 = &uart0_inst;
+static bool uart_quiet = false;
+
+void sim_uart_set_quiet(bool quiet) {
+    uart_quiet = quiet;
+}
+
+bool uart_is_writable(uart_inst_t* uart) {
+    (void)uart;
+    return true;
+}
+
+void uart_putc_raw(uart_inst_t* uart, char c) {
+    (void)uart;
+    if (!uart_quiet) putchar(c);
+}
+
+void reset_usb_boot(uint32_t gpio_activity_pin_mask, uint32_t disable_interface_mask) {
+    (void)gpio_activity_pin_mask;
+    (void)disable_interface_mask;
+    fprintf(stderr, "SIM: Firmware rebooted to BOOTSEL\n");
+    exit(0);
+}
@@ -0,0 +1,483 @@
+#include "sim.h"
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+
+// Scenario runner for the host simulation.
+//
+// A scenario is a text file with one command per line ('#' starts a comment):
+//   wait <ms>                      run the firmware for <ms> of virtual time
+//   press <input> / release <input>
+//                                  inputs: green red yellow blue orange strum_up
+//                                  strum_down start select guide tilt up down left
+//                                  right, or gp<N> for a raw pin
+//   adc <whammy|joy_x|joy_y|N> <raw 0-4095>
+//   cdc open / cdc close           assert / drop DTR on the config port
+//   cdc send <text>                send <text> plus a newline
+//   cdc write <text>               send <text> alone (build up over-long lines)
+//   msc save <file> <bytes> <seed> save <file> over the USB drive, content made
+//                                  from <seed>; one sector per frame, NOT READY
+//                                  is retried
+//   expect report <field> <value>  field: buttons lt rt lx ly rx ry
+//   expect hid <field> <value>     last HID gamepad report; field: x y z rz rx ry
+//                                  hat buttons
+//   expect reports <min>           at least <min> reports since boot
+//   expect cdc <text>              CDC output contains <text> (consumed up to it)
+//   expect led <index> <RRGGBB>    last LED frame
+//   expect mounted <ms>            device enumerated within <ms> of boot
+//   expect rate <hz>               at least <hz> reports per second since the
+//                                  previous 'expect rate' (or the latest
+//                                  enumeration, if the device re-enumerated)
+//   expect product <id>            mounted with this idProduct (which USB mode)
+//   expect msc idle                every queued drive write done, none failed
+//                                  and none erased flash in the write callback
+//   expect msc retried             the drive refused a write (NOT READY) at least
+//                                  once and the host retried it
+//   expect saved <file>            CDC output holds the START_/END_ dump of the
+//                                  last 'msc save' of <file> (READFILE first)
+//   repeat <n> ... end             run the enclosed lines <n> times (nestable)
+//   print <text>
+// Commands before the first 'wait' are applied before the firmware boots,
+// so boot combos can be held.
+
+// Firmware entry point (main.cpp is built with main renamed)
+int firmware_main(void);
+
+#define MAX_LINES       4096
+#define MAX_DEPTH       16
+#define DEFAULT_LOOP_US 50
+
+typedef struct {
+    char* text;
+    int number;
+} script_line_t;
+
+static script_line_t lines[MAX_LINES];
+static int line_count = 0;
+static int pc = 0;
+
+static struct {
+    int start;
+    int remaining;
+} loops[MAX_DEPTH];
+static int depth = 0;
+
+static uint64_t wait_until_us = 0;
+static uint32_t loop_us = DEFAULT_LOOP_US;
+static bool booted = false;
+static uint32_t passed = 0;
+static uint32_t failed = 0;
+static uint64_t iterations = 0;
+static clock_t wall_start;
+static clock_t wall_mounted;
+static bool seen_mounted = false;
+static uint64_t seen_mount_us = 0;
+static uint64_t rate_mark_us = 0;
+static uint32_t rate_mark_reports = 0;
+
+//--------------------------------------------------------------------+
+// INPUTS
+//--------------------------------------------------------------------+
+typedef struct {
+    const char* name;
+    uint8_t (*pin)(void);
+    uint8_t default_pin;    // Before the firmware has loaded its config
+} input_name_t;
+
+static uint8_t guide_pin(void) { return 6; }
+static uint8_t tilt_pin(void) { return 9; }
+
+static const input_name_t inputs[] = {
+    { "green",      config_get_green_pin,       10 },
+    { "red",        config_get_red_pin,         11 },
+    { "yellow",     config_get_yellow_pin,      12 },
+    { "blue",       config_get_blue_pin,        13 },
+    { "orange",     config_get_orange_pin,      14 },
+    { "strum_up",   config_get_strum_up_pin,    7 },
+    { "strum_down", config_get_strum_down_pin,  8 },
+    { "start",      config_get_start_pin,       1 },
+    { "select",     config_get_select_pin,      0 },
+    { "guide",      guide_pin,                  6 },
+    { "tilt",       tilt_pin,                   9 },
+    { "up",         config_get_dpad_up_pin,     2 },
+    { "down",       config_get_dpad_down_pin,   3 },
+    { "left",       config_get_dpad_left_pin,   4 },
+    { "right",      config_get_dpad_right_pin,  5 },
+};
+
+static int resolve_pin(const char* name) {
+    if ((name[0] == 'g' || name[0] == 'G') && (name[1] == 'p' || name[1] == 'P') && isdigit((unsigned char)name[2])) {
+        return atoi(name + 2);
+    }
+    bool config_loaded = config_get_current()->GREEN_FRET != NULL;
+    for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++) {
+        if (strcmp(name, inputs[i].name) == 0) {
+            return config_loaded ? inputs[i].pin() : inputs[i].default_pin;
+        }
+    }
+    return -1;
+}
+
+static int resolve_adc(const char* name) {
+    if (strcmp(name, "whammy") == 0) return 1;
+    if (strcmp(name, "joy_x") == 0) return 2;
+    if (strcmp(name, "joy_y") == 0) return 3;
+    return isdigit((unsigned char)name[0]) ? atoi(name) : -1;
+}
+
+//--------------------------------------------------------------------+
+// EXPECTATIONS
+//--------------------------------------------------------------------+
+static void check(bool ok, const script_line_t* line, const char* detail) {
+    if (ok) {
+        passed++;
+    } else {
+        failed++;
+        fprintf(stderr, "SIM: FAIL line %d: %s (%s) at %lu ms\n", line->number, line->text, detail,
+                (unsigned long)(sim_now_us() / 1000));
+    }
+}
+
+static int32_t report_field(const char* field, bool* known) {
+    const uint8_t* report = sim_usb_last_report() + 2;  // Skip the message header
+    *known = true;
+    if (strcmp(field, "buttons") == 0) return report[0] | (report[1] << 8);
+    if (strcmp(field, "lt") == 0) return report[2];
+    if (strcmp(field, "rt") == 0) return report[3];
+    if (strcmp(field, "lx") == 0) return (int16_t)(report[4] | (report[5] << 8));
+    if (strcmp(field, "ly") == 0) return (int16_t)(report[6] | (report[7] << 8));
+    if (strcmp(field, "rx") == 0) return (int16_t)(report[8] | (report[9] << 8));
+    if (strcmp(field, "ry") == 0) return (int16_t)(report[10] | (report[11] << 8));
+    *known = false;
+    return 0;
+}
+
+// TinyUSB gamepad report: int8 x y z rz rx ry, hat, 32 buttons
+static int32_t hid_field(const char* field, bool* known) {
+    uint16_t length;
+    const uint8_t* report = sim_usb_last_hid_report(&length);
+    *known = length >= 11;
+    if (!*known) return 0;
+    if (strcmp(field, "x") == 0) return (int8_t)report[0];
+    if (strcmp(field, "y") == 0) return (int8_t)report[1];
+    if (strcmp(field, "z") == 0) return (int8_t)report[2];
+    if (strcmp(field, "rz") == 0) return (int8_t)report[3];
+    if (strcmp(field, "rx") == 0) return (int8_t)report[4];
+    if (strcmp(field, "ry") == 0) return (int8_t)report[5];
+    if (strcmp(field, "hat") == 0) return report[6];
+    if (strcmp(field, "buttons") == 0) {
+        return (int32_t)(report[7] | (report[8] << 8) | (report[9] << 16) | ((uint32_t)report[10] << 24));
+    }
+    *known = false;
+    return 0;
+}
+
+static void run_expect(const script_line_t* line, char* args) {
+    char detail[96];
+    char* what = strtok(args, " \t");
+    char* rest = strtok(NULL, "");
+    if (!what || !rest) {
+        check(false, line, "malformed expect");
+        return;
+    }
+    while (*rest == ' ' || *rest == '\t') rest++;
+
+    if (strcmp(what, "report") == 0 || strcmp(what, "hid") == 0) {
+        char field[16];
+        long expected;
+        bool known;
+        if (sscanf(rest, "%15s %li", field, &expected) != 2) {
+            check(false, line, "malformed expect");
+            return;
+        }
+        int32_t actual = (what[0] == 'r') ? report_field(field, &known) : hid_field(field, &known);
+        snprintf(detail, sizeof(detail), "got %ld / 0x%04lx", (long)actual, (unsigned long)(uint16_t)actual);
+        check(known && sim_usb_report_count() > 0 && actual == expected, line, detail);
+    } else if (strcmp(what, "reports") == 0) {
+        snprintf(detail, sizeof(detail), "got %lu", (unsigned long)sim_usb_report_count());
+        check(sim_usb_report_count() >= strtoul(rest, NULL, 0), line, detail);
+    } else if (strcmp(what, "cdc") == 0) {
+        uint32_t length;
+        const char* output = sim_usb_cdc_output(&length);
+        const char* found = strstr(output, rest);
+        check(found != NULL, line, "not in CDC output");
+        if (found) sim_usb_cdc_consume((uint32_t)(found - output) + strlen(rest));
+    } else if (strcmp(what, "led") == 0) {
+        unsigned index;
+        unsigned long expected;
+        if (sscanf(rest, "%u %lx", &index, &expected) != 2) {
+            check(false, line, "malformed expect");
+            return;
+        }
+        snprintf(detail, sizeof(detail), "got %06lx", (unsigned long)sim_led_get(index));
+        check(sim_led_frame_count() > 0 && sim_led_get(index) == expected, line, detail);
+    } else if (strcmp(what, "mounted") == 0) {
+        uint64_t limit_us = strtoull(rest, NULL, 0) * 1000;
+        snprintf(detail, sizeof(detail), sim_usb_mounted() ? "mounted at %lu ms" : "not mounted",
+                 (unsigned long)(sim_usb_mount_time_us() / 1000));
+        check(sim_usb_mounted() && sim_usb_mount_time_us() <= limit_us, line, detail);
+    } else if (strcmp(what, "product") == 0) {
+        snprintf(detail, sizeof(detail), "got %04x", sim_usb_product_id());
+        check(sim_usb_mounted() && sim_usb_product_id() == strtoul(rest, NULL, 0), line, detail);
+    } else if (strcmp(what, "rate") == 0) {
+        double seconds = (sim_now_us() - rate_mark_us) / 1e6;
+        double rate = seconds > 0 ? (sim_usb_report_count() - rate_mark_reports) / seconds : 0.0;
+        snprintf(detail, sizeof(detail), "got %.1f reports/s", rate);
+        check(sim_usb_mounted() && rate >= strtod(rest, NULL), line, detail);
+        rate_mark_us = sim_now_us();
+        rate_mark_reports = sim_usb_report_count();
+    } else if (strcmp(what, "msc") == 0 && strcmp(rest, "idle") == 0) {
+        snprintf(detail, sizeof(detail), "%lu pending, %lu errors, %lu retries",
+                 (unsigned long)sim_msc_pending(), (unsigned long)sim_msc_errors(),
+                 (unsigned long)sim_msc_retries());
+        check(sim_msc_pending() == 0 && sim_msc_errors() == 0, line, detail);
+    } else if (strcmp(what, "msc") == 0 && strcmp(rest, "retried") == 0) {
+        snprintf(detail, sizeof(detail), "%lu retries", (unsigned long)sim_msc_retries());
+        check(sim_msc_retries() > 0, line, detail);
+    } else if (strcmp(what, "saved") == 0) {
+        static char dump[16384];
+        uint32_t size;
+        const uint8_t* content = sim_msc_saved(rest, &size);
+        if (!content || size + 2 * strlen(rest) + 16 > sizeof(dump)) {
+            check(false, line, "not saved");
+            return;
+        }
+        int length = snprintf(dump, sizeof(dump), "START_%s\n", rest);
+        memcpy(dump + length, content, size);
+        snprintf(dump + length + size, sizeof(dump) - length - size, "\nEND_%s\n", rest);
+
+        uint32_t output_length;
+        const char* output = sim_usb_cdc_output(&output_length);
+        const char* found = strstr(output, dump);
+        check(found != NULL, line, "saved content not in CDC output");
+        if (found) sim_usb_cdc_consume((uint32_t)(found - output) + strlen(dump));
+    } else {
+        check(false, line, "unknown expectation");
+    }
+}
+
+//--------------------------------------------------------------------+
+// SCRIPT
+//--------------------------------------------------------------------+
+static bool load_script(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "SIM: Cannot open scenario %s\n", path);
+        return false;
+    }
+
+    char buffer[512];
+    int number = 0;
+    while (fgets(buffer, sizeof(buffer), file)) {
+        number++;
+        char* text = buffer;
+        while (isspace((unsigned char)*text)) text++;
+        char* end = text + strlen(text);
+        while (end > text && isspace((unsigned char)end[-1])) *--end = '\0';
+        if (*text == '\0' || *text == '#') continue;
+
+        if (line_count >= MAX_LINES) {
+            fprintf(stderr, "SIM: %s: too many lines\n", path);
+            break;
+        }
+        lines[line_count].text = strdup(text);
+        lines[line_count].number = number;
+        line_count++;
+    }
+    fclose(file);
+    return true;
+}
+
+// Find the 'end' matching the 'repeat' at index
+static int find_end(int index) {
+    int nesting = 0;
+    for (int i = index + 1; i < line_count; i++) {
+        if (strncmp(lines[i].text, "repeat", 6) == 0) nesting++;
+        if (strcmp(lines[i].text, "end") == 0 && nesting-- == 0) return i;
+    }
+    return line_count;
+}
+
+static void finish(void) {
+    double wall = (double)(clock() - wall_start) / CLOCKS_PER_SEC;
+    double simulated = sim_now_us() / 1e6;
+    fprintf(stderr, "SIM: %.3f s simulated in %.3f s (%.0fx), %llu loops, %lu reports, %lu LED frames\n",
+            simulated, wall, wall > 0 ? simulated / wall : 0.0, (unsigned long long)iterations,
+            (unsigned long)sim_usb_report_count(), (unsigned long)sim_led_frame_count());
+    if (seen_mounted && sim_usb_report_count()) {
+        // Both cover the latest enumeration only, so the rate is that of the current USB mode.
+        // Host time per report covers the whole main loop, not just report building
+        uint32_t reports = sim_usb_report_count() - sim_usb_mount_report_count();
+        double since_mount = (sim_now_us() - sim_usb_mount_time_us()) / 1e6;
+        double host_us = (double)(clock() - wall_mounted) * 1e6 / CLOCKS_PER_SEC;
+        fprintf(stderr, "SIM: USB %.1f reports/s since enumeration, %.2f us host time per report\n",
+                since_mount > 0 ? reports / since_mount : 0.0,
+                reports ? host_us / reports : 0.0);
+        fprintf(stderr, "SIM: Cold boot to first report %.3f ms\n", sim_usb_first_report_us() / 1000.0);
+    }
+    fprintf(stderr, "SIM: %lu passed, %lu failed\n", (unsigned long)passed, (unsigned long)failed);
+    fflush(stdout);
+    exit(failed ? 1 : 0);
+}
+
+// Run commands until the script waits (true) or ends (false)
+static bool run_script(void) {
+    while (pc < line_count) {
+        script_line_t* line = &lines[pc++];
+        char buffer[512];
+        strncpy(buffer, line->text, sizeof(buffer) - 1);
+        buffer[sizeof(buffer) - 1] = '\0';
+
+        char* command = strtok(buffer, " \t");
+        char* args = strtok(NULL, "");
+        if (args) {
+            while (*args == ' ' || *args == '\t') args++;
+        }
+
+        if (strcmp(command, "wait") == 0 && args) {
+            if (!booted) {
+                pc--;  // Boot first; the wait counts from the first main loop
+                return true;
+            }
+            wait_until_us = sim_now_us() + strtoull(args, NULL, 0) * 1000;
+            return true;
+        } else if ((strcmp(command, "press") == 0 || strcmp(command, "release") == 0) && args) {
+            int pin = resolve_pin(args);
+            if (pin < 0 || pin >= SIM_GPIO_COUNT) {
+                check(false, line, "unknown input");
+            } else {
+                sim_gpio_drive(pin, command[0] == 'r');  // Active low
+            }
+        } else if (strcmp(command, "adc") == 0 && args) {
+            char name[16];
+            unsigned value;
+            int channel = -1;
+            if (sscanf(args, "%15s %u", name, &value) == 2) channel = resolve_adc(name);
+            if (channel < 0 || channel >= SIM_ADC_CHANNELS) {
+                check(false, line, "unknown ADC input");
+            } else {
+                sim_adc_set(channel, (uint16_t)value);
+            }
+        } else if (strcmp(command, "cdc") == 0 && args) {
+            if (strcmp(args, "open") == 0) {
+                sim_usb_cdc_open(true);
+            } else if (strcmp(args, "close") == 0) {
+                sim_usb_cdc_open(false);
+            } else if (strncmp(args, "send ", 5) == 0) {
+                sim_usb_cdc_send(args + 5, strlen(args + 5));
+                sim_usb_cdc_send("\n", 1);
+            } else if (strncmp(args, "write ", 6) == 0) {
+                sim_usb_cdc_send(args + 6, strlen(args + 6));
+            } else {
+                check(false, line, "unknown cdc command");
+            }
+        } else if (strcmp(command, "msc") == 0 && args) {
+            char name[32];
+            unsigned long size, seed;
+            if (sscanf(args, "save %31s %lu %lu", name, &size, &seed) != 3) {
+                check(false, line, "unknown msc command");
+            } else if (!sim_msc_save(name, (uint32_t)size, (uint32_t)seed)) {
+                check(false, line, "drive save not started");
+            }
+        } else if (strcmp(command, "expect") == 0 && args) {
+            run_expect(line, args);
+        } else if (strcmp(command, "repeat") == 0 && args) {
+            int count = atoi(args);
+            if (count <= 0) {
+                pc = find_end(pc - 1) + 1;
+            } else if (depth < MAX_DEPTH) {
+                loops[depth].start = pc;
+                loops[depth].remaining = count;
+                depth++;
+            }
+        } else if (strcmp(command, "end") == 0) {
+            if (depth > 0 && --loops[depth - 1].remaining > 0) {
+                pc = loops[depth - 1].start;
+            } else if (depth > 0) {
+                depth--;
+            }
+        } else if (strcmp(command, "print") == 0) {
+            fprintf(stderr, "SIM: %s\n", args ? args : "");
+        } else {
+            check(false, line, "unknown command");
+        }
+    }
+    return false;
+}
+
+void sim_loop_hook(void) {
+    iterations++;
+    sim_advance_us(loop_us);
+    // Every enumeration (a mode switch re-enumerates) starts a new rate window
+    if (sim_usb_mounted() && (!seen_mounted || sim_usb_mount_time_us() != seen_mount_us)) {
+        seen_mounted = true;
+        seen_mount_us = sim_usb_mount_time_us();
+        wall_mounted = clock();
+        rate_mark_us = seen_mount_us;
+        rate_mark_reports = sim_usb_mount_report_count();
+    }
+
+    if (sim_now_us() < wait_until_us) {
+        return;
+    }
+    if (!run_script()) {
+        finish();
+    }
+}
+
+//--------------------------------------------------------------------+
+// MAIN
+//--------------------------------------------------------------------+
+static void usage(void) {
+    fprintf(stderr,
+            "usage: bgg_sim [-f flash.bin] [-l loop_us] [-q] [-c] scenario\n"
+            "  -f  flash image file, created erased if missing (default: memory only)\n"
+            "  -l  virtual time per main loop iteration (default %d us)\n"
+            "  -q  hide the firmware console\n"
+            "  -c  echo CDC output\n", DEFAULT_LOOP_US);
+}
+
+int main(int argc, char** argv) {
+    const char* flash_path = NULL;
+    const char* script_path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            flash_path = argv[++i];
+        } else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+            loop_us = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-q") == 0) {
+            sim_uart_set_quiet(true);
+            if (!freopen("/dev/null", "w", stdout)) return 2;
+        } else if (strcmp(argv[i], "-c") == 0) {
+            sim_usb_cdc_set_echo(true);
+        } else if (argv[i][0] != '-' && !script_path) {
+            script_path = argv[i];
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (!script_path) {
+        usage();
+        return 2;
+    }
+
+    if (!sim_flash_open(flash_path) || !load_script(script_path)) {
+        return 2;
+    }
+
+    // Setup commands run before boot, up to the first wait
+    wall_start = clock();
+    if (!run_script()) {
+        finish();
+    }
+    booted = true;
+
+    firmware_main();
+    finish();
+    return 0;
+}
@@ -0,0 +1,304 @@
+#include "sim.h"
+#include "tusb.h"
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+// Simulated USB drive host. 'msc save' writes a file the way a desktop OS
+// does: it reads the boot sector, FAT and root directory through READ10,
+// puts the new content in free clusters, then writes the data sectors, the
+// FAT (new chain linked, old chain freed) and finally the directory entry.
+// One sector goes out per 1 ms frame. A write failed with NOT READY is
+// retried a few frames later, as hosts do; any other failure is an error
+// and drops the rest of the save. A flash erase inside the write callback
+// also counts as an error (erases belong in the main loop).
+
+#define SIM_MSC_SECTOR          512
+#define SIM_MSC_QUEUE           64
+#define SIM_MSC_RETRY_US        5000
+#define SIM_MSC_MAX_FILE        8192
+#define SIM_MSC_MAX_FAT         4       // Sectors
+#define SIM_MSC_MAX_ROOT        4       // Sectors
+#define SIM_MSC_SAVED_FILES     4
+#define SIM_MSC_EOC             0xFFF
+
+// Only builds with a drive (CFG_TUD_MSC) define the class callbacks
+#pragma weak tud_msc_read10_cb
+#pragma weak tud_msc_write10_cb
+
+typedef struct {
+    uint32_t lba;
+    uint8_t data[SIM_MSC_SECTOR];
+} sim_msc_write_t;
+
+static sim_msc_write_t queue[SIM_MSC_QUEUE];
+static uint32_t queue_head = 0;
+static uint32_t queue_count = 0;
+static uint64_t next_write_us = 0;
+static uint32_t retries = 0;
+static uint32_t errors = 0;
+static uint8_t sense_key = SCSI_SENSE_NONE;
+
+// Content of the last save per file name, for 'expect saved'
+static struct {
+    char name[32];
+    uint32_t size;
+    uint8_t content[SIM_MSC_MAX_FILE];
+} saved[SIM_MSC_SAVED_FILES];
+
+//--------------------------------------------------------------------+
+// VOLUME ACCESS
+//--------------------------------------------------------------------+
+static struct {
+    uint32_t fat_lba;
+    uint32_t fat_sectors;
+    uint32_t root_lba;
+    uint32_t root_sectors;
+    uint32_t data_lba;
+    uint32_t clusters;
+} volume;
+
+// The host's view: what the drive holds, with writes still queued on top
+static bool read_sectors(uint32_t lba, uint32_t count, uint8_t* out) {
+    for (uint32_t i = 0; i < count; i++) {
+        uint8_t* sector = out + i * SIM_MSC_SECTOR;
+        if (tud_msc_read10_cb(0, lba + i, 0, sector, SIM_MSC_SECTOR) != SIM_MSC_SECTOR) {
+            return false;
+        }
+        for (uint32_t q = 0; q < queue_count; q++) {
+            const sim_msc_write_t* write = &queue[(queue_head + q) % SIM_MSC_QUEUE];
+            if (write->lba == lba + i) memcpy(sector, write->data, SIM_MSC_SECTOR);
+        }
+    }
+    return true;
+}
+
+static bool read_volume(void) {
+    uint8_t boot[SIM_MSC_SECTOR];
+    if (!read_sectors(0, 1, boot)) return false;
+
+    uint32_t bytes_per_sector = boot[11] | (boot[12] << 8);
+    uint32_t reserved = boot[14] | (boot[15] << 8);
+    uint32_t fats = boot[16];
+    uint32_t root_entries = boot[17] | (boot[18] << 8);
+    uint32_t total = boot[19] | (boot[20] << 8);
+    uint32_t fat_sectors = boot[22] | (boot[23] << 8);
+    if (bytes_per_sector != SIM_MSC_SECTOR || boot[13] != 1 || fats == 0) return false;
+
+    volume.fat_lba = reserved;
+    volume.fat_sectors = fat_sectors;
+    volume.root_lba = reserved + fats * fat_sectors;
+    volume.root_sectors = root_entries * 32 / SIM_MSC_SECTOR;
+    volume.data_lba = volume.root_lba + volume.root_sectors;
+    volume.clusters = total - volume.data_lba;
+    return fat_sectors <= SIM_MSC_MAX_FAT && volume.root_sectors <= SIM_MSC_MAX_ROOT;
+}
+
+static uint32_t fat12_get(const uint8_t* fat, uint32_t cluster) {
+    uint32_t pos = cluster + cluster / 2;
+    uint32_t pair = fat[pos] | (fat[pos + 1] << 8);
+    return (cluster & 1) ? (pair >> 4) : (pair & 0xFFF);
+}
+
+static void fat12_set(uint8_t* fat, uint32_t cluster, uint32_t value) {
+    uint32_t pos = cluster + cluster / 2;
+    if (cluster & 1) {
+        fat[pos] = (uint8_t)((fat[pos] & 0x0F) | (value << 4));
+        fat[pos + 1] = (uint8_t)(value >> 4);
+    } else {
+        fat[pos] = (uint8_t)value;
+        fat[pos + 1] = (uint8_t)((fat[pos + 1] & 0xF0) | ((value >> 8) & 0x0F));
+    }
+}
+
+// Short directory entry of a file, matched on its long name or its 8.3 name
+static uint8_t* find_entry(uint8_t* dir, uint32_t entries, const char* name) {
+    static const uint8_t lfn_offsets[13] = { 1, 3, 5, 7, 9, 14, 16, 18, 20, 22, 24, 28, 30 };
+    char lfn[256];
+    bool lfn_valid = false;
+
+    for (uint32_t i = 0; i < entries; i++) {
+        uint8_t* entry = dir + i * 32;
+        if (entry[0] == 0x00) break;
+        if (entry[0] == 0xE5) {
+            lfn_valid = false;
+            continue;
+        }
+
+        if (entry[11] == 0x0F) {
+            uint32_t sequence = entry[0] & 0x1F;
+            if (entry[0] & 0x40) {
+                memset(lfn, 0, sizeof(lfn));
+                lfn_valid = true;
+            }
+            for (uint32_t c = 0; lfn_valid && sequence > 0 && c < 13; c++) {
+                uint32_t pos = (sequence - 1) * 13 + c;
+                uint8_t ch = entry[lfn_offsets[c]];
+                if (ch == 0x00 || ch == 0xFF || pos >= sizeof(lfn) - 1) break;
+                lfn[pos] = (char)ch;
+            }
+            continue;
+        }
+
+        char short_name[13];
+        uint32_t n = 0;
+        for (uint32_t c = 0; c < 8 && entry[c] != ' '; c++) short_name[n++] = (char)tolower(entry[c]);
+        if (entry[8] != ' ') {
+            short_name[n++] = '.';
+            for (uint32_t c = 8; c < 11 && entry[c] != ' '; c++) short_name[n++] = (char)tolower(entry[c]);
+        }
+        short_name[n] = '\0';
+
+        if ((lfn_valid && strcmp(lfn, name) == 0) || strcmp(short_name, name) == 0) {
+            return entry;
+        }
+        lfn_valid = false;
+    }
+    return NULL;
+}
+
+static void queue_write(uint32_t lba, const uint8_t* data) {
+    sim_msc_write_t* write = &queue[(queue_head + queue_count) % SIM_MSC_QUEUE];
+    write->lba = lba;
+    memcpy(write->data, data, SIM_MSC_SECTOR);
+    queue_count++;
+}
+
+//--------------------------------------------------------------------+
+// PUBLIC API
+//--------------------------------------------------------------------+
+bool sim_msc_save(const char* name, uint32_t size, uint32_t seed) {
+    static uint8_t fat[SIM_MSC_MAX_FAT * SIM_MSC_SECTOR];
+    static uint8_t dir[SIM_MSC_MAX_ROOT * SIM_MSC_SECTOR];
+
+    if (!tud_msc_read10_cb || !tud_msc_write10_cb || size > SIM_MSC_MAX_FILE || !read_volume()) {
+        return false;
+    }
+    uint32_t sectors = (size + SIM_MSC_SECTOR - 1) / SIM_MSC_SECTOR;
+    if (queue_count + sectors + volume.fat_sectors + 1 > SIM_MSC_QUEUE ||
+        !read_sectors(volume.fat_lba, volume.fat_sectors, fat) ||
+        !read_sectors(volume.root_lba, volume.root_sectors, dir)) {
+        return false;
+    }
+    uint8_t* entry = find_entry(dir, volume.root_sectors * SIM_MSC_SECTOR / 32, name);
+    if (!entry) {
+        return false;
+    }
+
+    // Remember the content for 'expect saved'
+    uint32_t slot = 0;
+    while (slot < SIM_MSC_SAVED_FILES - 1 && saved[slot].name[0] && strcmp(saved[slot].name, name) != 0) slot++;
+    snprintf(saved[slot].name, sizeof(saved[slot].name), "%s", name);
+    saved[slot].size = size;
+    for (uint32_t i = 0; i < size; i++) {
+        saved[slot].content[i] = (i % 64 == 63) ? '\n' : (uint8_t)('a' + (seed + i / 64) % 26);
+    }
+
+    // New chain in free clusters, written before anything points to it
+    uint32_t first = 0;
+    uint32_t previous = 0;
+    uint32_t cluster = 2;
+    for (uint32_t i = 0; i < sectors; i++) {
+        while (cluster < volume.clusters + 2 && fat12_get(fat, cluster) != 0) cluster++;
+        if (cluster >= volume.clusters + 2) {
+            return false;   // Volume full
+        }
+        fat12_set(fat, cluster, SIM_MSC_EOC);
+        if (previous) {
+            fat12_set(fat, previous, cluster);
+        } else {
+            first = cluster;
+        }
+        previous = cluster;
+
+        uint8_t data[SIM_MSC_SECTOR];
+        uint32_t length = size - i * SIM_MSC_SECTOR;
+        if (length > SIM_MSC_SECTOR) length = SIM_MSC_SECTOR;
+        memset(data, 0, sizeof(data));
+        memcpy(data, saved[slot].content + i * SIM_MSC_SECTOR, length);
+        queue_write(volume.data_lba + cluster - 2, data);
+    }
+
+    // Free the old chain, then point the entry at the new one
+    uint32_t old = entry[26] | (entry[27] << 8);
+    for (uint32_t steps = 0; old >= 2 && old < volume.clusters + 2 && steps < volume.clusters; steps++) {
+        uint32_t next = fat12_get(fat, old);
+        fat12_set(fat, old, 0);
+        old = next;
+    }
+    for (uint32_t i = 0; i < volume.fat_sectors; i++) {
+        queue_write(volume.fat_lba + i, fat + i * SIM_MSC_SECTOR);
+    }
+
+    entry[26] = (uint8_t)first;
+    entry[27] = (uint8_t)(first >> 8);
+    entry[28] = (uint8_t)size;
+    entry[29] = (uint8_t)(size >> 8);
+    entry[30] = (uint8_t)(size >> 16);
+    entry[31] = (uint8_t)(size >> 24);
+    uint32_t dir_sector = (uint32_t)(entry - dir) / SIM_MSC_SECTOR;
+    queue_write(volume.root_lba + dir_sector, dir + dir_sector * SIM_MSC_SECTOR);
+    return true;
+}
+
+void sim_msc_service(void) {
+    if (queue_count == 0 || sim_now_us() < next_write_us) return;
+
+    sim_msc_write_t* write = &queue[queue_head];
+    uint32_t erases = sim_flash_erase_count();
+    sense_key = SCSI_SENSE_NONE;
+    int32_t result = tud_msc_write10_cb(0, write->lba, 0, write->data, SIM_MSC_SECTOR);
+
+    if (sim_flash_erase_count() != erases) {
+        fprintf(stderr, "SIM: MSC write of LBA %lu erased flash in the callback\n", (unsigned long)write->lba);
+        errors++;
+    }
+    if (result == SIM_MSC_SECTOR) {
+        queue_head = (queue_head + 1) % SIM_MSC_QUEUE;
+        queue_count--;
+        next_write_us = sim_now_us() + 1000;
+    } else if (result < 0 && sense_key == SCSI_SENSE_NOT_READY) {
+        retries++;
+        next_write_us = sim_now_us() + SIM_MSC_RETRY_US;
+    } else {
+        fprintf(stderr, "SIM: MSC write of LBA %lu failed (sense %u), save dropped\n",
+                (unsigned long)write->lba, sense_key);
+        errors++;
+        queue_count = 0;
+    }
+}
+
+bool sim_msc_event_ready(void) {
+    return queue_count && sim_now_us() >= next_write_us;
+}
+
+uint32_t sim_msc_pending(void) {
+    return queue_count;
+}
+
+uint32_t sim_msc_errors(void) {
+    return errors;
+}
+
+uint32_t sim_msc_retries(void) {
+    return retries;
+}
+
+const uint8_t* sim_msc_saved(const char* name, uint32_t* size) {
+    for (uint32_t i = 0; i < SIM_MSC_SAVED_FILES; i++) {
+        if (saved[i].name[0] && strcmp(saved[i].name, name) == 0) {
+            *size = saved[i].size;
+            return saved[i].content;
+        }
+    }
+    return NULL;
+}
+
+// MSC class
+bool tud_msc_set_sense(uint8_t lun, uint8_t key, uint8_t add_sense_code, uint8_t add_sense_qualifier) {
+    (void)lun;
+    (void)add_sense_code;
+    (void)add_sense_qualifier;
+    sense_key = key;
+    return true;
+}
@@ -0,0 +1,788 @@
+#include "sim.h"
+#include "tusb.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+// Simulated USB host. It enumerates the device a little after tusb_init()
+// (once the firmware calls tud_task()), polls interrupt IN endpoints at their
+// bInterval on 1 ms frames, drains CDC output as fast as the firmware
+// produces it and feeds CDC input from the scenario.
+//
+// Enumeration checks the descriptors the way a strict host would: every
+// descriptor must fit inside wTotalLength, interface and endpoint counts must
+// match, endpoint addresses must be unique. Interfaces are then offered to
+// the application class drivers (usbd_app_driver_get_cb) like TinyUSB's usbd
+// does at SET_CONFIGURATION, and each driver must claim exactly its own
+// descriptors. Any error leaves the device unmounted. A HID interface's
+// report descriptor is read at wDescriptorLength and parsed; every input
+// report must then be exactly the size it declares.
+//
+// tud_disconnect() / tud_connect() unplug and replug: the host enumerates
+// again, with whatever descriptors the device returns then.
+
+#define SIM_USB_ENUM_US         20000   // Host reset and enumeration time
+#define SIM_USB_FRAME_US        1000
+#define SIM_VENDOR_PACKET       32      // wMaxPacketSize of the XInput IN endpoint
+#define SIM_CDC_HOST_QUEUE      8192
+#define SIM_USB_MAX_PACKET      64      // Full speed interrupt and bulk limit
+#define SIM_USB_ENDPOINTS       32      // 16 addresses, both directions
+
+static bool initialized = false;
+static bool connected = false;
+static bool mounted = false;
+static uint64_t init_time_us = 0;
+static uint64_t mount_time_us = 0;
+static uint32_t descriptor_errors = 0;
+
+// Endpoints opened by application class drivers
+typedef struct {
+    bool open;
+    bool busy;
+    bool claimed;
+    uint8_t interval;
+    uint16_t max_packet;
+    uint16_t length;
+    uint8_t data[SIM_USB_MAX_PACKET];
+    uint64_t complete_us;
+    const usbd_class_driver_t* driver;
+} sim_endpoint_t;
+
+static sim_endpoint_t endpoints[SIM_USB_ENDPOINTS];
+static const usbd_class_driver_t* opening_driver = NULL;
+static uint8_t vendor_interval = 1;     // bInterval of the built-in vendor class IN endpoint
+
+// Built-in TinyUSB classes enabled in the firmware build (CFG_TUD_*)
+static struct {
+    bool vendor;
+    bool cdc;
+    bool msc;
+    bool hid;
+} builtin;
+
+// HID IN: one report in flight, completed on the host's next poll
+static uint8_t hid_in_address = 0;
+static uint8_t hid_interval = 1;
+static uint16_t hid_max_packet = 0;
+static uint16_t hid_report_bytes = 0;   // Input report size from the report descriptor
+static bool hid_report_id = false;      // Report descriptor declares report IDs
+static uint8_t hid_packet[SIM_USB_MAX_PACKET];
+static uint16_t hid_packet_length = 0;
+static bool hid_in_flight = false;
+static uint64_t hid_complete_us = 0;
+static uint8_t last_hid_report[SIM_USB_MAX_PACKET];
+static uint16_t last_hid_length = 0;
+
+// Vendor IN: FIFO filled by tud_vendor_write, one packet in flight per frame
+static uint8_t vendor_fifo[CFG_TUD_VENDOR_TX_BUFSIZE];
+static uint32_t vendor_fifo_count = 0;
+static uint8_t vendor_packet[SIM_VENDOR_PACKET];
+static uint32_t vendor_packet_length = 0;
+static bool vendor_in_flight = false;
+static uint64_t vendor_complete_us = 0;
+static uint8_t last_report[SIM_REPORT_SIZE];
+static uint32_t report_count = 0;
+static uint32_t mount_report_count = 0;
+static uint64_t first_report_us = 0;
+
+// CDC
+static bool cdc_dtr = false;
+static bool cdc_echo = false;
+static uint8_t cdc_rx_fifo[CFG_TUD_CDC_RX_BUFSIZE];
+static uint32_t cdc_rx_count = 0;
+static uint8_t host_queue[SIM_CDC_HOST_QUEUE];   // Scenario input not yet in the device FIFO
+static uint32_t host_queue_count = 0;
+static uint8_t cdc_tx_fifo[CFG_TUD_CDC_TX_BUFSIZE];
+static uint32_t cdc_tx_count = 0;
+static char cdc_capture[SIM_CDC_CAPTURE_SIZE];
+static uint32_t cdc_capture_length = 0;
+
+static inline sim_endpoint_t* endpoint_get(uint8_t ep_addr) {
+    return &endpoints[(ep_addr & 0x0F) | (tu_edpt_dir(ep_addr) == TUSB_DIR_IN ? 0x10 : 0)];
+}
+
+// Next frame boundary on which the host polls an endpoint with this bInterval
+static uint64_t next_poll_us(uint8_t interval) {
+    uint64_t frame = sim_now_us() / SIM_USB_FRAME_US;
+    if (interval == 0) interval = 1;
+    return (frame / interval + 1) * interval * SIM_USB_FRAME_US;
+}
+
+static void capture_report(const uint8_t* data, uint32_t length) {
+    if (length >= 20 && data[0] == 0x00 && data[1] == 0x14) {
+        memset(last_report, 0, sizeof(last_report));
+        memcpy(last_report, data, length < SIM_REPORT_SIZE ? length : SIM_REPORT_SIZE);
+        if (report_count++ == 0) first_report_us = sim_now_us();
+    }
+}
+
+static void capture_hid_report(const uint8_t* data, uint16_t length) {
+    memcpy(last_hid_report, data, length);
+    last_hid_length = length;
+    if (report_count++ == 0) first_report_us = sim_now_us();
+}
+
+//--------------------------------------------------------------------+
+// ENUMERATION
+//--------------------------------------------------------------------+
+static void descriptor_error(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    fprintf(stderr, "SIM: USB descriptor error: ");
+    vfprintf(stderr, format, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+    descriptor_errors++;
+}
+
+// Offset of the next interface (or association) descriptor after pos
+static uint16_t next_interface(const uint8_t* config, uint16_t pos, uint16_t total) {
+    pos += config[pos];
+    while (pos < total && config[pos] >= 2 &&
+           tu_desc_type(&config[pos]) != TUSB_DESC_INTERFACE &&
+           tu_desc_type(&config[pos]) != TUSB_DESC_INTERFACE_ASSOCIATION) {
+        pos += config[pos];
+    }
+    return pos;
+}
+
+static void check_interface_endpoints(const tusb_desc_interface_t* itf, uint8_t found) {
+    if (itf && found != itf->bNumEndpoints) {
+        descriptor_error("interface %u declares %u endpoints, %u follow",
+                         itf->bInterfaceNumber, itf->bNumEndpoints, found);
+    }
+}
+
+// Structural checks of the whole configuration descriptor
+static void check_configuration(const uint8_t* config) {
+    const tusb_desc_configuration_t* desc = (const tusb_desc_configuration_t*)config;
+    if (desc->bLength != sizeof(tusb_desc_configuration_t) || desc->bDescriptorType != TUSB_DESC_CONFIGURATION) {
+        descriptor_error("bad configuration descriptor header");
+        return;
+    }
+
+    uint16_t total = desc->wTotalLength;
+    uint32_t interfaces = 0;
+    uint32_t endpoint_addresses = 0;
+    const tusb_desc_interface_t* itf = NULL;
+    uint8_t itf_endpoints = 0;
+
+    for (uint16_t pos = 0; pos < total; pos += config[pos]) {
+        uint8_t length = config[pos];
+        uint8_t type = tu_desc_type(&config[pos]);
+        if (length < 2) {
+            descriptor_error("zero length descriptor at offset %u", pos);
+            return;
+        }
+        if (pos + length > total) {
+            descriptor_error("descriptor at offset %u (type 0x%02x, %u bytes) runs past wTotalLength %u",
+                             pos, type, length, total);
+            return;
+        }
+
+        if (type == TUSB_DESC_INTERFACE) {
+            check_interface_endpoints(itf, itf_endpoints);
+            itf = (const tusb_desc_interface_t*)&config[pos];
+            itf_endpoints = 0;
+            if (length != sizeof(tusb_desc_interface_t)) {
+                descriptor_error("interface descriptor at offset %u is %u bytes", pos, length);
+            }
+            if (itf->bAlternateSetting == 0) {
+                if (interfaces & (1u << itf->bInterfaceNumber)) {
+                    descriptor_error("interface %u defined twice", itf->bInterfaceNumber);
+                }
+                interfaces |= 1u << itf->bInterfaceNumber;
+            }
+        } else if (type == TUSB_DESC_ENDPOINT) {
+            const tusb_desc_endpoint_t* ep = (const tusb_desc_endpoint_t*)&config[pos];
+            uint32_t bit = 1u << ((ep->bEndpointAddress & 0x0F) | (tu_edpt_dir(ep->bEndpointAddress) ? 0x10 : 0));
+            itf_endpoints++;
+            if (length != sizeof(tusb_desc_endpoint_t)) {
+                descriptor_error("endpoint descriptor at offset %u is %u bytes", pos, length);
+            }
+            if (endpoint_addresses & bit) {
+                descriptor_error("endpoint 0x%02x used twice", ep->bEndpointAddress);
+            }
+            endpoint_addresses |= bit;
+            if (ep->wMaxPacketSize > SIM_USB_MAX_PACKET) {
+                descriptor_error("endpoint 0x%02x wMaxPacketSize %u exceeds full speed limit",
+                                 ep->bEndpointAddress, ep->wMaxPacketSize);
+            }
+            if (ep->bmAttributes.xfer == TUSB_XFER_INTERRUPT && ep->bInterval == 0) {
+                descriptor_error("interrupt endpoint 0x%02x has bInterval 0", ep->bEndpointAddress);
+            }
+        }
+    }
+    check_interface_endpoints(itf, itf_endpoints);
+
+    uint32_t interface_count = __builtin_popcount(interfaces);
+    if (interface_count != desc->bNumInterfaces) {
+        descriptor_error("bNumInterfaces is %u, %u interfaces present", desc->bNumInterfaces, interface_count);
+    }
+}
+
+// Input report size declared by a HID report descriptor of exactly length
+// bytes (short items only); 0 if it does not parse
+static uint16_t parse_hid_report_descriptor(const uint8_t* desc, uint16_t length, bool* report_id) {
+    static const uint8_t item_sizes[4] = { 0, 1, 2, 4 };
+    uint32_t report_size = 0, report_count = 0, input_bits = 0;
+    int depth = 0;
+    uint16_t pos = 0;
+
+    *report_id = false;
+    while (pos < length) {
+        uint8_t prefix = desc[pos];
+        uint8_t size = item_sizes[prefix & 0x03];
+        if (prefix == 0xFE || pos + 1 + size > length) {
+            descriptor_error("HID report descriptor item at offset %u runs past wDescriptorLength %u", pos, length);
+            return 0;
+        }
+        uint32_t data = 0;
+        for (uint8_t i = 0; i < size; i++) data |= (uint32_t)desc[pos + 1 + i] << (8 * i);
+
+        switch (prefix & 0xFC) {
+            case 0x74: report_size = data; break;                       // Report Size
+            case 0x94: report_count = data; break;                      // Report Count
+            case 0x84: *report_id = true; break;                        // Report ID
+            case 0x80: input_bits += report_size * report_count; break; // Input
+            case 0xA0: depth++; break;                                  // Collection
+            case 0xC0:                                                  // End Collection
+                if (--depth < 0) {
+                    descriptor_error("HID report descriptor closes a collection it never opened");
+                    return 0;
+                }
+                break;
+        }
+        pos += 1 + size;
+    }
+    if (depth != 0) {
+        descriptor_error("HID report descriptor ends with %d collections open at wDescriptorLength %u", depth, length);
+        return 0;
+    }
+    return (uint16_t)((input_bits + 7) / 8);
+}
+
+// HID descriptor, report descriptor and IN endpoint of a HID interface
+static void open_hid_interface(const tusb_desc_interface_t* itf, uint16_t span) {
+    const uint8_t* end = (const uint8_t*)itf + span;
+    uint16_t report_length = 0;
+    bool hid_descriptor = false;
+
+    for (const uint8_t* p = tu_desc_next(itf); p < end; p = tu_desc_next(p)) {
+        if (tu_desc_type(p) == HID_DESC_TYPE_HID && tu_desc_len(p) >= 9 && p[6] == HID_DESC_TYPE_REPORT) {
+            hid_descriptor = true;
+            report_length = (uint16_t)(p[7] | (p[8] << 8));
+        } else if (tu_desc_type(p) == TUSB_DESC_ENDPOINT) {
+            const tusb_desc_endpoint_t* ep = (const tusb_desc_endpoint_t*)p;
+            if (tu_edpt_dir(ep->bEndpointAddress) == TUSB_DIR_IN) {
+                hid_in_address = ep->bEndpointAddress;
+                hid_interval = ep->bInterval;
+                hid_max_packet = ep->wMaxPacketSize;
+            }
+        }
+    }
+
+    if (!hid_descriptor) {
+        descriptor_error("HID interface %u has no HID descriptor", itf->bInterfaceNumber);
+        return;
+    }
+    if (hid_in_address == 0) {
+        descriptor_error("HID interface %u has no IN endpoint", itf->bInterfaceNumber);
+        return;
+    }
+    const uint8_t* report_desc = tud_hid_descriptor_report_cb ? tud_hid_descriptor_report_cb(0) : NULL;
+    if (!report_desc) {
+        descriptor_error("HID interface %u has no report descriptor", itf->bInterfaceNumber);
+        return;
+    }
+    hid_report_bytes = parse_hid_report_descriptor(report_desc, report_length, &hid_report_id);
+    if (hid_report_bytes + hid_report_id > hid_max_packet) {
+        descriptor_error("HID input report of %u bytes exceeds wMaxPacketSize %u", hid_report_bytes, hid_max_packet);
+    }
+}
+
+// SET_CONFIGURATION: offer each interface to the class drivers
+static void open_interfaces(const uint8_t* config) {
+    uint16_t total = ((const tusb_desc_configuration_t*)config)->wTotalLength;
+    uint8_t driver_count = 0;
+    const usbd_class_driver_t* drivers = usbd_app_driver_get_cb ? usbd_app_driver_get_cb(&driver_count) : NULL;
+
+    uint16_t pos = sizeof(tusb_desc_configuration_t);
+    while (pos < total) {
+        const tusb_desc_interface_t* itf = (const tusb_desc_interface_t*)&config[pos];
+        if (itf->bDescriptorType == TUSB_DESC_INTERFACE_ASSOCIATION) {
+            pos += itf->bLength;
+            continue;
+        }
+        if (itf->bDescriptorType != TUSB_DESC_INTERFACE) {
+            descriptor_error("descriptor type 0x%02x at offset %u is outside any interface", itf->bDescriptorType, pos);
+            pos += itf->bLength;
+            continue;
+        }
+
+        uint16_t span = next_interface(config, pos, total) - pos;
+        uint16_t claimed = 0;
+        for (uint8_t i = 0; i < driver_count && !claimed; i++) {
+            opening_driver = &drivers[i];
+            claimed = drivers[i].open(0, itf, total - pos);
+            opening_driver = NULL;
+        }
+
+        if (!claimed) {
+            // Built-in classes take the interface and its class/endpoint descriptors
+            bool supported = (itf->bInterfaceClass == TUSB_CLASS_VENDOR_SPECIFIC && builtin.vendor) ||
+                             ((itf->bInterfaceClass == TUSB_CLASS_CDC || itf->bInterfaceClass == TUSB_CLASS_CDC_DATA) && builtin.cdc) ||
+                             (itf->bInterfaceClass == TUSB_CLASS_MSC && builtin.msc) ||
+                             (itf->bInterfaceClass == TUSB_CLASS_HID && builtin.hid);
+            if (!supported) {
+                descriptor_error("no driver claimed interface %u (class 0x%02x)",
+                                 itf->bInterfaceNumber, itf->bInterfaceClass);
+            }
+            claimed = span;
+            if (itf->bInterfaceClass == TUSB_CLASS_VENDOR_SPECIFIC) {
+                const uint8_t* p = tu_desc_next(itf);
+                for (; p < (const uint8_t*)itf + span; p = tu_desc_next(p)) {
+                    const tusb_desc_endpoint_t* ep = (const tusb_desc_endpoint_t*)p;
+                    if (tu_desc_type(p) == TUSB_DESC_ENDPOINT && tu_edpt_dir(ep->bEndpointAddress) == TUSB_DIR_IN) {
+                        vendor_interval = ep->bInterval;
+                    }
+                }
+            } else if (itf->bInterfaceClass == TUSB_CLASS_HID && builtin.hid) {
+                open_hid_interface(itf, span);
+            }
+        } else if (claimed != span) {
+            // Drivers must claim up to the next interface, no more and no less
+            descriptor_error("driver for interface %u claimed %u bytes, its descriptors are %u bytes",
+                             itf->bInterfaceNumber, claimed, span);
+            if (claimed > total - pos) return;
+        }
+        pos += claimed;
+    }
+}
+
+static void enumerate(void) {
+    const tusb_desc_device_t* device = (const tusb_desc_device_t*)tud_descriptor_device_cb();
+    const uint8_t* config = tud_descriptor_configuration_cb(0);
+    if (!device || !config || device->bDescriptorType != TUSB_DESC_DEVICE) {
+        fprintf(stderr, "SIM: USB enumeration failed: no device descriptor\n");
+        initialized = false;
+        return;
+    }
+    if (device->bLength != sizeof(tusb_desc_device_t)) {
+        descriptor_error("device descriptor is %u bytes", device->bLength);
+    }
+
+    check_configuration(config);
+    if (descriptor_errors == 0) {
+        open_interfaces(config);
+    }
+
+    uint16_t total = ((const tusb_desc_configuration_t*)config)->wTotalLength;
+    if (descriptor_errors) {
+        fprintf(stderr, "SIM: USB enumeration failed: %lu descriptor errors\n", (unsigned long)descriptor_errors);
+        initialized = false;
+        return;
+    }
+    fprintf(stderr, "SIM: USB enumerated %04x:%04x, %u interfaces, wTotalLength %u at %lu ms\n",
+            device->idVendor, device->idProduct, config[4], total,
+            (unsigned long)(sim_now_us() / 1000));
+
+    mounted = true;
+    mount_time_us = sim_now_us();
+    mount_report_count = report_count;
+    if (tud_mount_cb) tud_mount_cb();
+}
+
+//--------------------------------------------------------------------+
+// HOST SIDE
+//--------------------------------------------------------------------+
+static void capture_cdc(const uint8_t* data, uint32_t length) {
+    if (cdc_echo) {
+        fwrite(data, 1, length, stderr);
+    }
+    if (length > SIM_CDC_CAPTURE_SIZE - 1 - cdc_capture_length) {
+        // Keep the newer half; expectations look at recent output
+        uint32_t keep = SIM_CDC_CAPTURE_SIZE / 2;
+        if (keep > cdc_capture_length) keep = cdc_capture_length;
+        memmove(cdc_capture, cdc_capture + cdc_capture_length - keep, keep);
+        cdc_capture_length = keep;
+        if (length > SIM_CDC_CAPTURE_SIZE - 1 - cdc_capture_length) {
+            length = SIM_CDC_CAPTURE_SIZE - 1 - cdc_capture_length;
+        }
+    }
+    memcpy(cdc_capture + cdc_capture_length, data, length);
+    cdc_capture_length += length;
+    cdc_capture[cdc_capture_length] = '\0';
+}
+
+void sim_usb_service(void) {
+    if (!initialized || !connected) return;
+
+    if (!mounted) {
+        if (sim_now_us() - init_time_us >= SIM_USB_ENUM_US) enumerate();
+        return;
+    }
+
+    // Interrupt IN transfers complete on the host's next poll of the endpoint
+    if (vendor_in_flight && sim_now_us() >= vendor_complete_us) {
+        vendor_in_flight = false;
+        capture_report(vendor_packet, vendor_packet_length);
+        if (tud_vendor_tx_cb) tud_vendor_tx_cb(0, vendor_packet_length);
+        if (vendor_fifo_count) tud_vendor_write_flush();
+    }
+    if (hid_in_flight && sim_now_us() >= hid_complete_us) {
+        hid_in_flight = false;
+        capture_hid_report(hid_packet, hid_packet_length);
+        if (tud_hid_report_complete_cb) tud_hid_report_complete_cb(0, hid_packet, hid_packet_length);
+    }
+    if (builtin.msc) sim_msc_service();
+    for (uint8_t i = 0x10; i < SIM_USB_ENDPOINTS; i++) {
+        sim_endpoint_t* ep = &endpoints[i];
+        if (ep->busy && sim_now_us() >= ep->complete_us) {
+            ep->busy = false;
+            capture_report(ep->data, ep->length);
+            if (ep->driver && ep->driver->xfer_cb) {
+                ep->driver->xfer_cb(0, (uint8_t)(i & 0x0F) | TUSB_DIR_IN_MASK, XFER_RESULT_SUCCESS, ep->length);
+            }
+        }
+    }
+
+    // Host reads everything the device has flushed
+    if (cdc_tx_count) {
+        capture_cdc(cdc_tx_fifo, cdc_tx_count);
+        cdc_tx_count = 0;
+    }
+
+    // Host writes as much as the device FIFO takes
+    if (host_queue_count && cdc_dtr) {
+        uint32_t room = sizeof(cdc_rx_fifo) - cdc_rx_count;
+        uint32_t chunk = host_queue_count < room ? host_queue_count : room;
+        if (chunk) {
+            memcpy(cdc_rx_fifo + cdc_rx_count, host_queue, chunk);
+            cdc_rx_count += chunk;
+            memmove(host_queue, host_queue + chunk, host_queue_count - chunk);
+            host_queue_count -= chunk;
+            if (tud_cdc_rx_cb) tud_cdc_rx_cb(0);
+        }
+    }
+}
+
+void sim_usb_cdc_open(bool dtr) {
+    cdc_dtr = dtr;
+    if (tud_cdc_line_state_cb) tud_cdc_line_state_cb(0, dtr, dtr);
+}
+
+void sim_usb_cdc_send(const char* data, uint32_t length) {
+    if (length > SIM_CDC_HOST_QUEUE - host_queue_count) {
+        fprintf(stderr, "SIM: CDC host queue full, %lu bytes dropped\n", (unsigned long)length);
+        return;
+    }
+    memcpy(host_queue + host_queue_count, data, length);
+    host_queue_count += length;
+}
+
+const char* sim_usb_cdc_output(uint32_t* length) {
+    *length = cdc_capture_length;
+    return cdc_capture;
+}
+
+void sim_usb_cdc_consume(uint32_t length) {
+    if (length > cdc_capture_length) length = cdc_capture_length;
+    memmove(cdc_capture, cdc_capture + length, cdc_capture_length - length);
+    cdc_capture_length -= length;
+    cdc_capture[cdc_capture_length] = '\0';
+}
+
+void sim_usb_cdc_set_echo(bool echo) {
+    cdc_echo = echo;
+}
+
+bool sim_usb_mounted(void) {
+    return mounted;
+}
+
+uint64_t sim_usb_mount_time_us(void) {
+    return mount_time_us;
+}
+
+uint32_t sim_usb_descriptor_errors(void) {
+    return descriptor_errors;
+}
+
+uint64_t sim_usb_first_report_us(void) {
+    return first_report_us;
+}
+
+uint32_t sim_usb_report_count(void) {
+    return report_count;
+}
+
+uint32_t sim_usb_mount_report_count(void) {
+    return mount_report_count;
+}
+
+const uint8_t* sim_usb_last_report(void) {
+    return last_report;
+}
+
+const uint8_t* sim_usb_last_hid_report(uint16_t* length) {
+    *length = last_hid_length;
+    return last_hid_report;
+}
+
+uint16_t sim_usb_product_id(void) {
+    const tusb_desc_device_t* device = mounted ? (const tusb_desc_device_t*)tud_descriptor_device_cb() : NULL;
+    return device ? device->idProduct : 0;
+}
+
+//--------------------------------------------------------------------+
+// DEVICE API
+//--------------------------------------------------------------------+
+bool sim_tusb_init(bool vendor, bool cdc, bool msc, bool hid) {
+    builtin.vendor = vendor;
+    builtin.cdc = cdc;
+    builtin.msc = msc;
+    builtin.hid = hid;
+    initialized = true;
+    connected = true;
+    init_time_us = sim_now_us();
+
+    uint8_t driver_count = 0;
+    const usbd_class_driver_t* drivers = usbd_app_driver_get_cb ? usbd_app_driver_get_cb(&driver_count) : NULL;
+    for (uint8_t i = 0; i < driver_count; i++) {
+        if (drivers[i].init) drivers[i].init();
+    }
+    return true;
+}
+
+void tud_task(void) {
+    sim_loop_hook();
+    sim_usb_service();
+}
+
+// What would be queued by a USB interrupt on the device
+bool tud_task_event_ready(void) {
+    if (!initialized || !connected) return false;
+    if (!mounted) return sim_now_us() - init_time_us >= SIM_USB_ENUM_US;
+
+    if (vendor_in_flight && sim_now_us() >= vendor_complete_us) return true;
+    if (hid_in_flight && sim_now_us() >= hid_complete_us) return true;
+    if (builtin.msc && sim_msc_event_ready()) return true;
+    for (uint8_t i = 0x10; i < SIM_USB_ENDPOINTS; i++) {
+        if (endpoints[i].busy && sim_now_us() >= endpoints[i].complete_us) return true;
+    }
+    return cdc_tx_count != 0 ||
+           (host_queue_count && cdc_dtr && cdc_rx_count < sizeof(cdc_rx_fifo));
+}
+
+bool tud_mounted(void) {
+    return mounted;
+}
+
+bool tud_ready(void) {
+    return mounted;
+}
+
+bool tud_suspended(void) {
+    return false;
+}
+
+bool tud_remote_wakeup(void) {
+    return false;
+}
+
+bool tud_disconnect(void) {
+    if (!initialized || !connected) return false;
+
+    // Everything in flight is lost with the bus, the host closes the CDC
+    // port and class drivers see a bus reset
+    connected = false;
+    cdc_dtr = false;
+    cdc_rx_count = 0;
+    host_queue_count = 0;
+    cdc_tx_count = 0;
+    vendor_in_flight = false;
+    vendor_fifo_count = 0;
+    hid_in_flight = false;
+    hid_in_address = 0;
+    memset(endpoints, 0, sizeof(endpoints));
+    uint8_t driver_count = 0;
+    const usbd_class_driver_t* drivers = usbd_app_driver_get_cb ? usbd_app_driver_get_cb(&driver_count) : NULL;
+    for (uint8_t i = 0; i < driver_count; i++) {
+        if (drivers[i].reset) drivers[i].reset(0);
+    }
+
+    if (mounted) {
+        mounted = false;
+        fprintf(stderr, "SIM: USB disconnected at %lu ms\n", (unsigned long)(sim_now_us() / 1000));
+        if (tud_umount_cb) tud_umount_cb();
+    }
+    return true;
+}
+
+bool tud_connect(void) {
+    if (!initialized || connected) return false;
+    connected = true;
+    init_time_us = sim_now_us();
+    return true;
+}
+
+bool tud_control_xfer(uint8_t rhport, tusb_control_request_t const* request, void* buffer, uint16_t len) {
+    (void)rhport;
+    (void)request;
+    (void)buffer;
+    (void)len;
+    return true;
+}
+
+bool tud_control_status(uint8_t rhport, tusb_control_request_t const* request) {
+    (void)rhport;
+    (void)request;
+    return true;
+}
+
+// Vendor class
+bool tud_vendor_mounted(void) {
+    return mounted;
+}
+
+uint32_t tud_vendor_available(void) {
+    return 0;
+}
+
+uint32_t tud_vendor_read(void* buffer, uint32_t bufsize) {
+    (void)buffer;
+    (void)bufsize;
+    return 0;
+}
+
+uint32_t tud_vendor_write(void const* buffer, uint32_t bufsize) {
+    uint32_t room = sizeof(vendor_fifo) - vendor_fifo_count;
+    if (bufsize > room) bufsize = room;
+    memcpy(vendor_fifo + vendor_fifo_count, buffer, bufsize);
+    vendor_fifo_count += bufsize;
+    return bufsize;
+}
+
+uint32_t tud_vendor_write_flush(void) {
+    if (!mounted || vendor_in_flight || vendor_fifo_count == 0) return 0;
+
+    vendor_packet_length = vendor_fifo_count < SIM_VENDOR_PACKET ? vendor_fifo_count : SIM_VENDOR_PACKET;
+    memcpy(vendor_packet, vendor_fifo, vendor_packet_length);
+    memmove(vendor_fifo, vendor_fifo + vendor_packet_length, vendor_fifo_count - vendor_packet_length);
+    vendor_fifo_count -= vendor_packet_length;
+
+    vendor_in_flight = true;
+    vendor_complete_us = next_poll_us(vendor_interval);
+    return vendor_packet_length;
+}
+
+uint32_t tud_vendor_write_available(void) {
+    return sizeof(vendor_fifo) - vendor_fifo_count;
+}
+
+// HID class
+bool tud_hid_ready(void) {
+    return mounted && hid_in_address != 0 && !hid_in_flight;
+}
+
+bool tud_hid_report(uint8_t report_id, void const* report, uint16_t len) {
+    if (!tud_hid_ready()) return false;
+
+    // The host parses reports by the report descriptor; a mismatch is a firmware bug
+    if (len != hid_report_bytes || (report_id != 0) != hid_report_id) {
+        fprintf(stderr, "SIM: HID report of %u bytes (report ID %u), report descriptor declares %u bytes%s\n",
+                len, report_id, hid_report_bytes, hid_report_id ? " with report IDs" : "");
+        return false;
+    }
+
+    hid_packet_length = 0;
+    if (report_id) hid_packet[hid_packet_length++] = report_id;
+    memcpy(hid_packet + hid_packet_length, report, len);
+    hid_packet_length += len;
+    hid_in_flight = true;
+    hid_complete_us = next_poll_us(hid_interval);
+    return true;
+}
+
+// Endpoints of application class drivers
+bool usbd_edpt_open(uint8_t rhport, tusb_desc_endpoint_t const* desc_ep) {
+    (void)rhport;
+    sim_endpoint_t* ep = endpoint_get(desc_ep->bEndpointAddress);
+    if (ep->open || desc_ep->wMaxPacketSize > SIM_USB_MAX_PACKET) return false;
+
+    memset(ep, 0, sizeof(*ep));
+    ep->open = true;
+    ep->interval = desc_ep->bInterval;
+    ep->max_packet = desc_ep->wMaxPacketSize;
+    ep->driver = opening_driver;
+    return true;
+}
+
+bool usbd_edpt_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t* buffer, uint16_t total_bytes) {
+    (void)rhport;
+    sim_endpoint_t* ep = endpoint_get(ep_addr);
+    if (!mounted || !ep->open || ep->busy || total_bytes > ep->max_packet) return false;
+
+    ep->busy = true;
+    if (tu_edpt_dir(ep_addr) == TUSB_DIR_IN) {
+        // The controller copies the packet into its buffer when the transfer starts
+        memcpy(ep->data, buffer, total_bytes);
+        ep->length = total_bytes;
+        ep->complete_us = next_poll_us(ep->interval);
+    }
+    return true;  // OUT transfers stay pending: the host never sends output reports
+}
+
+bool usbd_edpt_busy(uint8_t rhport, uint8_t ep_addr) {
+    (void)rhport;
+    return endpoint_get(ep_addr)->busy;
+}
+
+bool usbd_edpt_claim(uint8_t rhport, uint8_t ep_addr) {
+    (void)rhport;
+    sim_endpoint_t* ep = endpoint_get(ep_addr);
+    if (ep->busy || ep->claimed) return false;
+    ep->claimed = true;
+    return true;
+}
+
+bool usbd_edpt_release(uint8_t rhport, uint8_t ep_addr) {
+    (void)rhport;
+    endpoint_get(ep_addr)->claimed = false;
+    return true;
+}
+
+// CDC class
+bool tud_cdc_connected(void) {
+    return mounted && cdc_dtr;
+}
+
+uint32_t tud_cdc_available(void) {
+    return cdc_rx_count;
+}
+
+uint32_t tud_cdc_read(void* buffer, uint32_t bufsize) {
+    uint32_t count = bufsize < cdc_rx_count ? bufsize : cdc_rx_count;
+    memcpy(buffer, cdc_rx_fifo, count);
+    memmove(cdc_rx_fifo, cdc_rx_fifo + count, cdc_rx_count - count);
+    cdc_rx_count -= count;
+    return count;
+}
+
+uint32_t tud_cdc_write(void const* buffer, uint32_t bufsize) {
+    if (!tud_cdc_connected()) return 0;
+    uint32_t room = sizeof(cdc_tx_fifo) - cdc_tx_count;
+    if (bufsize > room) bufsize = room;
+    memcpy(cdc_tx_fifo + cdc_tx_count, buffer, bufsize);
+    cdc_tx_count += bufsize;
+    return bufsize;
+}
+
+uint32_t tud_cdc_write_flush(void) {
+    return cdc_tx_count;
+}
+
+uint32_t tud_cdc_write_available(void) {
+    return sizeof(cdc_tx_fifo) - cdc_tx_count;
+}
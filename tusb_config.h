@@ -21,7 +21,7 @@ extern "C" {
 
 // Debug level
 #ifndef CFG_TUSB_DEBUG
-#define CFG_TUSB_DEBUG 2
+#define CFG_TUSB_DEBUG 0
 #endif
 
 // Enable Device stack
@@ -33,13 +33,49 @@ extern "C" {
 #endif
 
 //------------- CLASS CONFIGURATION -------------//
-// XInput custom driver - exact fluffymadness configuration
+// Defaults match the exact fluffymadness XInput build (custom driver, no
+// standard classes). Other firmware targets override these per target.
+#ifndef CFG_TUD_CDC
 #define CFG_TUD_CDC               0
+#endif
+#ifndef CFG_TUD_MSC
 #define CFG_TUD_MSC               0
+#endif
+#ifndef CFG_TUD_HID
 #define CFG_TUD_HID               0
+#endif
+#ifndef CFG_TUD_MIDI
 #define CFG_TUD_MIDI              0
+#endif
+#ifndef CFG_TUD_VENDOR
 #define CFG_TUD_VENDOR            0  // Using custom driver, not vendor class
-#define CFG_TUSB_DEBUG            0
+#endif
+
+// CDC FIFO sizes
+#ifndef CFG_TUD_CDC_RX_BUFSIZE
+#define CFG_TUD_CDC_RX_BUFSIZE    256
+#endif
+#ifndef CFG_TUD_CDC_TX_BUFSIZE
+#define CFG_TUD_CDC_TX_BUFSIZE    256
+#endif
+
+// Vendor FIFO sizes
+#ifndef CFG_TUD_VENDOR_RX_BUFSIZE
+#define CFG_TUD_VENDOR_RX_BUFSIZE 64
+#endif
+#ifndef CFG_TUD_VENDOR_TX_BUFSIZE
+#define CFG_TUD_VENDOR_TX_BUFSIZE 64
+#endif
+
+// HID gamepad report is 11 bytes
+#ifndef CFG_TUD_HID_EP_BUFSIZE
+#define CFG_TUD_HID_EP_BUFSIZE    16
+#endif
+
+// MSC buffer holds exactly one virtual disk sector
+#ifndef CFG_TUD_MSC_EP_BUFSIZE
+#define CFG_TUD_MSC_EP_BUFSIZE    512
+#endif
 
 // Memory alignment
 #ifndef CFG_TUSB_MEM_SECTION
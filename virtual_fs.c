@@ -0,0 +1,826 @@
+#include "virtual_fs.h"
+#include "file_emulation.h"
+#include "pico/stdlib.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+#include "tusb.h"
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+#define VFS_CHUNK_SIZE        64
+#define VFS_ATTR_READ_ONLY    0x01
+#define VFS_ATTR_VOLUME_ID    0x08
+#define VFS_ATTR_DIRECTORY    0x10
+#define VFS_ATTR_ARCHIVE      0x20
+#define VFS_ATTR_LFN          0x0F
+#define VFS_LFN_CHARS         13
+#define VFS_FAT12_EOC         0xFFF
+
+// Fixed timestamp for synthesized entries (2025-08-21 12:00)
+#define VFS_DATE              (((2025 - 1980) << 9) | (8 << 5) | 21)
+#define VFS_TIME              (12 << 11)
+
+// Boot sector / BPB, the rest of sector 0 is zero apart from the 0x55AA signature
+static const uint8_t boot_sector[62] = {
+    0xEB, 0x3C, 0x90,                               // Jump instruction
+    'M', 'S', 'D', 'O', 'S', '5', '.', '0',         // OEM name
+    VFS_SECTOR_SIZE & 0xFF, VFS_SECTOR_SIZE >> 8,   // Bytes per sector
+    0x01,                                           // Sectors per cluster
+    VFS_RESERVED_SECTORS, 0x00,                     // Reserved sectors
+    0x01,                                           // Number of FATs
+    VFS_ROOT_ENTRIES & 0xFF, VFS_ROOT_ENTRIES >> 8, // Root directory entries
+    VFS_SECTOR_COUNT & 0xFF, VFS_SECTOR_COUNT >> 8, // Total sectors
+    0xF8,                                           // Media descriptor
+    VFS_FAT_SECTORS, 0x00,                          // Sectors per FAT
+    0x01, 0x00,                                     // Sectors per track
+    0x01, 0x00,                                     // Number of heads
+    0x00, 0x00, 0x00, 0x00,                         // Hidden sectors
+    0x00, 0x00, 0x00, 0x00,                         // Total sectors (32-bit)
+    0x80,                                           // Drive number
+    0x00,                                           // Reserved
+    0x29,                                           // Extended boot signature
+    0x43, 0x47, 0x47, 0x42,                         // Volume serial number
+    'B', 'G', 'G', ' ', 'G', 'U', 'I', 'T', 'A', 'R', ' ',  // Volume label
+    'F', 'A', 'T', '1', '2', ' ', ' ', ' '          // File system type
+};
+
+static const char volume_label[11] = { 'B', 'G', 'G', ' ', 'G', 'U', 'I', 'T', 'A', 'R', ' ' };
+
+// Host write overlay: LBA -> log entry + 1 (0 = synthesized). Log positions
+// count up forever, the entry is position % VFS_LOG_ENTRIES: [log_tail,
+// log_head) hold host sectors, live or superseded by a later write of the
+// same LBA, [log_head, log_erased) are erased and free.
+static uint8_t overlay_map[VFS_SECTOR_COUNT];
+static uint8_t log_lba[VFS_LOG_ENTRIES];        // LBA held by each entry
+static uint32_t log_tail = 0;
+static uint32_t log_head = 0;
+static uint32_t log_erased = 0;
+static uint32_t log_live = 0;           // Entries the overlay map points to
+static bool log_committed = true;       // No host write since a clean commit
+static bool log_full_reported = false;
+static uint8_t log_copy[VFS_SECTOR_SIZE];
+
+// File sizes snapshot used while synthesizing FAT/directory sectors
+static uint32_t layout_size[MAX_VIRTUAL_FILES];
+static const char* layout_name[MAX_VIRTUAL_FILES];
+
+static bool mounted = false;
+static bool media_changed = false;
+static bool commit_pending = false;
+static bool commit_running = false;     // Committing file by file from vfs_task()
+static bool commit_clean = false;       // Every file of this pass committed (or unchanged)
+static uint32_t commit_cursor = 0;      // Next root directory entry to look at
+static uint32_t last_write_ms = 0;
+
+static inline uint32_t vfs_millis(void) {
+    return to_ms_since_boot(get_absolute_time());
+}
+
+//--------------------------------------------------------------------+
+// OVERLAY LOG
+//--------------------------------------------------------------------+
+static inline uint32_t log_offset(uint32_t entry) {
+    return VFS_LOG_FLASH_OFFSET + entry * VFS_SECTOR_SIZE;
+}
+
+static inline uint32_t log_entry(uint32_t position) {
+    return position % VFS_LOG_ENTRIES;
+}
+
+static const uint8_t* overlay_sector(uint32_t lba) {
+    if (lba >= VFS_SECTOR_COUNT || overlay_map[lba] == 0) {
+        return NULL;
+    }
+    return (const uint8_t*)(XIP_BASE + log_offset(overlay_map[lba] - 1u));
+}
+
+static void overlay_reset(void) {
+    memset(overlay_map, 0, sizeof(overlay_map));
+    log_tail = 0;
+    log_head = 0;
+    log_erased = 0;             // Old entries are still in flash, vfs_task erases ahead again
+    log_live = 0;
+    log_committed = true;
+    log_full_reported = false;
+}
+
+// Room for another host sector: an erased entry, and the reclaim reserve left free
+static bool log_has_room(void) {
+    return log_head < log_erased && log_head - log_tail < VFS_LOG_HOST_ENTRIES;
+}
+
+// Append a sector at the head; only programs (well under a millisecond)
+static void log_append(uint32_t lba, const uint8_t* data) {
+    uint32_t entry = log_entry(log_head++);
+
+    uint32_t interrupts = save_and_disable_interrupts();
+    flash_range_program(log_offset(entry), data, VFS_SECTOR_SIZE);
+    restore_interrupts(interrupts);
+
+    log_lba[entry] = (uint8_t)lba;
+    overlay_map[lba] = (uint8_t)(entry + 1);
+}
+
+static bool log_sector_blank(uint32_t offset) {
+    const uint32_t* words = (const uint32_t*)(XIP_BASE + offset);
+    for (uint32_t i = 0; i < FLASH_SECTOR_SIZE / sizeof(uint32_t); i++) {
+        if (words[i] != 0xFFFFFFFFu) return false;
+    }
+    return true;
+}
+
+// Erase (or confirm blank) the next flash sector of the log ahead of the host.
+// The erase holds interrupts off for tens of milliseconds, so it runs here in
+// the main loop rather than inside a host write; the sample clock counts the
+// ticks it drops under "missed". Sectors already blank are not erased again.
+static void log_erase_next(void) {
+    uint32_t offset = log_offset(log_entry(log_erased));
+    log_erased += VFS_LOG_ENTRIES_PER_SECTOR;
+    if (log_sector_blank(offset)) {
+        return;
+    }
+
+    uint32_t interrupts = save_and_disable_interrupts();
+    flash_range_erase(offset, FLASH_SECTOR_SIZE);
+    restore_interrupts(interrupts);
+}
+
+// Free the oldest flash sector of the log: superseded entries are dropped,
+// live ones copied to the head. The reserve guarantees room for them once
+// erase-ahead has caught up with the tail.
+static void log_reclaim(void) {
+    do {
+        uint32_t entry = log_entry(log_tail);
+        uint32_t lba = log_lba[entry];
+        if (overlay_map[lba] == entry + 1) {
+            if (log_head >= log_erased) {
+                return;
+            }
+            memcpy(log_copy, (const uint8_t*)(XIP_BASE + log_offset(entry)), VFS_SECTOR_SIZE);
+            log_append(lba, log_copy);
+        }
+        log_tail++;
+    } while ((log_tail % VFS_LOG_ENTRIES_PER_SECTOR) != 0 && log_tail < log_head);
+}
+
+// One step of log upkeep per vfs_task() call, at most one sector erase
+static void log_maintain(void) {
+    bool room_wanted = log_head - log_tail >= VFS_LOG_HOST_ENTRIES;
+    bool erase_wanted = log_erased < log_head + VFS_LOG_ERASE_AHEAD;
+    bool erase_possible = log_erased + VFS_LOG_ENTRIES_PER_SECTOR <= log_tail + VFS_LOG_ENTRIES;
+
+    if (erase_wanted && erase_possible) {
+        log_erase_next();
+        return;
+    }
+    if (!room_wanted && !erase_wanted) {
+        return;
+    }
+
+    // Only worth copying entries forward if some of the log is superseded
+    if (log_head - log_tail > log_live) {
+        log_reclaim();
+        return;
+    }
+
+    // Full of sectors the host still needs. Once they are all in the real
+    // files the log starts over and the host re-reads the volume; until then
+    // its writes are refused and nothing is lost.
+    if (log_committed) {
+        printf("VFS: Overlay log full, starting over\n");
+        overlay_reset();
+        media_changed = true;
+    } else if (!log_full_reported) {
+        printf("VFS: Overlay log full of uncommitted sectors, host writes refused\n");
+        log_full_reported = true;
+    }
+}
+
+//--------------------------------------------------------------------+
+// SECTOR SYNTHESIS
+//--------------------------------------------------------------------+
+static void layout_refresh(void) {
+    for (uint32_t i = 0; i < MAX_VIRTUAL_FILES; i++) {
+        layout_name[i] = file_emu_get_file_name(i);
+        layout_size[i] = 0;
+        if (layout_name[i]) {
+            file_emu_get_size(layout_name[i], &layout_size[i]);
+        }
+    }
+}
+
+static inline uint32_t file_first_cluster(uint32_t index) {
+    return 2 + index * VFS_FILE_CLUSTERS;
+}
+
+// FAT12 entry for the synthesized layout
+static uint16_t fat_entry_synth(uint32_t cluster) {
+    if (cluster == 0) return 0xFF8;
+    if (cluster == 1) return VFS_FAT12_EOC;
+
+    uint32_t index = (cluster - 2) / VFS_FILE_CLUSTERS;
+    uint32_t within = (cluster - 2) % VFS_FILE_CLUSTERS;
+    if (index >= MAX_VIRTUAL_FILES || !layout_name[index]) {
+        return 0;
+    }
+
+    uint32_t clusters = (layout_size[index] + VFS_SECTOR_SIZE - 1) / VFS_SECTOR_SIZE;
+    if (within >= clusters) return 0;
+    if (within == clusters - 1) return VFS_FAT12_EOC;
+    return (uint16_t)(cluster + 1);
+}
+
+// Next cluster in a chain as the host currently sees it
+static uint16_t fat_next(uint32_t cluster) {
+    const uint8_t* fat = overlay_sector(VFS_FAT_LBA);
+    if (!fat) {
+        return fat_entry_synth(cluster);
+    }
+
+    uint32_t pos = cluster * 3 / 2;
+    uint16_t value = fat[pos] | (fat[pos + 1] << 8);
+    return (cluster & 1) ? (value >> 4) : (value & 0x0FFF);
+}
+
+static inline void put_byte(uint8_t* out, uint32_t offset, uint32_t length, uint32_t pos, uint8_t value) {
+    if (pos >= offset && pos < offset + length) {
+        out[pos - offset] |= value;
+    }
+}
+
+static void synth_fat(uint32_t offset, uint8_t* out, uint32_t length) {
+    for (uint32_t cluster = 0; cluster < VFS_CLUSTER_COUNT + 2; cluster++) {
+        uint16_t value = fat_entry_synth(cluster);
+        uint32_t pos = cluster * 3 / 2;
+
+        if (cluster & 1) {
+            put_byte(out, offset, length, pos, (uint8_t)((value & 0x0F) << 4));
+            put_byte(out, offset, length, pos + 1, (uint8_t)(value >> 4));
+        } else {
+            put_byte(out, offset, length, pos, (uint8_t)(value & 0xFF));
+            put_byte(out, offset, length, pos + 1, (uint8_t)((value >> 8) & 0x0F));
+        }
+    }
+}
+
+static void short_name(const char* filename, uint32_t index, uint8_t sfn[11]) {
+    memset(sfn, ' ', 11);
+
+    const char* dot = strrchr(filename, '.');
+    const char* end = dot ? dot : filename + strlen(filename);
+    uint32_t n = 0;
+    for (const char* p = filename; p < end && n < 6; p++) {
+        if (isalnum((unsigned char)*p) || *p == '_' || *p == '-') {
+            sfn[n++] = (uint8_t)toupper((unsigned char)*p);
+        }
+    }
+    sfn[n++] = '~';
+    sfn[n] = (uint8_t)('1' + index);
+
+    if (dot) {
+        for (uint32_t i = 0; i < 3 && dot[1 + i]; i++) {
+            sfn[8 + i] = (uint8_t)toupper((unsigned char)dot[1 + i]);
+        }
+    }
+}
+
+static uint8_t short_name_checksum(const uint8_t sfn[11]) {
+    uint8_t sum = 0;
+    for (int i = 0; i < 11; i++) {
+        sum = (uint8_t)(((sum & 1) << 7) + (sum >> 1) + sfn[i]);
+    }
+    return sum;
+}
+
+// Character slots within an LFN entry
+static const uint8_t lfn_char_offsets[VFS_LFN_CHARS] = { 1, 3, 5, 7, 9, 14, 16, 18, 20, 22, 24, 28, 30 };
+
+static void make_lfn_entry(uint8_t entry[32], const char* filename, uint32_t sequence, bool last, uint8_t checksum) {
+    uint32_t length = strlen(filename);
+
+    memset(entry, 0, 32);
+    entry[0] = (uint8_t)(sequence | (last ? 0x40 : 0));
+    entry[11] = VFS_ATTR_LFN;
+    entry[13] = checksum;
+
+    for (uint32_t i = 0; i < VFS_LFN_CHARS; i++) {
+        uint32_t pos = (sequence - 1) * VFS_LFN_CHARS + i;
+        uint16_t c = (pos < length) ? (uint8_t)filename[pos] : (pos == length ? 0x0000 : 0xFFFF);
+        entry[lfn_char_offsets[i]] = c & 0xFF;
+        entry[lfn_char_offsets[i] + 1] = c >> 8;
+    }
+}
+
+static void synth_root_dir(uint32_t offset, uint8_t* out, uint32_t length) {
+    uint8_t entry[32];
+    uint32_t slot = 0;
+
+    // Copy the part of a generated entry that overlaps the requested range
+    #define EMIT_ENTRY() do { \
+        uint32_t start = slot * 32; \
+        for (uint32_t b = 0; b < 32; b++) put_byte(out, offset, length, start + b, entry[b]); \
+        slot++; \
+    } while (0)
+
+    memset(entry, 0, sizeof(entry));
+    memcpy(entry, volume_label, sizeof(volume_label));
+    entry[11] = VFS_ATTR_VOLUME_ID;
+    EMIT_ENTRY();
+
+    for (uint32_t i = 0; i < MAX_VIRTUAL_FILES; i++) {
+        const char* name = layout_name[i];
+        if (!name) continue;
+
+        uint8_t sfn[11];
+        short_name(name, i, sfn);
+        uint8_t checksum = short_name_checksum(sfn);
+
+        uint32_t lfn_count = (strlen(name) + VFS_LFN_CHARS - 1) / VFS_LFN_CHARS;
+        if (slot + lfn_count + 1 > VFS_ROOT_ENTRIES) break;
+
+        for (uint32_t seq = lfn_count; seq >= 1; seq--) {
+            make_lfn_entry(entry, name, seq, seq == lfn_count, checksum);
+            EMIT_ENTRY();
+        }
+
+        vfs_dir_entry_t* dir = (vfs_dir_entry_t*)entry;
+        memset(entry, 0, sizeof(entry));
+        memcpy(entry, sfn, sizeof(sfn));
+        dir->attr = VFS_ATTR_ARCHIVE;
+        dir->create_time = VFS_TIME;
+        dir->create_date = VFS_DATE;
+        dir->access_date = VFS_DATE;
+        dir->modify_time = VFS_TIME;
+        dir->modify_date = VFS_DATE;
+        dir->cluster_low = layout_size[i] ? (uint16_t)file_first_cluster(i) : 0;
+        dir->size = layout_size[i];
+        EMIT_ENTRY();
+    }
+
+    #undef EMIT_ENTRY
+}
+
+static void synth_data(uint32_t cluster, uint32_t offset, uint8_t* out, uint32_t length) {
+    uint32_t index = (cluster - 2) / VFS_FILE_CLUSTERS;
+    uint32_t within = (cluster - 2) % VFS_FILE_CLUSTERS;
+
+    if (index >= MAX_VIRTUAL_FILES) {
+        return;  // Free space reads as zeros
+    }
+
+    const char* name = file_emu_get_file_name(index);
+    if (name) {
+        file_emu_read_at(name, within * VFS_SECTOR_SIZE + offset, out, length);
+    }
+}
+
+// Read part of a sector as the host sees it
+static void vfs_read(uint32_t lba, uint32_t offset, uint8_t* out, uint32_t length) {
+    const uint8_t* overlay = overlay_sector(lba);
+    if (overlay) {
+        memcpy(out, overlay + offset, length);
+        return;
+    }
+
+    memset(out, 0, length);
+
+    if (lba == 0) {
+        for (uint32_t pos = 0; pos < sizeof(boot_sector); pos++) {
+            put_byte(out, offset, length, pos, boot_sector[pos]);
+        }
+        put_byte(out, offset, length, 510, 0x55);
+        put_byte(out, offset, length, 511, 0xAA);
+    } else if (lba == VFS_FAT_LBA) {
+        layout_refresh();
+        synth_fat(offset, out, length);
+    } else if (lba == VFS_ROOT_DIR_LBA) {
+        layout_refresh();
+        synth_root_dir(offset, out, length);
+    } else if (lba >= VFS_DATA_LBA) {
+        synth_data(lba - VFS_DATA_LBA + 2, offset, out, length);
+    }
+}
+
+//--------------------------------------------------------------------+
+// COMMITTING HOST WRITES
+//--------------------------------------------------------------------+
+// Walk a cluster chain, feeding the file content to a sink. Returns false on a broken chain.
+typedef void (*chain_sink_t)(const uint8_t* data, uint32_t length, void* context);
+
+static bool walk_chain(uint32_t cluster, uint32_t size, chain_sink_t sink, void* context) {
+    uint8_t chunk[VFS_CHUNK_SIZE];
+    uint32_t remaining = size;
+    uint32_t steps = 0;
+
+    while (remaining > 0) {
+        if (cluster < 2 || cluster >= VFS_CLUSTER_COUNT + 2 || ++steps > VFS_CLUSTER_COUNT) {
+            return false;
+        }
+
+        uint32_t lba = VFS_DATA_LBA + cluster - 2;
+        for (uint32_t offset = 0; offset < VFS_SECTOR_SIZE && remaining > 0; offset += VFS_CHUNK_SIZE) {
+            uint32_t length = (remaining < VFS_CHUNK_SIZE) ? remaining : VFS_CHUNK_SIZE;
+            vfs_read(lba, offset, chunk, length);
+            sink(chunk, length, context);
+            remaining -= length;
+        }
+
+        cluster = fat_next(cluster);
+    }
+
+    return true;
+}
+
+static void crc_sink(const uint8_t* data, uint32_t length, void* context) {
+    uint32_t* crc = (uint32_t*)context;
+    *crc = config_storage_crc32_update(*crc, data, length);
+}
+
+static void write_sink(const uint8_t* data, uint32_t length, void* context) {
+    (void)context;
+    file_emu_write_append(data, length);
+}
+
+static uint32_t file_crc(const char* filename, uint32_t size) {
+    uint8_t chunk[VFS_CHUNK_SIZE];
+    uint32_t crc = 0;
+
+    for (uint32_t offset = 0; offset < size; offset += VFS_CHUNK_SIZE) {
+        uint32_t length = file_emu_read_at(filename, offset, chunk, sizeof(chunk));
+        if (length == 0) break;
+        crc = config_storage_crc32_update(crc, chunk, length);
+    }
+    return crc;
+}
+
+// Returns false if the file is not (yet) in its flash slot as the host wrote it
+static bool commit_file(const char* filename, uint32_t cluster, uint32_t size) {
+    if (size > MAX_FILE_CONTENT) {
+        printf("VFS: %s too large (%lu bytes), ignored\n", filename, (unsigned long)size);
+        return true;
+    }
+
+    uint32_t host_crc = 0;
+    if (!walk_chain(cluster, size, crc_sink, &host_crc)) {
+        return false;  // Chain not complete yet
+    }
+
+    uint32_t current_size = 0;
+    file_emu_get_size(filename, &current_size);
+    if (current_size == size && file_crc(filename, current_size) == host_crc) {
+        return true;  // Unchanged
+    }
+
+    // Stream the whole chain into the inactive flash slot; the header commit is atomic
+    printf("VFS: Committing %s (%lu bytes)\n", filename, (unsigned long)size);
+    if (!file_emu_write_begin(filename)) {
+        return false;
+    }
+    walk_chain(cluster, size, write_sink, NULL);
+    if (!file_emu_write_commit()) {
+        printf("VFS: Commit of %s failed\n", filename);
+        return false;
+    }
+    return true;
+}
+
+// Scan the host's root directory for known files whose content changed,
+// from directory entry *cursor on. Stops after max_files known files and
+// returns false if entries remain (*cursor is where to carry on).
+static bool vfs_commit_changes(uint32_t* cursor, uint32_t max_files) {
+    const uint8_t* dir = overlay_sector(VFS_ROOT_DIR_LBA);
+    if (!dir) {
+        return true;  // Host never touched the directory
+    }
+
+    if (*cursor == 0) {
+        layout_refresh();
+    }
+
+    // Long name entries precede their short entry, so a slice never ends inside one
+    char lfn[MAX_FILENAME_LENGTH];
+    bool lfn_valid = false;
+    uint8_t lfn_checksum = 0;
+
+    for (uint32_t i = *cursor; i < VFS_ROOT_ENTRIES; i++) {
+        const uint8_t* entry = dir + i * 32;
+
+        if (entry[0] == 0x00) break;
+        if (entry[0] == 0xE5) {
+            lfn_valid = false;
+            continue;
+        }
+
+        if (entry[11] == VFS_ATTR_LFN) {
+            uint32_t sequence = entry[0] & 0x1F;
+            if (entry[0] & 0x40) {
+                memset(lfn, 0, sizeof(lfn));
+                lfn_valid = true;
+                lfn_checksum = entry[13];
+            }
+            if (!lfn_valid || sequence == 0) continue;
+
+            for (uint32_t c = 0; c < VFS_LFN_CHARS; c++) {
+                uint32_t pos = (sequence - 1) * VFS_LFN_CHARS + c;
+                uint8_t lo = entry[lfn_char_offsets[c]];
+                uint8_t hi = entry[lfn_char_offsets[c] + 1];
+                if ((lo == 0x00 && hi == 0x00) || (lo == 0xFF && hi == 0xFF)) break;
+                if (pos >= sizeof(lfn) - 1) {
+                    lfn_valid = false;
+                    break;
+                }
+                lfn[pos] = hi ? '?' : (char)lo;
+            }
+            continue;
+        }
+
+        bool have_lfn = lfn_valid && short_name_checksum(entry) == lfn_checksum;
+        lfn_valid = false;
+
+        if (entry[11] & (VFS_ATTR_VOLUME_ID | VFS_ATTR_DIRECTORY)) continue;
+
+        char name[MAX_FILENAME_LENGTH];
+        if (have_lfn) {
+            memcpy(name, lfn, sizeof(name));
+        } else {
+            // 8.3 name, trimmed and lowercased
+            uint32_t n = 0;
+            for (uint32_t c = 0; c < 8 && entry[c] != ' '; c++) name[n++] = (char)tolower(entry[c]);
+            if (entry[8] != ' ') {
+                name[n++] = '.';
+                for (uint32_t c = 8; c < 11 && entry[c] != ' '; c++) name[n++] = (char)tolower(entry[c]);
+            }
+            name[n] = '\0';
+        }
+
+        // Only known files are committed; editor temp files and the like are ignored
+        if (!file_emu_exists(name)) continue;
+
+        const vfs_dir_entry_t* dir_entry = (const vfs_dir_entry_t*)entry;
+        if (!commit_file(name, dir_entry->cluster_low, dir_entry->size)) {
+            commit_clean = false;
+        }
+
+        if (--max_files == 0) {
+            *cursor = i + 1;
+            return false;
+        }
+    }
+    return true;
+}
+
+//--------------------------------------------------------------------+
+// PUBLIC API
+//--------------------------------------------------------------------+
+bool vfs_init(void) {
+    overlay_reset();
+    layout_refresh();
+    commit_pending = false;
+    commit_running = false;
+    media_changed = false;
+    mounted = true;
+
+    printf("VFS: FAT12 volume ready (%d sectors)\n", VFS_SECTOR_COUNT);
+    return true;
+}
+
+bool vfs_format(void) {
+    // Drop uncommitted host writes and force the host to re-read the volume
+    overlay_reset();
+    commit_pending = false;
+    commit_running = false;
+    media_changed = true;
+    return true;
+}
+
+bool vfs_is_mounted(void) {
+    return mounted;
+}
+
+bool vfs_file_exists(const char* filename) {
+    return file_emu_exists(filename);
+}
+
+bool vfs_read_file(const char* filename, uint8_t* buffer, uint32_t buffer_size, uint32_t* bytes_read) {
+    if (!file_emu_exists(filename)) {
+        return false;
+    }
+
+    uint32_t count = file_emu_read_at(filename, 0, buffer, buffer_size);
+    if (bytes_read) {
+        *bytes_read = count;
+    }
+    return true;
+}
+
+bool vfs_write_file(const char* filename, const uint8_t* data, uint32_t size) {
+    bool ok = file_emu_write(filename, (const char*)data, size);
+    if (ok) {
+        // Layout changed underneath the host
+        vfs_format();
+    }
+    return ok;
+}
+
+bool vfs_delete_file(const char* filename) {
+    // Emulated files always exist (built-ins fall back to their defaults)
+    (void)filename;
+    return false;
+}
+
+uint32_t vfs_get_file_count(void) {
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < MAX_VIRTUAL_FILES; i++) {
+        if (file_emu_get_file_name(i)) count++;
+    }
+    return count;
+}
+
+bool vfs_get_file_info(uint32_t index, char* filename, uint32_t* size) {
+    for (uint32_t i = 0; i < MAX_VIRTUAL_FILES; i++) {
+        const char* name = file_emu_get_file_name(i);
+        if (!name) continue;
+
+        if (index-- == 0) {
+            if (filename) {
+                strncpy(filename, name, VFS_FILENAME_LENGTH - 1);
+                filename[VFS_FILENAME_LENGTH - 1] = '\0';
+            }
+            if (size) {
+                file_emu_get_size(name, size);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+bool vfs_read_sector(uint32_t sector, uint8_t* buffer) {
+    if (sector >= VFS_SECTOR_COUNT) {
+        return false;
+    }
+    vfs_read(sector, 0, buffer, VFS_SECTOR_SIZE);
+    return true;
+}
+
+bool vfs_write_sector(uint32_t sector, const uint8_t* buffer) {
+    // Never erases: with no room left the write is refused until vfs_task has made some
+    if (sector >= VFS_SECTOR_COUNT || !log_has_room()) {
+        return false;
+    }
+
+    if (overlay_map[sector] == 0) {
+        log_live++;             // Otherwise the LBA's previous entry is superseded
+    }
+    log_append(sector, buffer);
+
+    log_committed = false;
+    log_full_reported = false;
+    commit_pending = true;
+    commit_running = false;     // Host is writing again, start over once it is done
+    last_write_ms = vfs_millis();
+    return true;
+}
+
+void vfs_task(void) {
+    if (commit_pending && (vfs_millis() - last_write_ms) >= VFS_COMMIT_DELAY_MS) {
+        commit_pending = false;
+        commit_running = true;
+        commit_clean = true;
+        commit_cursor = 0;
+    }
+
+    // One file per call, so a multi-file save does not hold up the main loop.
+    // A write over the config port owns the file writer: retry next call
+    if (commit_running && file_emu_write_busy()) {
+        return;
+    }
+    if (commit_running) {
+        commit_running = !vfs_commit_changes(&commit_cursor, VFS_COMMIT_FILES_PER_TASK);
+        if (!commit_running && commit_clean && !commit_pending) {
+            log_committed = true;
+        }
+        return;
+    }
+
+    // At most one sector erase per call, and never in the same call as a commit
+    log_maintain();
+}
+
+bool vfs_create_default_files(void) {
+    return file_emu_create_default_files();
+}
+
+//--------------------------------------------------------------------+
+// TINYUSB MSC CALLBACKS
+//--------------------------------------------------------------------+
+#if CFG_TUD_MSC
+
+void tud_msc_inquiry_cb(uint8_t lun, uint8_t vendor_id[8], uint8_t product_id[16], uint8_t product_rev[4]) {
+    (void)lun;
+    memcpy(vendor_id, "BGG     ", 8);
+    memcpy(product_id, "Guitar Config   ", 16);
+    memcpy(product_rev, "1.0 ", 4);
+}
+
+bool tud_msc_test_unit_ready_cb(uint8_t lun) {
+    if (media_changed) {
+        // Report "medium may have changed" once so the host drops its cache
+        media_changed = false;
+        tud_msc_set_sense(lun, SCSI_SENSE_UNIT_ATTENTION, 0x28, 0x00);
+        return false;
+    }
+    return mounted;
+}
+
+void tud_msc_capacity_cb(uint8_t lun, uint32_t* block_count, uint16_t* block_size) {
+    (void)lun;
+    *block_count = VFS_SECTOR_COUNT;
+    *block_size = VFS_SECTOR_SIZE;
+}
+
+bool tud_msc_start_stop_cb(uint8_t lun, uint8_t power_condition, bool start, bool load_eject) {
+    (void)lun;
+    (void)power_condition;
+    (void)start;
+    (void)load_eject;
+    return true;
+}
+
+int32_t tud_msc_read10_cb(uint8_t lun, uint32_t lba, uint32_t offset, void* buffer, uint32_t bufsize) {
+    (void)lun;
+    uint8_t* out = (uint8_t*)buffer;
+    uint32_t remaining = bufsize;
+
+    while (remaining > 0) {
+        if (lba >= VFS_SECTOR_COUNT) {
+            return -1;
+        }
+
+        uint32_t length = VFS_SECTOR_SIZE - offset;
+        if (length > remaining) length = remaining;
+
+        vfs_read(lba, offset, out, length);
+        out += length;
+        remaining -= length;
+        offset = 0;
+        lba++;
+    }
+
+    return (int32_t)bufsize;
+}
+
+bool tud_msc_is_writable_cb(uint8_t lun) {
+    (void)lun;
+    return true;
+}
+
+int32_t tud_msc_write10_cb(uint8_t lun, uint32_t lba, uint32_t offset, uint8_t* buffer, uint32_t bufsize) {
+    // Whole sectors only (CFG_TUD_MSC_EP_BUFSIZE is one sector)
+    if (offset != 0 || (bufsize % VFS_SECTOR_SIZE) != 0) {
+        tud_msc_set_sense(lun, SCSI_SENSE_ILLEGAL_REQUEST, 0x24, 0x00);
+        return -1;
+    }
+
+    // A volume that changed underneath the host must be re-read before it writes
+    if (media_changed) {
+        media_changed = false;
+        tud_msc_set_sense(lun, SCSI_SENSE_UNIT_ATTENTION, 0x28, 0x00);
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < bufsize / VFS_SECTOR_SIZE; i++) {
+        if (lba + i < VFS_SECTOR_COUNT && !log_has_room()) {
+            // Not ready: vfs_task erases ahead or reclaims, the host retries the rest
+            if (i > 0) {
+                return (int32_t)(i * VFS_SECTOR_SIZE);
+            }
+            tud_msc_set_sense(lun, SCSI_SENSE_NOT_READY, 0x04, 0x01);
+            return -1;
+        }
+        if (!vfs_write_sector(lba + i, buffer + i * VFS_SECTOR_SIZE)) {
+            tud_msc_set_sense(lun, SCSI_SENSE_ILLEGAL_REQUEST, 0x21, 0x00);
+            return -1;
+        }
+    }
+
+    return (int32_t)bufsize;
+}
+
+int32_t tud_msc_scsi_cb(uint8_t lun, uint8_t const scsi_cmd[16], void* buffer, uint16_t bufsize) {
+    (void)buffer;
+    (void)bufsize;
+
+    switch (scsi_cmd[0]) {
+        case SCSI_CMD_PREVENT_ALLOW_MEDIUM_REMOVAL:
+            return 0;
+
+        default:
+            // Invalid command operation code
+            tud_msc_set_sense(lun, SCSI_SENSE_ILLEGAL_REQUEST, 0x20, 0x00);
+            return -1;
+    }
+}
+
+#endif // CFG_TUD_MSC
@@ -3,39 +3,79 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "file_emulation.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// Virtual FAT12 volume exposed over USB mass storage.
+//
+// Nothing is stored as a disk image: the boot sector, FAT and root directory
+// are synthesized from the file emulation table, and data sectors are read
+// from the same flash/generated sources as the CDC protocol. Sectors written
+// by the host go to a flash overlay log and are committed to the real files
+// once the host's directory entry and cluster chain describe a complete file.
+//
+// The log is a ring. Host writes only program flash; vfs_task() erases ahead
+// of them and reclaims the oldest entries, copying forward any the host has
+// not overwritten since. When the log has no erased entry left, or is full
+// of sectors the host still needs, a write fails with NOT READY and the host
+// retries. Entries are only dropped wholesale (the host then sees a media
+// change) once everything in them has been committed.
+
 // Virtual filesystem configuration
 #define VFS_SECTOR_SIZE       512
-#define VFS_SECTOR_COUNT      64      // 32KB total virtual disk
+#define VFS_RESERVED_SECTORS  1
+#define VFS_FAT_SECTORS       1
+#define VFS_ROOT_DIR_SECTORS  1
+#define VFS_ROOT_ENTRIES      (VFS_ROOT_DIR_SECTORS * VFS_SECTOR_SIZE / 32)
+
+#define VFS_FAT_LBA           VFS_RESERVED_SECTORS
+#define VFS_ROOT_DIR_LBA      (VFS_FAT_LBA + VFS_FAT_SECTORS)
+#define VFS_DATA_LBA          (VFS_ROOT_DIR_LBA + VFS_ROOT_DIR_SECTORS)
+
+// One sector per cluster; each file owns a fixed cluster range, plus free space for the host
+#define VFS_FILE_CLUSTERS     ((MAX_FILE_CONTENT + VFS_SECTOR_SIZE - 1) / VFS_SECTOR_SIZE)
+#define VFS_FREE_CLUSTERS     64
+#define VFS_CLUSTER_COUNT     (MAX_VIRTUAL_FILES * VFS_FILE_CLUSTERS + VFS_FREE_CLUSTERS)
+
+#define VFS_SECTOR_COUNT      (VFS_DATA_LBA + VFS_CLUSTER_COUNT)
 #define VFS_DISK_SIZE         (VFS_SECTOR_COUNT * VFS_SECTOR_SIZE)
 
+// Host write overlay log in flash, directly below the file emulation slots
+#define VFS_LOG_ENTRIES       128
+#define VFS_LOG_FLASH_SIZE    (VFS_LOG_ENTRIES * VFS_SECTOR_SIZE)
+#define VFS_LOG_FLASH_OFFSET  (FILE_EMU_FLASH_OFFSET - VFS_LOG_FLASH_SIZE)
+#define VFS_LOG_ENTRIES_PER_SECTOR (FLASH_SECTOR_SIZE / VFS_SECTOR_SIZE)
+#define VFS_LOG_ERASE_AHEAD   (2 * VFS_LOG_ENTRIES_PER_SECTOR)  // Kept erased past the next entry by vfs_task()
+// Entries the host may fill; the last flash sector's worth is kept for
+// reclaiming, so the oldest sector's live entries always fit ahead
+#define VFS_LOG_HOST_ENTRIES  (VFS_LOG_ENTRIES - VFS_LOG_ENTRIES_PER_SECTOR)
+
+// Quiet time after the last host write before changes are committed
+#define VFS_COMMIT_DELAY_MS   500
+#define VFS_COMMIT_FILES_PER_TASK 1     // Files checked/committed per vfs_task()
+
 // File system layout
-#define VFS_MAX_FILES         8
-#define VFS_FILENAME_LENGTH   32
-#define VFS_FILE_MAX_SIZE     8192
+#define VFS_FILENAME_LENGTH   MAX_FILENAME_LENGTH
 
-// File allocation table entry
+// FAT directory entry (32 bytes)
 typedef struct {
-    char filename[VFS_FILENAME_LENGTH];
-    uint32_t start_sector;
-    uint32_t size_bytes;
-    bool in_use;
-    uint8_t reserved[8];
-} vfs_file_entry_t;
-
-// Virtual filesystem header (stored in first sector)
-typedef struct {
-    char signature[8];           // "BGGVFS\0\0"
-    uint32_t version;
-    uint32_t total_sectors;
-    uint32_t file_count;
-    vfs_file_entry_t files[VFS_MAX_FILES];
-    uint8_t padding[VFS_SECTOR_SIZE - 16 - (VFS_MAX_FILES * sizeof(vfs_file_entry_t))];
-} vfs_header_t;
+    char name[8];
+    char ext[3];
+    uint8_t attr;
+    uint8_t reserved;
+    uint8_t create_time_ms;
+    uint16_t create_time;
+    uint16_t create_date;
+    uint16_t access_date;
+    uint16_t cluster_high;
+    uint16_t modify_time;
+    uint16_t modify_date;
+    uint16_t cluster_low;
+    uint32_t size;
+} __attribute__((packed)) vfs_dir_entry_t;
 
 // Function prototypes
 bool vfs_init(void);
@@ -56,6 +96,10 @@ bool vfs_get_file_info(uint32_t index, char* filename, uint32_t* size);
 bool vfs_read_sector(uint32_t sector, uint8_t* buffer);
 bool vfs_write_sector(uint32_t sector, const uint8_t* buffer);
 
+// Commit host writes once they settle, erase the log ahead of the host and
+// reclaim old entries (call from the main loop)
+void vfs_task(void);
+
 // Default file creation
 bool vfs_create_default_files(void);
 
@@ -0,0 +1,117 @@
+#include "whammy_cal.h"
+#include "hardware/sync.h"
+#include <stdio.h>
+
+typedef struct {
+    uint16_t min;
+    uint16_t max;
+    uint32_t scale_q16;
+    bool reverse;
+} whammy_cal_t;
+
+// Read in the sample clock interrupt; changed from the main loop with
+// interrupts disabled, or from the interrupt itself while auto-calibrating
+static whammy_cal_t cal;
+static whammy_cal_t saved;              // Range to go back to on cancel
+
+static volatile bool auto_active = false;
+static uint16_t seen_min = 0;
+static uint16_t seen_max = 0;
+
+static void compile(whammy_cal_t* target, uint32_t min, uint32_t max, bool reverse) {
+    if (max > 65535) max = 65535;
+    if (min >= max) min = max - 1;
+
+    target->min = (uint16_t)min;
+    target->max = (uint16_t)max;
+    target->scale_q16 = ((65535u << 16) + (max - min) - 1) / (max - min);  // Rounded up: max maps to 65535
+    target->reverse = reverse;
+}
+
+//--------------------------------------------------------------------+
+// CALIBRATION
+//--------------------------------------------------------------------+
+void whammy_cal_set(uint32_t min, uint32_t max, bool reverse) {
+    whammy_cal_t next;
+    compile(&next, min, max, reverse);
+
+    uint32_t interrupts = save_and_disable_interrupts();
+    cal = next;
+    auto_active = false;
+    restore_interrupts(interrupts);
+}
+
+void whammy_cal_load(const config_t* config) {
+    whammy_cal_set(config->whammy_min, config->whammy_max, config->whammy_reverse);
+}
+
+uint16_t whammy_cal_apply(uint16_t raw) {
+    if (auto_active) {
+        bool wider = false;
+        if (raw < seen_min) { seen_min = raw; wider = true; }
+        if (raw > seen_max) { seen_max = raw; wider = true; }
+        if (wider && seen_max - seen_min >= WHAMMY_CAL_MIN_SPAN) {
+            compile(&cal, seen_min, seen_max, cal.reverse);
+        }
+    }
+
+    uint32_t clamped = raw < cal.min ? cal.min : (raw > cal.max ? cal.max : raw);
+    uint32_t out = ((clamped - cal.min) * cal.scale_q16) >> 16;
+    return (uint16_t)(cal.reverse ? 65535 - out : out);
+}
+
+//--------------------------------------------------------------------+
+// AUTO-CALIBRATION
+//--------------------------------------------------------------------+
+void whammy_cal_auto_start(void) {
+    uint32_t interrupts = save_and_disable_interrupts();
+    if (!auto_active) saved = cal;
+    seen_min = 65535;
+    seen_max = 0;
+    auto_active = true;
+    restore_interrupts(interrupts);
+}
+
+bool whammy_cal_auto_active(void) {
+    return auto_active;
+}
+
+bool whammy_cal_auto_finish(uint32_t* min, uint32_t* max) {
+    uint32_t interrupts = save_and_disable_interrupts();
+    bool enough = auto_active && seen_max >= seen_min && seen_max - seen_min >= WHAMMY_CAL_MIN_SPAN;
+    uint32_t low = seen_min;
+    uint32_t high = seen_max;
+    if (auto_active && !enough) cal = saved;
+    auto_active = false;
+    restore_interrupts(interrupts);
+
+    if (!enough) {
+        return false;
+    }
+
+    uint32_t margin = (high - low) / WHAMMY_CAL_MARGIN_DIV;
+    *min = low + margin;
+    *max = high - margin;
+    return true;
+}
+
+void whammy_cal_auto_cancel(void) {
+    uint32_t interrupts = save_and_disable_interrupts();
+    if (auto_active) {
+        auto_active = false;
+        cal = saved;
+    }
+    restore_interrupts(interrupts);
+}
+
+uint32_t whammy_cal_format_report(char* out, uint32_t size) {
+    int length;
+    if (auto_active) {
+        length = snprintf(out, size, "WHAMMY min %u max %u reverse %d auto on seen_min %u seen_max %u\n",
+                          cal.min, cal.max, cal.reverse, seen_min, seen_max);
+    } else {
+        length = snprintf(out, size, "WHAMMY min %u max %u reverse %d auto off\n",
+                          cal.min, cal.max, cal.reverse);
+    }
+    return (length < (int)size) ? (uint32_t)length : size - 1;
+}
@@ -0,0 +1,53 @@
+#ifndef WHAMMY_CAL_H
+#define WHAMMY_CAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Whammy calibration.
+//
+// whammy_min, whammy_max and whammy_reverse (16-bit ADC units, as in
+// config.json) are compiled once into an offset and a Q16 scale, so each
+// sample costs one subtract, one clamp and one multiply:
+//   out = (clamp(raw, min, max) - min) * scale >> 16, scale = 65535 << 16 / span
+// with the scale rounded up so max lands on 65535; the product stays below
+// 2^32.
+//
+// Auto-calibration tracks the lowest and highest raw value while the
+// player works the bar through its travel; once the travel spans
+// WHAMMY_CAL_MIN_SPAN it is applied live. Finishing pulls both ends in by
+// 1/WHAMMY_CAL_MARGIN_DIV of the span so they are reached reliably, and
+// returns the range for saving to the config.
+
+#define WHAMMY_CAL_DEFAULT_MIN      500
+#define WHAMMY_CAL_DEFAULT_MAX      65000
+#define WHAMMY_CAL_MIN_SPAN         2048
+#define WHAMMY_CAL_MARGIN_DIV       64
+#define WHAMMY_CAL_REPORT_MAX       128
+
+// Calibration functions
+void whammy_cal_set(uint32_t min, uint32_t max, bool reverse);
+void whammy_cal_load(const config_t* config);
+
+// Raw oversampled whammy (0-65535) to the calibrated 0-65535 travel
+uint16_t whammy_cal_apply(uint16_t raw);
+
+// Auto-calibration
+void whammy_cal_auto_start(void);
+bool whammy_cal_auto_active(void);
+bool whammy_cal_auto_finish(uint32_t* min, uint32_t* max);  // false: not enough travel seen
+void whammy_cal_auto_cancel(void);                          // Back to the range before the start
+
+// Render the text report ("WHAMMY" command), returns its length
+uint32_t whammy_cal_format_report(char* out, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WHAMMY_CAL_H